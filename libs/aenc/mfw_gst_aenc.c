@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Module Name:    mfw_gst_aenc.c
+ *
+ * Description:    Common helpers of the audio encoders. Working memory
+ *                 freed by one encoder instance is kept in a process wide
+ *                 pool and handed to the next one, so any number of
+ *                 encoders can run without per instance tables.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+
+#include "mfw_gst_aenc.h"
+
+GST_DEBUG_CATEGORY_STATIC (mfw_gst_aenc_debug);
+#define GST_CAT_DEFAULT mfw_gst_aenc_debug
+
+#define AENC_MIN_ALIGN  (2 * sizeof (gpointer))
+#define AENC_FRAME_ALIGN 4      /* codecs access frames by 32 bit words */
+
+#define AENC_ALIGNED(p) ((((gsize) (p)) & (AENC_FRAME_ALIGN - 1)) == 0)
+
+/* a free block starts with its list link */
+typedef struct _MfwGstAencBlock
+{
+  struct _MfwGstAencBlock *next;
+  gsize size;
+} MfwGstAencBlock;
+
+/* header just before the pointer handed out */
+typedef struct
+{
+  gpointer block;
+  gsize size;
+} MfwGstAencMemHeader;
+
+G_LOCK_DEFINE_STATIC (aenc_pool);
+static MfwGstAencBlock *aenc_pool_list = NULL;
+static gsize aenc_pool_bytes = 0;
+
+static void
+mfw_gst_aenc_init_debug (void)
+{
+  static volatile gsize done = 0;
+
+  if (g_once_init_enter (&done)) {
+    GST_DEBUG_CATEGORY_INIT (mfw_gst_aenc_debug, "mfw_aenc", 0,
+        "Freescale audio encoder helpers");
+    g_once_init_leave (&done, 1);
+  }
+}
+
+gpointer
+mfw_gst_aenc_mem_alloc (gsize size, guint align)
+{
+  MfwGstAencBlock *block, **prev, **best = NULL;
+  MfwGstAencMemHeader *header;
+  gsize total;
+  guint8 *ptr;
+
+  if (align < AENC_MIN_ALIGN)
+    align = AENC_MIN_ALIGN;
+  total = size + align + sizeof (MfwGstAencMemHeader);
+
+  /* best fit, but do not waste more than the block is used */
+  G_LOCK (aenc_pool);
+  for (prev = &aenc_pool_list; *prev; prev = &(*prev)->next) {
+    if (((*prev)->size >= total) && ((*prev)->size <= 2 * total)
+        && ((best == NULL) || ((*prev)->size < (*best)->size)))
+      best = prev;
+  }
+  if (best) {
+    block = *best;
+    *best = block->next;
+    aenc_pool_bytes -= block->size;
+    total = block->size;
+  } else {
+    block = NULL;
+  }
+  G_UNLOCK (aenc_pool);
+
+  if (block == NULL) {
+    block = g_try_malloc (total);
+    if (block == NULL)
+      return NULL;
+  }
+
+  ptr = (guint8 *) block + sizeof (MfwGstAencMemHeader);
+  ptr = (guint8 *) (((gsize) ptr + align - 1) & ~((gsize) align - 1));
+  header = (MfwGstAencMemHeader *) ptr - 1;
+  header->block = block;
+  header->size = total;
+
+  return ptr;
+}
+
+void
+mfw_gst_aenc_mem_free (gpointer ptr)
+{
+  MfwGstAencMemHeader *header;
+  MfwGstAencBlock *block;
+  gsize size;
+
+  if (ptr == NULL)
+    return;
+
+  header = (MfwGstAencMemHeader *) ptr - 1;
+  block = header->block;
+  size = header->size;
+
+  G_LOCK (aenc_pool);
+  if (aenc_pool_bytes + size <= MFW_GST_AENC_POOL_MAX) {
+    block->size = size;
+    block->next = aenc_pool_list;
+    aenc_pool_list = block;
+    aenc_pool_bytes += size;
+    block = NULL;
+  }
+  G_UNLOCK (aenc_pool);
+
+  g_free (block);
+}
+
+void
+mfw_gst_aenc_batch_init (MfwGstAencBatch * batch, GstPad * srcpad,
+    guint frame_size, guint max_out_size, guint bytes_per_second,
+    gboolean copy_input)
+{
+  mfw_gst_aenc_init_debug ();
+
+  memset (batch, 0, sizeof (MfwGstAencBatch));
+  batch->srcpad = srcpad;
+  batch->frame_size = frame_size;
+  batch->max_out_size = max_out_size;
+  batch->bytes_per_second = bytes_per_second;
+  batch->max_frames = MFW_GST_AENC_DEFAULT_BATCH;
+  batch->copy_input = copy_input;
+
+  batch->frame_duration = bytes_per_second ?
+      gst_util_uint64_scale_int (frame_size, GST_SECOND, bytes_per_second) :
+      GST_CLOCK_TIME_NONE;
+  batch->next_ts = GST_CLOCK_TIME_NONE;
+  batch->discont = TRUE;
+  batch->scratch = mfw_gst_aenc_mem_alloc (frame_size, 0);
+  batch->out_scratch = mfw_gst_aenc_mem_alloc (max_out_size, 0);
+}
+
+void
+mfw_gst_aenc_batch_free (MfwGstAencBatch * batch)
+{
+  mfw_gst_aenc_mem_free (batch->scratch);
+  batch->scratch = NULL;
+  mfw_gst_aenc_mem_free (batch->out_scratch);
+  batch->out_scratch = NULL;
+}
+
+void
+mfw_gst_aenc_batch_flush (MfwGstAencBatch * batch, GstAdapter * adapter)
+{
+  gst_adapter_clear (adapter);
+  batch->next_ts = GST_CLOCK_TIME_NONE;
+  batch->discont = TRUE;
+}
+
+/* timestamp of the first byte in the adapter */
+static GstClockTime
+mfw_gst_aenc_batch_timestamp (MfwGstAencBatch * batch, GstAdapter * adapter)
+{
+  GstClockTime ts;
+  guint64 distance;
+
+  ts = gst_adapter_prev_timestamp (adapter, &distance);
+  if (GST_CLOCK_TIME_IS_VALID (ts) && batch->bytes_per_second) {
+    ts += gst_util_uint64_scale_int (distance, GST_SECOND,
+        batch->bytes_per_second);
+    return ts;
+  }
+  return batch->next_ts;
+}
+
+GstFlowReturn
+mfw_gst_aenc_batch_encode (MfwGstAencBatch * batch, GstAdapter * adapter,
+    MfwGstAencFrameFunc func, gpointer user_data)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstBuffer *outbuf;
+  GstClockTime ts, frame_ts;
+  const guint8 *data;
+  guint8 *in, *out, *dst;
+  guint frames, i, size;
+  gint len;
+
+  if ((batch->frame_size == 0) || (batch->scratch == NULL)
+      || (batch->out_scratch == NULL))
+    return GST_FLOW_OK;
+
+  while ((ret == GST_FLOW_OK)
+      && ((frames = gst_adapter_available (adapter) / batch->frame_size))) {
+    frames = MIN (frames, MAX (batch->max_frames, 1));
+    ts = mfw_gst_aenc_batch_timestamp (batch, adapter);
+
+    ret = gst_pad_alloc_buffer_and_set_caps (batch->srcpad,
+        GST_BUFFER_OFFSET_NONE, frames * batch->max_out_size,
+        GST_PAD_CAPS (batch->srcpad), &outbuf);
+    if (ret != GST_FLOW_OK) {
+      GST_WARNING ("Can not allocate buffer from next element!");
+      break;
+    }
+
+    /* merges at most once when the frames span input buffers */
+    data = gst_adapter_peek (adapter, frames * batch->frame_size);
+    out = GST_BUFFER_DATA (outbuf);
+    size = 0;
+    frame_ts = ts;
+
+    for (i = 0; i < frames; i++) {
+      in = (guint8 *) data + i * batch->frame_size;
+      if ((batch->copy_input) || (!AENC_ALIGNED (in))) {
+        memcpy (batch->scratch, in, batch->frame_size);
+        in = batch->scratch;
+      }
+
+      /* packed frames have odd sizes, the codec writes aligned */
+      dst = AENC_ALIGNED (out + size) ? out + size : batch->out_scratch;
+      len = func (user_data, in, dst, frame_ts);
+      if (len < 0) {
+        ret = GST_FLOW_ERROR;
+        break;
+      }
+      if (dst != out + size)
+        memcpy (out + size, dst, len);
+      size += len;
+
+      if (GST_CLOCK_TIME_IS_VALID (frame_ts))
+        frame_ts += batch->frame_duration;
+    }
+    /* frames after an error are dropped as well */
+    gst_adapter_flush (adapter, frames * batch->frame_size);
+    batch->next_ts = frame_ts;
+
+    GST_LOG ("%d frames, %d bytes, ts %" GST_TIME_FORMAT, i, size,
+        GST_TIME_ARGS (ts));
+
+    if (size == 0) {
+      gst_buffer_unref (outbuf);
+      continue;
+    }
+
+    GST_BUFFER_SIZE (outbuf) = size;
+    GST_BUFFER_TIMESTAMP (outbuf) = ts;
+    GST_BUFFER_DURATION (outbuf) =
+        GST_CLOCK_TIME_IS_VALID (batch->frame_duration) ?
+        i * batch->frame_duration : GST_CLOCK_TIME_NONE;
+    if (batch->discont) {
+      GST_BUFFER_FLAG_SET (outbuf, GST_BUFFER_FLAG_DISCONT);
+      batch->discont = FALSE;
+    }
+
+    if (ret == GST_FLOW_OK)
+      ret = gst_pad_push (batch->srcpad, outbuf);
+    else
+      gst_pad_push (batch->srcpad, outbuf);
+  }
+
+  return ret;
+}
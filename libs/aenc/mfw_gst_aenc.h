@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Module Name:    mfw_gst_aenc.h
+ *
+ * Description:    Common helpers of the audio encoders: a shared pool for
+ *                 the codec working memory and a batched encode loop
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __MFW_GST_AENC_H__
+#define __MFW_GST_AENC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstadapter.h>
+
+G_BEGIN_DECLS
+
+#define MFW_GST_AENC_DEFAULT_BATCH  32  /* frames per output buffer */
+#define MFW_GST_AENC_POOL_MAX       (4 * 1024 * 1024)   /* bytes kept free */
+
+/*!
+ * Encode one frame.
+ *
+ * @param   user_data   the encoder element
+ * @param   in          frame_size bytes of input
+ * @param   out         room for max_out_size bytes of output
+ * @param   timestamp   timestamp of the frame, may be GST_CLOCK_TIME_NONE
+ *
+ * @return  bytes written to out, -1 on error.
+ */
+typedef gint (*MfwGstAencFrameFunc) (gpointer user_data, guint8 * in,
+    guint8 * out, GstClockTime timestamp);
+
+/*
+ * Batched encode state. All complete frames in the adapter, up to
+ * max_frames, are encoded into one output buffer whose timestamp is the
+ * one of the first frame and whose duration covers all of them; frame n
+ * of the buffer starts at timestamp + n * frame_duration.
+ */
+typedef struct
+{
+  GstPad *srcpad;
+  guint frame_size;             /* input bytes per frame */
+  guint max_out_size;           /* worst case output bytes per frame */
+  guint bytes_per_second;       /* input byte rate, 0 for no timestamps */
+  guint max_frames;             /* frames per output buffer */
+  gboolean copy_input;          /* the codec writes into its input */
+
+  /*< private > */
+  GstClockTime frame_duration;
+  GstClockTime next_ts;
+  gboolean discont;
+  guint8 *scratch;
+  guint8 *out_scratch;
+} MfwGstAencBatch;
+
+/*!
+ * Allocate codec working memory from the pool shared by all encoder
+ * instances in the process.
+ *
+ * @param   size    bytes
+ * @param   align   alignment, a power of 2, 0 for the default
+ *
+ * @return  the memory, NULL on failure. It is not cleared.
+ */
+gpointer mfw_gst_aenc_mem_alloc (gsize size, guint align);
+
+/*!
+ * Return working memory to the pool, NULL is ignored.
+ */
+void mfw_gst_aenc_mem_free (gpointer ptr);
+
+/*!
+ * Set up the batch state once the frame geometry is known.
+ */
+void mfw_gst_aenc_batch_init (MfwGstAencBatch * batch, GstPad * srcpad,
+    guint frame_size, guint max_out_size, guint bytes_per_second,
+    gboolean copy_input);
+
+/*!
+ * Release the batch state.
+ */
+void mfw_gst_aenc_batch_free (MfwGstAencBatch * batch);
+
+/*!
+ * Drop the queued input, the next output buffer is marked discont.
+ */
+void mfw_gst_aenc_batch_flush (MfwGstAencBatch * batch, GstAdapter * adapter);
+
+/*!
+ * Encode and push all complete frames in the adapter. The input is read
+ * in place from the adapter, or through a scratch copy if copy_input is
+ * set or it is not word aligned. A frame whose output offset is not word
+ * aligned is encoded into a scratch buffer and copied. Bytes of an
+ * incomplete frame are left in the adapter.
+ */
+GstFlowReturn mfw_gst_aenc_batch_encode (MfwGstAencBatch * batch,
+    GstAdapter * adapter, MfwGstAencFrameFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __MFW_GST_AENC_H__ */
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/*
+ * Module Name:    mfw_gst_aenc_test.c
+ *
+ * Description:    Test of the batched encode path and the working memory
+ *                 pool. Input arrives in buffers of random size, with or
+ *                 without timestamps and with flushes in between, and is
+ *                 encoded by a fake codec whose output has odd sizes and
+ *                 depends on every input byte. Output data, timestamps,
+ *                 durations, discont flags and batch sizes are checked
+ *                 against a model of the stream, as are the word alignment
+ *                 the codecs rely on and that input buffers stay untouched.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+
+#include "mfw_gst_aenc.h"
+
+#define AENC_TEST_SEED      0xae4c
+#define AENC_TEST_PUSHES    3000
+#define AENC_TEST_THREADS   4
+
+#define AENC_TEST_ALIGNED(p) ((((gsize) (p)) & 3) == 0)
+
+/* the fake codec, records what it was called with */
+typedef struct
+{
+  guint frame_size;
+  guint max_out_size;
+  gboolean scribble;            /* writes into its input, as amr does */
+  gint poison;                  /* frame to fail on, -1 for none */
+  guint frames;                 /* frames encoded */
+  GstClockTime first_ts;        /* timestamp of the batch's first frame */
+} AencTestCodec;
+
+/*
+ * The stream model. Input is timestamped continuously from a base that
+ * changes on every flush, so any input buffer the timestamp is derived
+ * from gives the same result within rounding.
+ */
+typedef struct
+{
+  AencTestCodec codec;
+  MfwGstAencBatch batch;
+  GstAdapter *adapter;
+  GstPad *srcpad;
+  GstPad *sinkpad;
+  GByteArray *expected;         /* output of all frames encoded */
+  GArray *lengths;              /* output bytes per frame */
+  GPtrArray *inputs;            /* input buffers not yet checked */
+  GByteArray *inputs_data;      /* their data as pushed */
+  GstClockTime base;            /* timestamp of segment offset 0 */
+  guint segment;                /* frames received before the segment */
+  guint64 pushed;               /* bytes pushed in this segment */
+  guint64 encoded;              /* bytes of the segment encoded */
+  guint received;               /* frames received by the sink */
+  guint64 received_bytes;
+  gboolean discont;             /* next buffer must be discont */
+} AencTest;
+
+static gint failures;
+static AencTest *current;
+
+/* a hash of the input decides the length and content of the output */
+static guint32
+aenc_test_hash (const guint8 * in, guint size)
+{
+  guint32 h = 2166136261u;
+  guint i;
+
+  for (i = 0; i < size; i++)
+    h = (h ^ in[i]) * 16777619u;
+  return h;
+}
+
+static guint
+aenc_test_code (AencTestCodec * codec, const guint8 * in, guint8 * out)
+{
+  guint32 h = aenc_test_hash (in, codec->frame_size);
+  guint len = 1 + h % codec->max_out_size;
+  guint i;
+
+  for (i = 0; i < len; i++)
+    out[i] = (guint8) ((h >> ((i & 3) * 8)) ^ i);
+  return len;
+}
+
+static gint
+aenc_test_frame (gpointer user_data, guint8 * in, guint8 * out,
+    GstClockTime timestamp)
+{
+  AencTest *t = user_data;
+  AencTestCodec *codec = &t->codec;
+  guint len;
+  gint64 diff;
+
+  if (!AENC_TEST_ALIGNED (in) || !AENC_TEST_ALIGNED (out)) {
+    g_printerr ("frame %u: unaligned in %p out %p\n", codec->frames, in, out);
+    failures++;
+  }
+
+  /* frames of a batch follow the first one at the frame duration */
+  if (codec->frames == t->received)
+    codec->first_ts = timestamp;
+  if (GST_CLOCK_TIME_IS_VALID (timestamp)
+      != GST_CLOCK_TIME_IS_VALID (codec->first_ts)) {
+    g_printerr ("frame %u: timestamp validity changed in a batch\n",
+        codec->frames);
+    failures++;
+  } else if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+    diff = timestamp - codec->first_ts -
+        (codec->frames - t->received) * t->batch.frame_duration;
+    if (diff != 0) {
+      g_printerr ("frame %u: timestamp off by %" G_GINT64_FORMAT " ns\n",
+          codec->frames, diff);
+      failures++;
+    }
+  }
+
+  if ((gint) codec->frames == codec->poison) {
+    codec->frames++;
+    return -1;
+  }
+
+  len = aenc_test_code (codec, in, out);
+  if (codec->scribble)
+    memset (in, 0xee, codec->frame_size);
+  codec->frames++;
+  return len;
+}
+
+static GstFlowReturn
+aenc_test_chain (GstPad * pad, GstBuffer * buffer)
+{
+  AencTest *t = current;
+  GstClockTime want;
+  guint frames, i, size = 0;
+  gint64 diff;
+
+  frames = t->codec.frames - t->received;
+  if ((frames == 0) || (frames > t->batch.max_frames)) {
+    g_printerr ("buffer of %u frames, batch of %u\n", frames,
+        t->batch.max_frames);
+    failures++;
+  }
+  /* a failed frame is the last one encoded but not in the buffer */
+  if (t->codec.poison == (gint) t->codec.frames - 1)
+    frames--;
+  for (i = 0; i < frames; i++)
+    size += g_array_index (t->lengths, guint, t->received + i);
+
+  if ((GST_BUFFER_SIZE (buffer) != size)
+      || (t->received_bytes + size > t->expected->len)
+      || memcmp (GST_BUFFER_DATA (buffer),
+          t->expected->data + t->received_bytes, size)) {
+    g_printerr ("frames %u+%u: %u bytes not as encoded, want %u\n",
+        t->received, frames, GST_BUFFER_SIZE (buffer), size);
+    failures++;
+  }
+
+  if (t->batch.bytes_per_second) {
+    want = t->base + gst_util_uint64_scale_int ((t->received - t->segment) *
+        (guint64) t->codec.frame_size, GST_SECOND, t->batch.bytes_per_second);
+    diff = GST_BUFFER_TIMESTAMP (buffer) - want;
+    if (!GST_BUFFER_TIMESTAMP_IS_VALID (buffer) || (diff < -1) || (diff > 1)
+        || (GST_BUFFER_DURATION (buffer) != frames * t->batch.frame_duration)) {
+      g_printerr ("frames %u+%u: timestamp %" GST_TIME_FORMAT " duration %"
+          GST_TIME_FORMAT ", want %" GST_TIME_FORMAT "\n", t->received,
+          frames, GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (buffer)),
+          GST_TIME_ARGS (GST_BUFFER_DURATION (buffer)), GST_TIME_ARGS (want));
+      failures++;
+    }
+  } else if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer)
+      || GST_BUFFER_DURATION_IS_VALID (buffer)) {
+    g_printerr ("frames %u+%u: timestamped without a byte rate\n",
+        t->received, frames);
+    failures++;
+  }
+
+  if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT) != t->discont) {
+    g_printerr ("frames %u+%u: discont %d, want %d\n", t->received, frames,
+        !t->discont, t->discont);
+    failures++;
+  }
+  t->discont = FALSE;
+
+  t->received = t->codec.frames;
+  t->received_bytes += size;
+  gst_buffer_unref (buffer);
+  return GST_FLOW_OK;
+}
+
+static void
+aenc_test_setup (AencTest * t, guint frame_size, guint max_out_size,
+    guint bytes_per_second, gboolean scribble, guint max_frames)
+{
+  memset (t, 0, sizeof (AencTest));
+  t->codec.frame_size = frame_size;
+  t->codec.max_out_size = max_out_size;
+  t->codec.scribble = scribble;
+  t->codec.poison = -1;
+
+  t->srcpad = gst_pad_new ("src", GST_PAD_SRC);
+  t->sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (t->sinkpad, aenc_test_chain);
+  gst_pad_link (t->srcpad, t->sinkpad);
+  gst_pad_set_active (t->srcpad, TRUE);
+  gst_pad_set_active (t->sinkpad, TRUE);
+
+  t->adapter = gst_adapter_new ();
+  mfw_gst_aenc_batch_init (&t->batch, t->srcpad, frame_size, max_out_size,
+      bytes_per_second, scribble);
+  if (max_frames)
+    t->batch.max_frames = max_frames;
+
+  t->expected = g_byte_array_new ();
+  t->lengths = g_array_new (FALSE, FALSE, sizeof (guint));
+  t->inputs = g_ptr_array_new ();
+  t->inputs_data = g_byte_array_new ();
+  t->discont = TRUE;
+  current = t;
+}
+
+/* input handed to the encoder must come back unmodified */
+static void
+aenc_test_check_inputs (AencTest * t)
+{
+  GstBuffer *buffer;
+  guint i, offset = 0;
+
+  for (i = 0; i < t->inputs->len; i++) {
+    buffer = g_ptr_array_index (t->inputs, i);
+    if (memcmp (GST_BUFFER_DATA (buffer), t->inputs_data->data + offset,
+            GST_BUFFER_SIZE (buffer))) {
+      g_printerr ("input buffer of %u bytes modified\n",
+          GST_BUFFER_SIZE (buffer));
+      failures++;
+    }
+    offset += GST_BUFFER_SIZE (buffer);
+    gst_buffer_unref (buffer);
+  }
+  g_ptr_array_set_size (t->inputs, 0);
+  g_byte_array_set_size (t->inputs_data, 0);
+}
+
+static void
+aenc_test_teardown (AencTest * t)
+{
+  aenc_test_check_inputs (t);
+  if (t->received_bytes != t->expected->len) {
+    g_printerr ("%u bytes received, %u encoded\n", (guint) t->received_bytes,
+        t->expected->len);
+    failures++;
+  }
+
+  mfw_gst_aenc_batch_free (&t->batch);
+  g_object_unref (t->adapter);
+  gst_pad_set_active (t->srcpad, FALSE);
+  gst_pad_set_active (t->sinkpad, FALSE);
+  gst_object_unref (t->srcpad);
+  gst_object_unref (t->sinkpad);
+  g_byte_array_free (t->expected, TRUE);
+  g_array_free (t->lengths, TRUE);
+  g_ptr_array_free (t->inputs, TRUE);
+  g_byte_array_free (t->inputs_data, TRUE);
+  current = NULL;
+}
+
+/* push size random bytes, the model encodes the frames it completes */
+static GstFlowReturn
+aenc_test_push (AencTest * t, GRand * rand, guint size, gboolean timestamp)
+{
+  GstBuffer *buffer = gst_buffer_new_and_alloc (size);
+  guint8 *out;
+  guint32 r = 0;
+  guint i, len, start;
+
+  for (i = 0; i < size; i++) {
+    if ((i & 3) == 0)
+      r = g_rand_int (rand);
+    GST_BUFFER_DATA (buffer)[i] = r >> ((i & 3) * 8);
+  }
+  if (timestamp && t->batch.bytes_per_second)
+    GST_BUFFER_TIMESTAMP (buffer) = t->base +
+        gst_util_uint64_scale_int (t->pushed, GST_SECOND,
+        t->batch.bytes_per_second);
+
+  start = t->inputs_data->len - (guint) (t->pushed - t->encoded);
+  g_ptr_array_add (t->inputs, gst_buffer_ref (buffer));
+  g_byte_array_append (t->inputs_data, GST_BUFFER_DATA (buffer), size);
+  t->pushed += size;
+
+  /* frames are encoded in order, whatever the batching */
+  out = g_malloc (t->codec.max_out_size);
+  while (t->pushed - t->encoded >= t->codec.frame_size) {
+    len = aenc_test_code (&t->codec, t->inputs_data->data + start, out);
+    g_byte_array_append (t->expected, out, len);
+    g_array_append_val (t->lengths, len);
+    start += t->codec.frame_size;
+    t->encoded += t->codec.frame_size;
+  }
+  g_free (out);
+
+  gst_adapter_push (t->adapter, buffer);
+  return mfw_gst_aenc_batch_encode (&t->batch, t->adapter, aenc_test_frame, t);
+}
+
+static void
+aenc_test_flush (AencTest * t, GRand * rand)
+{
+  mfw_gst_aenc_batch_flush (&t->batch, t->adapter);
+  aenc_test_check_inputs (t);
+  t->base = g_rand_int_range (rand, 0, 100000) * GST_MSECOND;
+  t->segment = t->received;
+  t->pushed = 0;
+  t->encoded = 0;
+  t->discont = TRUE;
+}
+
+/*
+ * Feed a stream in buffers of 1 to 2 * mean bytes. One buffer in ten has
+ * no timestamp, one in a hundred is followed by a flush.
+ */
+static void
+aenc_test_stream (GRand * rand, guint frame_size, guint max_out_size,
+    guint bytes_per_second, gboolean scribble, guint max_frames, guint mean)
+{
+  AencTest t;
+  GstFlowReturn ret;
+  gboolean timestamp = TRUE;
+  guint i;
+
+  aenc_test_setup (&t, frame_size, max_out_size, bytes_per_second, scribble,
+      max_frames);
+  aenc_test_flush (&t, rand);
+
+  for (i = 0; i < AENC_TEST_PUSHES; i++) {
+    ret = aenc_test_push (&t, rand, g_rand_int_range (rand, 1, 2 * mean + 1),
+        timestamp);
+    if (ret != GST_FLOW_OK) {
+      g_printerr ("frame %u: encode returned %d\n", t.codec.frames, ret);
+      failures++;
+      break;
+    }
+    if (g_rand_int_range (rand, 0, 100) == 0) {
+      aenc_test_flush (&t, rand);
+      /* the first buffer of a segment carries a timestamp */
+      timestamp = TRUE;
+    } else {
+      timestamp = g_rand_int_range (rand, 0, 10) != 0;
+    }
+    if ((t.inputs->len > 64) && (t.pushed == t.encoded))
+      aenc_test_check_inputs (&t);
+  }
+
+  if ((gst_adapter_available (t.adapter) != t.pushed - t.encoded)
+      || (t.received != t.codec.frames)) {
+    g_printerr ("frame size %u: %u bytes left, want %u\n", frame_size,
+        gst_adapter_available (t.adapter), (guint) (t.pushed - t.encoded));
+    failures++;
+  }
+  aenc_test_teardown (&t);
+}
+
+/*
+ * A codec error ends the call. The frames before it are pushed, the rest
+ * of the batch is dropped and the next call carries on after it.
+ */
+static void
+aenc_test_error (GRand * rand)
+{
+  AencTest t;
+  GstFlowReturn ret;
+  guint8 *out;
+  guint len;
+
+  aenc_test_setup (&t, 256, 64, 32000, FALSE, 8);
+  aenc_test_flush (&t, rand);
+  t.codec.poison = 3;
+
+  ret = aenc_test_push (&t, rand, 256 * 10, TRUE);
+  if ((ret != GST_FLOW_ERROR) || (t.codec.frames != 4) || (t.received != 4)
+      || (gst_adapter_available (t.adapter) != 256 * 2)) {
+    g_printerr ("error: returned %d after %u frames, %u received, %u left\n",
+        ret, t.codec.frames, t.received, gst_adapter_available (t.adapter));
+    failures++;
+  }
+
+  /*
+   * The model has all 10 frames, the encoder failed frame 3 and dropped
+   * 4 to 7, so 8 and 9 come next. Its frame count only went up to 3.
+   */
+  out = t.expected->data + t.received_bytes;
+  len = t.expected->len - t.received_bytes;
+  g_memmove (out, out + len - g_array_index (t.lengths, guint, 8) -
+      g_array_index (t.lengths, guint, 9), g_array_index (t.lengths, guint,
+          8) + g_array_index (t.lengths, guint, 9));
+  g_byte_array_set_size (t.expected, t.received_bytes +
+      g_array_index (t.lengths, guint, 8) + g_array_index (t.lengths, guint,
+          9));
+  g_array_remove_range (t.lengths, 4, 4);
+  t.base += gst_util_uint64_scale_int (4 * 256, GST_SECOND, 32000);
+
+  ret = mfw_gst_aenc_batch_encode (&t.batch, t.adapter, aenc_test_frame, &t);
+  if ((ret != GST_FLOW_OK) || (t.codec.frames != 6)) {
+    g_printerr ("error: returned %d on the frames after it\n", ret);
+    failures++;
+  }
+  aenc_test_teardown (&t);
+}
+
+/* blocks are aligned, usable, reused and safe to share between threads */
+static gpointer
+aenc_test_pool (gpointer data)
+{
+  static const guint aligns[] = { 0, 4, 16, 64, 4096 };
+  GRand *rand = g_rand_new_with_seed (GPOINTER_TO_UINT (data));
+  guint8 *blocks[64] = { NULL };
+  gsize sizes[64];
+  guint i, n, align;
+
+  for (i = 0; i < 20000; i++) {
+    n = g_rand_int_range (rand, 0, 64);
+    if (blocks[n]) {
+      if ((blocks[n][0] != (guint8) n)
+          || (blocks[n][sizes[n] - 1] != (guint8) ~n)) {
+        g_printerr ("pool: block of %u bytes overwritten\n",
+            (guint) sizes[n]);
+        g_atomic_int_inc (&failures);
+      }
+      mfw_gst_aenc_mem_free (blocks[n]);
+      blocks[n] = NULL;
+      continue;
+    }
+    align = aligns[g_rand_int_range (rand, 0, G_N_ELEMENTS (aligns))];
+    sizes[n] = g_rand_int_range (rand, 2, 256 * 1024);
+    blocks[n] = mfw_gst_aenc_mem_alloc (sizes[n], align);
+    if ((blocks[n] == NULL)
+        || ((gsize) blocks[n] & (MAX (align, 2 * sizeof (gpointer)) - 1))) {
+      g_printerr ("pool: block %p for %u bytes aligned to %u\n", blocks[n],
+          (guint) sizes[n], align);
+      g_atomic_int_inc (&failures);
+      break;
+    }
+    blocks[n][0] = (guint8) n;
+    blocks[n][sizes[n] - 1] = (guint8) ~n;
+  }
+
+  for (i = 0; i < 64; i++)
+    mfw_gst_aenc_mem_free (blocks[i]);
+  g_rand_free (rand);
+  return NULL;
+}
+
+static void
+aenc_test_pool_reuse (void)
+{
+  gpointer a, b;
+
+  a = mfw_gst_aenc_mem_alloc (10000, 64);
+  mfw_gst_aenc_mem_free (a);
+  b = mfw_gst_aenc_mem_alloc (10000, 64);
+  if (a != b) {
+    g_printerr ("pool: freed block not reused\n");
+    failures++;
+  }
+  mfw_gst_aenc_mem_free (b);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GThread *threads[AENC_TEST_THREADS];
+  GRand *rand;
+  guint i;
+
+  gst_init (&argc, &argv);
+  rand = g_rand_new_with_seed (AENC_TEST_SEED);
+
+  /* mp3 stereo frames in page sized buffers */
+  aenc_test_stream (rand, 4608, 1441, 176400, FALSE, 0, 4096);
+  /* amr frames written by the codec, whole frames are read in place */
+  aenc_test_stream (rand, 320, 32, 16000, TRUE, 0, 2000);
+  /* small odd buffers, most frames span several */
+  aenc_test_stream (rand, 320, 32, 16000, FALSE, 0, 37);
+  /* odd frame size, big buffers cut into short batches */
+  aenc_test_stream (rand, 417, 97, 48000, FALSE, 7, 20000);
+  /* a byte stream without timestamps, as wma8 */
+  aenc_test_stream (rand, 2048, 515, 0, FALSE, 0, 1500);
+  aenc_test_error (rand);
+
+  aenc_test_pool_reuse ();
+  for (i = 0; i < AENC_TEST_THREADS; i++)
+    threads[i] = g_thread_create (aenc_test_pool, GUINT_TO_POINTER (i + 1),
+        TRUE, NULL);
+  for (i = 0; i < AENC_TEST_THREADS; i++)
+    g_thread_join (threads[i]);
+
+  g_rand_free (rand);
+  g_print ("%d failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
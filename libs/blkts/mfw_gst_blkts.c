@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Module Name:    mfw_gst_blkts.c
+ *
+ * Description:    Byte count based timestamp queue for audio decoders. The
+ *                 entries live in fixed size chunks linked to the queue, a
+ *                 new chunk is only added when the free list is empty.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+
+#include "mfw_gst_blkts.h"
+
+struct _MfwGstBlockTsEntry
+{
+  MfwGstBlockTsEntry *next;
+  guint length;                 /* bytes not consumed yet */
+  GstClockTime timestamp;
+  gboolean discont;
+};
+
+struct _MfwGstBlockTsChunk
+{
+  MfwGstBlockTsChunk *next;
+  MfwGstBlockTsEntry entries[MFW_GST_BLKTS_CHUNK_ENTRIES];
+};
+
+static MfwGstBlockTsEntry *
+mfw_gst_blkts_new_entry (MfwGstBlockTs * bts)
+{
+  MfwGstBlockTsEntry *entry;
+  MfwGstBlockTsChunk *chunk;
+  gint i;
+
+  if (bts->freelist == NULL) {
+    chunk = g_try_new (MfwGstBlockTsChunk, 1);
+    if (chunk == NULL)
+      return NULL;
+
+    chunk->next = bts->chunks;
+    bts->chunks = chunk;
+    for (i = MFW_GST_BLKTS_CHUNK_ENTRIES - 1; i >= 0; i--) {
+      chunk->entries[i].next = bts->freelist;
+      bts->freelist = &chunk->entries[i];
+    }
+    bts->allocated += MFW_GST_BLKTS_CHUNK_ENTRIES;
+  }
+
+  entry = bts->freelist;
+  bts->freelist = entry->next;
+  return entry;
+}
+
+void
+mfw_gst_blkts_init (MfwGstBlockTs * bts)
+{
+  memset (bts, 0, sizeof (MfwGstBlockTs));
+}
+
+void
+mfw_gst_blkts_deinit (MfwGstBlockTs * bts)
+{
+  MfwGstBlockTsChunk *chunk;
+
+  while ((chunk = bts->chunks)) {
+    bts->chunks = chunk->next;
+    g_free (chunk);
+  }
+  memset (bts, 0, sizeof (MfwGstBlockTs));
+}
+
+void
+mfw_gst_blkts_clear (MfwGstBlockTs * bts)
+{
+  if (bts->head) {
+    bts->tail->next = bts->freelist;
+    bts->freelist = bts->head;
+  }
+  bts->head = bts->tail = NULL;
+  bts->queued = 0;
+  bts->discont = TRUE;
+}
+
+gboolean
+mfw_gst_blkts_push (MfwGstBlockTs * bts, guint length,
+    GstClockTime timestamp, gboolean discont)
+{
+  MfwGstBlockTsEntry *entry;
+
+  if (length == 0) {
+    bts->discont |= discont;
+    return TRUE;
+  }
+
+  entry = mfw_gst_blkts_new_entry (bts);
+  if (entry == NULL)
+    return FALSE;
+
+  entry->next = NULL;
+  entry->length = length;
+  entry->timestamp = timestamp;
+  entry->discont = discont || bts->discont;
+  bts->discont = FALSE;
+
+  if (bts->tail)
+    bts->tail->next = entry;
+  else
+    bts->head = entry;
+  bts->tail = entry;
+  bts->queued += length;
+
+  return TRUE;
+}
+
+GstClockTime
+mfw_gst_blkts_consume (MfwGstBlockTs * bts, guint length, gboolean * discont)
+{
+  MfwGstBlockTsEntry *entry = bts->head;
+  GstClockTime ts = GST_CLOCK_TIME_NONE;
+  gboolean disc = FALSE;
+
+  if (entry) {
+    ts = entry->timestamp;
+    if (entry->discont) {
+      disc = TRUE;
+      entry->discont = FALSE;
+    }
+
+    while (entry && (length >= entry->length)) {
+      length -= entry->length;
+      bts->queued -= entry->length;
+
+      bts->head = entry->next;
+      if (bts->head == NULL)
+        bts->tail = NULL;
+      entry->next = bts->freelist;
+      bts->freelist = entry;
+
+      entry = bts->head;
+      /* the consumed bytes run into this block */
+      if (entry && length && entry->discont) {
+        ts = entry->timestamp;
+        disc = TRUE;
+        entry->discont = FALSE;
+      }
+    }
+
+    if (entry) {
+      entry->length -= length;
+      bts->queued -= length;
+    }
+  }
+
+  if (discont)
+    *discont = disc;
+  return ts;
+}
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Module Name:    mfw_gst_blkts.h
+ *
+ * Description:    Byte count based timestamp queue for audio decoders which
+ *                 collect their input in an adapter
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __MFW_GST_BLKTS_H__
+#define __MFW_GST_BLKTS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* entries added to the pool each time it runs dry */
+#define MFW_GST_BLKTS_CHUNK_ENTRIES 32
+
+typedef struct _MfwGstBlockTsEntry MfwGstBlockTsEntry;
+typedef struct _MfwGstBlockTsChunk MfwGstBlockTsChunk;
+
+/*
+ * Every pushed input buffer is one entry holding its byte length and
+ * timestamp. Entries come from chunks which are never moved or freed
+ * before mfw_gst_blkts_deinit, so growing the pool does not copy the
+ * queue. The structure may be embedded in the element.
+ */
+typedef struct
+{
+  MfwGstBlockTsChunk *chunks;
+  MfwGstBlockTsEntry *freelist;
+  MfwGstBlockTsEntry *head;
+  MfwGstBlockTsEntry *tail;
+  guint allocated;              /* entries in all chunks */
+  guint queued;                 /* bytes in the queue */
+  gboolean discont;             /* mark the next pushed entry */
+} MfwGstBlockTs;
+
+/*!
+ * Initialize an empty queue, no entry is allocated yet.
+ */
+void mfw_gst_blkts_init (MfwGstBlockTs * bts);
+
+/*!
+ * Free all chunks, the queue must be initialized again before reuse.
+ */
+void mfw_gst_blkts_deinit (MfwGstBlockTs * bts);
+
+/*!
+ * Drop all queued entries, for flush and seek. The pool is kept and the
+ * next pushed block is reported as a discontinuity.
+ */
+void mfw_gst_blkts_clear (MfwGstBlockTs * bts);
+
+/*!
+ * Queue a block of input bytes with the timestamp of its first byte.
+ * An empty block only passes its discont flag on to the next block.
+ *
+ * @param   bts         the queue
+ * @param   length      block size in bytes
+ * @param   timestamp   timestamp of the block, may be GST_CLOCK_TIME_NONE
+ * @param   discont     TRUE if the block does not follow the previous one
+ *
+ * @return  FALSE if the pool can not grow.
+ */
+gboolean mfw_gst_blkts_push (MfwGstBlockTs * bts, guint length,
+    GstClockTime timestamp, gboolean discont);
+
+/*!
+ * Consume bytes from the front of the queue.
+ *
+ * The timestamp returned is the one of the block the consumed bytes start
+ * in. If the bytes run into a block marked discont, that block's timestamp
+ * is returned instead and *discont is set, so the caller resyncs to it
+ * whichever way the time jumped. A discont is reported only once.
+ *
+ * @param   bts         the queue
+ * @param   length      bytes consumed
+ * @param   discont     set to TRUE on a discontinuity, may be NULL
+ *
+ * @return  the timestamp, GST_CLOCK_TIME_NONE if the queue is empty.
+ */
+GstClockTime mfw_gst_blkts_consume (MfwGstBlockTs * bts, guint length,
+    gboolean * discont);
+
+/*!
+ * Bytes in the queue.
+ */
+#define mfw_gst_blkts_queued(bts) ((bts)->queued)
+
+G_END_DECLS
+
+#endif /* __MFW_GST_BLKTS_H__ */
@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+/*
+ * Module Name:    mfw_gst_blkts_test.c
+ *
+ * Description:    Synthetic stream test for the block timestamp queue. A
+ *                 decoder is simulated pushing input blocks of random size
+ *                 with timestamps that run on, jump both ways, go missing
+ *                 or are marked discont, and consuming frames of random
+ *                 size, with flushes in between. Every result is checked
+ *                 against a byte by byte model of the stream.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include "mfw_gst_blkts.h"
+
+#define BLKTS_TEST_SEED     0xb1c75
+#define BLKTS_TEST_OPS      200000
+
+/*
+ * The model keeps every block ever pushed with the stream offset it
+ * starts at, and the stream offset consumed up to.
+ */
+typedef struct
+{
+  guint64 *start;
+  GstClockTime *timestamp;
+  gboolean *discont;
+  guint blocks;
+  guint first;                  /* first block not fully consumed */
+  guint64 pos;
+  guint64 end;
+  gboolean pending;             /* discont for the next block */
+} BlktsTestModel;
+
+static gint failures;
+
+static void
+blkts_test_model_push (BlktsTestModel * m, guint length,
+    GstClockTime timestamp, gboolean discont)
+{
+  if (length == 0) {
+    m->pending |= discont;
+    return;
+  }
+  m->start[m->blocks] = m->end;
+  m->timestamp[m->blocks] = timestamp;
+  m->discont[m->blocks] = discont || m->pending;
+  m->pending = FALSE;
+  m->blocks++;
+  m->end += length;
+}
+
+/* block holding stream byte pos, from the first block on */
+static guint
+blkts_test_model_block (const BlktsTestModel * m, guint64 pos)
+{
+  guint b = m->first;
+
+  while ((b + 1 < m->blocks) && (m->start[b + 1] <= pos))
+    b++;
+  return b;
+}
+
+static GstClockTime
+blkts_test_model_consume (BlktsTestModel * m, guint length,
+    gboolean * discont)
+{
+  GstClockTime ts;
+  guint64 end;
+  guint b, last;
+
+  *discont = FALSE;
+  if (m->pos == m->end)
+    return GST_CLOCK_TIME_NONE;
+
+  /* every block the consumed bytes touch, the last discont one wins */
+  end = MIN (m->pos + length, m->end);
+  b = blkts_test_model_block (m, m->pos);
+  last = (end > m->pos) ? blkts_test_model_block (m, end - 1) : b;
+  ts = m->timestamp[b];
+  for (; b <= last; b++) {
+    if (m->discont[b]) {
+      ts = m->timestamp[b];
+      *discont = TRUE;
+      m->discont[b] = FALSE;
+    }
+  }
+
+  m->pos = end;
+  m->first = blkts_test_model_block (m, end);
+  return ts;
+}
+
+static void
+blkts_test_model_clear (BlktsTestModel * m)
+{
+  m->pos = m->end;
+  m->first = m->blocks ? m->blocks - 1 : 0;
+  m->pending = TRUE;
+}
+
+/*
+ * Input and output sizes around a mean block, so that frames both span
+ * several blocks and share blocks. A frame size of 0 is a decoder asking
+ * for the timestamp without consuming, as when it needs more input.
+ */
+static void
+blkts_test_stream (GRand * rand, guint mean, guint frame)
+{
+  MfwGstBlockTs bts;
+  BlktsTestModel m = { 0 };
+  GstClockTime next = 0, ts, want;
+  gboolean disc, want_disc;
+  guint i, op, len, live, max_live = 0;
+
+  m.start = g_new (guint64, BLKTS_TEST_OPS);
+  m.timestamp = g_new (GstClockTime, BLKTS_TEST_OPS);
+  m.discont = g_new (gboolean, BLKTS_TEST_OPS);
+  mfw_gst_blkts_init (&bts);
+
+  for (i = 0; i < BLKTS_TEST_OPS; i++) {
+    op = g_rand_int_range (rand, 0, 100);
+    if (op == 0) {
+      /* flush on seek */
+      mfw_gst_blkts_clear (&bts);
+      blkts_test_model_clear (&m);
+      next = g_rand_int_range (rand, 0, 1000) * GST_MSECOND;
+    } else if (op < 50) {
+      len = g_rand_int_range (rand, 0, 2 * mean);
+      disc = g_rand_int_range (rand, 0, 20) == 0;
+      ts = next;
+      if (g_rand_int_range (rand, 0, 20) == 0)
+        ts = GST_CLOCK_TIME_NONE;
+      else if (disc && g_rand_boolean (rand) && (next > GST_SECOND))
+        ts = next - GST_SECOND;
+      if (!mfw_gst_blkts_push (&bts, len, ts, disc)) {
+        g_printerr ("push failed\n");
+        failures++;
+      }
+      blkts_test_model_push (&m, len, ts, disc);
+      next += len * GST_USECOND;
+    } else {
+      len = g_rand_int_range (rand, 0, 2 * frame);
+      ts = mfw_gst_blkts_consume (&bts, len, &disc);
+      want = blkts_test_model_consume (&m, len, &want_disc);
+      if ((ts != want) || (disc != want_disc)) {
+        g_printerr ("mean %u frame %u op %u: consume %u got %"
+            GST_TIME_FORMAT " discont %d, want %" GST_TIME_FORMAT
+            " discont %d\n", mean, frame, i, len, GST_TIME_ARGS (ts), disc,
+            GST_TIME_ARGS (want), want_disc);
+        failures++;
+      }
+    }
+
+    if (mfw_gst_blkts_queued (&bts) != m.end - m.pos) {
+      g_printerr ("mean %u frame %u op %u: %u bytes queued, want %"
+          G_GUINT64_FORMAT "\n", mean, frame, i, mfw_gst_blkts_queued (&bts),
+          m.end - m.pos);
+      failures++;
+      break;
+    }
+    live = (m.pos < m.end) ? m.blocks - m.first : 0;
+    max_live = MAX (max_live, live);
+  }
+
+  /* the pool grows by chunks only as far as the queue ever got */
+  if (bts.allocated > (max_live / MFW_GST_BLKTS_CHUNK_ENTRIES + 1) *
+      MFW_GST_BLKTS_CHUNK_ENTRIES) {
+    g_printerr ("mean %u frame %u: %u entries for %u queued blocks\n", mean,
+        frame, bts.allocated, max_live);
+    failures++;
+  }
+
+  mfw_gst_blkts_deinit (&bts);
+  g_free (m.start);
+  g_free (m.timestamp);
+  g_free (m.discont);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GRand *rand = g_rand_new_with_seed (BLKTS_TEST_SEED);
+
+  /* ADTS sized blocks and frames, then each side much larger */
+  blkts_test_stream (rand, 400, 400);
+  blkts_test_stream (rand, 4096, 371);
+  blkts_test_stream (rand, 37, 4096);
+  blkts_test_stream (rand, 1, 3);
+
+  g_rand_free (rand);
+  g_print ("%d failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_fdump.c
+ *
+ * Description:    Asynchronous raw frame dump writer for video sinks. The
+ *                 render thread copies the frame into a bounded ring, a
+ *                 writer thread drains the ring to the file.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "mfw_gst_fdump.h"
+
+typedef struct
+{
+  guint8 *data;
+  guint size;                   /* allocated */
+  guint len;                    /* filled */
+} MfwGstDumpSlot;
+
+struct _MfwGstFrameDump
+{
+  gchar *location;
+  FILE *file;
+
+  GThread *thread;
+  GMutex *lock;
+  GCond *cond;
+  gboolean exit;
+  gboolean failed;
+  gint error;                   /* errno of the failed write */
+  gboolean error_posted;
+
+  /* ring, head is filled by the render thread and tail written by the
+     writer thread, a slot between them belongs to the writer */
+  MfwGstDumpSlot *slots;
+  guint depth;
+  guint head;
+  guint tail;
+  guint count;
+
+  guint interval;
+  guint64 pushed;
+  gint roi_left;
+  gint roi_top;
+  gint roi_width;
+  gint roi_height;
+
+  guint64 written;
+  guint64 dropped;
+  guint64 bytes;
+};
+
+static gpointer
+mfw_gst_fdump_thread (gpointer data)
+{
+  MfwGstFrameDump *dump = (MfwGstFrameDump *) data;
+  MfwGstDumpSlot *slot;
+  gboolean failed;
+  gint error = 0;
+
+  g_mutex_lock (dump->lock);
+  for (;;) {
+    while ((dump->count == 0) && (!dump->exit))
+      g_cond_wait (dump->cond, dump->lock);
+    if (dump->count == 0)
+      break;
+
+    slot = &dump->slots[dump->tail];
+    failed = dump->failed;
+    g_mutex_unlock (dump->lock);
+
+    /* fflush so a full disk is seen now and not when the file is closed */
+    if ((!failed) && ((fwrite (slot->data, slot->len, 1, dump->file) != 1)
+            || (fflush (dump->file) != 0))) {
+      error = errno;
+      failed = TRUE;
+    }
+
+    g_mutex_lock (dump->lock);
+    if (failed) {
+      if (!dump->failed)
+        dump->error = error;
+      dump->failed = TRUE;
+      dump->dropped++;
+    } else {
+      dump->written++;
+      dump->bytes += slot->len;
+    }
+    dump->tail = (dump->tail + 1) % dump->depth;
+    dump->count--;
+  }
+  g_mutex_unlock (dump->lock);
+
+  return NULL;
+}
+
+static guint8 *
+mfw_gst_fdump_copy_plane (guint8 * dst, const guint8 * src, gint stride,
+    gint x, gint y, gint w, gint h)
+{
+  gint i;
+
+  src += y * stride + x;
+  for (i = 0; i < h; i++) {
+    memcpy (dst, src, w);
+    dst += w;
+    src += stride;
+  }
+  return dst;
+}
+
+MfwGstFrameDump *
+mfw_gst_fdump_new (const gchar * location, guint depth)
+{
+  MfwGstFrameDump *dump;
+  GError *error = NULL;
+
+  if ((location == NULL) || (location[0] == '\0'))
+    return NULL;
+
+  dump = g_new0 (MfwGstFrameDump, 1);
+  dump->file = fopen (location, "wb");
+  if (dump->file == NULL) {
+    g_warning ("Could not open file \"%s\" for writing.", location);
+    g_free (dump);
+    return NULL;
+  }
+
+  dump->location = g_strdup (location);
+  dump->depth = depth ? depth : MFW_GST_FDUMP_DEFAULT_DEPTH;
+  dump->slots = g_new0 (MfwGstDumpSlot, dump->depth);
+  dump->lock = g_mutex_new ();
+  dump->cond = g_cond_new ();
+  dump->interval = 1;
+
+  dump->thread = g_thread_create (mfw_gst_fdump_thread, dump, TRUE, &error);
+  if (dump->thread == NULL) {
+    g_warning ("Could not create dump thread: %s",
+        error ? error->message : "unknown");
+    if (error)
+      g_error_free (error);
+    dump->thread = NULL;
+    mfw_gst_fdump_free (dump);
+    return NULL;
+  }
+
+  return dump;
+}
+
+void
+mfw_gst_fdump_free (MfwGstFrameDump * dump)
+{
+  guint i;
+
+  if (dump == NULL)
+    return;
+
+  if (dump->thread) {
+    g_mutex_lock (dump->lock);
+    dump->exit = TRUE;
+    g_cond_signal (dump->cond);
+    g_mutex_unlock (dump->lock);
+    g_thread_join (dump->thread);
+  }
+
+  if (dump->file)
+    fclose (dump->file);
+
+  for (i = 0; i < dump->depth; i++)
+    g_free (dump->slots[i].data);
+  g_free (dump->slots);
+
+  g_cond_free (dump->cond);
+  g_mutex_free (dump->lock);
+  g_free (dump->location);
+  g_free (dump);
+}
+
+void
+mfw_gst_fdump_set_interval (MfwGstFrameDump * dump, guint interval)
+{
+  g_mutex_lock (dump->lock);
+  dump->interval = interval ? interval : 1;
+  dump->pushed = 0;
+  g_mutex_unlock (dump->lock);
+}
+
+void
+mfw_gst_fdump_set_roi (MfwGstFrameDump * dump, gint left, gint top,
+    gint width, gint height)
+{
+  g_mutex_lock (dump->lock);
+  dump->roi_left = MAX (left, 0);
+  dump->roi_top = MAX (top, 0);
+  dump->roi_width = MAX (width, 0);
+  dump->roi_height = MAX (height, 0);
+  g_mutex_unlock (dump->lock);
+}
+
+gboolean
+mfw_gst_fdump_push (MfwGstFrameDump * dump, const MfwGstDumpFrame * frame)
+{
+  MfwGstDumpSlot *slot;
+  gint x, y, w, h;
+  guint len;
+  guint8 *dst;
+  const guint8 *src = frame->data;
+
+  /* interval and roi may be set from another thread */
+  g_mutex_lock (dump->lock);
+  if ((dump->pushed++) % dump->interval) {
+    g_mutex_unlock (dump->lock);
+    return TRUE;
+  }
+
+  x = frame->left;
+  y = frame->top;
+  w = frame->width;
+  h = frame->height;
+  if ((dump->roi_width > 0) && (dump->roi_height > 0)) {
+    x += dump->roi_left;
+    y += dump->roi_top;
+    w = MIN (dump->roi_width, frame->width - dump->roi_left);
+    h = MIN (dump->roi_height, frame->height - dump->roi_top);
+  }
+  g_mutex_unlock (dump->lock);
+
+  switch (frame->fourcc) {
+    case GST_MAKE_FOURCC ('I', '4', '2', '0'):
+    case GST_MAKE_FOURCC ('Y', 'V', '1', '2'):
+    case GST_MAKE_FOURCC ('N', 'V', '1', '2'):
+      x &= ~1;
+      y &= ~1;
+      w &= ~1;
+      h &= ~1;
+      len = w * h * 3 / 2;
+      break;
+    case GST_MAKE_FOURCC ('Y', 'U', 'Y', '2'):
+    case GST_MAKE_FOURCC ('Y', 'U', 'Y', 'V'):
+    case GST_MAKE_FOURCC ('U', 'Y', 'V', 'Y'):
+      x &= ~1;
+      w &= ~1;
+      len = w * h * 2;
+      break;
+    default:
+      len = frame->size;
+      break;
+  }
+
+  if ((src == NULL) || (w <= 0) || (h <= 0) || (len == 0))
+    return FALSE;
+
+  g_mutex_lock (dump->lock);
+  if ((dump->failed) || (dump->count == dump->depth)) {
+    dump->dropped++;
+    g_mutex_unlock (dump->lock);
+    return FALSE;
+  }
+  slot = &dump->slots[dump->head];
+  g_mutex_unlock (dump->lock);
+
+  /* the slot at head is not seen by the writer until count is raised */
+  if (slot->size < len) {
+    g_free (slot->data);
+    slot->data = g_malloc (len);
+    slot->size = len;
+  }
+  dst = slot->data;
+
+  switch (frame->fourcc) {
+    case GST_MAKE_FOURCC ('I', '4', '2', '0'):
+    case GST_MAKE_FOURCC ('Y', 'V', '1', '2'):
+    {
+      gint cstride = frame->stride / 2;
+      const guint8 *c0 = src + frame->stride * frame->plane_height;
+      const guint8 *c1 = c0 + cstride * (frame->plane_height / 2);
+
+      dst = mfw_gst_fdump_copy_plane (dst, src, frame->stride, x, y, w, h);
+      dst = mfw_gst_fdump_copy_plane (dst, c0, cstride, x / 2, y / 2, w / 2,
+          h / 2);
+      mfw_gst_fdump_copy_plane (dst, c1, cstride, x / 2, y / 2, w / 2, h / 2);
+      break;
+    }
+    case GST_MAKE_FOURCC ('N', 'V', '1', '2'):
+      dst = mfw_gst_fdump_copy_plane (dst, src, frame->stride, x, y, w, h);
+      mfw_gst_fdump_copy_plane (dst,
+          src + frame->stride * frame->plane_height, frame->stride, x, y / 2,
+          w, h / 2);
+      break;
+    case GST_MAKE_FOURCC ('Y', 'U', 'Y', '2'):
+    case GST_MAKE_FOURCC ('Y', 'U', 'Y', 'V'):
+    case GST_MAKE_FOURCC ('U', 'Y', 'V', 'Y'):
+      mfw_gst_fdump_copy_plane (dst, src, frame->stride * 2, x * 2, y, w * 2,
+          h);
+      break;
+    default:
+      memcpy (dst, src, len);
+      break;
+  }
+
+  g_mutex_lock (dump->lock);
+  slot->len = len;
+  dump->head = (dump->head + 1) % dump->depth;
+  dump->count++;
+  g_cond_signal (dump->cond);
+  g_mutex_unlock (dump->lock);
+
+  return TRUE;
+}
+
+void
+mfw_gst_fdump_get_stats (MfwGstFrameDump * dump, guint64 * written,
+    guint64 * dropped, guint64 * bytes)
+{
+  g_mutex_lock (dump->lock);
+  if (written)
+    *written = dump->written;
+  if (dropped)
+    *dropped = dump->dropped;
+  if (bytes)
+    *bytes = dump->bytes;
+  g_mutex_unlock (dump->lock);
+}
+
+gboolean
+mfw_gst_fdump_post_error (MfwGstFrameDump * dump, GstElement * element)
+{
+  gint error;
+
+  g_mutex_lock (dump->lock);
+  if ((!dump->failed) || (dump->error_posted)) {
+    g_mutex_unlock (dump->lock);
+    return FALSE;
+  }
+  dump->error_posted = TRUE;
+  error = dump->error;
+  g_mutex_unlock (dump->lock);
+
+  if (error == ENOSPC) {
+    GST_ELEMENT_ERROR (element, RESOURCE, NO_SPACE_LEFT, (NULL), (NULL));
+  } else {
+    GST_ELEMENT_ERROR (element, RESOURCE, WRITE,
+        ("Error while writing to file \"%s\".", dump->location),
+        ("%s", g_strerror (error)));
+  }
+  return TRUE;
+}
+
+gboolean
+mfw_gst_fdump_parse_roi (const gchar * str, gint * left, gint * top,
+    gint * width, gint * height)
+{
+  gint l, t, w, h;
+
+  if ((str == NULL)
+      || (sscanf (str, "%d,%d,%d,%d", &l, &t, &w, &h) != 4)
+      || (l < 0) || (t < 0) || (w < 0) || (h < 0))
+    return FALSE;
+
+  *left = l;
+  *top = t;
+  *width = w;
+  *height = h;
+  return TRUE;
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_fdump.h
+ *
+ * Description:    Asynchronous raw frame dump writer for video sinks
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __MFW_GST_FDUMP_H__
+#define __MFW_GST_FDUMP_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define MFW_GST_FDUMP_DEFAULT_DEPTH 4
+
+typedef struct _MfwGstFrameDump MfwGstFrameDump;
+
+/*
+ * Frame to dump. Planar I420/YV12, semi planar NV12 and packed YUY2/UYVY
+ * are cut to the visible rectangle and the region of interest, any other
+ * fourcc is written as size bytes from data.
+ */
+typedef struct
+{
+  guint32 fourcc;               /* GST_MAKE_FOURCC, 0 for raw */
+  guint8 *data;                 /* start of the first plane */
+  guint size;                   /* buffer size, used for raw */
+  gint stride;                  /* luma line length in pixels */
+  gint plane_height;            /* luma plane height in lines */
+  gint left;                    /* visible rectangle in the planes */
+  gint top;
+  gint width;
+  gint height;
+} MfwGstDumpFrame;
+
+/*!
+ * Create a dump writer and its thread.
+ *
+ * @param   location    file to write
+ * @param   depth       frames the ring holds, 0 for default
+ *
+ * @return  the writer, NULL if the file can not be opened.
+ */
+MfwGstFrameDump *mfw_gst_fdump_new (const gchar * location, guint depth);
+
+/*!
+ * Write the pending frames, stop the thread and close the file.
+ */
+void mfw_gst_fdump_free (MfwGstFrameDump * dump);
+
+/*!
+ * Only dump one frame of every interval frames, 0 and 1 dump all.
+ */
+void mfw_gst_fdump_set_interval (MfwGstFrameDump * dump, guint interval);
+
+/*!
+ * Region of interest relative to the visible rectangle, a zero width or
+ * height dumps the whole visible rectangle. Left, top and size are
+ * rounded down to even for the chroma planes.
+ */
+void mfw_gst_fdump_set_roi (MfwGstFrameDump * dump, gint left, gint top,
+    gint width, gint height);
+
+/*!
+ * Copy the frame into the ring for the writer thread. The frame is dropped
+ * and counted if the ring is full, so the caller never waits on the disk.
+ * Only one thread may push.
+ *
+ * @return  FALSE if the frame is dropped or the writer has failed.
+ */
+gboolean mfw_gst_fdump_push (MfwGstFrameDump * dump,
+    const MfwGstDumpFrame * frame);
+
+/*!
+ * Post the error of a failed write on element, RESOURCE NO_SPACE_LEFT for
+ * a full disk and RESOURCE WRITE otherwise. Call it from the thread that
+ * pushes, the error is posted once.
+ *
+ * @return  TRUE if the error was posted.
+ */
+gboolean mfw_gst_fdump_post_error (MfwGstFrameDump * dump,
+    GstElement * element);
+
+/*!
+ * Counters: frames written, frames dropped on a full ring, bytes written.
+ * Any pointer may be NULL.
+ */
+void mfw_gst_fdump_get_stats (MfwGstFrameDump * dump, guint64 * written,
+    guint64 * dropped, guint64 * bytes);
+
+/*!
+ * Parse a "left,top,width,height" region of interest string.
+ */
+gboolean mfw_gst_fdump_parse_roi (const gchar * str, gint * left, gint * top,
+    gint * width, gint * height);
+
+G_END_DECLS
+
+#endif /* __MFW_GST_FDUMP_H__ */
@@ -38,8 +38,25 @@
 /*=============================================================================
                             INCLUDE FILES
 =============================================================================*/
+#include <string.h>
 #include "gstbufmeta.h"
 
+struct _GstBufferMetaOwner {
+  gint refcount;
+  gpointer owner;
+  GDestroyNotify release;
+};
+
+static void
+gst_buffer_meta_owner_unref (GstBufferMetaOwner *owner)
+{
+  if (g_atomic_int_dec_and_test (&owner->refcount)) {
+    if (owner->release)
+      owner->release (owner->owner);
+    g_slice_free (GstBufferMetaOwner, owner);
+  }
+}
+
 GType
 gst_buffer_meta_get_type (void)
 {
@@ -67,15 +84,79 @@ gst_buffer_meta_new  ()
 GstBufferMeta *
 gst_buffer_meta_copy (const GstBufferMeta *meta)
 {
-  if (G_LIKELY (meta != NULL))
+  if (G_LIKELY (meta != NULL)) {
+    if (meta->owner)
+      g_atomic_int_inc (&meta->owner->refcount);
     return g_slice_dup (GstBufferMeta, meta);
+  }
   return NULL;
 }
 
 void
 gst_buffer_meta_free (GstBufferMeta       *meta)
 {
-  if (G_LIKELY (meta != NULL))
+  if (G_LIKELY (meta != NULL)) {
+    if (meta->owner)
+      gst_buffer_meta_owner_unref (meta->owner);
     g_slice_free (GstBufferMeta, meta);
+  }
+}
+
+void
+gst_buffer_meta_set_layout (GstBufferMeta *meta, guint32 fourcc,
+    gpointer vaddr, guint width, guint height, guint n_planes,
+    const guint *offsets, const guint *strides)
+{
+  guint i;
+
+  g_return_if_fail (meta != NULL);
+  g_return_if_fail (n_planes <= GST_BUFFER_META_MAX_PLANES);
+
+  memset (meta->planes, 0, sizeof (meta->planes));
+  for (i = 0; i < n_planes; i++) {
+    meta->planes[i].physical_data = (guint8 *) meta->physical_data + offsets[i];
+    if (vaddr)
+      meta->planes[i].virtual_data = (guint8 *) vaddr + offsets[i];
+    meta->planes[i].stride = strides[i];
+  }
+  meta->fourcc = fourcc;
+  meta->n_planes = n_planes;
+  meta->width = width;
+  meta->height = height;
+  gst_buffer_meta_set_crop (meta, 0, 0, width, height);
+}
+
+void
+gst_buffer_meta_set_crop (GstBufferMeta *meta, guint left, guint top,
+    guint width, guint height)
+{
+  g_return_if_fail (meta != NULL);
+
+  meta->crop_left = left;
+  meta->crop_top = top;
+  meta->crop_width = width;
+  meta->crop_height = height;
+}
+
+void
+gst_buffer_meta_set_owner (GstBufferMeta *meta, gpointer owner,
+    GDestroyNotify release)
+{
+  g_return_if_fail (meta != NULL);
+
+  if (meta->owner)
+    gst_buffer_meta_owner_unref (meta->owner);
+  meta->owner = g_slice_new (GstBufferMetaOwner);
+  meta->owner->refcount = 1;
+  meta->owner->owner = owner;
+  meta->owner->release = release;
+}
+
+gpointer
+gst_buffer_meta_get_owner (const GstBufferMeta *meta)
+{
+  if (G_LIKELY ((meta != NULL) && (meta->owner != NULL)))
+    return meta->owner->owner;
+  return NULL;
 }
 
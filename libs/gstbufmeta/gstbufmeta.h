@@ -46,12 +46,42 @@ G_BEGIN_DECLS
 #define GST_IS_BUFFER_META(obj) ((obj) != NULL ? *((GType*)(obj)) == GST_TYPE_BUFFER_META : FALSE)
 #define GST_BUFFER_META(obj) (GST_IS_BUFFER_META(obj) ? (GstBufferMeta*)(obj) : NULL)
 #define GST_BUFFER_META_PRIVOBJ(buf)			(GST_BUFFER_META_CAST(buf)->priv)
+#define GST_BUFFER_META_HAS_LAYOUT(meta)   ((meta)->n_planes > 0)
+
+#define GST_BUFFER_META_MAX_PLANES 4
+
 typedef struct _GstBufferMeta GstBufferMeta;
+typedef struct _GstBufferMetaPlane GstBufferMetaPlane;
+typedef struct _GstBufferMetaOwner GstBufferMetaOwner;
+
+struct _GstBufferMetaPlane {
+  gpointer physical_data;
+  gpointer virtual_data;
+  guint stride;               /* bytes per line */
+};
 
+/*
+ * The fields up to priv are all older producers fill. A producer knowing
+ * the memory layout also describes the planes, in memory order of fourcc,
+ * the padded frame size and the visible area, so a consumer can address
+ * padded frames directly instead of deriving offsets from caps.
+ */
 struct _GstBufferMeta {
   GType type;
   gpointer physical_data;
   void * priv; /* caller defined priv */
+
+  guint32 fourcc;
+  guint n_planes;             /* 0 if layout is not known */
+  GstBufferMetaPlane planes[GST_BUFFER_META_MAX_PLANES];
+  guint width;                /* padded frame size in pixels */
+  guint height;
+  guint crop_left;            /* visible area */
+  guint crop_top;
+  guint crop_width;
+  guint crop_height;
+
+  GstBufferMetaOwner *owner;  /* shared between copies */
 };
 
 GType gst_buffer_meta_get_type (void);
@@ -60,6 +90,37 @@ GstBufferMeta *gst_buffer_meta_new  ();
 GstBufferMeta *gst_buffer_meta_copy (const GstBufferMeta *meta);
 void              gst_buffer_meta_free (GstBufferMeta    *meta);
 
+/*!
+ * Describe the frame in the memory at physical_data.
+ *
+ * @param   meta        meta with physical_data set
+ * @param   fourcc      pixel format
+ * @param   vaddr       virtual address of physical_data, may be NULL
+ * @param   width       padded width in pixels
+ * @param   height      padded height in lines
+ * @param   n_planes    number of planes, up to GST_BUFFER_META_MAX_PLANES
+ * @param   offsets     byte offset of each plane from physical_data
+ * @param   strides     bytes per line of each plane
+ */
+void gst_buffer_meta_set_layout (GstBufferMeta *meta, guint32 fourcc,
+    gpointer vaddr, guint width, guint height, guint n_planes,
+    const guint *offsets, const guint *strides);
+
+/*!
+ * Set the visible area, the whole padded frame unless set.
+ */
+void gst_buffer_meta_set_crop (GstBufferMeta *meta, guint left, guint top,
+    guint width, guint height);
+
+/*!
+ * Attach the pool or object owning the memory. release is called with owner
+ * when the meta and all its copies are freed.
+ */
+void gst_buffer_meta_set_owner (GstBufferMeta *meta, gpointer owner,
+    GDestroyNotify release);
+
+gpointer gst_buffer_meta_get_owner (const GstBufferMeta *meta);
+
 G_END_DECLS
 
 #endif /* _GST_META_BUFFER_H_ */
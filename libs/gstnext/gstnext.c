@@ -159,3 +159,72 @@ gst_video_format_get_size_next (GstVideoFormat format, int width, int height)
 }
 
 #endif
+
+
+#define VIDEO_INFO_CACHE_SIZE 8
+
+typedef struct
+{
+  GstCaps *caps;
+  GstVideoFormat format;
+  int width;
+  int height;
+  int size;
+} VideoInfoCacheEntry;
+
+static VideoInfoCacheEntry g_video_info_cache[VIDEO_INFO_CACHE_SIZE];
+static int g_video_info_cache_next = 0;
+G_LOCK_DEFINE_STATIC (video_info_cache);
+
+gboolean
+gst_video_format_parse_caps_cached (GstCaps * caps, GstVideoFormat * format,
+    int *width, int *height, int *size)
+{
+  VideoInfoCacheEntry *entry;
+  GstCaps *oldcaps = NULL;
+  int i;
+
+  if (caps == NULL)
+    return FALSE;
+
+  G_LOCK (video_info_cache);
+  for (i = 0; i < VIDEO_INFO_CACHE_SIZE; i++) {
+    entry = &g_video_info_cache[i];
+    if (entry->caps == caps) {
+      *format = entry->format;
+      *width = entry->width;
+      *height = entry->height;
+      *size = entry->size;
+      G_UNLOCK (video_info_cache);
+      return TRUE;
+    }
+  }
+  G_UNLOCK (video_info_cache);
+
+#if (!GST_CHECK_VERSION(0, 10, 30))
+  if (!gst_video_format_parse_caps_next (caps, format, width, height))
+    return FALSE;
+  *size = gst_video_format_get_size_next (*format, *width, *height);
+#else
+  if (!gst_video_format_parse_caps (caps, format, width, height))
+    return FALSE;
+  *size = gst_video_format_get_size (*format, *width, *height);
+#endif
+
+  G_LOCK (video_info_cache);
+  entry = &g_video_info_cache[g_video_info_cache_next];
+  g_video_info_cache_next =
+      (g_video_info_cache_next + 1) % VIDEO_INFO_CACHE_SIZE;
+  oldcaps = entry->caps;
+  entry->caps = gst_caps_ref (caps);
+  entry->format = *format;
+  entry->width = *width;
+  entry->height = *height;
+  entry->size = *size;
+  G_UNLOCK (video_info_cache);
+
+  /* unref outside the lock, finalizing caps may take other locks */
+  if (oldcaps)
+    gst_caps_unref (oldcaps);
+  return TRUE;
+}
@@ -59,5 +59,14 @@ int gst_video_format_get_size_next (GstVideoFormat format, int width,
     int height);
 #endif
 
+/*
+ * Format, size and frame size of raw video caps, cached for the last few
+ * caps looked up. The cache holds a reference on the caps, so a pointer
+ * can not be reused for other caps while cached, and caps are read only
+ * once shared. Returns FALSE if the caps can not be parsed, none of the
+ * outputs may be NULL.
+ */
+gboolean gst_video_format_parse_caps_cached (GstCaps * caps,
+    GstVideoFormat * format, int *width, int *height, int *size);
 
 #endif /* #ifndef __GSTNEXT_H__ */
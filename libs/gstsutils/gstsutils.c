@@ -44,6 +44,148 @@ g_string_to_boolean (const gchar * str)
 }
 
 
+/* parsed config files by name, NULL keyfile if it could not be loaded */
+static GHashTable *g_config_files = NULL;
+G_LOCK_DEFINE_STATIC (config);
+
+static void
+gstsutils_config_free_keyfile (gpointer data)
+{
+  if (data)
+    g_key_file_free ((GKeyFile *) data);
+}
+
+/* called with config lock held */
+static GKeyFile *
+gstsutils_config_get_keyfile (const gchar * filename)
+{
+  GKeyFile *keyfile;
+
+  if (filename == NULL)
+    return NULL;
+
+  if (g_config_files == NULL) {
+    g_config_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        gstsutils_config_free_keyfile);
+  }
+
+  if (g_hash_table_lookup_extended (g_config_files, filename, NULL,
+          (gpointer *) & keyfile))
+    return keyfile;
+
+  keyfile = g_key_file_new ();
+  if ((keyfile)
+      && (!g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE,
+              NULL))) {
+    g_key_file_free (keyfile);
+    keyfile = NULL;
+  }
+  g_hash_table_insert (g_config_files, g_strdup (filename), keyfile);
+  return keyfile;
+}
+
+/* value of key in a newly allocated string, NULL if there is none */
+static gchar *
+gstsutils_config_get_value (const gchar * filename, const gchar * group,
+    const gchar * key)
+{
+  GKeyFile *keyfile;
+  gchar *value = NULL;
+
+  if ((group == NULL) || (key == NULL))
+    return NULL;
+
+  G_LOCK (config);
+  keyfile = gstsutils_config_get_keyfile (filename);
+  if (keyfile)
+    value = g_key_file_get_value (keyfile, group, key, NULL);
+  G_UNLOCK (config);
+  return value;
+}
+
+gboolean
+gstsutils_config_get_string (const gchar * filename, const gchar * group,
+    const gchar * key, gchar ** value)
+{
+  gchar *svalue = gstsutils_config_get_value (filename, group, key);
+
+  if ((svalue == NULL) || (value == NULL)) {
+    g_free (svalue);
+    return FALSE;
+  }
+  *value = g_strstrip (svalue);
+  return TRUE;
+}
+
+gboolean
+gstsutils_config_get_int (const gchar * filename, const gchar * group,
+    const gchar * key, gint * value)
+{
+  gchar *svalue = gstsutils_config_get_value (filename, group, key);
+  gchar *end;
+  gint64 v;
+
+  if (svalue == NULL)
+    return FALSE;
+  /* base 10 like g_key_file_get_integer, a leading 0 is not octal */
+  v = g_ascii_strtoll (g_strstrip (svalue), &end, 10);
+  if ((end == svalue) || (*end != '\0') || (value == NULL)) {
+    g_free (svalue);
+    return FALSE;
+  }
+  *value = (gint) v;
+  g_free (svalue);
+  return TRUE;
+}
+
+gboolean
+gstsutils_config_get_boolean (const gchar * filename, const gchar * group,
+    const gchar * key, gboolean * value)
+{
+  gchar *svalue = gstsutils_config_get_value (filename, group, key);
+
+  if ((svalue == NULL) || (value == NULL)) {
+    g_free (svalue);
+    return FALSE;
+  }
+  *value = g_string_to_boolean (g_strstrip (svalue));
+  g_free (svalue);
+  return TRUE;
+}
+
+gboolean
+gstsutils_config_get_double (const gchar * filename, const gchar * group,
+    const gchar * key, gdouble * value)
+{
+  gchar *svalue = gstsutils_config_get_value (filename, group, key);
+  gchar *end;
+  gdouble v;
+
+  if (svalue == NULL)
+    return FALSE;
+  v = g_ascii_strtod (g_strstrip (svalue), &end);
+  if ((end == svalue) || (*end != '\0') || (value == NULL)) {
+    g_free (svalue);
+    return FALSE;
+  }
+  *value = v;
+  g_free (svalue);
+  return TRUE;
+}
+
+void
+gstsutils_config_reload (const gchar * filename)
+{
+  G_LOCK (config);
+  if (g_config_files) {
+    if (filename)
+      g_hash_table_remove (g_config_files, filename);
+    else
+      g_hash_table_remove_all (g_config_files);
+  }
+  G_UNLOCK (config);
+}
+
 void
 gstsutils_options_install_properties_by_options (GstsutilsOptionEntry * table,
     GObjectClass * oclass)
@@ -88,9 +230,9 @@ gstsutils_options_install_properties_by_options (GstsutilsOptionEntry * table,
         g_object_class_install_property (oclass, p->id,
             g_param_spec_double (p->name, p->nickname,
                 p->desc,
-                g_strtod (p->min, NULL),
-                g_strtod (p->max, NULL),
-                g_strtod (p->def, NULL), G_PARAM_READWRITE));
+                g_ascii_strtod (p->min, NULL),
+                g_ascii_strtod (p->max, NULL),
+                g_ascii_strtod (p->def, NULL), G_PARAM_READWRITE));
         break;
 
       case (G_TYPE_STRING):
@@ -170,9 +312,9 @@ gstsutils_set_value (gchar * target, GstsutilsOptionEntry * p,
     case (G_TYPE_DOUBLE):
     {
       if (svalue) {
-        gdouble value = g_strtod (svalue, NULL);
-        if ((value >= g_strtod (p->min, NULL))
-            && (value <= g_strtod (p->max, NULL))) {
+        gdouble value = g_ascii_strtod (svalue, NULL);
+        if ((value >= g_ascii_strtod (p->min, NULL))
+            && (value <= g_ascii_strtod (p->max, NULL))) {
           *(gdouble *) (target + p->offset) = value;
         }
       }
@@ -332,33 +474,29 @@ gboolean
 gstsutils_options_load_from_keyfile (GstsutilsOptionEntry * table,
     gchar * option, gchar * filename, gchar * group)
 {
-  GKeyFile *keyfile = NULL;
+  GKeyFile *keyfile;
   gboolean ret = FALSE;
 
-  if (filename == NULL)
+  if ((filename == NULL) || (option == NULL))
     goto bail;
 
-  if ((option) && (keyfile = g_key_file_new ())
-      && (g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL))) {
+  G_LOCK (config);
+  if ((keyfile = gstsutils_config_get_keyfile (filename))) {
     GstsutilsOptionEntry *p = table;
 
     while (p->id != -1) {
-      if (g_key_file_has_key (keyfile, group, p->name, NULL)) {
-        gchar *svalue = g_key_file_get_value (keyfile, group, p->name, NULL);
+      gchar *svalue = g_key_file_get_value (keyfile, group, p->name, NULL);
+      if (svalue) {
         gstsutils_set_value (option, p, svalue);
-        if (svalue) {
-          g_free (svalue);
-        }
+        g_free (svalue);
       }
       p++;
     };
     ret = TRUE;
   }
+  G_UNLOCK (config);
 
 bail:
-  if (keyfile) {
-    g_key_file_free (keyfile);
-  }
   return ret;
 }
 
@@ -367,23 +505,5 @@ gboolean
 gstsutils_elementutil_get_int (gchar * filename, gchar * group,
     gchar * field, gint * value)
 {
-  gboolean ret = FALSE;
-  GKeyFile *keyfile = NULL;
-
-  if ((filename) && (field) && (value)) {
-    if ((keyfile = g_key_file_new ())
-        && (g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE,
-                NULL))) {
-      if (g_key_file_has_key (keyfile, group, field, NULL)) {
-        *value = g_key_file_get_integer (keyfile, group, field, NULL);
-        ret = TRUE;
-      }
-    }
-
-  }
-
-  if (keyfile) {
-    g_key_file_free (keyfile);
-  }
-  return ret;
+  return gstsutils_config_get_int (filename, group, field, value);
 }
@@ -83,5 +83,23 @@ gboolean
 gstsutils_elementutil_get_int (gchar * filename, gchar * group, gchar * field,
     gint * value);
 
+/*
+ * Process wide config registry. Each file is parsed once on first lookup
+ * and kept, missing files are remembered as well. Lookups return FALSE if
+ * the file, group or key is not there, or the value does not parse as a
+ * whole (decimal integers, C locale doubles), and leave value untouched.
+ * gstsutils_config_reload drops a parsed file, or all of them for NULL, so
+ * the next lookup reads it again.
+ */
+gboolean gstsutils_config_get_string (const gchar * filename,
+    const gchar * group, const gchar * key, gchar ** value);
+gboolean gstsutils_config_get_int (const gchar * filename, const gchar * group,
+    const gchar * key, gint * value);
+gboolean gstsutils_config_get_boolean (const gchar * filename,
+    const gchar * group, const gchar * key, gboolean * value);
+gboolean gstsutils_config_get_double (const gchar * filename,
+    const gchar * group, const gchar * key, gdouble * value);
+void gstsutils_config_reload (const gchar * filename);
+
 
 #endif
@@ -0,0 +1,231 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+* Module Name:    gstsutils_test.c
+*
+* Description:    Test of the config registry. Typed lookups of a file
+*                 written by the test, decimal integers and C locale
+*                 doubles whatever the process locale, values which do not
+*                 parse as a whole, a missing file, and reload after the
+*                 file changed on disk.
+*
+* Portability:    This code is written for Linux OS and Gstreamer
+*/
+
+/*
+* Changelog:
+*
+*/
+
+#include <locale.h>
+#include <glib/gstdio.h>
+
+#include "gstsutils.h"
+
+#define CONFIG_TEST_GROUP "test"
+
+/* untouched marker for lookups which must fail */
+#define CONFIG_TEST_UNSET -12345
+
+static const gchar *config_test_contents =
+    "[" CONFIG_TEST_GROUP "]\n"
+    "int = 42\n"
+    "negative = -7\n"
+    "leading_zero = 010\n"
+    "hex = 0x10\n"
+    "trailing = 12abc\n"
+    "empty =\n"
+    "yes = true\n"
+    "YES = TRUE\n"
+    "no = false\n"
+    "double = 1.5\n"
+    "exponent = -2.5e3\n"
+    "comma = 1,5\n"
+    "string =   padded value  \n";
+
+/* locales with a decimal comma, the first one installed is used */
+static const gchar *config_test_comma_locales[] = {
+  "de_DE.UTF-8", "de_DE", "fr_FR.UTF-8", "fr_FR", "nl_NL.UTF-8", NULL
+};
+
+static gint failures;
+
+#define CONFIG_TEST_CHECK(cond, ...) \
+    do{\
+        if (!(cond)){\
+            g_printerr ("%s:%d: ", __FILE__, __LINE__);\
+            g_printerr (__VA_ARGS__);\
+            g_printerr ("\n");\
+            failures++;\
+        }\
+    }while(0)
+
+static void
+config_test_write (const gchar * filename, const gchar * contents)
+{
+  if (!g_file_set_contents (filename, contents, -1, NULL)) {
+    g_printerr ("can not write %s\n", filename);
+    exit (1);
+  }
+}
+
+static void
+config_test_int (const gchar * filename, const gchar * key, gboolean ok,
+    gint want)
+{
+  gint value = CONFIG_TEST_UNSET;
+  gboolean ret =
+      gstsutils_config_get_int (filename, CONFIG_TEST_GROUP, key, &value);
+
+  CONFIG_TEST_CHECK (ret == ok, "int %s returned %d", key, ret);
+  CONFIG_TEST_CHECK (value == (ok ? want : CONFIG_TEST_UNSET),
+      "int %s is %d", key, value);
+}
+
+static void
+config_test_double (const gchar * filename, const gchar * key, gboolean ok,
+    gdouble want)
+{
+  gdouble value = CONFIG_TEST_UNSET;
+  gboolean ret =
+      gstsutils_config_get_double (filename, CONFIG_TEST_GROUP, key, &value);
+
+  CONFIG_TEST_CHECK (ret == ok, "double %s returned %d", key, ret);
+  CONFIG_TEST_CHECK (value == (ok ? want : CONFIG_TEST_UNSET),
+      "double %s is %g", key, value);
+}
+
+static void
+config_test_boolean (const gchar * filename, const gchar * key, gboolean ok,
+    gboolean want)
+{
+  gboolean value = CONFIG_TEST_UNSET;
+  gboolean ret =
+      gstsutils_config_get_boolean (filename, CONFIG_TEST_GROUP, key, &value);
+
+  CONFIG_TEST_CHECK (ret == ok, "boolean %s returned %d", key, ret);
+  CONFIG_TEST_CHECK (value == (ok ? want : CONFIG_TEST_UNSET),
+      "boolean %s is %d", key, value);
+}
+
+static void
+config_test_lookups (const gchar * filename)
+{
+  gchar *string = NULL;
+
+  config_test_int (filename, "int", TRUE, 42);
+  config_test_int (filename, "negative", TRUE, -7);
+  config_test_int (filename, "leading_zero", TRUE, 10);
+  config_test_int (filename, "hex", FALSE, 0);
+  config_test_int (filename, "trailing", FALSE, 0);
+  config_test_int (filename, "empty", FALSE, 0);
+  config_test_int (filename, "string", FALSE, 0);
+  config_test_int (filename, "nokey", FALSE, 0);
+
+  config_test_boolean (filename, "yes", TRUE, TRUE);
+  config_test_boolean (filename, "YES", TRUE, TRUE);
+  config_test_boolean (filename, "no", TRUE, FALSE);
+  config_test_boolean (filename, "int", TRUE, FALSE);
+  config_test_boolean (filename, "nokey", FALSE, FALSE);
+
+  config_test_double (filename, "double", TRUE, 1.5);
+  config_test_double (filename, "exponent", TRUE, -2500.0);
+  config_test_double (filename, "int", TRUE, 42.0);
+  config_test_double (filename, "comma", FALSE, 0);
+  config_test_double (filename, "trailing", FALSE, 0);
+  config_test_double (filename, "nokey", FALSE, 0);
+
+  CONFIG_TEST_CHECK (gstsutils_config_get_string (filename, CONFIG_TEST_GROUP,
+          "string", &string), "string not found");
+  CONFIG_TEST_CHECK ((string) && (strcmp (string, "padded value") == 0),
+      "string is \"%s\"", string ? string : "(null)");
+  g_free (string);
+  string = NULL;
+  CONFIG_TEST_CHECK (!gstsutils_config_get_string (filename, "nogroup",
+          "string", &string), "string found in missing group");
+  CONFIG_TEST_CHECK (string == NULL, "string set for missing group");
+}
+
+int
+main (int argc, char *argv[])
+{
+  gchar *dir = g_build_filename (g_get_tmp_dir (), "gstsutils_test_XXXXXX",
+      NULL);
+  gchar *filename;
+  const gchar **locale;
+  gint value;
+
+  if (mkdtemp (dir) == NULL) {
+    g_printerr ("can not create %s\n", dir);
+    return 1;
+  }
+  filename = g_build_filename (dir, "test.conf", NULL);
+
+  /* a missing file fails every lookup, and is remembered */
+  value = CONFIG_TEST_UNSET;
+  CONFIG_TEST_CHECK (!gstsutils_config_get_int (filename, CONFIG_TEST_GROUP,
+          "int", &value), "lookup in missing file");
+  CONFIG_TEST_CHECK (value == CONFIG_TEST_UNSET, "value set by missing file");
+  config_test_write (filename, config_test_contents);
+  CONFIG_TEST_CHECK (!gstsutils_config_get_int (filename, CONFIG_TEST_GROUP,
+          "int", &value), "missing file read again without reload");
+
+  gstsutils_config_reload (filename);
+  config_test_lookups (filename);
+
+  /* numbers parse the same with a decimal comma locale */
+  for (locale = config_test_comma_locales; *locale; locale++) {
+    if (setlocale (LC_NUMERIC, *locale)) {
+      g_print ("lookups with LC_NUMERIC %s\n", *locale);
+      config_test_lookups (filename);
+      setlocale (LC_NUMERIC, "C");
+      break;
+    }
+  }
+  if (*locale == NULL) {
+    g_print ("no decimal comma locale installed\n");
+  }
+
+  /* a changed file is read again after reload, by name or all files */
+  config_test_write (filename, "[" CONFIG_TEST_GROUP "]\nint = 43\n");
+  config_test_int (filename, "int", TRUE, 42);
+  gstsutils_config_reload (filename);
+  config_test_int (filename, "int", TRUE, 43);
+  config_test_int (filename, "negative", FALSE, 0);
+
+  config_test_write (filename, "[" CONFIG_TEST_GROUP "]\nint = 44\n");
+  gstsutils_config_reload (NULL);
+  config_test_int (filename, "int", TRUE, 44);
+
+  /* a file removed is still served until reload */
+  g_unlink (filename);
+  config_test_int (filename, "int", TRUE, 44);
+  gstsutils_config_reload (filename);
+  config_test_int (filename, "int", FALSE, 0);
+
+  g_rmdir (dir);
+  g_free (filename);
+  g_free (dir);
+
+  g_print ("%d failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
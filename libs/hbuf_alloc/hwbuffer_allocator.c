@@ -41,13 +41,20 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <time.h>
 #include <sys/mman.h>
 
 
+#ifdef HAVE_LINUX_IPU_H
 #include "linux/ipu.h"
+#endif
+#include "hwbuffer_allocator.h"
 
 
-#if defined (IPU_ALLOC)
+/* the ipu backend is only built with the ipu header, see configure */
+#if !defined (HAVE_LINUX_IPU_H)
+typedef int mem_desc;
+#elif defined (IPU_ALLOC)
 typedef int mem_desc;
 #define PHY_MEM_ALLOC_IOCTL_ID IPU_ALLOC
 #define PHY_MEM_FREE_IOCTL_ID IPU_FREE
@@ -70,6 +77,59 @@ typedef ipu_mem_info mem_desc;
 
 #define ROUND_UP_SIZE(size) ((((size)+(MAX_DIFF_SIZE-1))>>MAX_DIFF_SIZE_SHIFT)<<MAX_DIFF_SIZE_SHIFT)
 
+/* size class table, zones hash by their page count */
+#define ZONE_TABLE_SIZE 64
+#define ZONE_TABLE_INDEX(zone_size) (((zone_size)>>MAX_DIFF_SIZE_SHIFT)&(ZONE_TABLE_SIZE-1))
+
+/* 
+ * Buffers are carved as slabs out of chunks, each chunk is one contiguous
+ * allocation and one mapping. A chunk holds up to CHUNK_MAX_SLABS slabs and
+ * about CHUNK_TARGET_SIZE bytes, buffers above SLAB_MAX_SIZE get a chunk of
+ * their own.
+ */
+#define CHUNK_TARGET_SIZE (16*1024*1024)
+#define CHUNK_MAX_SLABS 16
+#define SLAB_MAX_SIZE (CHUNK_TARGET_SIZE/2)
+
+/*
+ * Free slabs are cached instead of released on the last free. A zone keeps
+ * at most high watermark free slabs, and once it stayed completely free for
+ * the idle timeout it is trimmed down to the low watermark, by a timer
+ * thread if no other call comes in before. The budget caps
+ * the total size of all chunks, 0 means no limit. All of them can be set by
+ * environment.
+ */
+#define HWBUF_IDLE_TIMEOUT_ENV "HWBUF_IDLE_TIMEOUT_MS"
+#define HWBUF_LOW_WATERMARK_ENV "HWBUF_LOW_WATERMARK"
+#define HWBUF_HIGH_WATERMARK_ENV "HWBUF_HIGH_WATERMARK"
+#define HWBUF_BUDGET_ENV "HWBUF_BUDGET_KB"
+
+#define DEFAULT_IDLE_TIMEOUT_MS 3000
+#define DEFAULT_LOW_WATERMARK 0
+#define DEFAULT_HIGH_WATERMARK 32
+#define DEFAULT_BUDGET 0
+
+/*
+ * Each thread caches recently freed slabs in small magazines, one per size
+ * class, so a free followed by an alloc of the same size does not take the
+ * allocator lock. A miss refills half a magazine from the zone, a full
+ * magazine flushes half of it back, in both cases under a single lock.
+ * Slabs cached per class are limited by count and by MAGAZINE_MAX_BYTES,
+ * HWBUF_MAGAZINE_SIZE of 0 disables the caches. All caches are registered
+ * with the allocator, each has its own lock which other threads only take
+ * to reclaim its slabs when memory runs out or to collect its stats.
+ */
+#define HWBUF_MAGAZINE_SIZE_ENV "HWBUF_MAGAZINE_SIZE"
+
+#define MAGAZINE_CLASSES 8
+#define MAGAZINE_MAX 16
+#define MAGAZINE_MAX_BYTES (8*1024*1024)
+#define DEFAULT_MAGAZINE_SIZE 8
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
 #define FSL_MM_IOCTL(devfd, request, errorroute, ...)\
     do{\
         int ret;\
@@ -82,6 +142,12 @@ typedef ipu_mem_info mem_desc;
 #define LOCK() pthread_mutex_lock(&g_hwallocator_lock);
 #define UNLOCK() pthread_mutex_unlock(&g_hwallocator_lock);
 
+#define STAT_CALL(allocator, zone, field) \
+    do{\
+        (zone)->stat.field++;\
+        (allocator)->stat.field++;\
+    }while(0)
+
 
 #define LIST2_ADD(head, item) \
     do{\
@@ -121,109 +187,627 @@ typedef ipu_mem_info mem_desc;
 
 typedef struct _HWBufAllocator HWBufAllocator;
 typedef struct _HWBufZone HWBufZone;
+typedef struct _HWBufChunk HWBufChunk;
 
 
-typedef struct _HWBufDesc{
+/* memory reserved from a backend, phy_addr is the physical cookie */
+typedef struct _HWBufMem{
     mem_desc memdesc;
     void * virt_addr;
     void * phy_addr;
-    struct _HWBufDesc * prev; /* link in zone all pool */
-    struct _HWBufDesc * next; /* link in zone all pool */
+    int size;
+}HWBufMem;
+
+typedef struct _HWBufBackend{
+    const char * name;
+    int (*open)(HWBufAllocator * allocator);
+    void (*close)(HWBufAllocator * allocator);
+    int (*alloc)(HWBufAllocator * allocator, HWBufMem * mem);
+    void (*free)(HWBufAllocator * allocator, HWBufMem * mem);
+    int (*map)(HWBufAllocator * allocator, HWBufMem * mem);
+    void (*unmap)(HWBufAllocator * allocator, HWBufMem * mem);
+}HWBufBackend;
+
+typedef struct _HWBufStat{
+    long long live;           /* bytes handed out, including thread caches */
+    long long peak;
+    unsigned int allocs;      /* slabs taken from zone */
+    unsigned int frees;       /* slabs returned to zone */
+    unsigned int failures;
+    /* calls, hits are counted by the thread cache serving them and are
+       folded in under the lock */
+    unsigned int alloc_hits;
+    unsigned int alloc_misses;
+    unsigned int free_hits;
+    unsigned int free_misses;
+}HWBufStat;
+
+
+typedef struct _HWBufDesc{
+    void * virt_addr;
+    void * phy_addr;
     struct _HWBufDesc * link; /* link in zone free pool */
+    HWBufChunk * chunk;
     HWBufZone * zone;
+    const char * owner;
+    int inuse;
 }HWBufDesc;
 
 
+struct _HWBufChunk{
+    HWBufMem mem;
+    int slabs;
+    int freecnt;
+    int trim;                 /* to be released by trim_zone */
+    HWBufDesc * descs;        /* one per slab */
+    struct _HWBufChunk * prev; /* link in zone */
+    struct _HWBufChunk * next; /* link in zone */
+};
+
+
+/* recently freed slabs of one size class */
+typedef struct _HWBufMagazine{
+    int size;                 /* zone size, 0 if not assigned */
+    int cap;
+    int cnt;
+    unsigned int alloc_hits;  /* not yet folded into zone stat */
+    unsigned int free_hits;
+    HWBufDesc * bufs[MAGAZINE_MAX]; /* oldest first */
+}HWBufMagazine;
+
+typedef struct _HWBufThreadCache{
+    pthread_mutex_t lock;     /* held by its thread on the lock free path */
+    int victim;               /* next magazine to reassign when all are used */
+    HWBufMagazine mags[MAGAZINE_CLASSES];
+    struct _HWBufThreadCache * prev; /* link in allocator */
+    struct _HWBufThreadCache * next; /* link in allocator */
+}HWBufThreadCache;
+
+
 struct _HWBufZone{
     int cnt;
     int freecnt;
     HWBufDesc * free;
-    HWBufDesc * all;
+    HWBufChunk * chunks;
     int size;
+    int chunk_slabs;            /* slabs per chunk for this size */
+    int low_wm;                 /* free slabs kept after idle timeout */
+    int high_wm;                /* free slabs kept at most */
+    long long idle_since;       /* ms since zone is completely free, -1 when in use */
+    HWBufStat stat;
+    struct _HWBufZone * hnext;  /* link in size class table */
     struct _HWBufZone * prev; /* link in allocator */
     struct _HWBufZone * next; /* link in allocator */
 };
 
 struct _HWBufAllocator{
+    const HWBufBackend * backend;
     int devfd;                 /* file descriptor for hw buffer allocator */
     struct _HWBufZone * zones;  /* zone for specific size hw buffer */
+    struct _HWBufZone * table[ZONE_TABLE_SIZE]; /* zones by size class */
+    int configured;
+    int idle_timeout;          /* ms */
+    int low_wm;
+    int high_wm;
+    long long budget;          /* bytes, 0 for no limit */
+    long long reserved;        /* bytes in all chunks */
+    int magazine_size;         /* slabs per thread cache magazine, 0 for none */
+    HWBufThreadCache * caches; /* all thread caches */
+    int trim_timer;            /* trim thread started */
+    pthread_t trim_thread;
+    int shutdown;
+    HWBufStat stat;            /* all zones, including destroyed ones */
 };
 
 static HWBufAllocator g_hwallocator = 
     {
+        NULL,   /* backend */
         0,      /* device */
         NULL   /* zones */
     };
 
 static pthread_mutex_t g_hwallocator_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* wakes the trim thread, waits with the allocator lock on CLOCK_MONOTONIC */
+static pthread_cond_t g_hwtrim_cond;
+static pthread_once_t g_hwtrim_once = PTHREAD_ONCE_INIT;
+
+static pthread_key_t g_hwcache_key;
+static pthread_once_t g_hwcache_once = PTHREAD_ONCE_INIT;
+static int g_hwcache_keyed = 0;
+
 
 
+#ifdef HAVE_LINUX_IPU_H
+static int
+ipu_open(HWBufAllocator * allocator)
+{
+    allocator->devfd = open(MEMORY_DEVICE_NAME, O_RDWR);
+    if (allocator->devfd<=0){
+        allocator->devfd=0;
+        printf("can not open memory device %s\n", MEMORY_DEVICE_NAME);
+        return -1;
+    }
+    return 0;
+}
+
+static void
+ipu_close(HWBufAllocator * allocator)
+{
+    if (allocator->devfd>0){
+        close(allocator->devfd);
+        allocator->devfd = 0;
+    }
+}
+
+static int
+ipu_alloc(HWBufAllocator * allocator, HWBufMem * mem)
+{
+    mem_desc * memdesc = &mem->memdesc;
+    memset(memdesc, 0, sizeof(mem_desc));
+    DESC2SIZE(memdesc) = mem->size;
+    FSL_MM_IOCTL(allocator->devfd, PHY_MEM_ALLOC_IOCTL_ID, error, memdesc);
+    mem->phy_addr = (void *)DESC2PHYADDRESS(memdesc);
+    return 0;
+error:
+    return -1;
+}
+
+static void
+ipu_free(HWBufAllocator * allocator, HWBufMem * mem)
+{
+    FSL_MM_IOCTL(allocator->devfd, PHY_MEM_FREE_IOCTL_ID, error, &mem->memdesc);
+error:
+    return;
+}
+
+static int
+ipu_map(HWBufAllocator * allocator, HWBufMem * mem)
+{
+    mem->virt_addr =  mmap(NULL, mem->size,
+			    PROT_READ | PROT_WRITE, MAP_SHARED,
+			    allocator->devfd, mem->phy_addr);
+    if ((int)mem->virt_addr==-1){
+        printf("can not map virtaddr for size %d address %p\n", mem->size, mem->phy_addr);
+        return -1;
+    }
+    return 0;
+}
+
+static void
+ipu_unmap(HWBufAllocator * allocator, HWBufMem * mem)
+{
+    munmap(mem->virt_addr, mem->size);
+}
+#endif
+
+static int
+anon_open(HWBufAllocator * allocator)
+{
+    printf("hwbuf allocator uses anonymous memory, no physical addresses\n");
+    return 0;
+}
+
+static void
+anon_close(HWBufAllocator * allocator)
+{
+}
+
+static int
+anon_alloc(HWBufAllocator * allocator, HWBufMem * mem)
+{
+    void * addr = mmap(NULL, mem->size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (addr==MAP_FAILED){
+        return -1;
+    }
+    mem->phy_addr = addr;
+    return 0;
+}
+
+static void
+anon_free(HWBufAllocator * allocator, HWBufMem * mem)
+{
+    munmap(mem->phy_addr, mem->size);
+}
+
+static int
+anon_map(HWBufAllocator * allocator, HWBufMem * mem)
+{
+    mem->virt_addr = mem->phy_addr;
+    return 0;
+}
+
+static void
+anon_unmap(HWBufAllocator * allocator, HWBufMem * mem)
+{
+}
+
+/* the first one is the default */
+static const HWBufBackend g_hwbackends[] = 
+    {
+#ifdef HAVE_LINUX_IPU_H
+        {"ipu", ipu_open, ipu_close, ipu_alloc, ipu_free, ipu_map, ipu_unmap},
+#endif
+        {"anon", anon_open, anon_close, anon_alloc, anon_free, anon_map, anon_unmap},
+        {NULL}
+    };
+
+#define ANON_BACKEND (&g_hwbackends[sizeof(g_hwbackends)/sizeof(g_hwbackends[0])-2])
+
+static const HWBufBackend *
+find_backend(const char * name)
+{
+    const HWBufBackend * backend = g_hwbackends;
+    if ((name==NULL) || (*name==0)){
+        return backend;
+    }
+    while(backend->name){
+        if (strcmp(backend->name, name)==0){
+            return backend;
+        }
+        backend++;
+    }
+    printf("unknown hwbuf backend %s\n", name);
+    return NULL;
+}
+
+static void
+stat_alloc(HWBufStat * stat, int size)
+{
+    stat->allocs++;
+    stat->live += size;
+    if (stat->live>stat->peak){
+        stat->peak = stat->live;
+    }
+}
+
+static void
+stat_free(HWBufStat * stat, int size)
+{
+    stat->frees++;
+    stat->live -= size;
+}
+
+static long long
+now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec*1000+ts.tv_nsec/1000000;
+}
+
+static int
+env_value(const char * name, int defvalue)
+{
+    char * value = getenv(name);
+    if ((value) && (*value)){
+        return atoi(value);
+    }
+    return defvalue;
+}
+
+static void
+load_config(HWBufAllocator * allocator)
+{
+    allocator->idle_timeout = env_value(HWBUF_IDLE_TIMEOUT_ENV, DEFAULT_IDLE_TIMEOUT_MS);
+    allocator->low_wm = env_value(HWBUF_LOW_WATERMARK_ENV, DEFAULT_LOW_WATERMARK);
+    allocator->high_wm = env_value(HWBUF_HIGH_WATERMARK_ENV, DEFAULT_HIGH_WATERMARK);
+    if (allocator->high_wm<allocator->low_wm){
+        allocator->high_wm = allocator->low_wm;
+    }
+    allocator->budget = (long long)env_value(HWBUF_BUDGET_ENV, DEFAULT_BUDGET)*1024;
+    allocator->magazine_size = env_value(HWBUF_MAGAZINE_SIZE_ENV, DEFAULT_MAGAZINE_SIZE);
+    if (allocator->magazine_size<0){
+        allocator->magazine_size = 0;
+    }else if (allocator->magazine_size>MAGAZINE_MAX){
+        allocator->magazine_size = MAGAZINE_MAX;
+    }
+    allocator->configured = 1;
+}
+
 static HWBufZone *
-find_or_create_zone_by_size(HWBufAllocator * allocator, int size)
+find_zone_by_size(HWBufAllocator * allocator, int zone_size)
 {
-    HWBufZone * zone = allocator->zones;
-    int zone_size = ROUND_UP_SIZE(size);
+    HWBufZone * zone = allocator->table[ZONE_TABLE_INDEX(zone_size)];
+
     while(zone){
-        
         if (zone_size==zone->size){
             return zone;
         }
-        zone=zone->next;
+        zone=zone->hnext;
     }
-    zone = malloc(sizeof(HWBufZone));
+    return NULL;
+}
+
+static HWBufZone *
+find_or_create_zone_by_size(HWBufAllocator * allocator, int size)
+{
+    int zone_size = ROUND_UP_SIZE(size);
+    int index = ZONE_TABLE_INDEX(zone_size);
+    HWBufZone * zone = find_zone_by_size(allocator, zone_size);
+
     if (zone){
-        zone->cnt = zone->freecnt = 0;
-        zone->all = zone->free = NULL;
-        zone->size = zone_size;
+        return zone;
+    }
+    zone = malloc(sizeof(HWBufZone));
+    if (zone==NULL){
+        return NULL;
+    }
+
+    zone->cnt = zone->freecnt = 0;
+    zone->free = NULL;
+    zone->chunks = NULL;
+    zone->size = zone_size;
+    zone->low_wm = allocator->low_wm;
+    zone->high_wm = allocator->high_wm;
+    zone->idle_since = -1;
+    memset(&zone->stat, 0, sizeof(HWBufStat));
+    if (zone_size>SLAB_MAX_SIZE){
+        zone->chunk_slabs = 1;
+    }else{
+        zone->chunk_slabs = CHUNK_TARGET_SIZE/zone_size;
+        if (zone->chunk_slabs>CHUNK_MAX_SLABS)
+            zone->chunk_slabs = CHUNK_MAX_SLABS;
     }
     printf("hwbuf allocator zone(%d) created\n", zone_size);
 
+    zone->hnext = allocator->table[index];
+    allocator->table[index] = zone;
     LIST2_ADD(allocator->zones, zone);
     return zone;
 }
 
 static void
-destory_zone(HWBufAllocator * allocator, HWBufZone * zone)
+remove_zone(HWBufAllocator * allocator, HWBufZone * zone)
 {
-    HWBufDesc * bufdesc = zone->all, * nextdesc;
-    while(bufdesc){
-        nextdesc = bufdesc->next;
-        munmap(bufdesc->virt_addr, zone->size);
-        FSL_MM_IOCTL(allocator->devfd, PHY_MEM_FREE_IOCTL_ID, error, &bufdesc->memdesc);
+    HWBufZone ** pzone = &allocator->table[ZONE_TABLE_INDEX(zone->size)];
+    while(*pzone){
+        if (*pzone==zone){
+            *pzone = zone->hnext;
+            break;
+        }
+        pzone = &(*pzone)->hnext;
+    }
+    LIST2_REMOVE(allocator->zones, zone);
+    free(zone);
+}
+
+static HWBufChunk *
+create_chunk(HWBufAllocator * allocator, HWBufZone * zone, int slabs)
+{
+    HWBufChunk * chunk;
+    int i;
+
+    if ((allocator->budget) 
+        && (allocator->reserved+(long long)zone->size*slabs>allocator->budget)){
+        return NULL;
+    }
+
+    chunk = malloc(sizeof(HWBufChunk)+sizeof(HWBufDesc)*slabs);
+    if (chunk==NULL){
+        return NULL;
+    }
+    chunk->mem.size = zone->size*slabs;
+    chunk->slabs = slabs;
+    chunk->trim = 0;
+    chunk->descs = (HWBufDesc *)(chunk+1);
+
+    if (allocator->backend->alloc(allocator, &chunk->mem)){
+        goto error;
+    }
+    if (allocator->backend->map(allocator, &chunk->mem)){
+        allocator->backend->free(allocator, &chunk->mem);
+        goto error;
+    }
+
+    for (i=slabs-1;i>=0;i--){
+        HWBufDesc * bufdesc = &chunk->descs[i];
+        bufdesc->phy_addr = (char *)chunk->mem.phy_addr+zone->size*i;
+        bufdesc->virt_addr = (char *)chunk->mem.virt_addr+zone->size*i;
+        bufdesc->chunk = chunk;
+        bufdesc->zone = zone;
+        bufdesc->owner = NULL;
+        bufdesc->inuse = 0;
+        LIST_PUSH(zone->free, bufdesc);
+    }
+    chunk->freecnt = slabs;
+    zone->cnt += slabs;
+    zone->freecnt += slabs;
+    allocator->reserved += chunk->mem.size;
+    LIST2_ADD(zone->chunks, chunk);
+    return chunk;
+
 error:
-        free(bufdesc);
-        bufdesc=nextdesc;
+    free(chunk);
+    return NULL;
+}
+
+static void
+destroy_chunk(HWBufAllocator * allocator, HWBufZone * zone, HWBufChunk * chunk)
+{
+    allocator->backend->unmap(allocator, &chunk->mem);
+    allocator->backend->free(allocator, &chunk->mem);
+    zone->cnt -= chunk->slabs;
+    zone->freecnt -= chunk->freecnt;
+    allocator->reserved -= chunk->mem.size;
+    LIST2_REMOVE(zone->chunks, chunk);
+    free(chunk);
+}
+
+static void
+destory_zone(HWBufAllocator * allocator, HWBufZone * zone)
+{
+    HWBufChunk * chunk;
+    while(chunk=zone->chunks){
+        destroy_chunk(allocator, zone, chunk);
     };
 
     printf("hwbuf allocator zone(%d) destroied.\n", zone->size);
 
-    LIST2_REMOVE(allocator->zones, zone);
-    free(zone);
+    remove_zone(allocator, zone);
 }
 
+/* release completely free chunks as long as keep free slabs remain */
 static void
-recycle_zone(HWBufAllocator * allocator, HWBufZone * zone)
+trim_zone(HWBufAllocator * allocator, HWBufZone * zone, int keep)
 {
+    HWBufDesc * bufdesc, * nextdesc;
+    HWBufChunk * chunk, * nextchunk;
+    int freecnt = zone->freecnt;
+    int trimmed = 0;
+
+    for (chunk=zone->chunks;chunk;chunk=chunk->next){
+        if ((chunk->freecnt==chunk->slabs) && (freecnt-chunk->slabs>=keep)){
+            chunk->trim = 1;
+            freecnt -= chunk->slabs;
+            trimmed++;
+        }
+    }
+    if (trimmed==0){
+        return;
+    }
 
-    HWBufDesc * bufdesc = zone->free, * nextdesc;
+    /* keep free slabs of chunks not released */
+    bufdesc = zone->free;
+    zone->free = NULL;
     while(bufdesc){
         nextdesc = bufdesc->link;
-        munmap(bufdesc->virt_addr, zone->size);
-        FSL_MM_IOCTL(allocator->devfd, PHY_MEM_FREE_IOCTL_ID, error, &bufdesc->memdesc);
-error:
-        LIST2_REMOVE(zone->all,bufdesc);
-        free(bufdesc);
-        zone->cnt--;
-        zone->freecnt--;
+        if (bufdesc->chunk->trim==0){
+            LIST_PUSH(zone->free, bufdesc);
+        }
         bufdesc=nextdesc;
     };
-    if (zone->all==NULL){
-        LIST2_REMOVE(allocator->zones, zone);
-        free(zone);
+
+    chunk = zone->chunks;
+    while(chunk){
+        nextchunk = chunk->next;
+        if (chunk->trim){
+            destroy_chunk(allocator, zone, chunk);
+        }
+        chunk = nextchunk;
+    }
+}
+
+static void
+recycle_zone(HWBufAllocator * allocator, HWBufZone * zone)
+{
+    trim_zone(allocator, zone, 0);
+
+    if (zone->chunks==NULL){
+        remove_zone(allocator, zone);
+    }
+}
+
+/* 
+ * Trims zones which stayed completely free for the idle timeout, or all
+ * completely free zones but ex_zone when force is set.
+ */
+static int
+reclaim_idle(HWBufAllocator * allocator, HWBufZone * ex_zone, int force)
+{
+    HWBufZone * zone = allocator->zones, *zonenext;
+    long long now = now_ms();
+    long long reserved = allocator->reserved;
+
+    while(zone){
+        zonenext = zone->next;
+        if ((zone!=ex_zone) && (zone->idle_since>=0)
+            && ((force) || (now-zone->idle_since>=allocator->idle_timeout))){
+            if ((force) || (zone->low_wm==0)){
+                destory_zone(allocator, zone);
+            }else{
+                trim_zone(allocator, zone, zone->low_wm);
+                zone->idle_since = now;
+            }
+        }
+        zone=zonenext;
     }
+    return (allocator->reserved<reserved);
 }
 
+/* ms when reclaim_idle has something to release next, -1 for never */
+static long long
+next_idle_deadline(HWBufAllocator * allocator)
+{
+    HWBufZone * zone;
+    HWBufChunk * chunk;
+    long long next = -1, deadline;
+    int slabs;
+
+    for (zone=allocator->zones;zone;zone=zone->next){
+        if (zone->idle_since<0){
+            continue;
+        }
+        /* a zone trimmed to its low watermark stays idle, skip it unless
+           another chunk can go */
+        if (zone->low_wm){
+            slabs = zone->freecnt;
+            for (chunk=zone->chunks;chunk;chunk=chunk->next){
+                if (chunk->slabs<slabs){
+                    slabs = chunk->slabs;
+                }
+            }
+            if (zone->freecnt-slabs<zone->low_wm){
+                continue;
+            }
+        }
+        deadline = zone->idle_since+allocator->idle_timeout;
+        if ((next<0) || (deadline<next)){
+            next = deadline;
+        }
+    }
+    return next;
+}
+
+static void *
+trim_thread(void * arg)
+{
+    HWBufAllocator * allocator = (HWBufAllocator *)arg;
+    struct timespec ts;
+    long long next;
+
+    LOCK();
+    while(allocator->shutdown==0){
+        next = next_idle_deadline(allocator);
+        if (next<0){
+            pthread_cond_wait(&g_hwtrim_cond, &g_hwallocator_lock);
+        }else if (now_ms()>=next){
+            reclaim_idle(allocator, NULL, 0);
+        }else{
+            ts.tv_sec = next/1000;
+            ts.tv_nsec = (next%1000)*1000000;
+            pthread_cond_timedwait(&g_hwtrim_cond, &g_hwallocator_lock, &ts);
+        }
+    }
+    UNLOCK();
+    return NULL;
+}
+
+static void
+init_trim_cond(void)
+{
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_hwtrim_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+/* a zone went idle, make sure it is trimmed even if no call follows */
+static void
+start_trim_timer(HWBufAllocator * allocator)
+{
+    if (allocator->shutdown){
+        return;
+    }
+    pthread_once(&g_hwtrim_once, init_trim_cond);
+    if (allocator->trim_timer){
+        pthread_cond_signal(&g_hwtrim_cond);
+    }else if (pthread_create(&allocator->trim_thread, NULL, trim_thread, allocator)==0){
+        allocator->trim_timer = 1;
+    }
+}
 
 static void
 recycle_exclude(HWBufAllocator * allocator, HWBufZone * ex_zone)
@@ -239,46 +823,248 @@ recycle_exclude(HWBufAllocator * allocator, HWBufZone * ex_zone)
     }
 }
 
-static HWBufDesc * 
-create_hwbuf(HWBufAllocator * allocator, HWBufZone * zone)
+static HWBufDesc *
+take_desc(HWBufAllocator * allocator, HWBufZone * zone)
 {
+    HWBufDesc * bufdesc=zone->free;
+    LIST_POP(zone->free, bufdesc);
+    zone->freecnt--;
+    bufdesc->chunk->freecnt--;
+    bufdesc->inuse = 1;
+    bufdesc->owner = NULL;
+    stat_alloc(&zone->stat, zone->size);
+    stat_alloc(&allocator->stat, zone->size);
+    return bufdesc;
+}
 
-    HWBufDesc * bufdesc = NULL;
-    int try_recycle = 1;
-    bufdesc = malloc(sizeof(HWBufDesc));
-    if (bufdesc==NULL){
-        goto error;
+static void
+release_desc(HWBufAllocator * allocator, HWBufDesc * bufdesc)
+{
+    HWBufZone * zone = bufdesc->zone;
+    LIST_PUSH(zone->free, bufdesc);
+    zone->freecnt++;
+    bufdesc->chunk->freecnt++;
+    bufdesc->inuse = 0;
+    stat_free(&zone->stat, zone->size);
+    stat_free(&allocator->stat, zone->size);
+}
+
+/* called after slabs went back to zone */
+static void
+zone_released(HWBufAllocator * allocator, HWBufZone * zone)
+{
+    /* cache free slabs up to the high watermark, the rest waits for the
+       idle timeout so a pool freed and allocated again is not thrashed */
+    if (zone->freecnt>zone->high_wm){
+        trim_zone(allocator, zone, zone->high_wm);
     }
-    mem_desc * memdesc =  &bufdesc->memdesc;
-allochwbuf:
-    memset(memdesc, 0, sizeof(mem_desc));
-    DESC2SIZE(memdesc) = zone->size;
-    FSL_MM_IOCTL(allocator->devfd, PHY_MEM_ALLOC_IOCTL_ID, recycle, memdesc);
-    bufdesc->phy_addr = (void *)DESC2PHYADDRESS(memdesc);
-    bufdesc->virt_addr =  mmap(NULL, zone->size,
-			    PROT_READ | PROT_WRITE, MAP_SHARED,
-			    allocator->devfd, bufdesc->phy_addr);
-    if ((int)bufdesc->virt_addr==-1){
-        printf("can not map virtaddr for size %d address %p\n", zone->size, bufdesc->phy_addr);
-        FSL_MM_IOCTL(allocator->devfd, PHY_MEM_FREE_IOCTL_ID, error, memdesc);
-        goto error;
+    if (zone->freecnt==zone->cnt){
+        zone->idle_since = now_ms();
+        start_trim_timer(allocator);
     }
-    bufdesc->zone = zone;
-    LIST2_ADD(zone->all,bufdesc);
-    zone->cnt++;
-    return bufdesc;
-recycle:
-    if (try_recycle){
-        try_recycle=0;
-        recycle_exclude(allocator, zone);
-        goto allochwbuf;
+
+    reclaim_idle(allocator, zone, 0);
+}
+
+/* return the oldest slabs of a magazine to their zone until keep remain */
+static void
+flush_magazine(HWBufAllocator * allocator, HWBufMagazine * mag, int keep)
+{
+    HWBufZone * zone;
+    int flush = mag->cnt-keep;
+    int i;
+
+    if (flush<=0){
+        return;
     }
-error:
-    if (bufdesc){
-        free(bufdesc);
-        bufdesc = NULL;
+    zone = mag->bufs[0]->zone;
+    for (i=0;i<flush;i++){
+        release_desc(allocator, mag->bufs[i]);
+    }
+    mag->cnt = keep;
+    memmove(mag->bufs, mag->bufs+flush, sizeof(HWBufDesc *)*keep);
+    zone_released(allocator, zone);
+}
+
+static void
+flush_thread_cache(HWBufAllocator * allocator, HWBufThreadCache * tc)
+{
+    int i;
+    for (i=0;i<MAGAZINE_CLASSES;i++){
+        flush_magazine(allocator, &tc->mags[i], 0);
+    }
+}
+
+/* move the hits a thread counted into zone and allocator stats */
+static void
+fold_thread_cache_stat(HWBufAllocator * allocator, HWBufThreadCache * tc)
+{
+    HWBufMagazine * mag;
+    HWBufZone * zone;
+    int i;
+
+    for (i=0;i<MAGAZINE_CLASSES;i++){
+        mag = &tc->mags[i];
+        if ((mag->alloc_hits==0) && (mag->free_hits==0)){
+            continue;
+        }
+        zone = find_zone_by_size(allocator, mag->size);
+        if (zone){
+            zone->stat.alloc_hits += mag->alloc_hits;
+            zone->stat.free_hits += mag->free_hits;
+        }
+        allocator->stat.alloc_hits += mag->alloc_hits;
+        allocator->stat.free_hits += mag->free_hits;
+        mag->alloc_hits = mag->free_hits = 0;
+    }
+}
+
+/* return slabs cached by all threads to their zones */
+static void
+reclaim_thread_caches(HWBufAllocator * allocator)
+{
+    HWBufThreadCache * tc;
+
+    for (tc=allocator->caches;tc;tc=tc->next){
+        pthread_mutex_lock(&tc->lock);
+        fold_thread_cache_stat(allocator, tc);
+        flush_thread_cache(allocator, tc);
+        pthread_mutex_unlock(&tc->lock);
+    }
+}
+
+static void
+destroy_thread_cache(void * data)
+{
+    HWBufAllocator * allocator = &g_hwallocator;
+    HWBufThreadCache * tc = (HWBufThreadCache *)data;
+    LOCK();
+    if (allocator->shutdown==0){
+        fold_thread_cache_stat(allocator, tc);
+        flush_thread_cache(allocator, tc);
+    }
+    LIST2_REMOVE(allocator->caches, tc);
+    UNLOCK();
+    pthread_mutex_destroy(&tc->lock);
+    free(tc);
+}
+
+static void
+init_thread_cache_key(void)
+{
+    if (pthread_key_create(&g_hwcache_key, destroy_thread_cache)==0){
+        g_hwcache_keyed = 1;
+    }
+}
+
+static HWBufThreadCache *
+get_thread_cache(HWBufAllocator * allocator)
+{
+    HWBufThreadCache * tc;
+
+    if ((allocator->magazine_size==0) || (allocator->shutdown)){
+        return NULL;
+    }
+    pthread_once(&g_hwcache_once, init_thread_cache_key);
+    if (g_hwcache_keyed==0){
+        return NULL;
+    }
+    tc = pthread_getspecific(g_hwcache_key);
+    if (tc==NULL){
+        tc = calloc(1, sizeof(HWBufThreadCache));
+        if ((tc) && (pthread_setspecific(g_hwcache_key, tc))){
+            free(tc);
+            return NULL;
+        }
+        if (tc){
+            pthread_mutex_init(&tc->lock, NULL);
+            LOCK();
+            LIST2_ADD(allocator->caches, tc);
+            UNLOCK();
+        }
+    }
+    return tc;
+}
+
+static void
+assign_magazine(HWBufAllocator * allocator, HWBufMagazine * mag, int size)
+{
+    mag->size = size;
+    mag->cap = MAGAZINE_MAX_BYTES/size;
+    if (mag->cap>allocator->magazine_size){
+        mag->cap = allocator->magazine_size;
+    }
+}
+
+/* 
+ * magazine for size, an empty one is assigned to size if create is set.
+ * Magazines with hits not folded yet keep their size until the next call
+ * under the lock.
+ */
+static HWBufMagazine *
+find_magazine(HWBufAllocator * allocator, HWBufThreadCache * tc, int size, int create)
+{
+    HWBufMagazine * mag, * empty = NULL;
+    int i;
+
+    for (i=0;i<MAGAZINE_CLASSES;i++){
+        mag = &tc->mags[i];
+        if (mag->size==size){
+            return mag;
+        }
+        if ((empty==NULL) && (mag->cnt==0)
+            && (mag->alloc_hits==0) && (mag->free_hits==0)){
+            empty = mag;
+        }
+    }
+    if ((create) && (empty)){
+        assign_magazine(allocator, empty, size);
+        return empty;
+    }
+    return NULL;
+}
+
+static int
+grow_zone(HWBufAllocator * allocator, HWBufZone * zone)
+{
+    int slabs = zone->chunk_slabs;
+    int try_reclaim = 1;
+    int try_caches = 1;
+    int try_recycle = 1;
+
+    /* first chunk of a zone is small, pools are often just a few buffers */
+    if (zone->cnt<slabs){
+        slabs = (zone->cnt>0) ? zone->cnt : 1;
+    }
+
+    while(1){
+        if (create_chunk(allocator, zone, slabs)){
+            return 0;
+        }
+        /* contiguous memory is short, first drop idle zones of other sizes,
+           then try smaller chunks, slabs cached by all threads and at last
+           recycle free slabs everywhere */
+        if (try_reclaim){
+            try_reclaim=0;
+            if (reclaim_idle(allocator, zone, 1)){
+                continue;
+            }
+        }
+        if (slabs>1){
+            slabs>>=1;
+        }else if (try_caches){
+            try_caches=0;
+            reclaim_thread_caches(allocator);
+            if (zone->free){
+                return 0;
+            }
+        }else if (try_recycle){
+            try_recycle=0;
+            recycle_exclude(allocator, zone);
+        }else{
+            return -1;
+        }
     }
-    return bufdesc;
 }
 
 void * 
@@ -287,45 +1073,104 @@ mfw_new_hw_buffer(int size, void **phy_addr, void **virt_addr, int flags)
     HWBufAllocator * allocator = &g_hwallocator;
     HWBufDesc * bufdesc = NULL;
     HWBufZone * zone = NULL;
+    HWBufThreadCache * tc;
+    HWBufMagazine * mag = NULL;
+
+    tc = get_thread_cache(allocator);
+    if (tc){
+        pthread_mutex_lock(&tc->lock);
+        mag = find_magazine(allocator, tc, ROUND_UP_SIZE(size), 0);
+        if ((mag) && (mag->cnt)){
+            bufdesc = mag->bufs[--mag->cnt];
+            bufdesc->inuse = 1;
+            bufdesc->owner = NULL;
+            mag->alloc_hits++;
+            pthread_mutex_unlock(&tc->lock);
+            (*phy_addr) = bufdesc->phy_addr;
+            (*virt_addr) = bufdesc->virt_addr;
+            return bufdesc;
+        }
+        pthread_mutex_unlock(&tc->lock);
+    }
+
     LOCK();
 
-    if (allocator->devfd==0){
-        allocator->devfd = open(MEMORY_DEVICE_NAME, O_RDWR);
-        if (allocator->devfd<=0){
-            allocator->devfd=0;
-            printf("can not open memory device %s\n", MEMORY_DEVICE_NAME);
+    /* other threads only touch this cache with the allocator lock held */
+    if (tc){
+        fold_thread_cache_stat(allocator, tc);
+    }
+
+    if (allocator->configured==0){
+        load_config(allocator);
+    }
+
+    if (allocator->backend==NULL){
+        const char * name = getenv(HWBUF_BACKEND_ENV);
+        const HWBufBackend * backend = find_backend(name);
+        if ((backend) && (backend->open(allocator))){
+            /* without the device the default falls back, a backend asked
+               for by name does not */
+            if (((name==NULL) || (*name==0)) && (backend!=ANON_BACKEND)
+                && (ANON_BACKEND->open(allocator)==0)){
+                backend = ANON_BACKEND;
+            }else{
+                backend = NULL;
+            }
+        }
+        if (backend==NULL){
+            allocator->stat.failures++;
             goto error;
         }
+        allocator->backend = backend;
     }
     
+    reclaim_idle(allocator, NULL, 0);
+
     zone = find_or_create_zone_by_size(allocator, size);
     if (zone==NULL){
         printf("can not create zone for size %d\n", size);
         goto error;
     }
+    zone->idle_since = -1;
 
-    if (bufdesc=zone->free){
-        LIST_POP(zone->free, bufdesc);
-        zone->freecnt--;    
-    }else{
-        bufdesc = create_hwbuf(allocator, zone);
-        if (bufdesc==NULL){
-            printf("can not create hwbuf for size %d\n", size);
-            goto error;
+    if ((zone->free==NULL) && (grow_zone(allocator, zone))){
+        printf("can not create hwbuf for size %d\n", size);
+        zone->stat.failures++;
+        allocator->stat.failures++;
+        goto error;
+    }
+
+    bufdesc = take_desc(allocator, zone);
+    STAT_CALL(allocator, zone, alloc_misses);
+
+    /* refill half a magazine while the lock is held anyway */
+    if (tc){
+        if (mag==NULL){
+            mag = find_magazine(allocator, tc, zone->size, 1);
+        }
+        if (mag==NULL){
+            mag = &tc->mags[tc->victim];
+            tc->victim = (tc->victim+1)%MAGAZINE_CLASSES;
+            flush_magazine(allocator, mag, 0);
+            assign_magazine(allocator, mag, zone->size);
+        }
+        while((mag->cnt<(mag->cap+1)/2) && (zone->free)){
+            mag->bufs[mag->cnt++] = take_desc(allocator, zone);
+            mag->bufs[mag->cnt-1]->inuse = 0;
         }
-        
     }
+
     (*phy_addr) = bufdesc->phy_addr;
     (*virt_addr) = bufdesc->virt_addr;
     UNLOCK();
     return bufdesc;
 
 error:
-    if ((zone) && (zone->all==NULL)){
+    if ((zone) && (zone->chunks==NULL)){
         destory_zone(allocator, zone);
     }
     UNLOCK();
-    return bufdesc;
+    return NULL;
 }
 
 void 
@@ -334,21 +1179,116 @@ mfw_free_hw_buffer(void * handle)
     HWBufAllocator * allocator = &g_hwallocator;
     HWBufDesc * bufdesc;
     HWBufZone * zone;
+    HWBufThreadCache * tc;
+    HWBufMagazine * mag = NULL;
     if (handle==NULL)
         return;
     bufdesc = (HWBufDesc *)handle;
     zone = bufdesc->zone;
 
+    tc = get_thread_cache(allocator);
+    if (tc){
+        pthread_mutex_lock(&tc->lock);
+        mag = find_magazine(allocator, tc, zone->size, 1);
+        if ((mag) && (mag->cnt<mag->cap)){
+            bufdesc->inuse = 0;
+            mag->bufs[mag->cnt++] = bufdesc;
+            mag->free_hits++;
+            pthread_mutex_unlock(&tc->lock);
+            return;
+        }
+        pthread_mutex_unlock(&tc->lock);
+    }
+
     LOCK();
-    LIST_PUSH(zone->free, bufdesc);
-    zone->freecnt++;
+    if (tc){
+        fold_thread_cache_stat(allocator, tc);
+    }
+    release_desc(allocator, bufdesc);
+    STAT_CALL(allocator, zone, free_misses);
+    if (mag){
+        flush_magazine(allocator, mag, mag->cap/2);
+    }
+    zone_released(allocator, zone);
+    UNLOCK();
+}
 
-    if (zone->freecnt==zone->cnt){
-        destory_zone(allocator,zone);
+
+
+void
+mfw_hw_buffer_set_owner(void * handle, const char * owner)
+{
+    if (handle){
+        ((HWBufDesc *)handle)->owner = owner;
+    }
+}
+
+static void
+dump_stat(const char * name, int size, HWBufStat * stat)
+{
+    printf("%-8s %10d %12lld %12lld %8u %8u %8u %8u %8u %8u %8u\n", name,
+        size, stat->live, stat->peak, stat->allocs, stat->frees,
+        stat->failures, stat->alloc_hits, stat->alloc_misses, stat->free_hits,
+        stat->free_misses);
+}
+
+void
+mfw_hw_buffer_dump_stats(void)
+{
+    HWBufAllocator * allocator = &g_hwallocator;
+    HWBufZone * zone;
+    HWBufThreadCache * tc;
+
+    LOCK();
+    for (tc=allocator->caches;tc;tc=tc->next){
+        pthread_mutex_lock(&tc->lock);
+        fold_thread_cache_stat(allocator, tc);
+        pthread_mutex_unlock(&tc->lock);
+    }
+    printf("hwbuf allocator %s, reserved %lld bytes\n",
+        allocator->backend ? allocator->backend->name : "none", allocator->reserved);
+    printf("%-8s %10s %12s %12s %8s %8s %8s %8s %8s %8s %8s\n", "zone", "size",
+        "live", "peak", "allocs", "frees", "failures", "ahits", "amisses",
+        "fhits", "fmisses");
+    for (zone=allocator->zones;zone;zone=zone->next){
+        dump_stat("", zone->size, &zone->stat);
     }
+    dump_stat("total", 0, &allocator->stat);
     UNLOCK();
 }
 
+static void
+dump_leaks(HWBufAllocator * allocator)
+{
+    HWBufZone * zone;
+    HWBufChunk * chunk;
+    int i;
+
+    int inuse;
+
+    /* slabs in thread caches are not in use, only count the others */
+    for (zone=allocator->zones;zone;zone=zone->next){
+        inuse = 0;
+        for (chunk=zone->chunks;chunk;chunk=chunk->next){
+            for (i=0;i<chunk->slabs;i++){
+                inuse += chunk->descs[i].inuse;
+            }
+        }
+        if (inuse==0){
+            continue;
+        }
+        printf("hwbuf allocator zone(%d) %d buffers not freed\n", zone->size, inuse);
+        for (chunk=zone->chunks;chunk;chunk=chunk->next){
+            for (i=0;i<chunk->slabs;i++){
+                if (chunk->descs[i].inuse){
+                    printf("    %p owner %s\n", chunk->descs[i].phy_addr,
+                        chunk->descs[i].owner ? chunk->descs[i].owner : "unknown");
+                }
+            }
+        }
+    }
+}
+
 
 
 void __attribute__ ((destructor)) hwbuffer_deconstructor(void);
@@ -358,12 +1298,37 @@ void hwbuffer_deconstructor(void)
 
     HWBufAllocator * allocator = &g_hwallocator;
     HWBufZone * zone;
+    HWBufThreadCache * tc;
+
     LOCK();
+    /* slabs cached by any thread are not leaked */
+    reclaim_thread_caches(allocator);
+    if (g_hwcache_keyed){
+        tc = pthread_getspecific(g_hwcache_key);
+        if (tc){
+            pthread_setspecific(g_hwcache_key, NULL);
+            LIST2_REMOVE(allocator->caches, tc);
+            pthread_mutex_destroy(&tc->lock);
+            free(tc);
+        }
+        pthread_key_delete(g_hwcache_key);
+        g_hwcache_keyed = 0;
+    }
+    allocator->shutdown = 1;
+    if (allocator->trim_timer){
+        pthread_cond_signal(&g_hwtrim_cond);
+        UNLOCK();
+        pthread_join(allocator->trim_thread, NULL);
+        LOCK();
+        allocator->trim_timer = 0;
+    }
+    dump_leaks(allocator);
     while(zone=allocator->zones){
         destory_zone(allocator, zone);
     }
+    if (allocator->backend){
+        allocator->backend->close(allocator);
+        allocator->backend = NULL;
+    }
     UNLOCK();
 }
-
-
-
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2010, 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    hwbuffer_allocator.h
+ *
+ * Description:    Physical buffer allocator interface
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __HWBUFFER_ALLOCATOR_H__
+#define __HWBUFFER_ALLOCATOR_H__
+
+/*
+ * Backend reserving the memory, selected by the HWBUF_BACKEND environment:
+ *   "ipu"  - physically contiguous memory from /dev/mxc_ipu, the default
+ *            when built with linux/ipu.h
+ *   "anon" - anonymous shared mapping, the virtual address is used as
+ *            physical cookie, for hosts without the device only
+ * If no backend is set and the device can not be opened, anon is used.
+ */
+#define HWBUF_BACKEND_ENV "HWBUF_BACKEND"
+
+/*!
+ * Allocate a buffer.
+ *
+ * @param   size        buffer size in bytes
+ * @param   phy_addr    returns the physical address
+ * @param   virt_addr   returns the virtual address
+ * @param   flags       not used, 0
+ *
+ * @return  handle of the buffer, NULL on failure.
+ */
+void * mfw_new_hw_buffer(int size, void **phy_addr, void **virt_addr, int flags);
+
+/*!
+ * Free a buffer allocated by mfw_new_hw_buffer.
+ */
+void mfw_free_hw_buffer(void * handle);
+
+/*!
+ * Tag a buffer with its owner, the tag is printed for buffers still in use
+ * when the allocator is unloaded. The string is not copied.
+ */
+void mfw_hw_buffer_set_owner(void * handle, const char * owner);
+
+/*!
+ * Print per zone statistics: live and peak bytes, slabs taken from and
+ * returned to the zone, failures, and allocation and free calls split into
+ * thread cache hits and misses. Slabs cached by threads for reuse count as
+ * live.
+ */
+void mfw_hw_buffer_dump_stats(void);
+
+#endif /* __HWBUFFER_ALLOCATOR_H__ */
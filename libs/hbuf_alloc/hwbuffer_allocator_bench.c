@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2010, 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    hwbuffer_allocator_bench.c
+ *
+ * Description:    Contention benchmark of the physical buffer allocator. Each
+ *                 thread churns like a pipeline stage: it allocates a few
+ *                 buffers of different sizes and frees them again, over and
+ *                 over. Runs with 1 to the given number of threads, with the
+ *                 thread caches off and on, on the anon backend.
+ *                 Usage: hwbuffer_allocator_bench [pairs per thread]
+ *                 [max threads]
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "hwbuffer_allocator.h"
+
+
+#define BENCH_PAIRS 1000000
+#define BENCH_THREADS 8
+
+/* buffers held at once by each thread */
+#define BENCH_DEPTH 4
+
+/* HWBUF_MAGAZINE_SIZE values compared, 0 is the locked path only */
+static const char * g_bench_magazines[] = {"0", "8"};
+
+static const int g_bench_sizes[BENCH_DEPTH] =
+    {
+        1280*720*3/2,
+        720*576*3/2,
+        64*1024,
+        4096,
+    };
+
+static int g_bench_pairs;
+static FILE * g_bench_out;
+static int g_bench_failed = 0;
+
+
+static double
+bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static void *
+bench_thread(void * arg)
+{
+    void * handles[BENCH_DEPTH];
+    void * phy_addr;
+    void * virt_addr;
+    int i, j;
+
+    for (i=0;i<g_bench_pairs;i+=BENCH_DEPTH){
+        for (j=0;j<BENCH_DEPTH;j++){
+            handles[j] = mfw_new_hw_buffer(g_bench_sizes[j], &phy_addr,
+                &virt_addr, 0);
+            if (handles[j]==NULL){
+                g_bench_failed = 1;
+                return NULL;
+            }
+        }
+        for (j=BENCH_DEPTH-1;j>=0;j--){
+            mfw_free_hw_buffer(handles[j]);
+        }
+    }
+    return NULL;
+}
+
+/* seconds for all threads to finish their pairs, negative on failure */
+static double
+bench_run(int threads)
+{
+    pthread_t tids[threads];
+    double start;
+    int i;
+
+    start = bench_now();
+    for (i=0;i<threads;i++){
+        pthread_create(&tids[i], NULL, bench_thread, NULL);
+    }
+    for (i=0;i<threads;i++){
+        pthread_join(tids[i], NULL);
+    }
+    return g_bench_failed ? -1 : bench_now()-start;
+}
+
+static int
+bench_magazine(const char * magazine, int max_threads)
+{
+    double seconds, base = 0;
+    int threads;
+
+    setenv(HWBUF_BACKEND_ENV, "anon", 1);
+    setenv("HWBUF_MAGAZINE_SIZE", magazine, 1);
+
+    /* warm up, so zones are grown before anything is timed */
+    if (bench_run(1)<0){
+        fprintf(g_bench_out, "allocation failed\n");
+        return 1;
+    }
+
+    for (threads=1;threads<=max_threads;threads*=2){
+        seconds = bench_run(threads);
+        if (seconds<0){
+            fprintf(g_bench_out, "allocation failed\n");
+            return 1;
+        }
+        if (threads==1){
+            base = seconds;
+        }
+        fprintf(g_bench_out, "%-10s %8d %12.1f %12.1f %10.2f\n", magazine,
+            threads, (double)g_bench_pairs*threads/seconds/1e6,
+            seconds*1e9/g_bench_pairs, base*threads/seconds);
+    }
+    fflush(g_bench_out);
+    return 0;
+}
+
+int
+main(int argc, char * argv[])
+{
+    int max_threads = BENCH_THREADS;
+    int i, status, failed = 0;
+    pid_t pid;
+
+    g_bench_pairs = BENCH_PAIRS;
+    if (argc>1){
+        g_bench_pairs = atoi(argv[1]);
+    }
+    if (argc>2){
+        max_threads = atoi(argv[2]);
+    }
+    if ((g_bench_pairs<=0) || (max_threads<=0)){
+        printf("usage: %s [pairs per thread] [max threads]\n", argv[0]);
+        return 1;
+    }
+
+    printf("%d alloc/free pairs per thread, %d buffers held per thread\n",
+        g_bench_pairs, BENCH_DEPTH);
+    printf("%-10s %8s %12s %12s %10s\n", "magazine", "threads", "Mpairs/s",
+        "ns/pair/thr", "scaling");
+    fflush(stdout);
+
+    /* the config is read once per process, each setting runs in a child */
+    for (i=0;i<sizeof(g_bench_magazines)/sizeof(g_bench_magazines[0]);i++){
+        pid = fork();
+        if (pid==0){
+            /* keep the allocator messages out of the table */
+            g_bench_out = fdopen(dup(STDOUT_FILENO), "w");
+            if ((g_bench_out==NULL)
+                || (freopen("/dev/null", "w", stdout)==NULL)){
+                exit(1);
+            }
+            exit(bench_magazine(g_bench_magazines[i], max_threads));
+        }
+        if ((pid<0) || (waitpid(pid, &status, 0)!=pid)
+            || (!WIFEXITED(status)) || (WEXITSTATUS(status))){
+            printf("magazine %s: FAILED\n", g_bench_magazines[i]);
+            failed++;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2010, 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    hwbuffer_allocator_stress.c
+ *
+ * Description:    Stress test of the physical buffer allocator, run once per
+ *                 backend. Threads share a table of buffer slots and take
+ *                 turns allocating and freeing them, so buffers are often
+ *                 freed by another thread than the one that allocated them.
+ *                 Sizes mix video frames and small side buffers. Every
+ *                 buffer is stamped at both ends and checked when freed, a
+ *                 buffer handed out twice or overlapping another fails the
+ *                 test. A second run sets a budget which is only met
+ *                 when slabs cached by an idle thread are reclaimed. The
+ *                 ipu backend is skipped without its device.
+ *                 Usage: hwbuffer_allocator_stress [ops per thread] [threads]
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#include "hwbuffer_allocator.h"
+
+
+#define STRESS_OPS 250000
+#define STRESS_THREADS 4
+#define STRESS_SLOTS 48
+
+/* exit code of a run whose backend is not available, as automake skips */
+#define STRESS_SKIP 77
+
+#define STRESS_OWNER "hwbuffer_allocator_stress"
+
+/* the reclaim run fills the budget with buffers one thread keeps cached */
+#define RECLAIM_BUDGET_KB 8192
+#define RECLAIM_CACHED_SIZE (1024*1024)
+#define RECLAIM_CACHED_CNT (RECLAIM_BUDGET_KB/1024)
+#define RECLAIM_SIZE (2*1024*1024)
+
+
+typedef struct _StressSlot{
+    pthread_mutex_t lock;
+    void * handle;
+    unsigned int * virt_addr;
+    int size;
+    unsigned int stamp;
+}StressSlot;
+
+static const int g_stress_sizes[] =
+    {
+        1920*1088*3/2,  /* 1080p NV12 */
+        1280*720*3/2,
+        720*576*3/2,
+        352*288*3/2,
+        4096,
+        12*1024,
+        64*1024,
+    };
+
+#define STRESS_SIZES (sizeof(g_stress_sizes)/sizeof(g_stress_sizes[0]))
+
+static StressSlot g_stress_slots[STRESS_SLOTS];
+static const char * g_stress_backend;
+static int g_stress_ops;
+static int g_stress_failed = 0;
+
+
+static unsigned int
+stress_rand(unsigned int * seed)
+{
+    *seed = (*seed)*1103515245+12345;
+    return (*seed)>>8;
+}
+
+static double
+stress_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+static void
+stress_fail(const char * what, int slot, StressSlot * s)
+{
+    printf("%s: %s, slot %d size %d buffer %p\n", g_stress_backend, what,
+        slot, s->size, s->virt_addr);
+    __sync_fetch_and_add(&g_stress_failed, 1);
+}
+
+/* the first and the last word carry the stamp */
+static void
+stress_stamp(StressSlot * s, unsigned int stamp)
+{
+    s->virt_addr[0] = stamp;
+    s->virt_addr[s->size/sizeof(unsigned int)-1] = ~stamp;
+}
+
+static void
+stress_check(StressSlot * s, int slot)
+{
+    if ((s->virt_addr[0]!=s->stamp)
+        || (s->virt_addr[s->size/sizeof(unsigned int)-1]!=~s->stamp)){
+        stress_fail("buffer overwritten while in use", slot, s);
+    }
+}
+
+static int
+stress_alloc(StressSlot * s, int size, unsigned int stamp)
+{
+    void * phy_addr = NULL;
+    void * virt_addr = NULL;
+    s->handle = mfw_new_hw_buffer(size, &phy_addr, &virt_addr, 0);
+    if (s->handle==NULL){
+        return -1;
+    }
+    mfw_hw_buffer_set_owner(s->handle, STRESS_OWNER);
+    s->virt_addr = virt_addr;
+    s->size = size;
+    s->stamp = stamp;
+    if ((phy_addr==NULL) || (virt_addr==NULL)){
+        stress_fail("no address", -1, s);
+        return 0;
+    }
+    stress_stamp(s, stamp);
+    return 0;
+}
+
+static void
+stress_free(StressSlot * s, int slot)
+{
+    stress_check(s, slot);
+    /* a stale stamp shows up if the buffer is handed out again too early */
+    stress_stamp(s, 0);
+    mfw_free_hw_buffer(s->handle);
+    s->handle = NULL;
+}
+
+static void *
+stress_thread(void * arg)
+{
+    unsigned int seed = (unsigned int)(long)arg*2654435761u+1;
+    unsigned int stamp;
+    StressSlot * s;
+    int i, slot;
+
+    for (i=0;i<g_stress_ops;i++){
+        slot = stress_rand(&seed)%STRESS_SLOTS;
+        s = &g_stress_slots[slot];
+        pthread_mutex_lock(&s->lock);
+        if (s->handle){
+            stress_free(s, slot);
+        }else{
+            int size = g_stress_sizes[stress_rand(&seed)%STRESS_SIZES];
+            stamp = ((unsigned int)(long)arg<<24)|(i&0xffffff)|1;
+            if (stress_alloc(s, size, stamp)){
+                s->size = size;
+                stress_fail("allocation failed", slot, s);
+            }
+        }
+        pthread_mutex_unlock(&s->lock);
+        if (g_stress_failed){
+            break;
+        }
+    }
+    return NULL;
+}
+
+static int
+stress_run(const char * backend, int ops, int threads)
+{
+    pthread_t tids[threads];
+    StressSlot probe;
+    double start, seconds;
+    int i;
+
+    setenv(HWBUF_BACKEND_ENV, backend, 1);
+    g_stress_backend = backend;
+    g_stress_ops = ops;
+
+    if (stress_alloc(&probe, 4096, 1)){
+        printf("%s: backend not available, skipped\n", backend);
+        return STRESS_SKIP;
+    }
+    stress_free(&probe, -1);
+
+    for (i=0;i<STRESS_SLOTS;i++){
+        pthread_mutex_init(&g_stress_slots[i].lock, NULL);
+    }
+
+    start = stress_now();
+    for (i=0;i<threads;i++){
+        pthread_create(&tids[i], NULL, stress_thread, (void *)(long)i);
+    }
+    for (i=0;i<threads;i++){
+        pthread_join(tids[i], NULL);
+    }
+    seconds = stress_now()-start;
+
+    for (i=0;i<STRESS_SLOTS;i++){
+        if (g_stress_slots[i].handle){
+            stress_free(&g_stress_slots[i], i);
+        }
+    }
+
+    printf("%s: %d threads, %d ops in %.3f s, %.0f ns per op\n", backend,
+        threads, ops*threads, seconds, seconds*1e9/((double)ops*threads));
+    mfw_hw_buffer_dump_stats();
+
+    return g_stress_failed ? 1 : 0;
+}
+
+static pthread_mutex_t g_reclaim_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_reclaim_cond = PTHREAD_COND_INITIALIZER;
+static int g_reclaim_state = 0;
+
+static void
+reclaim_set_state(int state)
+{
+    pthread_mutex_lock(&g_reclaim_lock);
+    g_reclaim_state = state;
+    pthread_cond_broadcast(&g_reclaim_cond);
+    pthread_mutex_unlock(&g_reclaim_lock);
+}
+
+static void
+reclaim_wait_state(int state)
+{
+    pthread_mutex_lock(&g_reclaim_lock);
+    while(g_reclaim_state<state){
+        pthread_cond_wait(&g_reclaim_cond, &g_reclaim_lock);
+    }
+    pthread_mutex_unlock(&g_reclaim_lock);
+}
+
+/* takes the whole budget, frees it into its own cache and stays alive */
+static void *
+reclaim_thread(void * arg)
+{
+    StressSlot slots[RECLAIM_CACHED_CNT];
+    int i, cnt = 0;
+
+    for (i=0;i<RECLAIM_CACHED_CNT;i++){
+        if (stress_alloc(&slots[i], RECLAIM_CACHED_SIZE, i+1)){
+            break;
+        }
+        cnt++;
+    }
+    if (cnt<RECLAIM_CACHED_CNT){
+        printf("%s: budget holds only %d buffers\n", g_stress_backend, cnt);
+        __sync_fetch_and_add(&g_stress_failed, 1);
+    }
+    for (i=0;i<cnt;i++){
+        stress_free(&slots[i], i);
+    }
+    reclaim_set_state(1);
+    reclaim_wait_state(2);
+    return NULL;
+}
+
+static int
+reclaim_run(const char * backend)
+{
+    char budget[16];
+    pthread_t tid;
+    StressSlot s;
+
+    setenv(HWBUF_BACKEND_ENV, backend, 1);
+    snprintf(budget, sizeof(budget), "%d", RECLAIM_BUDGET_KB);
+    setenv("HWBUF_BUDGET_KB", budget, 1);
+    g_stress_backend = backend;
+
+    pthread_create(&tid, NULL, reclaim_thread, NULL);
+    reclaim_wait_state(1);
+
+    if (g_stress_failed==0){
+        if (stress_alloc(&s, RECLAIM_SIZE, 1)){
+            s.size = RECLAIM_SIZE;
+            s.virt_addr = NULL;
+            stress_fail("slabs cached by another thread not reclaimed", -1, &s);
+        }else{
+            stress_free(&s, -1);
+        }
+    }
+
+    reclaim_set_state(2);
+    pthread_join(tid, NULL);
+
+    printf("%s: reclaim from thread caches %s\n", backend,
+        g_stress_failed ? "failed" : "ok");
+    return g_stress_failed ? 1 : 0;
+}
+
+/* run in a child, the backend and the budget are picked once per process */
+static int
+run_child(const char * backend, int ops, int threads)
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid==0){
+        if (ops){
+            exit(stress_run(backend, ops, threads));
+        }
+        exit(reclaim_run(backend));
+    }
+    if ((pid<0) || (waitpid(pid, &status, 0)!=pid)
+        || (!WIFEXITED(status))){
+        printf("%s: run did not finish\n", backend);
+        return 1;
+    }
+    if (WEXITSTATUS(status)==STRESS_SKIP){
+        return STRESS_SKIP;
+    }
+    if (WEXITSTATUS(status)){
+        printf("%s: FAILED\n", backend);
+        return 1;
+    }
+    return 0;
+}
+
+int
+main(int argc, char * argv[])
+{
+    static const char * backends[] = {"anon", "ipu"};
+    int ops = STRESS_OPS, threads = STRESS_THREADS;
+    int i, failed = 0;
+
+    if (argc>1){
+        ops = atoi(argv[1]);
+    }
+    if (argc>2){
+        threads = atoi(argv[2]);
+    }
+    if ((ops<=0) || (threads<=0)){
+        printf("usage: %s [ops per thread] [threads]\n", argv[0]);
+        return 1;
+    }
+
+    for (i=0;i<sizeof(backends)/sizeof(backends[0]);i++){
+        switch (run_child(backends[i], ops, threads)){
+            case 0:
+                /* skipped backends are not available for the reclaim run */
+                if (run_child(backends[i], 0, 0)){
+                    failed++;
+                }
+                break;
+            case STRESS_SKIP:
+                break;
+            default:
+                failed++;
+                break;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
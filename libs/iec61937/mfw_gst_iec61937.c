@@ -0,0 +1,587 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Module Name:    mfw_gst_iec61937.c
+ *
+ * Description:    IEC 61937 burst parser and packer for the S/PDIF elements.
+ *                 The sync search compares a 16 byte block of stream words
+ *                 with Pa at once on NEON and SSE2, and two 16 bit words per
+ *                 32 bit load elsewhere. Payloads are copied and byte
+ *                 swapped in runs straight between the input and the output.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mfw_gst_iec61937.h"
+
+enum
+{
+  IEC61937_STATE_SEARCH,
+  IEC61937_STATE_PREAMBLE,
+  IEC61937_STATE_PAYLOAD,
+};
+
+#define IEC61937_WORD(p)  ((p)[0] | ((p)[1] << 8))
+
+/* header byte i of a big endian frame stored in either byte order */
+#define IEC61937_HDR(p, i, le)  ((p)[(le) ? ((i) ^ 1) : (i)])
+
+/* AC-3 bit rates in kbit/s by frmsizecod / 2 */
+static const guint16 ac3_bitrates[19] = {
+  32, 40, 48, 56, 64, 80, 96, 112, 128, 160,
+  192, 224, 256, 320, 384, 448, 512, 576, 640
+};
+
+static const guint ac3_rates[3] = { 48000, 44100, 32000 };
+static const guint eac3_rates2[3] = { 24000, 22050, 16000 };
+static const guint eac3_blocks[4] = { 1, 2, 3, 6 };
+
+static const guint dts_rates[16] = {
+  0, 8000, 16000, 32000, 0, 0, 11025, 22050,
+  44100, 0, 0, 12000, 24000, 48000, 0, 0
+};
+
+/* index of the first stream word equal to Pa, n if there is none */
+static guint
+mfw_gst_iec61937_find_sync (const guint8 * data, guint n, guint wsize)
+{
+  guint32 w, x;
+  guint i = 0;
+
+  /* whole blocks without Pa are skipped, the word loop below finds the
+     word in the block with a hit and scans the tail */
+#if defined(__ARM_NEON__) && (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+  if (wsize == 2) {
+    const uint16x8_t pat = vdupq_n_u16 (MFW_GST_IEC61937_SYNC1);
+    uint64x2_t hit;
+
+    for (; i + 8 <= n; i += 8) {
+      hit = vreinterpretq_u64_u16 (vceqq_u16 (vreinterpretq_u16_u8 (vld1q_u8
+                  (data + i * 2)), pat));
+      if (vgetq_lane_u64 (hit, 0) | vgetq_lane_u64 (hit, 1))
+        break;
+    }
+  } else {
+    const uint32x4_t mask = vdupq_n_u32 (0xFFFF);
+    const uint32x4_t pat = vdupq_n_u32 (MFW_GST_IEC61937_SYNC1);
+    uint64x2_t hit;
+
+    for (; i + 4 <= n; i += 4) {
+      hit = vreinterpretq_u64_u32 (vceqq_u32 (vandq_u32 (vreinterpretq_u32_u8
+                  (vld1q_u8 (data + i * 4)), mask), pat));
+      if (vgetq_lane_u64 (hit, 0) | vgetq_lane_u64 (hit, 1))
+        break;
+    }
+  }
+#elif defined(__SSE2__)
+  if (wsize == 2) {
+    const __m128i pat = _mm_set1_epi16 ((gint16) MFW_GST_IEC61937_SYNC1);
+
+    for (; i + 8 <= n; i += 8) {
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi16 (_mm_loadu_si128 ((const __m128i
+                          *) (data + i * 2)), pat)))
+        break;
+    }
+  } else {
+    const __m128i mask = _mm_set1_epi32 (0xFFFF);
+    const __m128i pat = _mm_set1_epi32 (MFW_GST_IEC61937_SYNC1);
+
+    for (; i + 4 <= n; i += 4) {
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (_mm_and_si128 (_mm_loadu_si128
+                      ((const __m128i *) (data + i * 4)), mask), pat)))
+        break;
+    }
+  }
+#endif
+
+  if (wsize == 2) {
+    const guint32 pat = GUINT32_FROM_LE (0xF872F872);
+
+    /* a 16 bit half of w ^ pat is zero where a word matches */
+    for (; i + 1 < n; i += 2) {
+      memcpy (&w, data + i * 2, 4);
+      x = w ^ pat;
+      if ((x - 0x00010001) & ~x & 0x80008000) {
+        if (IEC61937_WORD (data + i * 2) == MFW_GST_IEC61937_SYNC1)
+          return i;
+        if (IEC61937_WORD (data + i * 2 + 2) == MFW_GST_IEC61937_SYNC1)
+          return i + 1;
+      }
+    }
+    if ((i < n) && (IEC61937_WORD (data + i * 2) == MFW_GST_IEC61937_SYNC1))
+      return i;
+    return n;
+  } else {
+    const guint32 mask = GUINT32_FROM_LE (0xFFFF);
+    const guint32 pat = GUINT32_FROM_LE (MFW_GST_IEC61937_SYNC1);
+
+    for (; i < n; i++) {
+      memcpy (&w, data + i * 4, 4);
+      if ((w & mask) == pat)
+        return i;
+    }
+    return n;
+  }
+}
+
+/* copy payload from up to n stream words, returns the words used */
+static guint
+mfw_gst_iec61937_copy (MfwGstIec61937Parser * parser, const guint8 * data,
+    guint n, guint wsize)
+{
+  guint bytes = MIN (parser->left, n * 2);
+  guint copy, i;
+
+  copy = (parser->pos < parser->size) ?
+      MIN (bytes, parser->size - parser->pos) : 0;
+
+  if (parser->out && copy) {
+    guint8 *out = parser->out + parser->pos;
+
+    if (wsize == 2) {
+      memcpy (out, data, copy);
+    } else {
+      for (i = 0; i + 1 < copy; i += 2, data += 4) {
+        out[i] = data[0];
+        out[i + 1] = data[1];
+      }
+      if (i < copy)
+        out[i] = data[0];
+    }
+  }
+
+  parser->pos += bytes;
+  parser->left -= bytes;
+  return bytes / 2;
+}
+
+/* one stream word outside of the fast paths */
+static MfwGstIec61937Result
+mfw_gst_iec61937_word (MfwGstIec61937Parser * parser, const guint8 * w)
+{
+  guint16 v = IEC61937_WORD (w);
+
+  switch (parser->state) {
+    case IEC61937_STATE_SEARCH:
+      if (v == MFW_GST_IEC61937_SYNC1) {
+        parser->pre[0] = v;
+        parser->npre = 1;
+        parser->state = IEC61937_STATE_PREAMBLE;
+      }
+      break;
+
+    case IEC61937_STATE_PREAMBLE:
+      if ((parser->npre == 1) && (v != MFW_GST_IEC61937_SYNC2)) {
+        if (v != MFW_GST_IEC61937_SYNC1)
+          parser->state = IEC61937_STATE_SEARCH;
+        break;
+      }
+      parser->pre[parser->npre++] = v;
+      if (parser->npre < 4)
+        break;
+
+      parser->size = mfw_gst_iec61937_payload_size (parser->pre[2] & 0x1f,
+          parser->pre[3]);
+      parser->pos = 0;
+      parser->left = (parser->size + 1) & ~1;
+      parser->out = NULL;
+      if (parser->size == 0) {
+        parser->state = IEC61937_STATE_SEARCH;
+        break;
+      }
+      parser->state = IEC61937_STATE_PAYLOAD;
+      return MFW_GST_IEC61937_BURST;
+
+    case IEC61937_STATE_PAYLOAD:
+      mfw_gst_iec61937_copy (parser, w, 1, parser->width >> 3);
+      if (parser->left == 0) {
+        parser->state = IEC61937_STATE_SEARCH;
+        return MFW_GST_IEC61937_PAYLOAD;
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return MFW_GST_IEC61937_NEED_DATA;
+}
+
+guint
+mfw_gst_iec61937_payload_size (guint type, guint pd)
+{
+  switch (type) {
+    case MFW_GST_IEC61937_NULL:
+    case MFW_GST_IEC61937_PAUSE:
+      return 0;
+    case MFW_GST_IEC61937_EAC3:
+      /* the only type with Pd in bytes */
+      return pd;
+    default:
+      return (pd + 7) >> 3;
+  }
+}
+
+guint
+mfw_gst_iec61937_detect (const guint8 * data, guint len)
+{
+  guint n = len / 2, i = 0;
+
+  while (i < n) {
+    i += mfw_gst_iec61937_find_sync (data + i * 2, n - i, 2);
+    if ((i + 1 < n)
+        && (IEC61937_WORD (data + i * 2 + 2) == MFW_GST_IEC61937_SYNC2))
+      return 16;
+    if ((i + 2 < n)
+        && (IEC61937_WORD (data + i * 2 + 4) == MFW_GST_IEC61937_SYNC2))
+      return 32;
+    i++;
+  }
+  return 0;
+}
+
+void
+mfw_gst_iec61937_parser_init (MfwGstIec61937Parser * parser, guint width)
+{
+  memset (parser, 0, sizeof (MfwGstIec61937Parser));
+  parser->width = (width == 32) ? 32 : 16;
+  parser->state = IEC61937_STATE_SEARCH;
+}
+
+void
+mfw_gst_iec61937_parser_reset (MfwGstIec61937Parser * parser)
+{
+  mfw_gst_iec61937_parser_init (parser, parser->width);
+}
+
+MfwGstIec61937Result
+mfw_gst_iec61937_parse (MfwGstIec61937Parser * parser, const guint8 * data,
+    guint len, guint * consumed)
+{
+  MfwGstIec61937Result ret = MFW_GST_IEC61937_NEED_DATA;
+  const guint wsize = parser->width >> 3;
+  guint used = 0, n;
+
+  /* finish a word split over two inputs */
+  if (parser->ncarry) {
+    n = MIN (wsize - parser->ncarry, len);
+    memcpy (parser->carry + parser->ncarry, data, n);
+    parser->ncarry += n;
+    used = n;
+    if (parser->ncarry < wsize)
+      goto done;
+    parser->ncarry = 0;
+    ret = mfw_gst_iec61937_word (parser, parser->carry);
+  }
+
+  while ((ret == MFW_GST_IEC61937_NEED_DATA) && (len - used >= wsize)) {
+    n = (len - used) / wsize;
+
+    switch (parser->state) {
+      case IEC61937_STATE_SEARCH:
+        used += mfw_gst_iec61937_find_sync (data + used, n, wsize) * wsize;
+        if (len - used >= wsize) {
+          ret = mfw_gst_iec61937_word (parser, data + used);
+          used += wsize;
+        }
+        break;
+
+      case IEC61937_STATE_PAYLOAD:
+        used += mfw_gst_iec61937_copy (parser, data + used, n, wsize) * wsize;
+        if (parser->left == 0) {
+          parser->state = IEC61937_STATE_SEARCH;
+          ret = MFW_GST_IEC61937_PAYLOAD;
+        }
+        break;
+
+      default:
+        ret = mfw_gst_iec61937_word (parser, data + used);
+        used += wsize;
+        break;
+    }
+  }
+
+  if ((ret == MFW_GST_IEC61937_NEED_DATA) && (len > used)) {
+    parser->ncarry = len - used;
+    memcpy (parser->carry, data + used, parser->ncarry);
+    used = len;
+  }
+
+done:
+  *consumed = used;
+  return ret;
+}
+
+void
+mfw_gst_iec61937_parser_set_output (MfwGstIec61937Parser * parser,
+    guint8 * out)
+{
+  parser->out = out;
+}
+
+guint
+mfw_gst_iec61937_find_frame (const guint8 * data, guint len)
+{
+  guint i;
+
+  for (i = 0; i + 1 < len; i++) {
+    switch (data[i]) {
+      case 0x0B:
+        if (data[i + 1] == 0x77)
+          return i;
+        break;
+      case 0x77:
+        if (data[i + 1] == 0x0B)
+          return i;
+        break;
+      case 0x7F:
+        if (data[i + 1] == 0xFE)
+          return i;
+        break;
+      case 0xFE:
+        if (data[i + 1] == 0x7F)
+          return i;
+        break;
+      default:
+        break;
+    }
+  }
+  return len ? len - 1 : 0;
+}
+
+static gboolean
+mfw_gst_iec61937_ac3_info (const guint8 * data, gboolean le,
+    MfwGstIec61937Frame * frame)
+{
+  guint bsid = IEC61937_HDR (data, 5, le) >> 3;
+  guint b2 = IEC61937_HDR (data, 2, le);
+  guint b4 = IEC61937_HDR (data, 4, le);
+  guint fscod = b4 >> 6;
+
+  if (bsid <= 10) {
+    guint frmsizecod = b4 & 0x3f;
+    guint br;
+
+    if ((fscod == 3) || (frmsizecod > 37))
+      return FALSE;
+
+    br = ac3_bitrates[frmsizecod >> 1];
+    frame->type = MFW_GST_IEC61937_AC3;
+    frame->rate = ac3_rates[fscod];
+    frame->samples = MFW_GST_IEC61937_AC3_PERIOD;
+    switch (fscod) {
+      case 0:
+        frame->size = br * 4;
+        break;
+      case 1:
+        frame->size = (br * 96000 / 44100 + (frmsizecod & 1)) * 2;
+        break;
+      default:
+        frame->size = br * 6;
+        break;
+    }
+  } else if (bsid <= 16) {
+    guint strmtyp = b2 >> 6;
+    guint substreamid = (b2 >> 3) & 0x7;
+
+    frame->type = MFW_GST_IEC61937_EAC3;
+    frame->size =
+        ((((b2 & 0x7) << 8) | IEC61937_HDR (data, 3, le)) + 1) * 2;
+    if (fscod == 3) {
+      if (((b4 >> 4) & 0x3) == 3)
+        return FALSE;
+      frame->rate = eac3_rates2[(b4 >> 4) & 0x3];
+      frame->samples = 6 * 256;
+    } else {
+      frame->rate = ac3_rates[fscod];
+      frame->samples = eac3_blocks[(b4 >> 4) & 0x3] * 256;
+    }
+    /* only the independent substream 0 counts toward the period */
+    if ((strmtyp == 1) || (substreamid != 0))
+      frame->samples = 0;
+  } else {
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+mfw_gst_iec61937_dts_info (const guint8 * data, gboolean le,
+    MfwGstIec61937Frame * frame)
+{
+  guint b4 = IEC61937_HDR (data, 4, le);
+  guint b5 = IEC61937_HDR (data, 5, le);
+  guint b6 = IEC61937_HDR (data, 6, le);
+  guint b7 = IEC61937_HDR (data, 7, le);
+  guint b8 = IEC61937_HDR (data, 8, le);
+  guint nblks = (((b4 & 0x1) << 6) | (b5 >> 2)) + 1;
+  guint fsize = (((b5 & 0x3) << 12) | (b6 << 4) | (b7 >> 4)) + 1;
+
+  if (fsize < 96)
+    return FALSE;
+
+  switch (nblks * 32) {
+    case 512:
+      frame->type = MFW_GST_IEC61937_DTS1;
+      break;
+    case 1024:
+      frame->type = MFW_GST_IEC61937_DTS2;
+      break;
+    case 2048:
+      frame->type = MFW_GST_IEC61937_DTS3;
+      break;
+    default:
+      return FALSE;
+  }
+  frame->size = fsize;
+  frame->samples = nblks * 32;
+  frame->rate = dts_rates[(b8 >> 2) & 0xf];
+
+  return TRUE;
+}
+
+gboolean
+mfw_gst_iec61937_frame_info (const guint8 * data, guint len,
+    MfwGstIec61937Frame * frame)
+{
+  if (len < MFW_GST_IEC61937_FRAME_HEADER_LEN)
+    return FALSE;
+
+  memset (frame, 0, sizeof (MfwGstIec61937Frame));
+
+  if ((data[0] == 0x0B) && (data[1] == 0x77))
+    return mfw_gst_iec61937_ac3_info (data, FALSE, frame);
+  if ((data[0] == 0x77) && (data[1] == 0x0B)) {
+    frame->le = TRUE;
+    return mfw_gst_iec61937_ac3_info (data, TRUE, frame);
+  }
+  if ((data[0] == 0x7F) && (data[1] == 0xFE)
+      && (data[2] == 0x80) && (data[3] == 0x01))
+    return mfw_gst_iec61937_dts_info (data, FALSE, frame);
+  if ((data[0] == 0xFE) && (data[1] == 0x7F)
+      && (data[2] == 0x01) && (data[3] == 0x80)) {
+    frame->le = TRUE;
+    return mfw_gst_iec61937_dts_info (data, TRUE, frame);
+  }
+
+  return FALSE;
+}
+
+guint
+mfw_gst_iec61937_period (guint type)
+{
+  switch (type) {
+    case MFW_GST_IEC61937_AC3:
+      return MFW_GST_IEC61937_AC3_PERIOD;
+    case MFW_GST_IEC61937_EAC3:
+      return MFW_GST_IEC61937_EAC3_PERIOD;
+    case MFW_GST_IEC61937_DTS1:
+      return 512;
+    case MFW_GST_IEC61937_DTS2:
+      return 1024;
+    case MFW_GST_IEC61937_DTS3:
+      return 2048;
+    default:
+      return 0;
+  }
+}
+
+/* one stream word from its little endian value bytes */
+static inline guint8 *
+mfw_gst_iec61937_put (guint8 * out, guint width, guint8 lo, guint8 hi)
+{
+  out[0] = lo;
+  out[1] = hi;
+  if (width == 32) {
+    out[2] = 0;
+    out[3] = 0;
+    return out + 4;
+  }
+  return out + 2;
+}
+
+void
+mfw_gst_iec61937_pack (guint8 * out, guint size, guint width, guint type,
+    const guint8 * payload, guint len, gboolean le)
+{
+  guint8 *end = out + size;
+  guint pd, i = 0;
+  guint32 w;
+
+  pd = (type == MFW_GST_IEC61937_EAC3) ? len : (len << 3);
+  out = mfw_gst_iec61937_put (out, width, 0x72, 0xF8);
+  out = mfw_gst_iec61937_put (out, width, 0x1F, 0x4E);
+  out = mfw_gst_iec61937_put (out, width, type & 0xff, type >> 8);
+  out = mfw_gst_iec61937_put (out, width, pd & 0xff, (pd >> 8) & 0xff);
+
+  if (width == 16) {
+    if (le) {
+      memcpy (out, payload, len & ~1);
+      i = len & ~1;
+    } else {
+      /* swap the bytes of two words per 32 bit load */
+      for (; i + 3 < len; i += 4) {
+        memcpy (&w, payload + i, 4);
+        w = ((w & 0x00FF00FF) << 8) | ((w >> 8) & 0x00FF00FF);
+        memcpy (out + i, &w, 4);
+      }
+      for (; i + 1 < len; i += 2) {
+        out[i] = payload[i + 1];
+        out[i + 1] = payload[i];
+      }
+    }
+    out += i;
+  } else {
+    for (; i + 1 < len; i += 2) {
+      if (le)
+        out = mfw_gst_iec61937_put (out, width, payload[i], payload[i + 1]);
+      else
+        out = mfw_gst_iec61937_put (out, width, payload[i + 1], payload[i]);
+    }
+  }
+
+  /* an odd last byte is the first byte of its word */
+  if (i < len) {
+    if (le)
+      out = mfw_gst_iec61937_put (out, width, payload[i], 0);
+    else
+      out = mfw_gst_iec61937_put (out, width, 0, payload[i]);
+  }
+
+  if (out < end)
+    memset (out, 0, end - out);
+}
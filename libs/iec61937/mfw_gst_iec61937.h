@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Module Name:    mfw_gst_iec61937.h
+ *
+ * Description:    IEC 61937 burst parser and packer for the S/PDIF elements
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __MFW_GST_IEC61937_H__
+#define __MFW_GST_IEC61937_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* burst preamble sync words Pa and Pb */
+#define MFW_GST_IEC61937_SYNC1      0xF872
+#define MFW_GST_IEC61937_SYNC2      0x4E1F
+#define MFW_GST_IEC61937_HEADER_LEN 8   /* Pa Pb Pc Pd */
+
+/* data types in bits 0-4 of Pc */
+#define MFW_GST_IEC61937_NULL       0
+#define MFW_GST_IEC61937_AC3        1
+#define MFW_GST_IEC61937_PAUSE      3
+#define MFW_GST_IEC61937_MPEG1_L1   4
+#define MFW_GST_IEC61937_MPEG1_L23  5
+#define MFW_GST_IEC61937_MPEG2_EXT  6
+#define MFW_GST_IEC61937_MPEG2_AAC  7
+#define MFW_GST_IEC61937_DTS1       11
+#define MFW_GST_IEC61937_DTS2       12
+#define MFW_GST_IEC61937_DTS3       13
+#define MFW_GST_IEC61937_EAC3       21
+
+/* repetition period in stereo frames */
+#define MFW_GST_IEC61937_AC3_PERIOD   1536
+#define MFW_GST_IEC61937_EAC3_PERIOD  6144      /* 1536 at 4 x the rate */
+
+/* samples per E-AC-3 burst, 6 audio blocks from one or more frames */
+#define MFW_GST_IEC61937_EAC3_SAMPLES 1536
+
+#define MFW_GST_IEC61937_FRAME_HEADER_LEN 10    /* bytes to parse a frame */
+
+/*
+ * Header of a compressed audio frame to pack.
+ */
+typedef struct
+{
+  guint type;                   /* burst data type */
+  guint size;                   /* frame bytes */
+  guint samples;                /* samples per channel, 0 for E-AC-3
+                                   dependent substreams */
+  guint rate;                   /* sample rate, 0 if unknown */
+  gboolean le;                  /* 16 bit words are little endian */
+} MfwGstIec61937Frame;
+
+typedef enum
+{
+  MFW_GST_IEC61937_NEED_DATA,   /* all input used */
+  MFW_GST_IEC61937_BURST,       /* preamble parsed, set the output now */
+  MFW_GST_IEC61937_PAYLOAD,     /* payload of the burst complete */
+} MfwGstIec61937Result;
+
+/*
+ * Streaming burst parser. Input can be split anywhere, the parser keeps
+ * its position and resumes in the next call. Stream words are 16 bit, or
+ * 32 bit with the 16 bit value in the first two bytes. Words are little
+ * endian and the payload is written out as received.
+ */
+typedef struct
+{
+  guint width;                  /* bits per stream word, 16 or 32 */
+
+  /*< private > */
+  gint state;
+  guint16 pre[4];
+  guint npre;
+  guint8 carry[4];              /* part of a word split over inputs */
+  guint ncarry;
+  guint8 *out;
+  guint size;                   /* payload bytes of the burst */
+  guint pos;                    /* payload bytes received */
+  guint left;                   /* stream payload bytes to come, even */
+} MfwGstIec61937Parser;
+
+#define mfw_gst_iec61937_parser_type(p)   ((p)->pre[2] & 0x1f)
+#define mfw_gst_iec61937_parser_size(p)   ((p)->size)
+
+/*!
+ * Payload bytes of a burst from its data type and Pd.
+ */
+guint mfw_gst_iec61937_payload_size (guint type, guint pd);
+
+/*!
+ * Find the first burst preamble in the data.
+ *
+ * @return  the stream word width, 16 or 32, 0 if there is no burst.
+ */
+guint mfw_gst_iec61937_detect (const guint8 * data, guint len);
+
+/*!
+ * Set up the parser for a stream word width of 16 or 32 bits.
+ */
+void mfw_gst_iec61937_parser_init (MfwGstIec61937Parser * parser, guint width);
+
+/*!
+ * Drop the partial burst, parsing restarts with a sync search.
+ */
+void mfw_gst_iec61937_parser_reset (MfwGstIec61937Parser * parser);
+
+/*!
+ * Parse input until the next event.
+ *
+ * On MFW_GST_IEC61937_BURST the type and size of the burst are known and
+ * mfw_gst_iec61937_parser_set_output () must be called before parsing on.
+ * On MFW_GST_IEC61937_PAYLOAD the whole payload has been written out.
+ * Bursts without payload are skipped.
+ *
+ * @param   consumed    bytes of data used, the rest is for the next call
+ */
+MfwGstIec61937Result mfw_gst_iec61937_parse (MfwGstIec61937Parser * parser,
+    const guint8 * data, guint len, guint * consumed);
+
+/*!
+ * Where to write the payload of the current burst, at least size bytes.
+ * NULL skips the payload, MFW_GST_IEC61937_PAYLOAD is still returned.
+ */
+void mfw_gst_iec61937_parser_set_output (MfwGstIec61937Parser * parser,
+    guint8 * out);
+
+/*!
+ * Offset of the first AC-3, E-AC-3 or DTS sync word candidate in either
+ * byte order, len - 1 if there is none.
+ */
+guint mfw_gst_iec61937_find_frame (const guint8 * data, guint len);
+
+/*!
+ * Parse the header of a frame at data, len must be at least
+ * MFW_GST_IEC61937_FRAME_HEADER_LEN.
+ *
+ * @return  FALSE if there is no valid frame header at data.
+ */
+gboolean mfw_gst_iec61937_frame_info (const guint8 * data, guint len,
+    MfwGstIec61937Frame * frame);
+
+/*!
+ * Repetition period of a data type in stereo frames, 0 if unsupported.
+ */
+guint mfw_gst_iec61937_period (guint type);
+
+/*!
+ * Write one burst of size bytes: preamble, the payload as stream words and
+ * zero stuffing, in one pass. Big endian payload is byte swapped to the
+ * little endian stream words.
+ *
+ * @param   width   bits per stream word, 16 or 32
+ * @param   le      the payload words are already little endian
+ */
+void mfw_gst_iec61937_pack (guint8 * out, guint size, guint width,
+    guint type, const guint8 * payload, guint len, gboolean le);
+
+G_END_DECLS
+
+#endif /* __MFW_GST_IEC61937_H__ */
@@ -0,0 +1,527 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/*
+ * Module Name:    mfw_gst_iec61937_test.c
+ *
+ * Description:    Burst corpus for the IEC 61937 parser and packer. AC-3,
+ *                 E-AC-3 and DTS frames of both byte orders are packed into
+ *                 16 and 32 bit streams between null and pause bursts,
+ *                 noise and false preambles, and parsed back with the
+ *                 input split at every size from one byte up. The frame
+ *                 header parser is checked against the AC-3 frame size
+ *                 table and the E-AC-3 and DTS header fields.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+
+#include "mfw_gst_iec61937.h"
+
+#define IEC61937_TEST_SEED      0x61937
+#define IEC61937_TEST_BURSTS    48
+#define IEC61937_TEST_MAX_FRAME 8192
+
+typedef struct
+{
+  guint type;
+  guint size;
+  guint8 *payload;              /* as the stream words carry it */
+} Iec61937TestBurst;
+
+typedef struct
+{
+  guint8 *data;
+  guint len;
+  Iec61937TestBurst bursts[IEC61937_TEST_BURSTS];
+  guint nbursts;
+} Iec61937TestStream;
+
+static gint failures;
+
+#define IEC61937_TEST_CHECK(cond, ...)      \
+  G_STMT_START {                            \
+    if (!(cond)) {                          \
+      g_printerr (__VA_ARGS__);             \
+      g_printerr ("\n");                    \
+      failures++;                           \
+    }                                       \
+  } G_STMT_END
+
+/* big endian frame headers, the rest of the frame is noise */
+
+static guint
+iec61937_test_ac3 (GRand * rand, guint8 * f, guint fscod, guint frmsizecod)
+{
+  static const guint16 words48[19] = {
+    64, 80, 96, 112, 128, 160, 192, 224, 256, 320,
+    384, 448, 512, 640, 768, 896, 1024, 1152, 1280
+  };
+  static const guint16 words44[19] = {
+    69, 87, 104, 121, 139, 174, 208, 243, 278, 348,
+    417, 487, 557, 696, 835, 975, 1114, 1253, 1393
+  };
+  static const guint16 words32[19] = {
+    96, 120, 144, 168, 192, 240, 288, 336, 384, 480,
+    576, 672, 768, 960, 1152, 1344, 1536, 1728, 1920
+  };
+  guint size, i;
+
+  /* frame sizes as tabulated in A/52, not derived from the bit rate */
+  switch (fscod) {
+    case 0:
+      size = words48[frmsizecod >> 1] * 2;
+      break;
+    case 1:
+      size = (words44[frmsizecod >> 1] + (frmsizecod & 1)) * 2;
+      break;
+    default:
+      size = words32[frmsizecod >> 1] * 2;
+      break;
+  }
+
+  for (i = 0; i < size; i++)
+    f[i] = (guint8) g_rand_int (rand);
+  f[0] = 0x0B;
+  f[1] = 0x77;
+  f[4] = (fscod << 6) | frmsizecod;
+  f[5] = (8 << 3) | (f[5] & 0x7);
+  return size;
+}
+
+static guint
+iec61937_test_eac3 (GRand * rand, guint8 * f, guint strmtyp,
+    guint substreamid, guint fscod, guint code, guint words)
+{
+  guint size = words * 2, i;
+
+  for (i = 0; i < size; i++)
+    f[i] = (guint8) g_rand_int (rand);
+  f[0] = 0x0B;
+  f[1] = 0x77;
+  f[2] = (strmtyp << 6) | (substreamid << 3) | (((words - 1) >> 8) & 0x7);
+  f[3] = (words - 1) & 0xff;
+  f[4] = (fscod << 6) | (code << 4) | (f[4] & 0xf);
+  f[5] = (16 << 3) | (f[5] & 0x7);
+  return size;
+}
+
+static guint
+iec61937_test_dts (GRand * rand, guint8 * f, guint nblks, guint fsize,
+    guint sfreq)
+{
+  guint i;
+
+  for (i = 0; i < fsize; i++)
+    f[i] = (guint8) g_rand_int (rand);
+  f[0] = 0x7F;
+  f[1] = 0xFE;
+  f[2] = 0x80;
+  f[3] = 0x01;
+  f[4] = (f[4] & 0xfe) | (((nblks - 1) >> 6) & 0x1);
+  f[5] = (((nblks - 1) & 0x3f) << 2) | (((fsize - 1) >> 12) & 0x3);
+  f[6] = ((fsize - 1) >> 4) & 0xff;
+  f[7] = (((fsize - 1) & 0xf) << 4) | (f[7] & 0xf);
+  f[8] = (f[8] & 0xc3) | (sfreq << 2);
+  return fsize;
+}
+
+/* swap to the little endian byte order of some encoders, odd tail kept */
+static void
+iec61937_test_swap (guint8 * f, guint size)
+{
+  guint8 t;
+  guint i;
+
+  for (i = 0; i + 1 < size; i += 2) {
+    t = f[i];
+    f[i] = f[i + 1];
+    f[i + 1] = t;
+  }
+}
+
+static void
+iec61937_test_info (const guint8 * f, guint size, gboolean valid,
+    guint type, guint samples, guint rate)
+{
+  guint8 copy[MFW_GST_IEC61937_FRAME_HEADER_LEN];
+  MfwGstIec61937Frame frame;
+  gboolean le, ret;
+
+  for (le = FALSE; le <= TRUE; le++) {
+    memcpy (copy, f, sizeof (copy));
+    if (le)
+      iec61937_test_swap (copy, sizeof (copy));
+
+    ret = mfw_gst_iec61937_frame_info (copy, sizeof (copy), &frame);
+    IEC61937_TEST_CHECK (ret == valid, "header %02x %02x %02x %02x %02x %02x"
+        " le %d: valid %d, want %d", f[2], f[3], f[4], f[5], f[6], f[7], le,
+        ret, valid);
+    if (!ret || !valid)
+      continue;
+
+    IEC61937_TEST_CHECK ((frame.type == type) && (frame.size == size)
+        && (frame.samples == samples) && (frame.rate == rate)
+        && (frame.le == le), "header %02x %02x %02x %02x %02x %02x le %d: "
+        "type %u size %u samples %u rate %u, want %u %u %u %u", f[2], f[3],
+        f[4], f[5], f[6], f[7], le, frame.type, frame.size, frame.samples,
+        frame.rate, type, size, samples, rate);
+    IEC61937_TEST_CHECK (mfw_gst_iec61937_find_frame (copy, sizeof (copy))
+        == 0, "frame sync not found at 0");
+  }
+}
+
+static void
+iec61937_test_headers (GRand * rand)
+{
+  static const guint ac3_rates[3] = { 48000, 44100, 32000 };
+  static const guint eac3_rates2[3] = { 24000, 22050, 16000 };
+  static const guint dts_rates[16] = {
+    0, 8000, 16000, 32000, 0, 0, 11025, 22050,
+    44100, 0, 0, 12000, 24000, 48000, 0, 0
+  };
+  guint8 *f = g_malloc (IEC61937_TEST_MAX_FRAME);
+  guint fscod, code, typ, id, nblks, sfreq, size;
+
+  for (fscod = 0; fscod < 3; fscod++)
+    for (code = 0; code < 38; code++) {
+      size = iec61937_test_ac3 (rand, f, fscod, code);
+      iec61937_test_info (f, size, TRUE, MFW_GST_IEC61937_AC3,
+          MFW_GST_IEC61937_AC3_PERIOD, ac3_rates[fscod]);
+    }
+  iec61937_test_ac3 (rand, f, 0, 0);
+  f[4] = (3 << 6);
+  iec61937_test_info (f, 0, FALSE, 0, 0, 0);
+  f[4] = 38;
+  iec61937_test_info (f, 0, FALSE, 0, 0, 0);
+  f[4] = 0;
+  f[5] = 17 << 3;
+  iec61937_test_info (f, 0, FALSE, 0, 0, 0);
+
+  /* only independent substream 0 carries samples for the period */
+  for (typ = 0; typ < 3; typ++)
+    for (id = 0; id < 8; id += 7)
+      for (fscod = 0; fscod < 4; fscod++)
+        for (code = 0; code < 4; code++) {
+          guint samples, rate;
+
+          if ((fscod == 3) && (code == 3)) {
+            iec61937_test_eac3 (rand, f, typ, id, fscod, code, 100);
+            iec61937_test_info (f, 0, FALSE, 0, 0, 0);
+            continue;
+          }
+          size = iec61937_test_eac3 (rand, f, typ, id, fscod, code,
+              1 + g_rand_int_range (rand, 5, 2048));
+          samples = (fscod == 3) ? 1536 : ((code == 3) ? 6 : code + 1) * 256;
+          rate = (fscod == 3) ? eac3_rates2[code] : ac3_rates[fscod];
+          if ((typ == 1) || (id != 0))
+            samples = 0;
+          iec61937_test_info (f, size, TRUE, MFW_GST_IEC61937_EAC3, samples,
+              rate);
+        }
+
+  for (nblks = 8; nblks <= 128; nblks++)
+    for (sfreq = 0; sfreq < 16; sfreq += 5) {
+      guint type = (nblks == 16) ? MFW_GST_IEC61937_DTS1 :
+          (nblks == 32) ? MFW_GST_IEC61937_DTS2 :
+          (nblks == 64) ? MFW_GST_IEC61937_DTS3 : 0;
+
+      size = iec61937_test_dts (rand, f, nblks, g_rand_int_range (rand, 96,
+              IEC61937_TEST_MAX_FRAME), sfreq);
+      iec61937_test_info (f, size, type != 0, type, nblks * 32,
+          dts_rates[sfreq]);
+    }
+  iec61937_test_dts (rand, f, 16, 95, 13);
+  iec61937_test_info (f, 0, FALSE, 0, 0, 0);
+
+  g_free (f);
+}
+
+static void
+iec61937_test_payload_size (void)
+{
+  IEC61937_TEST_CHECK (mfw_gst_iec61937_payload_size (MFW_GST_IEC61937_NULL,
+          800) == 0, "null burst has a payload");
+  IEC61937_TEST_CHECK (mfw_gst_iec61937_payload_size (MFW_GST_IEC61937_PAUSE,
+          32) == 0, "pause burst has a payload");
+  IEC61937_TEST_CHECK (mfw_gst_iec61937_payload_size (MFW_GST_IEC61937_AC3,
+          1792 * 8) == 1792, "AC-3 Pd is not in bits");
+  IEC61937_TEST_CHECK (mfw_gst_iec61937_payload_size (MFW_GST_IEC61937_DTS1,
+          8001) == 1001, "DTS Pd does not round up to bytes");
+  IEC61937_TEST_CHECK (mfw_gst_iec61937_payload_size (MFW_GST_IEC61937_EAC3,
+          1001) == 1001, "E-AC-3 Pd is not in bytes");
+}
+
+/* random words, preambles only where the corpus puts them */
+static guint8 *
+iec61937_test_noise (GRand * rand, guint8 * out, guint words, guint wsize)
+{
+  guint i, v;
+
+  for (i = 0; i < words; i++, out += wsize) {
+    do {
+      v = g_rand_int (rand);
+    } while (((v & 0xffff) == MFW_GST_IEC61937_SYNC1)
+        || ((v & 0xffff) == MFW_GST_IEC61937_SYNC2));
+    memcpy (out, &v, wsize);
+  }
+  return out;
+}
+
+static guint8 *
+iec61937_test_word (guint8 * out, guint16 v, guint wsize)
+{
+  out[0] = v & 0xff;
+  out[1] = v >> 8;
+  if (wsize == 4) {
+    out[2] = 0;
+    out[3] = 0;
+  }
+  return out + wsize;
+}
+
+/*
+ * One stream of packed frames for a word width. Every burst fills its
+ * repetition period, as the packer writes them for spdif_tx, and runs of
+ * noise, null and pause bursts and broken preambles sit between them.
+ */
+static void
+iec61937_test_stream (GRand * rand, Iec61937TestStream * s, guint width)
+{
+  guint wsize = width / 8;
+  guint8 *f = g_malloc (IEC61937_TEST_MAX_FRAME);
+  guint8 *out;
+  guint alloc, i, k;
+
+  /* the longest period is E-AC-3, two words per stereo frame */
+  alloc = IEC61937_TEST_BURSTS * (MFW_GST_IEC61937_EAC3_PERIOD * 2 + 256)
+      * wsize;
+  s->data = out = g_malloc (alloc);
+  s->nbursts = 0;
+
+  for (i = 0; i < IEC61937_TEST_BURSTS; i++) {
+    Iec61937TestBurst *b = &s->bursts[s->nbursts];
+    MfwGstIec61937Frame frame;
+    guint size, period;
+    gboolean le = g_rand_boolean (rand);
+
+    switch (g_rand_int_range (rand, 0, 4)) {
+      case 0:
+        out = iec61937_test_noise (rand, out, g_rand_int_range (rand, 0, 64),
+            wsize);
+        break;
+      case 1:
+        /* Pa without Pb, and Pa Pa Pb which is still a preamble */
+        out = iec61937_test_word (out, MFW_GST_IEC61937_SYNC1, wsize);
+        out = iec61937_test_noise (rand, out, 1, wsize);
+        out = iec61937_test_word (out, MFW_GST_IEC61937_SYNC1, wsize);
+        break;
+      case 2:
+        /* bursts without payload, skipped by the parser */
+        out = iec61937_test_word (out, MFW_GST_IEC61937_SYNC1, wsize);
+        out = iec61937_test_word (out, MFW_GST_IEC61937_SYNC2, wsize);
+        out = iec61937_test_word (out, g_rand_boolean (rand) ?
+            MFW_GST_IEC61937_NULL : MFW_GST_IEC61937_PAUSE, wsize);
+        out = iec61937_test_word (out, 32, wsize);
+        out = iec61937_test_noise (rand, out, 4, wsize);
+        break;
+      default:
+        break;
+    }
+
+    switch (g_rand_int_range (rand, 0, 3)) {
+      case 0:
+        size = iec61937_test_ac3 (rand, f, g_rand_int_range (rand, 0, 3),
+            g_rand_int_range (rand, 0, 38));
+        break;
+      case 1:
+        size = iec61937_test_eac3 (rand, f, 0, 0, 0, 3,
+            g_rand_int_range (rand, 5, 2048));
+        break;
+      default:
+        /* odd sizes leave half a stream word */
+        size = iec61937_test_dts (rand, f, 16 << g_rand_int_range (rand, 0, 3),
+            g_rand_int_range (rand, 96, 2 * 512), 13);
+        break;
+    }
+    if (le)
+      iec61937_test_swap (f, size);
+
+    IEC61937_TEST_CHECK (mfw_gst_iec61937_frame_info (f, size, &frame),
+        "corpus frame %u not recognized", i);
+    period = mfw_gst_iec61937_period (frame.type) * 2 * wsize;
+    mfw_gst_iec61937_pack (out, period, width, frame.type, f, size, le);
+
+    /* preamble, payload words, then zero stuffing to the period */
+    for (k = MFW_GST_IEC61937_HEADER_LEN / 2 + (size + 1) / 2; k < period /
+        wsize; k++)
+      IEC61937_TEST_CHECK ((out[k * wsize] | out[k * wsize + 1]) == 0,
+          "%u bit burst %u not stuffed at word %u", width, i, k);
+
+    b->type = frame.type;
+    b->size = size;
+    b->payload = g_malloc (size);
+    for (k = 0; k < size; k++)
+      b->payload[k] = (le || (k ^ 1) < size) ? f[le ? k : k ^ 1] : 0;
+    s->nbursts++;
+    out += period;
+  }
+
+  s->len = out - s->data;
+
+  /* 32 bit captures may carry anything next to the 16 bit value */
+  if (wsize == 4)
+    for (k = 0; k < s->len; k += 4) {
+      s->data[k + 2] = (guint8) g_rand_int (rand);
+      s->data[k + 3] = (guint8) g_rand_int (rand);
+    }
+
+  g_free (f);
+}
+
+static void
+iec61937_test_free (Iec61937TestStream * s)
+{
+  guint i;
+
+  for (i = 0; i < s->nbursts; i++)
+    g_free (s->bursts[i].payload);
+  g_free (s->data);
+}
+
+/*
+ * Parse the stream in pieces of split bytes, or of random sizes for split
+ * 0. Every other payload is skipped when skip is set, reset_at drops the
+ * parser state right after that burst started.
+ */
+static void
+iec61937_test_parse (GRand * rand, const Iec61937TestStream * s, guint width,
+    guint split, gboolean skip, guint reset_at)
+{
+  MfwGstIec61937Parser parser;
+  MfwGstIec61937Result ret;
+  guint8 *out = NULL;
+  guint off = 0, next = 0, len, used, consumed;
+
+  mfw_gst_iec61937_parser_init (&parser, width);
+
+  while (off < s->len) {
+    len = MIN (s->len - off, split ? split :
+        (guint) g_rand_int_range (rand, 1, 9000));
+    used = 0;
+
+    do {
+      ret = mfw_gst_iec61937_parse (&parser, s->data + off + used, len - used,
+          &consumed);
+      IEC61937_TEST_CHECK ((consumed <= len - used)
+          && ((ret != MFW_GST_IEC61937_NEED_DATA) || (consumed == len - used)),
+          "%u bit split %u: consumed %u of %u", width, split, consumed,
+          len - used);
+      used += consumed;
+
+      if (ret == MFW_GST_IEC61937_BURST) {
+        const Iec61937TestBurst *b;
+
+        if (next >= s->nbursts) {
+          IEC61937_TEST_CHECK (FALSE, "%u bit split %u: extra burst", width,
+              split);
+          g_free (out);
+          return;
+        }
+        b = &s->bursts[next];
+        if ((mfw_gst_iec61937_parser_type (&parser) != b->type)
+            || (mfw_gst_iec61937_parser_size (&parser) != b->size)) {
+          /* out of step with the corpus, the rest would only repeat it */
+          IEC61937_TEST_CHECK (FALSE, "%u bit split %u burst %u: type %u "
+              "size %u, want %u %u", width, split, next,
+              mfw_gst_iec61937_parser_type (&parser),
+              mfw_gst_iec61937_parser_size (&parser), b->type, b->size);
+          g_free (out);
+          return;
+        }
+
+        if (next == reset_at) {
+          mfw_gst_iec61937_parser_reset (&parser);
+          next++;
+          continue;
+        }
+        g_free (out);
+        out = (skip && (next & 1)) ? NULL : g_malloc (b->size);
+        mfw_gst_iec61937_parser_set_output (&parser, out);
+      } else if (ret == MFW_GST_IEC61937_PAYLOAD) {
+        const Iec61937TestBurst *b = &s->bursts[next];
+
+        IEC61937_TEST_CHECK (!out || (memcmp (out, b->payload, b->size) == 0),
+            "%u bit split %u burst %u: payload differs", width, split, next);
+        next++;
+      }
+    } while (used < len);
+
+    off += len;
+  }
+
+  IEC61937_TEST_CHECK (next == s->nbursts, "%u bit split %u: %u of %u bursts",
+      width, split, next, s->nbursts);
+  g_free (out);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GRand *rand = g_rand_new_with_seed (IEC61937_TEST_SEED);
+  Iec61937TestStream s;
+  guint8 noise[4096];
+  guint width, split;
+
+  iec61937_test_headers (rand);
+  iec61937_test_payload_size ();
+
+  iec61937_test_noise (rand, noise, sizeof (noise) / 2, 2);
+  IEC61937_TEST_CHECK (mfw_gst_iec61937_detect (noise, sizeof (noise)) == 0,
+      "burst detected in noise");
+
+  for (width = 16; width <= 32; width += 16) {
+    iec61937_test_stream (rand, &s, width);
+    IEC61937_TEST_CHECK (mfw_gst_iec61937_detect (s.data, s.len) == width,
+        "%u bit stream not detected", width);
+
+    for (split = 1; split <= 17; split++)
+      iec61937_test_parse (rand, &s, width, split, FALSE, G_MAXUINT);
+    iec61937_test_parse (rand, &s, width, 4096, TRUE, G_MAXUINT);
+    iec61937_test_parse (rand, &s, width, s.len, TRUE, s.nbursts / 2);
+    for (split = 0; split < 16; split++)
+      iec61937_test_parse (rand, &s, width, 0, split & 1, G_MAXUINT);
+
+    iec61937_test_free (&s);
+  }
+
+  g_rand_free (rand);
+  g_print ("%d failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
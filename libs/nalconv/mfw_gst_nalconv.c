@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_nalconv.c
+ *
+ * Description:    H.264 NAL unit framing conversion between length prefixed
+ *                 (AVC/mp4) and start code prefixed (Annex B) bitstreams
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+#include <string.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mfw_gst_nalconv.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+#if defined(__ARM_NEON__) || defined(__SSE2__)
+#define NALCONV_SCAN_BLOCK 16
+#else
+#define NALCONV_SCAN_BLOCK 4
+#endif
+
+#define NALCONV_IS_STARTCODE(p) \
+    (((p)[0] == 0) && ((p)[1] == 0) && ((p)[2] == 1))
+
+#define NALCONV_PUT_STARTCODE(p) \
+  do { \
+    (p)[0] = (p)[1] = (p)[2] = 0; \
+    (p)[3] = 0x01; \
+  } while (0)
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+
+/* scalar scan for a prefix starting in [p, limit), limit + 2 must be valid */
+static inline const guint8 *
+nalconv_scan_bytes (const guint8 * p, const guint8 * limit)
+{
+  for (; p < limit; p++) {
+    if (NALCONV_IS_STARTCODE (p))
+      return p;
+  }
+  return NULL;
+}
+
+/*=============================================================================
+                            GLOBAL FUNCTIONS
+=============================================================================*/
+
+const guint8 *
+mfw_nalconv_find_startcode (const guint8 * start, const guint8 * end)
+{
+  const guint8 *p = start;
+  const guint8 *limit, *found;
+
+  if ((start == NULL) || (end - start < 3))
+    return NULL;
+
+  /* last position a complete prefix can start at, plus one */
+  limit = end - 2;
+
+  while ((p < limit) && ((gsize) p & (NALCONV_SCAN_BLOCK - 1))) {
+    if (NALCONV_IS_STARTCODE (p))
+      return p;
+    p++;
+  }
+
+  /* A prefix always starts with a zero byte, so whole blocks without any
+   * zero byte are skipped and only the rare hits are looked at byte-wise. */
+#if defined(__ARM_NEON__)
+  {
+    const uint8x16_t zero = vdupq_n_u8 (0);
+    while (p + NALCONV_SCAN_BLOCK <= limit) {
+      uint64x2_t hit =
+          vreinterpretq_u64_u8 (vceqq_u8 (vld1q_u8 (p), zero));
+      if (vgetq_lane_u64 (hit, 0) | vgetq_lane_u64 (hit, 1)) {
+        found = nalconv_scan_bytes (p, p + NALCONV_SCAN_BLOCK);
+        if (found)
+          return found;
+      }
+      p += NALCONV_SCAN_BLOCK;
+    }
+  }
+#elif defined(__SSE2__)
+  {
+    const __m128i zero = _mm_setzero_si128 ();
+    while (p + NALCONV_SCAN_BLOCK <= limit) {
+      __m128i v = _mm_load_si128 ((const __m128i *) p);
+      if (_mm_movemask_epi8 (_mm_cmpeq_epi8 (v, zero))) {
+        found = nalconv_scan_bytes (p, p + NALCONV_SCAN_BLOCK);
+        if (found)
+          return found;
+      }
+      p += NALCONV_SCAN_BLOCK;
+    }
+  }
+#else
+  while (p + NALCONV_SCAN_BLOCK <= limit) {
+    guint32 x = *(const guint32 *) p;
+    /* non-zero when any of the 4 bytes is zero */
+    if ((x - 0x01010101) & ~x & 0x80808080) {
+      found = nalconv_scan_bytes (p, p + NALCONV_SCAN_BLOCK);
+      if (found)
+        return found;
+    }
+    p += NALCONV_SCAN_BLOCK;
+  }
+#endif
+
+  return nalconv_scan_bytes (p, limit);
+}
+
+gint
+mfw_nalconv_length_to_annexb (guint8 * src, guint src_size,
+    guint length_size, guint8 * dst, guint dst_size)
+{
+  guint8 *s = src;
+  guint8 *end = src + src_size;
+  guint8 *d = dst;
+  gboolean inplace = (dst == src);
+  guint32 len;
+  guint i;
+
+  if ((src == NULL) || (dst == NULL) || (length_size < 1)
+      || (length_size > NALCONV_START_CODE_SIZE))
+    return -1;
+  if (inplace && (length_size != NALCONV_START_CODE_SIZE))
+    return -1;
+
+  while ((guint) (end - s) >= length_size) {
+    /* the rest is already start code framed */
+    if (((guint) (end - s) >= NALCONV_START_CODE_SIZE)
+        && (s[0] == 0) && (s[1] == 0) && (s[2] == 0) && (s[3] == 1))
+      break;
+
+    len = 0;
+    for (i = 0; i < length_size; i++)
+      len = (len << 8) | s[i];
+    if (len > (guint) (end - s) - length_size)
+      break;
+
+    if (inplace) {
+      NALCONV_PUT_STARTCODE (s);
+      s += NALCONV_START_CODE_SIZE + len;
+    } else {
+      if ((guint) (dst + dst_size - d) < NALCONV_START_CODE_SIZE + len)
+        return -1;
+      NALCONV_PUT_STARTCODE (d);
+      memcpy (d + NALCONV_START_CODE_SIZE, s + length_size, len);
+      d += NALCONV_START_CODE_SIZE + len;
+      s += length_size + len;
+    }
+  }
+
+  if (inplace)
+    return src_size;
+
+  len = end - s;
+  if ((guint) (dst + dst_size - d) < len)
+    return -1;
+  memcpy (d, s, len);
+  d += len;
+
+  return d - dst;
+}
+
+gint
+mfw_nalconv_annexb_to_length (const guint8 * src, guint src_size,
+    guint8 * dst, guint dst_size)
+{
+  const guint8 *end = src + src_size;
+  const guint8 *nal, *next, *nal_end;
+  guint8 *d = dst;
+  guint32 len;
+
+  if ((src == NULL) || (dst == NULL))
+    return -1;
+
+  nal = mfw_nalconv_find_startcode (src, end);
+  if (nal == NULL)
+    return -1;
+  nal += 3;
+
+  while (nal < end) {
+    next = mfw_nalconv_find_startcode (nal, end);
+    nal_end = next ? next : end;
+    /* the leading zero of a 4 byte start code is not payload */
+    if ((next != NULL) && (nal_end > nal) && (nal_end[-1] == 0))
+      nal_end--;
+
+    len = nal_end - nal;
+    if ((guint) (dst + dst_size - d) < NALCONV_START_CODE_SIZE + len)
+      return -1;
+    d[0] = (len >> 24) & 0xff;
+    d[1] = (len >> 16) & 0xff;
+    d[2] = (len >> 8) & 0xff;
+    d[3] = len & 0xff;
+    memcpy (d + NALCONV_START_CODE_SIZE, nal, len);
+    d += NALCONV_START_CODE_SIZE + len;
+
+    if (next == NULL)
+      break;
+    nal = next + 3;
+  }
+
+  return d - dst;
+}
+
+gint
+mfw_nalconv_avcc_to_annexb (const guint8 * avcc, guint avcc_size,
+    guint8 * dst, guint dst_size, guint * length_size)
+{
+  /*
+     aligned(8) class AVCDecoderConfigurationRecord {
+     unsigned int(8) configurationVersion = 1;
+     unsigned int(8) AVCProfileIndication;
+     unsigned int(8) profile_compatibility;
+     unsigned int(8) AVCLevelIndication;
+     bit(6) reserved = '111111'b;
+     unsigned int(2) lengthSizeMinusOne;
+     bit(3) reserved = '111'b;
+     unsigned int(5) numOfSequenceParameterSets;
+     for (i=0; i< numOfSequenceParameterSets;  i++) {
+     unsigned int(16) sequenceParameterSetLength ;
+     bit(8*sequenceParameterSetLength) sequenceParameterSetNALUnit;
+     }
+     unsigned int(8) numOfPictureParameterSets;
+     for (i=0; i< numOfPictureParameterSets;  i++) {
+     unsigned int(16) pictureParameterSetLength;
+     bit(8*pictureParameterSetLength) pictureParameterSetNALUnit;
+     }
+     }
+   */
+  guint k = 5, j = 0;
+  guint set, count, i, len;
+
+  if ((avcc == NULL) || (dst == NULL) || (avcc_size < 7))
+    return -1;
+
+  if (length_size)
+    *length_size = (avcc[4] & 0x03) + 1;
+
+  /* first round SPS, second round PPS */
+  for (set = 0; set < 2; set++) {
+    if (k >= avcc_size)
+      return -1;
+    count = (set == 0) ? (avcc[k] & 0x1f) : avcc[k];
+    k++;
+
+    for (i = 0; i < count; i++) {
+      if (k + 2 > avcc_size)
+        return -1;
+      len = (avcc[k] << 8) | avcc[k + 1];
+      k += 2;
+      if ((len > avcc_size - k) || (dst_size - j < NALCONV_START_CODE_SIZE + len))
+        return -1;
+
+      NALCONV_PUT_STARTCODE (dst + j);
+      memcpy (dst + j + NALCONV_START_CODE_SIZE, avcc + k, len);
+      j += NALCONV_START_CODE_SIZE + len;
+      k += len;
+    }
+  }
+
+  return j;
+}
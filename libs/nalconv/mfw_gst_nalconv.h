@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_nalconv.h
+ *
+ * Description:    H.264 NAL unit framing conversion between length prefixed
+ *                 (AVC/mp4) and start code prefixed (Annex B) bitstreams
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __MFW_GST_NALCONV_H__
+#define __MFW_GST_NALCONV_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+#define NALCONV_START_CODE_SIZE 4
+
+/* worst case Annex B size of a length prefixed stream, every NAL grows by
+   (4 - length_size) bytes and there can be no more NALs than length fields */
+#define NALCONV_ANNEXB_MAX_SIZE(size, length_size) \
+    ((size) + ((size) / (length_size)) * (NALCONV_START_CODE_SIZE - (length_size)))
+
+/* worst case Annex B size of the parameter sets carried in an avcC record */
+#define NALCONV_AVCC_ANNEXB_MAX_SIZE(size) (2 * (size))
+
+/*!
+ * Find the next 3 byte start code prefix (00 00 01) in [start, end).
+ *
+ * @param   start   first byte to scan
+ * @param   end     one past the last byte to scan
+ *
+ * @return  pointer to the first 00 of the prefix, NULL if there is none.
+ *          A 4 byte start code begins one byte earlier when that byte is 0.
+ */
+const guint8 *mfw_nalconv_find_startcode (const guint8 * start,
+    const guint8 * end);
+
+/*!
+ * Convert a length prefixed NAL stream into Annex B in a single pass.
+ *
+ * When length_size is 4 and dst == src the conversion is done in place
+ * without moving any payload. Otherwise dst must not overlap src and should
+ * be at least NALCONV_ANNEXB_MAX_SIZE(src_size, length_size) bytes.
+ * Conversion stops at the first NAL which already starts with a start code
+ * or whose length runs past the buffer; the remaining bytes are carried over
+ * unmodified.
+ *
+ * @param   src         length prefixed input
+ * @param   src_size    input size in bytes
+ * @param   length_size size of the NAL length field, 1, 2 or 4
+ * @param   dst         output buffer, may be src when length_size is 4
+ * @param   dst_size    output buffer size in bytes
+ *
+ * @return  number of bytes written to dst, -1 on invalid arguments or
+ *          if dst is too small.
+ */
+gint mfw_nalconv_length_to_annexb (guint8 * src, guint src_size,
+    guint length_size, guint8 * dst, guint dst_size);
+
+/*!
+ * Convert an Annex B stream into 4 byte length prefixed NALs.
+ *
+ * @param   src         Annex B input, must start with a start code
+ * @param   src_size    input size in bytes
+ * @param   dst         output buffer, must not overlap src
+ * @param   dst_size    output buffer size in bytes, src_size plus one byte
+ *                      per 3 byte start code is always enough
+ *
+ * @return  number of bytes written to dst, -1 on error.
+ */
+gint mfw_nalconv_annexb_to_length (const guint8 * src, guint src_size,
+    guint8 * dst, guint dst_size);
+
+/*!
+ * Unwrap the SPS/PPS of an AVCDecoderConfigurationRecord (avcC) into
+ * start code prefixed NALs.
+ *
+ * @param   avcc        codec_data from caps
+ * @param   avcc_size   codec_data size in bytes
+ * @param   dst         output, NALCONV_AVCC_ANNEXB_MAX_SIZE(avcc_size) bytes
+ * @param   dst_size    output buffer size in bytes
+ * @param   length_size returns the NAL length field size of the stream
+ *
+ * @return  number of bytes written to dst, -1 if the record is malformed.
+ */
+gint mfw_nalconv_avcc_to_annexb (const guint8 * avcc, guint avcc_size,
+    guint8 * dst, guint dst_size, guint * length_size);
+
+G_END_DECLS
+
+#endif /* __MFW_GST_NALCONV_H__ */
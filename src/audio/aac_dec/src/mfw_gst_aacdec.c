@@ -50,6 +50,7 @@
 #endif
 #include <string.h>
 #include "aacd_dec_interface.h"
+#include "mfw_gst_blkts.h"
 #include "mfw_gst_aacdec.h"
 #include <gst/audio/multichannel.h>
 #include "mfw_gst_utils.h"
@@ -922,154 +923,6 @@ trnsptAdjustBitrate (unsigned int offset,
 }
 
 
-#ifdef PUSH_MODE
-
-#define COPY_BLOCK_TIMESTAMP(des, src) \
-    do { \
-        des->buflen = src->buflen; \
-        des->timestamp = src->timestamp; \
-    }while(0)
-
-void
-init_tsmanager (Timestamp_Manager * tm)
-{
-  memset (tm, 0, sizeof (Timestamp_Manager));
-}
-
-void
-deinit_tsmanager (Timestamp_Manager * tm)
-{
-  if (tm->allocatedbuffer) {
-    g_free (tm->allocatedbuffer);
-  }
-  memset (tm, 0, sizeof (Timestamp_Manager));
-}
-
-void
-clear_tsmanager (Timestamp_Manager * tm)
-{
-  int i;
-  Block_Timestamp *bt = tm->allocatedbuffer;
-  tm->freelist = tm->head = tm->tail = NULL;
-  for (i = 0; i < tm->allocatednum; i++) {
-    bt->next = tm->freelist;
-    tm->freelist = bt;
-    bt++;
-  }
-}
-
-Block_Timestamp *
-new_block_timestamp (Timestamp_Manager * tm)
-{
-  Block_Timestamp *newbuffer;
-  if (tm->freelist) {
-    newbuffer = tm->freelist;
-    tm->freelist = newbuffer->next;
-    return newbuffer;
-  }
-  if (tm->allocatednum)
-    tm->allocatednum <<= 1;
-  else
-    tm->allocatednum = 4;
-  if (newbuffer = g_malloc (sizeof (Block_Timestamp) * tm->allocatednum)) {
-    Block_Timestamp *oldhead, *nb;
-    int i = 0;
-
-    oldhead = tm->head;
-    nb = newbuffer;
-    tm->freelist = tm->head = tm->tail = NULL;
-    for (i = 0; i < (tm->allocatednum - 1); i++) {
-      if (oldhead) {
-        COPY_BLOCK_TIMESTAMP (nb, oldhead);
-        nb->next = NULL;
-        if (tm->tail) {
-          (tm->tail)->next = nb;
-          tm->tail = nb;
-        } else {
-          tm->head = tm->tail = nb;
-        }
-        oldhead = oldhead->next;
-      } else {
-        nb->next = tm->freelist;
-        tm->freelist = nb;
-      }
-      nb++;
-    }
-    if (tm->allocatedbuffer) {
-      g_free (tm->allocatedbuffer);
-    }
-    tm->allocatedbuffer = newbuffer;
-    return nb;
-  } else {
-    return newbuffer;
-  }
-}
-
-gboolean
-push_block_with_timestamp (Timestamp_Manager * tm, guint blen,
-    GstClockTime timestamp)
-{
-  Block_Timestamp *bt;
-  if (bt = new_block_timestamp (tm)) {
-    bt->buflen = blen;
-    bt->timestamp = timestamp;
-    bt->next = NULL;
-    if (tm->tail) {
-      (tm->tail)->next = bt;
-      tm->tail = bt;
-    } else {
-      tm->head = tm->tail = bt;
-    }
-    return TRUE;
-  } else {
-    return FALSE;
-  }
-}
-
-GstClockTime
-get_timestamp_with_length (Timestamp_Manager * tm, guint length)
-{
-  GstClockTime ts = -1;
-  Block_Timestamp *bt = tm->head;
-  if (bt) {
-    ts = bt->timestamp;
-    while (length >= bt->buflen) {
-      length -= bt->buflen;
-      if (bt == tm->tail) {
-        tm->tail = NULL;
-      }
-      tm->head = bt->next;
-      bt->next = tm->freelist;
-      tm->freelist = bt;
-      bt = tm->head;
-      if (!bt)
-        break;
-    }
-    if (bt) {
-      bt->buflen -= length;
-    }
-  }
-  return ts;
-}
-
-#if 0
-guint
-get_tsmanager_length (Timestamp_Manager * tm)
-{
-  guint len = 0;
-  Block_Timestamp *bt = tm->head;
-  while (bt) {
-    len += bt->buflen;
-    bt = bt->next;
-  }
-  return len;
-}
-#endif
-
-#endif
-
-
-
 /*=============================================================================
 FUNCTION: mfw_gst_aacdec_set_property
 
@@ -1421,6 +1274,7 @@ mfw_gst_aacdec_data (MFW_GST_AACDEC_INFO_T * aacdec_info, gint inbuffsize)
   dec_config = aacdec_info->app_params.dec_config;
   GstBuffer *residue = NULL;
   GstClockTime ts;
+  gboolean discont;
   gint consumelen = 0;
   guint framesinbuffer = 0;
 
@@ -1572,7 +1426,7 @@ mfw_gst_aacdec_data (MFW_GST_AACDEC_INFO_T * aacdec_info, gint inbuffsize)
       consumelen=gst_adapter_available (aacdec_info->pAdapter);
 
   if (*(dec_config->AACD_bno) < 2) {
-    get_timestamp_with_length (&aacdec_info->tsMgr, consumelen);
+    mfw_gst_blkts_consume (&aacdec_info->tsMgr, consumelen, NULL);
     goto bail;
   }
 
@@ -1694,9 +1548,12 @@ mfw_gst_aacdec_data (MFW_GST_AACDEC_INFO_T * aacdec_info, gint inbuffsize)
 
     /* The timestamp in nanoseconds     of the data     in the buffer. */
 
-    ts = get_timestamp_with_length (&aacdec_info->tsMgr, consumelen);
+    ts = mfw_gst_blkts_consume (&aacdec_info->tsMgr, consumelen, &discont);
     if (GST_CLOCK_TIME_IS_VALID (ts)) {
-      if ((ts > aacdec_info->time_offset)
+      if (discont) {
+        GST_DEBUG ("discont, resync to %" GST_TIME_FORMAT, GST_TIME_ARGS (ts));
+        aacdec_info->time_offset = ts;
+      } else if ((ts > aacdec_info->time_offset)
           && (ts - aacdec_info->time_offset > TIMESTAMP_DIFFRENCE_MAX_IN_NS)) {
         GST_ERROR ("error timestamp");
         aacdec_info->time_offset = ts;
@@ -2286,6 +2143,7 @@ mfw_gst_aacdec_chain (GstPad * pad, GstBuffer * buf)
   guint64 time_duration = 0;
   AACD_Decoder_Config *dec_config = NULL;
   gint i = 0;
+  gboolean discont;
   aacdec_info = MFW_GST_AACDEC (GST_OBJECT_PARENT (pad));
 
   if (aacdec_info->demo_mode == 2)
@@ -2294,6 +2152,7 @@ mfw_gst_aacdec_chain (GstPad * pad, GstBuffer * buf)
 
 
   aacdec_info->buffer_time = GST_BUFFER_TIMESTAMP (buf);
+  discont = GST_BUFFER_IS_DISCONT (buf);
 
 
   if (!aacdec_info->init_done) {
@@ -2404,9 +2263,10 @@ mfw_gst_aacdec_chain (GstPad * pad, GstBuffer * buf)
     }
 #ifdef PUSH_MODE
     if (GST_BUFFER_SIZE (aacdec_info->inbuffer1) > 0) {
+      mfw_gst_blkts_push (&aacdec_info->tsMgr,
+          GST_BUFFER_SIZE (aacdec_info->inbuffer1), aacdec_info->buffer_time,
+          discont);
       gst_adapter_push (aacdec_info->pAdapter, aacdec_info->inbuffer1);
-      push_block_with_timestamp (&aacdec_info->tsMgr,
-          GST_BUFFER_SIZE (buf), GST_BUFFER_TIMESTAMP (buf));
     } else {
       gst_buffer_unref (buf);
     }
@@ -2418,9 +2278,11 @@ mfw_gst_aacdec_chain (GstPad * pad, GstBuffer * buf)
 
   if (aacdec_info->packetised)
     buf = gen_codec_buffer (aacdec_info, buf);
+  /* the codec buffer carries the timestamp of the extra header, use the
+     one of the input buffer */
+  mfw_gst_blkts_push (&aacdec_info->tsMgr, GST_BUFFER_SIZE (buf),
+      aacdec_info->buffer_time, discont);
   gst_adapter_push (aacdec_info->pAdapter, buf);
-  push_block_with_timestamp (&aacdec_info->tsMgr, GST_BUFFER_SIZE (buf),
-      GST_BUFFER_TIMESTAMP (buf));
   while ((inbuffsize = gst_adapter_available (aacdec_info->pAdapter))
       > (BS_BUF_SIZE + ADTS_HEADER_LENGTH) || (aacdec_info->packetised
           && inbuffsize > 0)) {
@@ -2596,7 +2458,7 @@ mfw_gst_aacdec_change_state (GstElement * element, GstStateChange transition)
 
 #ifdef PUSH_MODE
       aacdec_info->pAdapter = gst_adapter_new ();
-      init_tsmanager (&aacdec_info->tsMgr);
+      mfw_gst_blkts_init (&aacdec_info->tsMgr);
 #endif
       break;
 
@@ -2659,7 +2521,7 @@ mfw_gst_aacdec_change_state (GstElement * element, GstStateChange transition)
         g_object_unref (aacdec_info->pAdapter);
         aacdec_info->pAdapter = NULL;
       }
-      deinit_tsmanager (&aacdec_info->tsMgr);
+      mfw_gst_blkts_deinit (&aacdec_info->tsMgr);
 #endif
       break;
 
@@ -3339,7 +3201,7 @@ mfw_gst_aacdec_sink_event (GstPad * pad, GstEvent * event)
       }
 #else
       gst_adapter_clear (aacdec_info->pAdapter);
-      clear_tsmanager (&aacdec_info->tsMgr);
+      mfw_gst_blkts_clear (&aacdec_info->tsMgr);
 #endif
       result = gst_pad_push_event (aacdec_info->srcpad, event);
       if (TRUE != result) {
@@ -50,6 +50,7 @@ Portability: This file is ported for Linux and GStreamer.
 #include <string.h>
 #include "aacd_dec_interface.h"
 #include "aacplus_dec_interface.h"
+#include "mfw_gst_blkts.h"
 #include "mfw_gst_aacplusdec.h"
 #include <gst/audio/multichannel.h>
 #include "mfw_gst_utils.h"
@@ -956,159 +957,6 @@ trnsptAdjustBitrate (unsigned int offset,
 }
 
 
-#ifdef PUSH_MODE
-
-#define COPY_BLOCK_TIMESTAMP(des, src) \
-    do { \
-        des->buflen = src->buflen; \
-        des->timestamp = src->timestamp; \
-    }while(0)
-
-void
-init_tsmanager (Timestamp_Manager * tm)
-{
-    memset (tm, 0, sizeof (Timestamp_Manager));
-}
-
-void
-deinit_tsmanager (Timestamp_Manager * tm)
-{
-    if (tm->allocatedbuffer) {
-        g_free (tm->allocatedbuffer);
-    }
-    memset (tm, 0, sizeof (Timestamp_Manager));
-}
-
-void
-clear_tsmanager (Timestamp_Manager * tm)
-{
-    int i;
-    Block_Timestamp *bt = tm->allocatedbuffer;
-    tm->freelist = tm->head = tm->tail = NULL;
-    for (i = 0; i < tm->allocatednum; i++) {
-        bt->next = tm->freelist;
-        tm->freelist = bt;
-        bt++;
-    }
-}
-
-Block_Timestamp *
-new_block_timestamp (Timestamp_Manager * tm)
-{
-    Block_Timestamp *newbuffer;
-    if (tm->freelist) {
-        newbuffer = tm->freelist;
-        tm->freelist = newbuffer->next;
-        return newbuffer;
-    }
-    if (tm->allocatednum)
-        tm->allocatednum <<= 1;
-    else
-        tm->allocatednum = 4;
-    if (newbuffer = g_malloc (sizeof (Block_Timestamp) * tm->allocatednum)) {
-        Block_Timestamp *oldhead, *nb;
-        int i = 0;
-
-        oldhead = tm->head;
-        nb = newbuffer;
-        tm->freelist = tm->head = tm->tail = NULL;
-        for (i = 0; i < (tm->allocatednum - 1); i++) {
-            if (oldhead) {
-                COPY_BLOCK_TIMESTAMP (nb, oldhead);
-                nb->next = NULL;
-                if (tm->tail) {
-                    (tm->tail)->next = nb;
-                    tm->tail = nb;
-                }
-                else {
-                    tm->head = tm->tail = nb;
-                }
-                oldhead = oldhead->next;
-            }
-            else {
-                nb->next = tm->freelist;
-                tm->freelist = nb;
-            }
-            nb++;
-        }
-        if (tm->allocatedbuffer) {
-            g_free (tm->allocatedbuffer);
-        }
-        tm->allocatedbuffer = newbuffer;
-        return nb;
-    }
-    else {
-        return newbuffer;
-    }
-}
-
-gboolean
-push_block_with_timestamp (Timestamp_Manager * tm, guint blen,
-                           GstClockTime timestamp)
-{
-    Block_Timestamp *bt;
-    if (bt = new_block_timestamp (tm)) {
-        bt->buflen = blen;
-        bt->timestamp = timestamp;
-        bt->next = NULL;
-        if (tm->tail) {
-            (tm->tail)->next = bt;
-            tm->tail = bt;
-        }
-        else {
-            tm->head = tm->tail = bt;
-        }
-        return TRUE;
-    }
-    else {
-        return FALSE;
-    }
-}
-
-GstClockTime
-get_timestamp_with_length (Timestamp_Manager * tm, guint length)
-{
-    GstClockTime ts = -1;
-    Block_Timestamp *bt = tm->head;
-    if (bt) {
-        ts = bt->timestamp;
-        while (length >= bt->buflen) {
-            length -= bt->buflen;
-            if (bt == tm->tail) {
-                tm->tail = NULL;
-            }
-            tm->head = bt->next;
-            bt->next = tm->freelist;
-            tm->freelist = bt;
-            bt = tm->head;
-            if (!bt)
-                break;
-        }
-        if (bt) {
-            bt->buflen -= length;
-        }
-    }
-    return ts;
-}
-
-#if 0
-guint
-get_tsmanager_length (Timestamp_Manager * tm)
-{
-    guint len = 0;
-    Block_Timestamp *bt = tm->head;
-    while (bt) {
-        len += bt->buflen;
-        bt = bt->next;
-    }
-    return len;
-}
-#endif
-
-#endif
-
-
-
 /*=============================================================================
 FUNCTION: mfw_gst_aacplusdec_set_property
 
@@ -1453,6 +1301,7 @@ mfw_gst_aacplusdec_data (MFW_GST_AACPLUSDEC_INFO_T * aacplusdec_info,
     dec_config = aacplusdec_info->app_params.dec_config;
     GstBuffer *residue = NULL;
     GstClockTime ts;
+    gboolean discont;
     gint consumelen = 0;
     guint framesinbuffer = 0;
 
@@ -1617,7 +1466,7 @@ mfw_gst_aacplusdec_data (MFW_GST_AACPLUSDEC_INFO_T * aacplusdec_info,
           consumelen=gst_adapter_available (aacplusdec_info->pAdapter);
 
         if (*(dec_config->AACD_bno) < 2) {
-            get_timestamp_with_length (&aacplusdec_info->tsMgr, consumelen);
+            mfw_gst_blkts_consume (&aacplusdec_info->tsMgr, consumelen, NULL);
             return consumelen;
         }
 
@@ -1781,10 +1630,15 @@ mfw_gst_aacplusdec_data (MFW_GST_AACPLUSDEC_INFO_T * aacplusdec_info,
 
             /* The timestamp in nanoseconds     of the data     in the buffer. */
 
-            ts = get_timestamp_with_length (&aacplusdec_info->tsMgr,
-                                            consumelen);
+            ts = mfw_gst_blkts_consume (&aacplusdec_info->tsMgr,
+                                        consumelen, &discont);
             if (GST_CLOCK_TIME_IS_VALID (ts)) {
-                if ((ts > aacplusdec_info->time_offset)
+                if (discont) {
+                    GST_DEBUG ("discont, resync to %" GST_TIME_FORMAT,
+                               GST_TIME_ARGS (ts));
+                    aacplusdec_info->time_offset = ts;
+                }
+                else if ((ts > aacplusdec_info->time_offset)
                     && (ts - aacplusdec_info->time_offset >
                         TIMESTAMP_DIFFRENCE_MAX_IN_NS)) {
                     GST_ERROR ("error timestamp\n");
@@ -2374,6 +2228,7 @@ mfw_gst_aacplusdec_chain (GstPad * pad, GstBuffer * buf)
     guint64 time_duration = 0;
     AACD_Decoder_Config *dec_config = NULL;
     gint i = 0;
+    gboolean discont;
     aacplusdec_info = MFW_GST_AACPLUSDEC (GST_OBJECT_PARENT (pad));
 
     if (aacplusdec_info->demo_mode == 2)
@@ -2383,6 +2238,7 @@ mfw_gst_aacplusdec_chain (GstPad * pad, GstBuffer * buf)
 
 
     aacplusdec_info->buffer_time = GST_BUFFER_TIMESTAMP (buf);
+    discont = GST_BUFFER_IS_DISCONT (buf);
 
 
     if (!aacplusdec_info->init_done) {
@@ -2484,11 +2340,11 @@ mfw_gst_aacplusdec_chain (GstPad * pad, GstBuffer * buf)
         }
 
         if (GST_BUFFER_SIZE (aacplusdec_info->inbuffer1) > 0) {
+            mfw_gst_blkts_push (&aacplusdec_info->tsMgr,
+                                GST_BUFFER_SIZE (aacplusdec_info->inbuffer1),
+                                aacplusdec_info->buffer_time, discont);
             gst_adapter_push (aacplusdec_info->pAdapter,
                               aacplusdec_info->inbuffer1);
-            push_block_with_timestamp (&aacplusdec_info->tsMgr,
-                                       GST_BUFFER_SIZE (buf),
-                                       GST_BUFFER_TIMESTAMP (buf));
         }
         else {
             gst_buffer_unref (buf);
@@ -2500,9 +2356,11 @@ mfw_gst_aacplusdec_chain (GstPad * pad, GstBuffer * buf)
 
     if (aacplusdec_info->packetised)
         buf = gen_codec_buffer (aacplusdec_info, buf);
+    /* the codec buffer carries the timestamp of the extra header, use the
+       one of the input buffer */
+    mfw_gst_blkts_push (&aacplusdec_info->tsMgr, GST_BUFFER_SIZE (buf),
+                        aacplusdec_info->buffer_time, discont);
     gst_adapter_push (aacplusdec_info->pAdapter, buf);
-    push_block_with_timestamp (&aacplusdec_info->tsMgr, GST_BUFFER_SIZE (buf),
-                               GST_BUFFER_TIMESTAMP (buf));
     while ((inbuffsize = gst_adapter_available (aacplusdec_info->pAdapter)) 
         >(BS_BUF_SIZE + ADTS_HEADER_LENGTH) || (aacplusdec_info->packetised && inbuffsize>0)) {
         gint flushlen;
@@ -2689,7 +2547,7 @@ mfw_gst_aacplusdec_change_state (GstElement * element,
 
 #ifdef PUSH_MODE
         aacplusdec_info->pAdapter = gst_adapter_new ();
-        init_tsmanager (&aacplusdec_info->tsMgr);
+        mfw_gst_blkts_init (&aacplusdec_info->tsMgr);
 #endif
 
         break;
@@ -2750,7 +2608,7 @@ mfw_gst_aacplusdec_change_state (GstElement * element,
 #ifdef PUSH_MODE
         gst_adapter_clear (aacplusdec_info->pAdapter);
         g_object_unref (aacplusdec_info->pAdapter);
-        deinit_tsmanager (&aacplusdec_info->tsMgr);
+        mfw_gst_blkts_deinit (&aacplusdec_info->tsMgr);
 #endif
         break;
 
@@ -3462,7 +3320,7 @@ mfw_gst_aacplusdec_sink_event (GstPad * pad, GstEvent * event)
             }
 #else
             gst_adapter_clear (aacplusdec_info->pAdapter);
-            clear_tsmanager (&aacplusdec_info->tsMgr);
+            mfw_gst_blkts_clear (&aacplusdec_info->tsMgr);
 #endif
             result = gst_pad_push_event (aacplusdec_info->srcpad, event);
             if (TRUE != result) {
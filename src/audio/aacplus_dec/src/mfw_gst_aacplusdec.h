@@ -121,22 +121,6 @@ typedef struct AACD_App_params_S {
     AACD_Decoder_Config *dec_config;	/* decoder context */
 } AACD_App_params;
 
-#ifdef PUSH_MODE
-typedef struct _blocktimestamp{
-    struct _blocktimestamp * next;
-    guint buflen;
-    GstClockTime timestamp;
-}Block_Timestamp;
-
-typedef struct _timestampmanager{
-    Block_Timestamp * allocatedbuffer;
-    Block_Timestamp * freelist;
-    Block_Timestamp * head;
-    Block_Timestamp * tail;
-    guint  allocatednum; 
-}Timestamp_Manager;
-#endif
-
 typedef struct MFW_GST_AACPLUSDEC_INFO_S {
     GstElement element;
     GstPad *sinkpad;
@@ -171,7 +155,7 @@ gint nBitsReceived;
     gboolean corrupt_bs;
 #ifdef PUSH_MODE    
     GstAdapter * pAdapter;
-    Timestamp_Manager tsMgr;
+    MfwGstBlockTs tsMgr;
 #endif    
     gint demo_mode; /* 0: Normal mode, 1: Demo mode 2: Demo ending */
     gint error_cnt;
@@ -151,6 +151,14 @@ GST_STATIC_PAD_TEMPLATE("src",
 #define AC3_BIG_STARTCODE 0x00000B77
 #define AC3_LITTLE_STARTCODE 0x0000770B
 
+/* seek index: one checkpoint per interval, head of file probed in one read */
+#define AC3_INDEX_INTERVAL   GST_SECOND
+#define AC3_INDEX_PROBE_SIZE (64 * 1024)
+#define AC3_SYNC_INFO_SIZE   6
+
+/* decoder output, 6 channels interleaved */
+#define AC3_DECODE_OUT_SIZE  (6 * AC3D_FRAME_SIZE * sizeof(AC3D_INT32))
+
 /* the clock in MHz for IMX31 to be changed for other platforms */
 #define PROCESSOR_CLOCK 532
 
@@ -159,6 +167,26 @@ GST_STATIC_PAD_TEMPLATE("src",
 #define	GST_TAG_MFW_AC3_CHANNELS		"channels"
 #define GST_TAG_MFW_AC3_SAMPLING_RATE	        "sampling_frequency"
 
+/*==================================================================================================
+                                 LOCAL TYPEDEFS
+==================================================================================================*/
+
+/* Output buffers are recycled through the pool by their free function. A
+   pool is referenced by the element and by each block out in a buffer, so
+   downstream may hold buffers past the element's lifetime. */
+typedef struct _MfwGstAc3OutPool {
+    gint refcount;
+    GMutex *lock;
+    guint block_size;		/* data bytes per block, 0 when not sized */
+    struct _MfwGstAc3OutBlock *blocks;	/* free blocks */
+} MfwGstAc3OutPool;
+
+typedef struct _MfwGstAc3OutBlock {
+    MfwGstAc3OutPool *pool;
+    struct _MfwGstAc3OutBlock *next;
+    guint64 size;		/* data bytes, data follows the header */
+} MfwGstAc3OutBlock;
+
 /*==================================================================================================
                                       STATIC VARIABLES
 ==================================================================================================*/
@@ -179,6 +207,14 @@ static GstStateChangeReturn mfw_gst_ac3dec_change_state(GstElement *,
 static gboolean mfw_gst_ac3dec_sink_event(GstPad * pad, GstEvent * event);
 static GstFlowReturn mfw_gst_ac3dec_chain(GstPad * pad, GstBuffer * buf);
 static GstFlowReturn decode_ac3_chunk(MfwGstAc3DecInfo * ac3dec_info);
+static gint mfw_gst_ac3dec_parse_frame(MfwGstAc3DecInfo * ac3dec_info);
+static gint mfw_gst_ac3dec_find_startcode(char *buffer, int len);
+static gint mfw_gst_ac3dec_sync_info(const guint8 * buffer, gint * samplerate,
+				     gboolean * eac3);
+static MfwGstAc3OutPool *mfw_gst_ac3dec_out_pool_new(void);
+static void mfw_gst_ac3dec_out_pool_unref(MfwGstAc3OutPool * pool);
+static void mfw_gst_ac3dec_adapter_flush(MfwGstAc3DecInfo * ac3dec_info,
+					 guint size);
 static void *alloc_fast(gint size);
 static void *alloc_slow(gint size);
 
@@ -187,6 +223,12 @@ static void *alloc_slow(gint size);
 static gboolean mfw_gst_ac3dec_src_query(GstPad * pad, GstQuery * query);
 static gboolean mfw_gst_ac3dec_seek(MfwGstAc3DecInfo *, GstPad *,
 				    GstEvent *);
+static void mfw_gst_ac3dec_index_add(MfwGstAc3DecInfo * ac3dec_info,
+				     GstClockTime time, guint64 offset);
+static guint64 mfw_gst_ac3dec_index_lookup(MfwGstAc3DecInfo * ac3dec_info,
+					   GstClockTime time,
+					   GstClockTime * start,
+					   gboolean * exact);
 static gboolean mfw_gst_ac3dec_src_event(GstPad *pad, GstEvent *event);
 static void mfw_gst_ac3dec_dispose(GObject * object);
 static void mfw_gst_ac3dec_set_index(GstElement * element,
@@ -647,11 +689,20 @@ static void mfw_gst_ac3dec_init(MfwGstAc3DecInfo * ac3dec_info)
 
     ac3dec_info->totalBytes = 0;
     ac3dec_info->duration = 0;
-    {
-        gint loopctr;
-        for(loopctr=0; loopctr<10; loopctr++)
-            ac3dec_info->seek_index[loopctr] = 0;
-    }
+    ac3dec_info->seek_index = NULL;
+    ac3dec_info->index_last = GST_CLOCK_TIME_NONE;
+    ac3dec_info->stream_offset = GST_BUFFER_OFFSET_NONE;
+    ac3dec_info->first_frame = 0;
+    ac3dec_info->frame_bytes = 0;
+    ac3dec_info->frame_duration = 0;
+    ac3dec_info->seek_estimated = FALSE;
+    ac3dec_info->resync = FALSE;
+    ac3dec_info->cur_frame_bytes = 0;
+    ac3dec_info->cur_frame_eac3 = FALSE;
+    ac3dec_info->eac3_warned = FALSE;
+    ac3dec_info->decode_out = NULL;
+    ac3dec_info->out_channels = 0;
+    ac3dec_info->out_pool = NULL;
 
     ac3dec_info->sampling_freq_pre = 0;
     ac3dec_info->num_channels_pre = 0;
@@ -812,6 +863,9 @@ static gboolean mfw_ac3_mem_flush(MfwGstAc3DecInfo * ac3dec_info)
 	goto done;
 
     gst_adapter_clear(ac3dec_info->adapter);
+    ac3dec_info->stream_offset = GST_BUFFER_OFFSET_NONE;
+    ac3dec_info->index_last = GST_CLOCK_TIME_NONE;
+    ac3dec_info->resync = ac3dec_info->seek_estimated;
 
 
     GST_PAD_STREAM_LOCK(ac3dec_info->sinkpad);
@@ -1087,7 +1141,7 @@ static gboolean mfw_gst_ac3dec_sink_event(GstPad * pad, GstEvent * event)
                     gettimeofday(&tv_prof2, 0);
                 }
 
-                do {
+                while (mfw_gst_ac3dec_parse_frame(ac3dec_info) > 0) {
                     if (ac3dec_info->stopped) {
                         ac3dec_info->stopped = FALSE;
                         break;
@@ -1098,7 +1152,10 @@ static gboolean mfw_gst_ac3dec_sink_event(GstPad * pad, GstEvent * event)
                         GST_ERROR("Fatal error stoping decode");
                         break;
                     }
-                } while (gst_adapter_available(adapter) > 0);
+                }
+
+                /* a truncated last frame can not be decoded */
+                gst_adapter_clear(adapter);
 
                 if (ac3dec_info->profile) {
 
@@ -1192,7 +1249,8 @@ mfw_gst_ac3dec_seek(MfwGstAc3DecInfo * ac3dec_info,
     gboolean res;
     guint bytesavailable;
     GstEvent *seek_event;
-    gint secctr, minctr, hourctr;
+    GstClockTime time_start;
+    gboolean exact;
 
     gst_event_parse_seek(event, &rate, &format, &flags, &cur_type, &cur,
             &stop_type, &stop);
@@ -1207,19 +1265,19 @@ mfw_gst_ac3dec_seek(MfwGstAc3DecInfo * ac3dec_info,
                 if(cur > ac3dec_info->duration)
                     return FALSE;
 
-                ac3dec_info->seeked_time = cur;
-
-                secctr = (cur / GST_SECOND) % 60;
-                minctr = (cur / (GST_SECOND * 60)) % 60;
-                hourctr = cur / (GST_SECOND * 60 * 60);
-
-                bytes_cur = ac3dec_info->seek_index[hourctr][minctr][secctr];
+                bytes_cur = mfw_gst_ac3dec_index_lookup(ac3dec_info, cur,
+                        &time_start, &exact);
                 bytes_stop = ac3dec_info->totalBytes;
-                if (-1 == bytes_cur) {
+                if (bytes_cur >= bytes_stop) {
                     GST_WARNING ("seek to EOS");
                     bytes_cur = bytes_stop;
+                    time_start = cur;
                 }
 
+                ac3dec_info->seeked_time = time_start;
+                /* applied on FLUSH_STOP */
+                ac3dec_info->seek_estimated = !exact;
+
 
             }
             break;
@@ -1433,6 +1491,242 @@ static gboolean mfw_gst_ac3dec_src_query(GstPad * pad, GstQuery * query)
 
 
 
+/*==================================================================================================
+
+FUNCTION:     mfw_gst_ac3dec_sync_info
+
+DESCRIPTION: this function parses the sync info of an AC-3 or E-AC-3 frame, in either byte
+             order, to get the frame size.
+
+ARGUMENTS PASSED:
+        buffer      - at least AC3_SYNC_INFO_SIZE bytes from the frame start
+        samplerate  - sample rate for this frame
+        eac3        - TRUE for an E-AC-3 frame
+
+RETURN VALUE:
+        frame size in bytes, 0 if buffer is not a valid frame start
+
+==================================================================================================*/
+static gint mfw_gst_ac3dec_sync_info(const guint8 * buffer, gint * samplerate,
+				     gboolean * eac3)
+{
+    gint x, fscod, bsid, frmsizecod, fscod2;
+
+    /* x swaps the bytes of a little endian stream */
+    if (buffer[0] == 0x0b && buffer[1] == 0x77)
+        x = 0;
+    else if (buffer[0] == 0x77 && buffer[1] == 0x0b)
+        x = 1;
+    else
+        return 0;
+
+    fscod = buffer[4 ^ x] >> 6;
+    bsid = buffer[5 ^ x] >> 3;
+
+    if (bsid <= 10) {
+        frmsizecod = buffer[4 ^ x] & 0x3f;
+        if ((fscod >= NFSCOD) || (frmsizecod >= NDATARATE))
+            return 0;
+        *samplerate = sampleratetab[fscod];
+        *eac3 = FALSE;
+        return 2 * frmsizetab[fscod][frmsizecod];
+    }
+    else if (bsid <= 16) {
+        if (fscod == 3) {
+            /* reduced sample rates */
+            fscod2 = (buffer[4 ^ x] >> 4) & 0x3;
+            if (fscod2 >= NFSCOD)
+                return 0;
+            *samplerate = sampleratetab[fscod2] / 2;
+        }
+        else
+            *samplerate = sampleratetab[fscod];
+        *eac3 = TRUE;
+        return 2 * ((((buffer[2 ^ x] & 0x07) << 8) | buffer[3 ^ x]) + 1);
+    }
+
+    return 0;
+}
+
+
+
+/*==================================================================================================
+
+FUNCTION:     mfw_gst_ac3dec_parse_frame
+
+DESCRIPTION: this function finds the frame at the adapter head, skipping data up to the next
+             start code when the sync is lost, so the decoder gets exactly one frame per call.
+             After an estimated seek a sync word is only taken when the next frame header
+             follows it, as the payload may contain the sync word as well.
+
+ARGUMENTS PASSED:
+        ac3dec_info - pointer to the plugin context
+
+RETURN VALUE:
+        size of the complete frame at the adapter head, 0 if more data is needed
+
+==================================================================================================*/
+static gint mfw_gst_ac3dec_parse_frame(MfwGstAc3DecInfo * ac3dec_info)
+{
+    GstAdapter *adapter = ac3dec_info->adapter;
+    const guint8 *data;
+    guint avail;
+    gint size, samplerate, skip;
+    gboolean eac3;
+
+    for (;;) {
+        avail = gst_adapter_available(adapter);
+        if (avail < AC3_SYNC_INFO_SIZE)
+            return 0;
+
+        data = gst_adapter_peek(adapter, AC3_SYNC_INFO_SIZE);
+        size = mfw_gst_ac3dec_sync_info(data, &samplerate, &eac3);
+        if ((size > 0) && (ac3dec_info->resync)) {
+            gint next_rate;
+            gboolean next_eac3;
+
+            if (avail < size + AC3_SYNC_INFO_SIZE)
+                return 0;
+            data = gst_adapter_peek(adapter, size + AC3_SYNC_INFO_SIZE);
+            if (mfw_gst_ac3dec_sync_info(data + size, &next_rate, &next_eac3) > 0)
+                ac3dec_info->resync = FALSE;
+            else
+                size = 0;
+        }
+        if (size > 0)
+            break;
+
+        /* lost sync, keep the last byte as it may start a sync word */
+        data = gst_adapter_peek(adapter, avail);
+        skip = mfw_gst_ac3dec_find_startcode((char *) data + 1, avail - 1);
+        skip = (skip < 0) ? (avail - 1) : (skip + 1);
+        GST_DEBUG("skip %d bytes to the next sync", skip);
+        mfw_gst_ac3dec_adapter_flush(ac3dec_info, skip);
+    }
+
+    if (avail < size)
+        return 0;
+
+    ac3dec_info->cur_frame_bytes = size;
+    ac3dec_info->cur_frame_eac3 = eac3;
+
+    return size;
+}
+
+
+
+/*==================================================================================================
+
+FUNCTION:     mfw_gst_ac3dec_out_pool_new / _unref / _set_size
+
+DESCRIPTION: output buffer pool. Blocks are sized to one decoded frame in the negotiated
+             layout; a block of a stale size is freed instead of recycled.
+
+==================================================================================================*/
+static MfwGstAc3OutPool *mfw_gst_ac3dec_out_pool_new(void)
+{
+    MfwGstAc3OutPool *pool = g_new0(MfwGstAc3OutPool, 1);
+
+    pool->refcount = 1;
+    pool->lock = g_mutex_new();
+
+    return pool;
+}
+
+static void mfw_gst_ac3dec_out_pool_free_blocks(MfwGstAc3OutPool * pool)
+{
+    MfwGstAc3OutBlock *block;
+
+    while ((block = pool->blocks) != NULL) {
+        pool->blocks = block->next;
+        g_free(block);
+    }
+}
+
+static void mfw_gst_ac3dec_out_pool_unref(MfwGstAc3OutPool * pool)
+{
+    if (!g_atomic_int_dec_and_test(&pool->refcount))
+        return;
+
+    mfw_gst_ac3dec_out_pool_free_blocks(pool);
+    g_mutex_free(pool->lock);
+    g_free(pool);
+}
+
+static void mfw_gst_ac3dec_out_pool_set_size(MfwGstAc3OutPool * pool,
+					     guint size)
+{
+    g_mutex_lock(pool->lock);
+    if (pool->block_size != size) {
+        mfw_gst_ac3dec_out_pool_free_blocks(pool);
+        pool->block_size = size;
+    }
+    g_mutex_unlock(pool->lock);
+}
+
+static void mfw_gst_ac3dec_out_block_free(gpointer data)
+{
+    MfwGstAc3OutBlock *block = (MfwGstAc3OutBlock *) data;
+    MfwGstAc3OutPool *pool = block->pool;
+
+    g_mutex_lock(pool->lock);
+    if (block->size == pool->block_size) {
+        block->next = pool->blocks;
+        pool->blocks = block;
+        block = NULL;
+    }
+    g_mutex_unlock(pool->lock);
+
+    g_free(block);
+    mfw_gst_ac3dec_out_pool_unref(pool);
+}
+
+/*==================================================================================================
+
+FUNCTION:     mfw_gst_ac3dec_alloc_outbuffer
+
+DESCRIPTION: this function gets an output buffer of one decoded frame from the pool.
+
+ARGUMENTS PASSED:
+        ac3dec_info - pointer to the plugin context
+        caps        - caps of the buffer
+
+RETURN VALUE:
+        new buffer
+
+==================================================================================================*/
+static GstBuffer *mfw_gst_ac3dec_alloc_outbuffer(MfwGstAc3DecInfo * ac3dec_info,
+						 GstCaps * caps)
+{
+    MfwGstAc3OutPool *pool = ac3dec_info->out_pool;
+    MfwGstAc3OutBlock *block;
+    GstBuffer *buffer;
+
+    g_mutex_lock(pool->lock);
+    block = pool->blocks;
+    if (block)
+        pool->blocks = block->next;
+    else {
+        block = g_malloc(sizeof(MfwGstAc3OutBlock) + pool->block_size);
+        block->pool = pool;
+        block->size = pool->block_size;
+    }
+    g_mutex_unlock(pool->lock);
+
+    g_atomic_int_inc(&pool->refcount);
+
+    buffer = gst_buffer_new();
+    GST_BUFFER_DATA(buffer) = (guint8 *) (block + 1);
+    GST_BUFFER_SIZE(buffer) = block->size;
+    GST_BUFFER_MALLOCDATA(buffer) = (guint8 *) block;
+    GST_BUFFER_FREE_FUNC(buffer) = mfw_gst_ac3dec_out_block_free;
+    gst_buffer_set_caps(buffer, caps);
+
+    return buffer;
+}
+
+
+
 /*==================================================================================================
 
 FUNCTION:     app_calc_seek_index
@@ -1451,27 +1745,151 @@ RETURN VALUE:
 ==================================================================================================*/
 gint app_calc_seek_index(gint *samplerate, gint *framesize, gchar *buffer)
 {
-    gint ret = 0;
-    gint fscod, frmsizecod;
+    gboolean eac3;
 
+    *framesize = mfw_gst_ac3dec_sync_info((const guint8 *) buffer,
+            samplerate, &eac3);
 
-    if(buffer[0] == 0x0b && buffer[1] == 0x77)
-    {
-        fscod = buffer[4] >> 6;
-        frmsizecod = buffer[4] & 0x3f;
+    return (*framesize > 0) ? 0 : 1;
+}
+
+
+
+/*==================================================================================================
+
+FUNCTION:     mfw_gst_ac3dec_index_add
+
+DESCRIPTION: this function records a frame start in the sparse seek index. Checkpoints closer
+             than AC3_INDEX_INTERVAL to an existing one are skipped, so the index grows by one
+             entry per interval of decoded stream whatever the seek pattern.
+
+ARGUMENTS PASSED:
+        ac3dec_info - pointer to the plugin context
+        time        - stream time of the frame
+        offset      - byte offset of the frame
+
+RETURN VALUE:
+        None
+
+==================================================================================================*/
+static void mfw_gst_ac3dec_index_add(MfwGstAc3DecInfo * ac3dec_info,
+				     GstClockTime time, guint64 offset)
+{
+    GArray *index = ac3dec_info->seek_index;
+    MfwGstAc3IndexEntry entry;
+    guint lo, hi, mid;
+
+    if (index == NULL)
+        return;
+
+    GST_OBJECT_LOCK(ac3dec_info);
+
+    /* first entry later than time */
+    lo = 0;
+    hi = index->len;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (g_array_index(index, MfwGstAc3IndexEntry, mid).time <= time)
+            lo = mid + 1;
+        else
+            hi = mid;
     }
-    else if(buffer[0] == 0x77 && buffer[1] == 0x0b)
-    {
-        fscod = buffer[5] >> 6;
-        frmsizecod = buffer[5] & 0x3f;
+
+    if (((lo > 0) && (time <
+            g_array_index(index, MfwGstAc3IndexEntry, lo - 1).time + AC3_INDEX_INTERVAL))
+        || ((lo < index->len) && (g_array_index(index, MfwGstAc3IndexEntry, lo).time <
+            time + AC3_INDEX_INTERVAL))) {
+        GST_OBJECT_UNLOCK(ac3dec_info);
+        return;
     }
-    else
-        return 1;
 
-    *samplerate = sampleratetab[fscod];
-    *framesize = 2 * frmsizetab[fscod][frmsizecod];
+    entry.time = time;
+    entry.offset = offset;
+    g_array_insert_val(index, lo, entry);
 
-    return ret;
+    GST_OBJECT_UNLOCK(ac3dec_info);
+}
+
+
+
+/*==================================================================================================
+
+FUNCTION:     mfw_gst_ac3dec_index_lookup
+
+DESCRIPTION: this function finds the byte offset to seek to for time. The nearest checkpoint
+             before time is found by bisection. If time is past the checkpoint frame, the
+             offset is extrapolated with the average byte rate of the indexed stream. Frame
+             sizes vary at 44.1 kHz and with bitrate changes, so such an offset is not frame
+             aligned and the stream has to be resynced on the next sync word.
+
+ARGUMENTS PASSED:
+        ac3dec_info - pointer to the plugin context
+        time        - stream time to seek to
+        start       - returns the stream time at the offset, an estimate if not exact
+        exact       - returns TRUE if the offset is the start of a checkpoint frame
+
+RETURN VALUE:
+        byte offset to seek to
+
+==================================================================================================*/
+static guint64 mfw_gst_ac3dec_index_lookup(MfwGstAc3DecInfo * ac3dec_info,
+					   GstClockTime time,
+					   GstClockTime * start,
+					   gboolean * exact)
+{
+    GArray *index = ac3dec_info->seek_index;
+    MfwGstAc3IndexEntry base, first, last;
+    guint64 bytes;
+    GstClockTime span;
+    guint lo, hi, mid;
+
+    base.time = 0;
+    base.offset = ac3dec_info->first_frame;
+    first = last = base;
+
+    if (index) {
+        GST_OBJECT_LOCK(ac3dec_info);
+        lo = 0;
+        hi = index->len;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (g_array_index(index, MfwGstAc3IndexEntry, mid).time <= time)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo > 0)
+            base = g_array_index(index, MfwGstAc3IndexEntry, lo - 1);
+        if (index->len > 0) {
+            first = g_array_index(index, MfwGstAc3IndexEntry, 0);
+            last = g_array_index(index, MfwGstAc3IndexEntry, index->len - 1);
+        }
+        GST_OBJECT_UNLOCK(ac3dec_info);
+    }
+
+    if ((ac3dec_info->frame_duration == 0) || (ac3dec_info->frame_bytes == 0)
+        || (time < base.time + ac3dec_info->frame_duration)) {
+        *start = base.time;
+        *exact = TRUE;
+        return base.offset;
+    }
+
+    /* measured rate once the index spans a while, the first frame size before */
+    if (last.time > first.time + ac3dec_info->frame_duration) {
+        bytes = last.offset - first.offset;
+        span = last.time - first.time;
+    } else {
+        bytes = ac3dec_info->frame_bytes;
+        span = ac3dec_info->frame_duration;
+    }
+
+    *start = time;
+    *exact = FALSE;
+
+    GST_DEBUG("seek %" GST_TIME_FORMAT " estimated from checkpoint %"
+              GST_TIME_FORMAT, GST_TIME_ARGS(time), GST_TIME_ARGS(base.time));
+
+    return base.offset + gst_util_uint64_scale(time - base.time, bytes, span);
 }
 
 
@@ -1480,7 +1898,9 @@ gint app_calc_seek_index(gint *samplerate, gint *framesize, gchar *buffer)
 
 FUNCTION:     mfw_gst_ac3decoder_create_seek_index
 
-DESCRIPTION: this function creates index for seek and duration.
+DESCRIPTION: this function prepares the seek index and estimates the duration. Only the head
+             of the file is read, in one pull, to locate the first frame and its size; the
+             index is filled in while decoding.
 
 ARGUMENTS PASSED:
         ac3dec_info - pointer to the plugin context
@@ -1499,115 +1919,97 @@ gint mfw_gst_ac3decoder_create_seek_index(MfwGstAc3DecInfo * ac3dec_info)
     GstPad *peer_pad = NULL;
 
     GstFormat fmt = GST_FORMAT_BYTES;
-    guint64 totalBytes = 0;
+    gint64 totalBytes = 0;
     GstBuffer *pullbuffer = NULL;
-    guint64  offset = 0;
-
+    guint probe_size;
+    gchar *data;
+    gint offset, size;
     gint samplerate, framesize;
-    guint frameduration;
-
-    guint temp = 0;
-    gint FileType=0;
-    GstClockTime file_duration;
-
-    gint secctr, minctr, hourctr ;
-    guint durationsec = 0;
+    gint result = 1;
 
     ac3dec_info->totalBytes = 0;
     ac3dec_info->duration = 0;
-    pad = ac3dec_info->sinkpad;
+    ac3dec_info->first_frame = 0;
+    ac3dec_info->frame_bytes = 0;
+    ac3dec_info->frame_duration = 0;
+    ac3dec_info->index_last = GST_CLOCK_TIME_NONE;
+    ac3dec_info->seek_estimated = FALSE;
+    ac3dec_info->resync = FALSE;
+
+    if (ac3dec_info->seek_index == NULL)
+        ac3dec_info->seek_index =
+            g_array_new(FALSE, FALSE, sizeof(MfwGstAc3IndexEntry));
+    g_array_set_size(ac3dec_info->seek_index, 0);
 
-    if (gst_pad_check_pull_range(pad))
-    {
-        if (gst_pad_activate_pull(GST_PAD_PEER(pad), TRUE))
-        {
-            peer_pad = gst_pad_get_peer(ac3dec_info->sinkpad);
-            gst_pad_query_duration(peer_pad, &fmt, &totalBytes);
-            gst_object_unref(GST_OBJECT(peer_pad));
+    pad = ac3dec_info->sinkpad;
 
-            ac3dec_info->totalBytes = totalBytes;
+    if (!gst_pad_check_pull_range(pad))
+        return 1;
 
-            ac3dec_info->seek_index[0] = (guint64 **)g_malloc(60 * sizeof(guint64 *));
-            if(ac3dec_info->seek_index[0] == NULL)
-            {
-                GST_ERROR("Failed in allocate memory for seek_index\n");
-                return 1;
-            }
-            memset(ac3dec_info->seek_index[0], 0, 60 * sizeof(guint64 *));
+    if (!gst_pad_activate_pull(GST_PAD_PEER(pad), TRUE))
+        return 1;
 
-            ac3dec_info->seek_index[0][0] = (guint64 *)g_malloc(60 * sizeof(guint64));
-            if(ac3dec_info->seek_index[0][0] == NULL)
-            {
-                GST_ERROR("Failed in allocate memory for seek_index\n");
-                return 1;
-            }
-            memset(ac3dec_info->seek_index[0][0], 0, 60 * sizeof(guint64));
+    peer_pad = gst_pad_get_peer(ac3dec_info->sinkpad);
+    gst_pad_query_duration(peer_pad, &fmt, &totalBytes);
+    gst_object_unref(GST_OBJECT(peer_pad));
 
-            ac3dec_info->seek_index[0][0][0] = 0;
-            secctr = 1;
-            minctr = 0;
-            hourctr =0;
+    ac3dec_info->totalBytes = totalBytes;
 
-            while(offset < totalBytes)
-            {
-                ret = gst_pad_pull_range(pad, offset, 6, &pullbuffer);
-                if(ret != GST_FLOW_OK)
-                    GST_ERROR("error while pull data\n");
+    probe_size = AC3_INDEX_PROBE_SIZE;
+    if ((totalBytes > 0) && (totalBytes < probe_size))
+        probe_size = totalBytes;
 
-                if(app_calc_seek_index(&samplerate, &framesize,(gchar *) GST_BUFFER_DATA(pullbuffer)))
-                    break;
+    ret = gst_pad_pull_range(pad, 0, probe_size, &pullbuffer);
+    if (ret != GST_FLOW_OK) {
+        GST_ERROR("error while pull data\n");
+        goto done;
+    }
 
-                frameduration = (guint)((1000000000.0 * 1536.0)/(gfloat)samplerate);
+    data = (gchar *) GST_BUFFER_DATA(pullbuffer);
+    size = GST_BUFFER_SIZE(pullbuffer);
+
+    /* first frame whose successor starts with a sync word as well */
+    for (offset = 0; offset + AC3_SYNC_INFO_SIZE <= size; offset++) {
+        if (app_calc_seek_index(&samplerate, &framesize, data + offset))
+            continue;
+        if (framesize <= 0)
+            continue;
+        if ((offset + framesize + AC3_SYNC_INFO_SIZE <= size)
+            && app_calc_seek_index(&samplerate, &framesize,
+                                   data + offset + framesize))
+            continue;
+        break;
+    }
 
-                ac3dec_info->duration += frameduration;
-                durationsec += frameduration;
+    if (offset + AC3_SYNC_INFO_SIZE > size) {
+        GST_WARNING("no ac3 frame found in the first %d bytes", size);
+        gst_buffer_unref(pullbuffer);
+        goto done;
+    }
 
-                if(durationsec >= GST_SECOND)
-                {
-                    ac3dec_info->seek_index[hourctr][minctr][secctr] = offset;
-                    durationsec = 0;
+    gst_buffer_unref(pullbuffer);
 
-                    secctr ++;
-                    if(secctr == 60)
-                    {
-                        minctr ++;
-                        secctr = 0;
+    ac3dec_info->first_frame = offset;
+    ac3dec_info->frame_bytes = framesize;
+    ac3dec_info->frame_duration =
+        gst_util_uint64_scale_int(GST_SECOND, AC3D_FRAME_SIZE, samplerate);
 
-                        ac3dec_info->seek_index[hourctr][minctr] = (guint64 *)g_malloc(60 * sizeof(guint64));
-                        if(ac3dec_info->seek_index[hourctr][minctr] == NULL)
-                        {
-                            GST_ERROR("Failed in allocate memory for seek_index\n");
-                            return 1;
-                        }
-                        memset(ac3dec_info->seek_index[hourctr][minctr], -1, 60 * sizeof(guint64));
-                    }
+    /* ac3 is constant frame size, refined by the checkpoints while decoding */
+    if (totalBytes > offset)
+        ac3dec_info->duration = (totalBytes - offset) / framesize *
+            ac3dec_info->frame_duration;
 
-                    if(minctr == 60)
-                    {
-                        hourctr ++;
-                        minctr == 0;
+    mfw_gst_ac3dec_index_add(ac3dec_info, 0, offset);
 
-                        ac3dec_info->seek_index[hourctr] = (guint64 **)g_malloc(60 * sizeof(guint64 *));
-                        if(ac3dec_info->seek_index[hourctr] == NULL)
-                        {
-                            GST_ERROR("Failed in allocate memory for seek_index\n");
-                            return 1;
-                        }
-                        memset(ac3dec_info->seek_index[hourctr], 0, 60 * sizeof(guint64 *));
-                    }
+    GST_DEBUG("first frame at %d, %d bytes, duration %" GST_TIME_FORMAT,
+              offset, framesize, GST_TIME_ARGS(ac3dec_info->duration));
 
-                    if(hourctr >= 10)
-                        break;
-                }
+    result = 0;
 
-                offset += framesize ;
-            }
+done:
+    gst_pad_activate_push(GST_PAD_PEER(pad), TRUE);
 
-            gst_pad_activate_push(GST_PAD_PEER(pad), TRUE);
-        }
-    }
-
-    return 0;
+    return result;
 }
 
 
@@ -1669,6 +2071,10 @@ mfw_gst_ac3dec_change_state(GstElement * element,
                     return GST_STATE_NULL;
                 }
 
+                /* decoder output scratch and output buffers, reused for every frame */
+                ac3dec_info->decode_out = g_malloc(AC3_DECODE_OUT_SIZE);
+                ac3dec_info->out_pool = mfw_gst_ac3dec_out_pool_new();
+
 
                 /* allocate static resources for ac3 decoder */
                 ac3dec_info->dec_param = (AC3D_PARAM *)alloc_fast(sizeof(AC3D_PARAM));
@@ -1860,6 +2266,13 @@ mfw_gst_ac3dec_change_state(GstElement * element,
             g_object_unref(ac3dec_info->adapter);
 
             ac3dec_info->adapter = NULL;
+
+            g_free(ac3dec_info->decode_out);
+            ac3dec_info->decode_out = NULL;
+            if (ac3dec_info->out_pool) {
+                mfw_gst_ac3dec_out_pool_unref(ac3dec_info->out_pool);
+                ac3dec_info->out_pool = NULL;
+            }
             GST_PAD_STREAM_LOCK(ac3dec_info->sinkpad);
             num = ac3dec_info->dec_config->sAC3DMemInfo.s32NumReqs;
             for (loopctr = 0; loopctr < num; loopctr++) {
@@ -1890,23 +2303,11 @@ mfw_gst_ac3dec_change_state(GstElement * element,
                 ac3dec_info->dec_config = NULL;
             }
             GST_PAD_STREAM_UNLOCK(ac3dec_info->sinkpad);
-            {
-                gint secctr, minctr, hourctr;
-
-                for(hourctr=0; hourctr<10; hourctr++)
-                {
-                    if(ac3dec_info->seek_index[hourctr] != NULL)
-                    {
-                        for(minctr=0; minctr<60; minctr++)
-                            if(ac3dec_info->seek_index[hourctr][minctr] != NULL)
-                                g_free(ac3dec_info->seek_index[hourctr][minctr]);
-
-                        g_free(ac3dec_info->seek_index[hourctr]);
-                    }
-                    else
-                        break;
-                }
+            if (ac3dec_info->seek_index != NULL) {
+                g_array_free(ac3dec_info->seek_index, TRUE);
+                ac3dec_info->seek_index = NULL;
             }
+            ac3dec_info->stream_offset = GST_BUFFER_OFFSET_NONE;
 
             ac3dec_info->eos_event = FALSE;
             ac3dec_info->init_flag = FALSE;
@@ -1946,6 +2347,29 @@ mfw_gst_ac3dec_find_startcode (char *buffer, int len)
 
 
 
+/*==================================================================================================
+
+FUNCTION:   mfw_gst_ac3dec_adapter_flush
+
+DESCRIPTION:    flushes bytes from the adapter and keeps the byte offset of the adapter head
+
+ARGUMENTS PASSED:
+        ac3dec_info -   pointer to decoder element
+        size        -   bytes to flush
+
+RETURN VALUE:
+        None
+
+==================================================================================================*/
+static void mfw_gst_ac3dec_adapter_flush(MfwGstAc3DecInfo * ac3dec_info,
+					 guint size)
+{
+    gst_adapter_flush(ac3dec_info->adapter, size);
+    if (ac3dec_info->stream_offset != GST_BUFFER_OFFSET_NONE)
+        ac3dec_info->stream_offset += size;
+}
+
+
 /*==================================================================================================
 
 FUNCTION:   mfw_gst_ac3dec_chain
@@ -2000,6 +2424,10 @@ static GstFlowReturn mfw_gst_ac3dec_chain(GstPad * pad, GstBuffer * buffer)
 
     adapter = (GstAdapter *) ac3dec_info->adapter;
 
+    /* byte offset of the adapter head, for the seek index */
+    if (gst_adapter_available(adapter) == 0)
+        ac3dec_info->stream_offset = GST_BUFFER_OFFSET(buffer);
+
     /* push input data from buffer to adapter */
     gst_adapter_push(adapter, buffer);
 
@@ -2012,10 +2440,10 @@ static GstFlowReturn mfw_gst_ac3dec_chain(GstPad * pad, GstBuffer * buffer)
         gint leading_bytes = mfw_gst_ac3dec_find_startcode(data, buflen);
         if (-1 == leading_bytes)
         {
-            gst_adapter_flush(adapter, buflen);
+            mfw_gst_ac3dec_adapter_flush(ac3dec_info, buflen);
         	return GST_FLOW_OK;
         }
-        gst_adapter_flush(adapter, leading_bytes);
+        mfw_gst_ac3dec_adapter_flush(ac3dec_info, leading_bytes);
 
         retval = AC3D_dec_init(ac3dec_info->dec_config,NULL,0);
     	if(retval != AC3D_OK)
@@ -2039,16 +2467,13 @@ static GstFlowReturn mfw_gst_ac3dec_chain(GstPad * pad, GstBuffer * buffer)
     }
 
 
-    if (gst_adapter_available(adapter) < AC3_MAX_ADAPTER_SIZE)
-	return GST_FLOW_OK;
-
-    /* start decode process until the input buffer is not enough */
-    do
+    /* decode every complete frame in the adapter */
+    while (mfw_gst_ac3dec_parse_frame(ac3dec_info) > 0)
     {
 	result = decode_ac3_chunk(ac3dec_info);
 	if (result != GST_FLOW_OK)
 	    break;
-    } while (gst_adapter_available(adapter) >= AC3_MAX_ADAPTER_SIZE);
+    }
 
     if (result != GST_FLOW_OK) {
 	GST_ERROR(" Error in decding\n");
@@ -2108,38 +2533,38 @@ static GstFlowReturn decode_ac3_chunk(MfwGstAc3DecInfo * ac3dec_info)
     long time_before = 0, time_after = 0;
     GstAdapter *adpt;
     gint16 *in_buf_data;
-    gint in_buf_len;
+    gint frame_bytes = ac3dec_info->cur_frame_bytes;
+    gint ch, nch;
+    const gint *map;
     DEMO_LIVE_CHECK(ac3dec_info->demo_mode,
         (ac3dec_info->time_offset*GST_SECOND),
         ac3dec_info->srcpad);
     if (ac3dec_info->demo_mode == 2)
         return GST_FLOW_ERROR;
 
-
-    decode_out = g_malloc(6 * AC3D_FRAME_SIZE * sizeof(AC3D_INT32));
+    decode_out = ac3dec_info->decode_out;
 
     if (ac3dec_info->profile)
     {
 	gettimeofday(&tv_prof, 0);
     }
 
-    /* Get the input buffer */
+    /* Get the input buffer, exactly the frame found by the parser */
     adpt = ac3dec_info->adapter;
 
-    if (gst_adapter_available(adpt) >= AC3_MAX_ADAPTER_SIZE) {
-        in_buf_data = (gint16 *)gst_adapter_peek(adpt, AC3_MAX_ADAPTER_SIZE);
-        /* decode one frame of data */
-        retval = AC3D_dec_Frame(ac3dec_info->dec_config,decode_out,in_buf_data,AC3_MAX_ADAPTER_SIZE);
+    if (ac3dec_info->cur_frame_eac3) {
+        if (!ac3dec_info->eac3_warned) {
+            GST_WARNING("E-AC-3 frames are skipped, the decoder core only decodes AC-3");
+            ac3dec_info->eac3_warned = TRUE;
+        }
+        mfw_gst_ac3dec_adapter_flush(ac3dec_info, frame_bytes);
+        return GST_FLOW_OK;
     }
-    else if (gst_adapter_available(adpt) > 0) {
-        in_buf_len = gst_adapter_available(adpt);
-        in_buf_data = (gint16 *)gst_adapter_peek(adpt, in_buf_len);
 
-        /* decode one frame of data */
-        retval = AC3D_dec_Frame(ac3dec_info->dec_config,decode_out,in_buf_data,in_buf_len);
-    }
-    else
-        return GST_FLOW_OK;
+    in_buf_data = (gint16 *)gst_adapter_peek(adpt, frame_bytes);
+
+    /* decode one frame of data */
+    retval = AC3D_dec_Frame(ac3dec_info->dec_config,decode_out,in_buf_data,frame_bytes);
 
     if (ac3dec_info->profile) {
 
@@ -2151,13 +2576,32 @@ static GstFlowReturn decode_ac3_chunk(MfwGstAc3DecInfo * ac3dec_info)
         ac3dec_info->frame_no++;
     }
 
-    /* Get the consumped length, if consumed, then skip it, ignore return status */
-	if(ac3dec_info->dec_config->pAC3param->ac3d_frame_size > 0)
-    gst_adapter_flush(adpt,ac3dec_info->dec_config->pAC3param->ac3d_frame_size);
+    /* record a seek checkpoint at the frame start, then skip the frame whatever the status,
+       times after an estimated seek are not exact and would spoil the index */
+    if ((ac3dec_info->seek_index != NULL) && (!ac3dec_info->seek_estimated)
+        && (ac3dec_info->stream_offset != GST_BUFFER_OFFSET_NONE)) {
+        GstClockTime time = ac3dec_info->time_offset * GST_SECOND;
+
+        if ((!GST_CLOCK_TIME_IS_VALID(ac3dec_info->index_last))
+            || (time < ac3dec_info->index_last)
+            || (time >= ac3dec_info->index_last + AC3_INDEX_INTERVAL)) {
+            mfw_gst_ac3dec_index_add(ac3dec_info, time,
+                    ac3dec_info->stream_offset);
+            ac3dec_info->index_last = time;
+        }
+    }
+
+    mfw_gst_ac3dec_adapter_flush(ac3dec_info, frame_bytes);
 
     if(retval < AC3D_ERR_FATAL )
     {
+        if( (ac3dec_info->dec_param->ac3d_sampling_freq != ac3dec_info->sampling_freq_pre)
+                || (ac3dec_info->dec_param->ac3d_num_channels != ac3dec_info->num_channels_pre)
+                || (ac3dec_info->dec_param->ac3d_outputmask != ac3dec_info->outputmask_pre) )
+        {
 
+            GValue chanpos = { 0 };
+            GValue pos = { 0 };
 
         out_L = (ac3dec_info->dec_param->ac3d_outputmask & 0x80) >> 7 ;
         out_C = (ac3dec_info->dec_param->ac3d_outputmask & 0x40) >> 6 ;
@@ -2170,13 +2614,25 @@ static GstFlowReturn decode_ac3_chunk(MfwGstAc3DecInfo * ac3dec_info)
         GST_DEBUG("Channel: %d\n", ac3dec_info->dec_param->ac3d_num_channels);
         GST_DEBUG("SampleRate: %d\n", ac3dec_info->dec_param->ac3d_sampling_freq);
 
-        if( (ac3dec_info->dec_param->ac3d_sampling_freq != ac3dec_info->sampling_freq_pre)
-                || (ac3dec_info->dec_param->ac3d_num_channels != ac3dec_info->num_channels_pre)
-                || (ac3dec_info->dec_param->ac3d_outputmask != ac3dec_info->outputmask_pre) )
-        {
-
-            GValue chanpos = { 0 };
-            GValue pos = { 0 };
+        /* decoder channel order is L, C, R, Ls, Rs, lfe */
+        nch = 0;
+        if(out_L)
+            ac3dec_info->out_map[nch++] = 0;
+        if(out_R)
+            ac3dec_info->out_map[nch++] = 2;
+        if(out_C)
+            ac3dec_info->out_map[nch++] = 1;
+        if(out_lfe)
+            ac3dec_info->out_map[nch++] = 5;
+        if(out_Ls)
+            ac3dec_info->out_map[nch++] = 3;
+        if(out_Rs)
+            ac3dec_info->out_map[nch++] = 4;
+        ac3dec_info->out_channels = nch;
+
+        mfw_gst_ac3dec_out_pool_set_size(ac3dec_info->out_pool,
+                (pcm_width/8) * ac3dec_info->dec_param->ac3d_num_channels *
+                AC3D_FRAME_SIZE);
 
         {
             GstTagList	*list = gst_tag_list_new();
@@ -2247,86 +2703,35 @@ static GstFlowReturn decode_ac3_chunk(MfwGstAc3DecInfo * ac3dec_info)
 	src_caps = GST_PAD_CAPS(ac3dec_info->srcpad);
 
 
-#if 0
-    result = gst_pad_alloc_buffer_and_set_caps(ac3dec_info->srcpad, 0,
-                                                    (pcm_width/8) *
-                                                    ac3dec_info->dec_param->ac3d_num_channels *
-                                                    AC3D_FRAME_SIZE,
-                                                    src_caps, &outbuffer);
-
-	if (result != GST_FLOW_OK)
-        {
-	    GST_ERROR("\n Error while allocating output buffer\n");
-	    g_free(decode_out);
-	    return result;
-	}
-#else
-    outbuffer = gst_buffer_new_and_alloc((pcm_width/8) *
-                                                    ac3dec_info->dec_param->ac3d_num_channels *
-                                                    AC3D_FRAME_SIZE);
-    gst_buffer_set_caps(outbuffer, src_caps);
-#endif
+    outbuffer = mfw_gst_ac3dec_alloc_outbuffer(ac3dec_info, src_caps);
+    map = ac3dec_info->out_map;
+    nch = ac3dec_info->out_channels;
 
 
         if(pcm_width > 16)
         {
             AC3D_INT32 *outdata = (AC3D_INT32 *) GST_BUFFER_DATA(outbuffer);
-            if (outdata == NULL) {
-                GST_ERROR("\n Could not allocate output buffer\n");
-                g_free(decode_out);
-                return result;
-            }
 
             /* copy data from codec's output buffer to GST_BUFFER */
             for (loopctr = 0; loopctr < AC3D_FRAME_SIZE * 6; loopctr += 6)
             {
-                if(out_L)
-                    *outdata++ = ((decode_out[loopctr+0])<<8) ;
-                if(out_R)
-                    *outdata++ = ((decode_out[loopctr+2])<<8) ;
-                if(out_C)
-                    *outdata++ = ((decode_out[loopctr+1])<<8) ;
-                if(out_lfe)
-                    *outdata++ = ((decode_out[loopctr+5])<<8) ;
-                if(out_Ls)
-                    *outdata++ = ((decode_out[loopctr+3])<<8) ;
-                if(out_Rs)
-                    *outdata++ = ((decode_out[loopctr+4])<<8) ;
+                for (ch = 0; ch < nch; ch++)
+                    *outdata++ = ((decode_out[loopctr+map[ch]])<<8) ;
             }
         }
         else
         {
             AC3D_INT16 *outdata = (AC3D_INT16 *) GST_BUFFER_DATA(outbuffer);
             AC3D_INT16 *in_buf = (AC3D_INT16 *)decode_out;
-            if (outdata == NULL) {
-                GST_ERROR("\n Could not allocate output buffer\n");
-                g_free(decode_out);
-                return result;
-            }
 
             /* copy data from codec's output buffer to GST_BUFFER */
             for (loopctr = 0; loopctr < AC3D_FRAME_SIZE * 6; loopctr += 6)
             {
-                if(out_L)
-                    *outdata++ = in_buf[loopctr+0] ;
-                if(out_R)
-                    *outdata++ = in_buf[loopctr+2];
-                if(out_C)
-                    *outdata++ = in_buf[loopctr+1];
-                if(out_lfe)
-                    *outdata++ = in_buf[loopctr+5];
-                if(out_Ls)
-                    *outdata++ = in_buf[loopctr+3];
-                if(out_Rs)
-                    *outdata++ = in_buf[loopctr+4];
+                for (ch = 0; ch < nch; ch++)
+                    *outdata++ = in_buf[loopctr+map[ch]];
             }
         }
 
-	g_free(decode_out);
-
-         GST_BUFFER_SIZE(outbuffer) = (pcm_width/8) *
-                                       ac3dec_info->dec_param->ac3d_num_channels *
-                                      AC3D_FRAME_SIZE,
 	ac3dec_info->total_samples += AC3D_FRAME_SIZE;
 	time_duration = (AC3D_FRAME_SIZE * 1.0 / ac3dec_info->dec_param->ac3d_sampling_freq);
 
@@ -2366,7 +2771,6 @@ static GstFlowReturn decode_ac3_chunk(MfwGstAc3DecInfo * ac3dec_info)
     }
     else
     {
-	g_free(decode_out);
 	GST_ERROR("\n Exiting decode_ac3_chunk return value  %d\n",
 		  retval);
 	GST_ERROR("\n Error during decoding of a frame\n");
@@ -2432,7 +2836,7 @@ AC3D_INT32  app_swap_buffers_ac3_dec(AC3D_UINT8 **buf_ptr,
 
     *buf_ptr = (AC3D_UINT8 *) send_buff;
     *buf_len = req_len ;
-    gst_adapter_flush(adapter, req_len);
+    mfw_gst_ac3dec_adapter_flush(pCallback->ac3dec_info, req_len);
 
     return 0;
 }
@@ -69,6 +69,12 @@ G_BEGIN_DECLS
 /*=============================================================================
                                  STRUCTURES AND OTHER TYPEDEFS
 =============================================================================*/
+    /* seek index checkpoint, offset is the start of a frame */
+    typedef struct _MfwGstAc3IndexEntry {
+    GstClockTime time;
+    guint64 offset;
+} MfwGstAc3IndexEntry;
+
     typedef struct _MfwGstAc3DecInfo {
     GstElement element;		/* instance of base class */
     GstPad *sinkpad, *srcpad;	/* source and sink pad of element */
@@ -93,7 +99,24 @@ G_BEGIN_DECLS
 
     guint64 totalBytes;
     guint64 duration;
-    guint64 **seek_index[10];
+    GArray *seek_index;		/* sparse MfwGstAc3IndexEntry sorted by time,
+				   protected by the object lock */
+    GstClockTime index_last;	/* time of the last checkpoint recorded */
+    guint64 stream_offset;	/* byte offset of the adapter head */
+    guint64 first_frame;	/* byte offset of the first frame */
+    gint frame_bytes;		/* frame size from the first frame header */
+    GstClockTime frame_duration;	/* duration of one frame */
+    gboolean seek_estimated;	/* the last seek offset was extrapolated, times
+				   are estimates and are not indexed */
+    gboolean resync;		/* confirm the sync by the next frame header */
+
+    gint cur_frame_bytes;	/* size of the frame at the adapter head */
+    gboolean cur_frame_eac3;	/* the frame at the adapter head is E-AC-3 */
+    gboolean eac3_warned;
+    AC3D_INT32 *decode_out;	/* decoder output scratch, 6 channels */
+    gint out_map[6];		/* decoder channel of each output channel */
+    gint out_channels;
+    struct _MfwGstAc3OutPool *out_pool;	/* recycled output buffers */
 
     gint32 sampling_freq_pre;
     gint32 num_channels_pre;
@@ -79,9 +79,20 @@ static const gint wb_block_size_if2[] = {
     61,  6,  1,  1,  1,  1,  1,  1
 };
 
+/* largest packed frame plus the extra byte of the WB MMS repacking */
+#define AMR_STAGE_SIZE              64
+/* one second of 20 ms frames */
+#define AMR_DEFAULT_BATCH_FRAMES    50
+#define AMR_MAX_BATCH_FRAMES        500
+
 /*=============================================================================
                 LOCAL TYPEDEFS (STRUCTURES, UNIONS, ENUMS)
 =============================================================================*/
+enum {
+    PROP_0,
+    PROP_BATCH_FRAMES
+};
+
 typedef struct _AmrDecParams {
     union {
         sAMRDDecoderConfigType *nb_dec_config;	/* decoder context */
@@ -113,6 +124,10 @@ struct _MfwGstAmrdecPrivate {
     
     guint64 time_stamp;
     guint64 frame_count;
+    guint   batch_frames;   /* max frames decoded into one output buffer */
+
+    /* the library writes into its input, each frame is staged here */
+    guint32 stage[AMR_STAGE_SIZE / sizeof(guint32)];
 };
 
 #define MFW_GST_AMRDEC_GET_PRIVATE(o) \
@@ -205,7 +220,16 @@ static void
 mfw_gst_amrdec_set_property(GObject * object, guint prop_id,
 				const GValue * value, GParamSpec * pspec)
 {
+    MfwGstAmrdecPrivate *priv = MFW_GST_AMRDEC(object)->priv;
     GST_DEBUG(" in mfw_gst_amrdec_set_property routine \n");
+    switch (prop_id) {
+        case PROP_BATCH_FRAMES:
+            priv->batch_frames = g_value_get_uint(value);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
     GST_DEBUG(" out of mfw_gst_amrdec_set_property routine \n");
 }
 
@@ -236,7 +260,16 @@ static void
 mfw_gst_amrdec_get_property(GObject * object, guint prop_id,
 				GValue * value, GParamSpec * pspec)
 {
+    MfwGstAmrdecPrivate *priv = MFW_GST_AMRDEC(object)->priv;
     GST_DEBUG(" in mfw_gst_amrdec_get_property routine \n");
+    switch (prop_id) {
+        case PROP_BATCH_FRAMES:
+            g_value_set_uint(value, priv->batch_frames);
+            break;
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+            break;
+    }
     GST_DEBUG(" out of mfw_gst_amrdec_get_property routine \n");
 
 }
@@ -464,35 +497,41 @@ mfw_gst_amrdec_term_codec(MfwGstAmrdec *self)
     priv->dec_params.frame_format = NULL;
 }
 
+/* in_buf points into the adapter and is not modified, the frame is copied
+   to the aligned stage buffer the library works on; out_buf must be 16 bit
+   aligned */
 static gboolean
-mfw_gst_amrdec_decode(MfwGstAmrdec *self, guint8 *in_buf,
+mfw_gst_amrdec_decode(MfwGstAmrdec *self, const guint8 *in_buf,
         gint in_size, guint8 *out_buf, gint out_size)
 {
     MfwGstAmrdecPrivate *priv = self->priv;
-	//FIXME: alignment problem
+    guint8 *stage = (guint8 *)priv->stage;
+
+    if (in_size + 1 > AMR_STAGE_SIZE)
+        return FALSE;
+
     if(priv->dec_params.mime == AMR_MIME_NB) {
-        eAMRDReturnType ret = eAMRDDecodeFrame(priv->dec_params.u.nb_dec_config,
-                (NBAMR_S16 *)in_buf, (NBAMR_S16 *)out_buf);
+        eAMRDReturnType ret;
+        memcpy(stage, in_buf, in_size);
+        ret = eAMRDDecodeFrame(priv->dec_params.u.nb_dec_config,
+                (NBAMR_S16 *)stage, (NBAMR_S16 *)out_buf);
         GST_DEBUG ("AMR-NB decode return %d\n", ret);
         return ret == E_NBAMRD_OK;
     }
     else if(priv->dec_params.mime == AMR_MIME_WB) {
         WBAMRD_RET_TYPE ret;
-        guint8 *real_in_buf = in_buf;
         guint8 format = priv->dec_params.u.wb_dec_config->bitstreamformat;
         if(format == 2) {
+            /* the library wants quality and mode in separate bytes */
             guint8 byte = *in_buf;
-            guint8 quality = (byte>>2) & 0x1;
-            gint mode = (byte>>3) & 0xF;
-            real_in_buf = g_malloc(in_size+1);
-            *real_in_buf = quality;
-            *(real_in_buf+1) = mode;
-            memcpy(real_in_buf+2, in_buf+1, in_size-1);
+            stage[0] = (byte>>2) & 0x1;
+            stage[1] = (byte>>3) & 0xF;
+            memcpy(stage+2, in_buf+1, in_size-1);
+        } else {
+            memcpy(stage, in_buf, in_size);
         }
         ret = wbamrd_decode_frame(priv->dec_params.u.wb_dec_config,
-                (WBAMR_S16 *)real_in_buf, (WBAMR_S16 *)out_buf);
-        if (real_in_buf != in_buf)
-            g_free(real_in_buf);
+                (WBAMR_S16 *)stage, (WBAMR_S16 *)out_buf);
         GST_DEBUG ("AMR-WB decode return %d\n", ret);
         return ret == WBAMRD_OK;
     }
@@ -613,53 +652,85 @@ mfw_gst_amrdec_chain(GstPad *pad, GstBuffer *buf)
     if (GST_BUFFER_TIMESTAMP_IS_VALID (buf))
         priv->time_stamp = GST_BUFFER_TIMESTAMP (buf);
 
+    GST_DEBUG("got buffer size %d\n", GST_BUFFER_SIZE(buf));
     gst_adapter_push (priv->adapter, buf);
 
     ret = GST_FLOW_OK;
 
-    GST_DEBUG("got buffer size %d\n", GST_BUFFER_SIZE(buf));
+    /* all complete frames in the adapter, up to batch_frames, are decoded
+     * into one output buffer */
     while (TRUE) {
-        GstBuffer *out;
-        guint8 *data;
-        gint in_size, out_size;
+        GstBuffer *out = NULL;
+        const guint8 *data;
+        guint avail, offset;
+        gint in_size = 0, out_size = 0;
+        guint frames, good, decoded, i;
         gboolean rv;
 
-        /* need to peek data to get the size */
-        if (gst_adapter_available (priv->adapter) < 1) {
-            GST_DEBUG("--------------------------\n");
+        avail = gst_adapter_available (priv->adapter);
+        if (avail < 1)
             break;
+        data = gst_adapter_peek (priv->adapter, avail);
+
+        /* count the frames of this batch */
+        frames = good = 0;
+        offset = 0;
+        while ((frames < MAX(priv->batch_frames, 1)) && (offset < avail)) {
+            rv = get_in_out_frame_size(dec, (guint8 *)data + offset,
+                    &in_size, &out_size);
+            if ((in_size <= 0) || (offset + in_size > avail))
+                break;
+            offset += in_size;
+            frames++;
+            if (rv)
+                good++;
         }
-        data = (guint8 *) gst_adapter_peek (priv->adapter, 1);
-        rv = get_in_out_frame_size(dec, data, &in_size, &out_size);
-        GST_DEBUG("got in size %d, out size %d\n", in_size, out_size);
-        if(in_size <= 0) {
-            GST_ERROR("AMR frame %lld mode not supported, maybe data misaligned\n", priv->frame_count);
-            gst_adapter_clear(priv->adapter);
-            ret = GST_FLOW_ERROR;
+        GST_DEBUG("batch of %d frames, %d bytes\n", frames, offset);
+
+        if (frames == 0) {
+            if (in_size <= 0) {
+                GST_ERROR("AMR frame %lld mode not supported, maybe data misaligned\n", priv->frame_count);
+                gst_adapter_clear(priv->adapter);
+                ret = GST_FLOW_ERROR;
+            }
             break;
         }
-        
-        if(gst_adapter_available (priv->adapter) < in_size)
-            break;
-        if (!rv) {
-            gst_adapter_flush(priv->adapter, in_size);
-            GST_ERROR("AMR frame %lld damaged\n", priv->frame_count);
+
+        if (good)
+            out = gst_buffer_new_and_alloc (good * out_size);
+
+        decoded = 0;
+        offset = 0;
+        for (i = 0; i < frames; i++) {
+            rv = get_in_out_frame_size(dec, (guint8 *)data + offset,
+                    &in_size, &out_size);
+            if (!rv) {
+                GST_ERROR("AMR frame %lld damaged\n", priv->frame_count);
+                ret = GST_FLOW_ERROR;
+            } else if (mfw_gst_amrdec_decode(dec, data + offset, in_size,
+                        GST_BUFFER_DATA(out) + decoded * out_size, out_size)) {
+                decoded++;
+            } else {
+                GST_ERROR("AMR decode frame %lld error\n", priv->frame_count);
+                ret = GST_FLOW_ERROR;   //just skip a frame
+            }
+            offset += in_size;
             priv->frame_count++;
-            ret = GST_FLOW_ERROR;
-            continue;
         }
-        /* the library seems to write into the source data, hence
-         * the copy. */
-        data = gst_adapter_take (priv->adapter, in_size);
+        gst_adapter_flush (priv->adapter, offset);
 
-        /* get output */
-        out = gst_buffer_new_and_alloc (out_size);
+        if (decoded == 0) {
+            if (out)
+                gst_buffer_unref(out);
+            continue;
+        }
 
-        GST_BUFFER_DURATION (out) = priv->duration;
+        GST_BUFFER_SIZE (out) = decoded * out_size;
+        GST_BUFFER_DURATION (out) = decoded * priv->duration;
         GST_BUFFER_TIMESTAMP (out) = priv->time_stamp;
 
         if (priv->time_stamp != -1)
-            priv->time_stamp += priv->duration;
+            priv->time_stamp += decoded * priv->duration;
         if (priv->discont) {
             GST_WARNING("--- AMR discontinous --- \n");
             GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_DISCONT);
@@ -668,20 +739,10 @@ mfw_gst_amrdec_chain(GstPad *pad, GstBuffer *buf)
 
         gst_buffer_set_caps (out, GST_PAD_CAPS (priv->srcpad));
 
-        /* decode */
-        rv = mfw_gst_amrdec_decode(dec, data, in_size, GST_BUFFER_DATA(out), out_size);
-        g_free (data);
-        if(!rv) {
-            GST_ERROR("AMR decode frame %lld error\n", priv->frame_count);
-            gst_buffer_unref(out);
-            ret = GST_FLOW_ERROR;
-            priv->frame_count++;
-            continue;   //just skip a frame
-        }
-
         /* send out */
         ret = gst_pad_push (priv->srcpad, out);
-        priv->frame_count++;
+        if (ret != GST_FLOW_OK)
+            break;
     }
 
     gst_object_unref (dec);
@@ -973,6 +1034,7 @@ mfw_gst_amrdec_init(MfwGstAmrdec *self, MfwGstAmrdecClass *klass)
                 (elem_class, "src"), "src");
 
     priv->adapter = gst_adapter_new ();
+    priv->batch_frames = AMR_DEFAULT_BATCH_FRAMES;
 
     gst_element_add_pad(GST_ELEMENT(self), priv->sinkpad);
     gst_element_add_pad(GST_ELEMENT(self), priv->srcpad);
@@ -1025,6 +1087,13 @@ mfw_gst_amrdec_class_init(MfwGstAmrdecClass * klass)
 
     elem_class->change_state = mfw_gst_amrdec_change_state;
 
+    g_object_class_install_property(gobject_class, PROP_BATCH_FRAMES,
+            g_param_spec_uint("batch-frames", "batch frames",
+                "maximum number of frames decoded into one output buffer, "
+                "only frames already received are batched",
+                1, AMR_MAX_BATCH_FRAMES, AMR_DEFAULT_BATCH_FRAMES,
+                G_PARAM_READWRITE));
+
     GST_DEBUG_CATEGORY_INIT(mfw_gst_amrdec_debug, "mfw_amrdecoder",
 			    0, "FreeScale's AMR Decoder's Log");
 }
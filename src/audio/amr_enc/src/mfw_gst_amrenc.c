@@ -142,6 +142,8 @@ GST_DEBUG_CATEGORY_STATIC (gst_amrnbenc_debug);
 static void gst_amrnbenc_finalize (GObject * object);
 
 static GstFlowReturn gst_amrnbenc_chain (GstPad * pad, GstBuffer * buffer);
+static gint gst_amrnbenc_encode_frame (gpointer user_data, guint8 * in,
+    guint8 * out, GstClockTime timestamp);
 static gboolean gst_amrnbenc_setcaps (GstPad * pad, GstCaps * caps);
 static GstStateChangeReturn gst_amrnbenc_state_change (GstElement * element,
     GstStateChange transition);
@@ -290,6 +292,7 @@ gst_amrnbenc_setcaps (GstPad * pad, GstCaps * caps)
   MfwGstAmrnbEnc *amrnbenc;
   GstCaps *copy;
   gchar *frame_format[] = {"esti", "mms", "if1", "if2"};
+  gint outsize = ((NBAMR_MAX_PACKED_SIZE/2)+(NBAMR_MAX_PACKED_SIZE%2)) * 2;
 
   amrnbenc = GST_AMRNBENC (GST_PAD_PARENT (pad));
 
@@ -323,16 +326,59 @@ gst_amrnbenc_setcaps (GstPad * pad, GstCaps * caps)
   gst_pad_set_caps (amrnbenc->srcpad, copy);
   gst_caps_unref (copy);
 
+  if (NBAMR_ETSI == amrnbenc->bitstream_format) {
+    outsize = SERIAL_FRAMESIZE * 2;
+  }
+
+  /* The AMR encoder actually writes into the source data buffers it gets,
+   * so each frame is copied out of the adapter before encoding */
+  mfw_gst_aenc_batch_free (&amrnbenc->batch);
+  mfw_gst_aenc_batch_init (&amrnbenc->batch, amrnbenc->srcpad, L_FRAME * 2,
+      outsize, amrnbenc->rate * 2, TRUE);
+
   return TRUE;
 }
 
+static gint
+gst_amrnbenc_encode_frame (gpointer user_data, guint8 * in, guint8 * out,
+    GstClockTime timestamp)
+{
+  MfwGstAmrnbEnc *amrnbenc = (MfwGstAmrnbEnc *) user_data;
+  eAMREReturnType  eRetVal;
+
+  /* encode */
+  eRetVal =
+      eAMREEncodeFrame (amrnbenc->psEncConfig,
+      (NBAMR_S16 *) in, (NBAMR_S16 *) out);
+  if (eRetVal != E_NBAMRE_OK) {
+      if (eRetVal == E_NBAMRE_INVALID_MODE) {
+          GST_ERROR("Invalid amr_mode specified: '%s'\n", amrnbenc->mode_str);
+      }
+      else {
+          GST_ERROR("eAMREEncodeFrame failed, error code: %d\n", eRetVal);
+      }
+      return -1;
+  }
+
+  /* set data size */
+  if (amrnbenc->psEncConfig->u8BitStreamFormat == NBAMR_IF1IO)
+  {
+      /*
+       * IF1 frame format returns number of bits based on the mode used. This
+       * includes the header part of 8 * 3 = 24 bits.
+       * Following calculation is done to get the number of packed bytes to be
+       * written into the file. 1 is added for the remainder bits.
+       */
+      amrnbenc->psEncConfig->pu32AMREPackedSize[0]=
+                (amrnbenc->psEncConfig->pu32AMREPackedSize[0] >> 3) + 1;
+  }
+  return amrnbenc->psEncConfig->pu32AMREPackedSize[0];
+}
+
 static GstFlowReturn
 gst_amrnbenc_chain (GstPad * pad, GstBuffer * buffer)
 {
   MfwGstAmrnbEnc *amrnbenc;
-  eAMREReturnType  eRetVal;
-  gint outsize = ((NBAMR_MAX_PACKED_SIZE/2)+(NBAMR_MAX_PACKED_SIZE%2)) * 2;
-  GstFlowReturn ret;
 
   amrnbenc = GST_AMRNBENC (GST_PAD_PARENT (pad));
 
@@ -342,9 +388,7 @@ gst_amrnbenc_chain (GstPad * pad, GstBuffer * buffer)
   /* discontinuity clears adapter, FIXME, maybe we can set some
    * encoder flag to mask the discont. */
   if (GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DISCONT)) {
-    gst_adapter_clear (amrnbenc->adapter);
-    amrnbenc->ts = 0;
-    amrnbenc->discont = TRUE;
+    mfw_gst_aenc_batch_flush (&amrnbenc->batch, amrnbenc->adapter);
   }
 
   GST_DEBUG("input buffer ts: %" GST_TIME_FORMAT ", size: %d, duration :%" 
@@ -352,80 +396,12 @@ gst_amrnbenc_chain (GstPad * pad, GstBuffer * buffer)
             GST_BUFFER_SIZE(buffer), 
             GST_TIME_ARGS(GST_BUFFER_DURATION(buffer)));
 
-  /* take latest timestamp, FIXME timestamp is the one of the
-   * first buffer in the adapter. */
-  if (GST_BUFFER_TIMESTAMP_IS_VALID (buffer))
-    amrnbenc->ts = GST_BUFFER_TIMESTAMP (buffer);
-
-  ret = GST_FLOW_OK;
   gst_adapter_push (amrnbenc->adapter, buffer);
-  
-  if (NBAMR_ETSI == amrnbenc->bitstream_format) {
-    outsize = SERIAL_FRAMESIZE * 2;
-  }
-
-  /* Collect samples until we have enough for an output frame */
-  while (gst_adapter_available (amrnbenc->adapter) >= L_FRAME * 2) {
-    GstBuffer *out;
-    guint8 *data;
-
-    /* get output, max size is 34 */
-    out = gst_buffer_new_and_alloc (outsize);
-    GST_BUFFER_DURATION (out) = amrnbenc->duration;
-    GST_BUFFER_TIMESTAMP (out) = amrnbenc->ts;
-    if (GST_CLOCK_TIME_IS_VALID(amrnbenc->ts)) {
-      amrnbenc->ts += amrnbenc->duration;
-    }
-    if (amrnbenc->discont) {
-      GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_DISCONT);
-      amrnbenc->discont = FALSE;
-    }
-
-    gst_buffer_set_caps (out, GST_PAD_CAPS (amrnbenc->srcpad));
-
-    /* The AMR encoder actually writes into the source data buffers it gets */
-    data = gst_adapter_take (amrnbenc->adapter, L_FRAME * 2);
-
-    /* encode */
-    eRetVal =
-        eAMREEncodeFrame (amrnbenc->psEncConfig,
-        (NBAMR_S16 *) data, (NBAMR_S16 *) GST_BUFFER_DATA (out));
-    g_free (data);
-    if (eRetVal != E_NBAMRE_OK) {
-        if (eRetVal == E_NBAMRE_INVALID_MODE) {
-            GST_ERROR("Invalid amr_mode specified: '%s'\n", amrnbenc->mode_str);
-        }
-        else {
-            GST_ERROR("eAMREEncodeFrame failed, error code: %d\n", eRetVal);
-        }
-
-        ret = GST_FLOW_ERROR;
-        break;
-    }
-
-    /* set data size */
-    if (amrnbenc->psEncConfig->u8BitStreamFormat == NBAMR_IF1IO)
-    {
-        /*
-         * IF1 frame format returns number of bits based on the mode used. This
-         * includes the header part of 8 * 3 = 24 bits.
-         * Following calculation is done to get the number of packed bytes to be
-         * written into the file. 1 is added for the remainder bits.
-         */
-        amrnbenc->psEncConfig->pu32AMREPackedSize[0]=
-                  (amrnbenc->psEncConfig->pu32AMREPackedSize[0] >> 3) + 1;
-    }
-    GST_BUFFER_SIZE(out) = amrnbenc->psEncConfig->pu32AMREPackedSize[0];
 
-    /* play */
-    if ((ret = gst_pad_push (amrnbenc->srcpad, out)) != GST_FLOW_OK)
-      break;
-    GST_DEBUG("push buffer ts: %" GST_TIME_FORMAT ", size: %d, duration :%" 
-              GST_TIME_FORMAT, GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(out)), 
-              GST_BUFFER_SIZE(out), 
-              GST_TIME_ARGS(GST_BUFFER_DURATION(out)));
-  }
-  return ret;
+  /* all complete frames go out in one buffer, the timestamp of each is
+   * interpolated from the input buffer it starts in */
+  return mfw_gst_aenc_batch_encode (&amrnbenc->batch, amrnbenc->adapter,
+      gst_amrnbenc_encode_frame, amrnbenc);
 
   /* ERRORS */
 not_negotiated:
@@ -523,7 +499,7 @@ gst_amrnbenc_alloc_memory(MfwGstAmrnbEnc *enc)
   	for(i = 0; i <s16NumMemReqs; i++)
     {
         psMem = &(psEncConfig->sAMREMemInfo.asMemInfoSub[i]);
-        psMem->pvAPPEBasePtr = g_malloc(psMem->s32AMRESize);
+        psMem->pvAPPEBasePtr = mfw_gst_aenc_mem_alloc(psMem->s32AMRESize, 0);
         if (psMem->pvAPPEBasePtr == NULL)
         {
             GST_ERROR ("Failed to allocate memory for pvAPPEBasePtr");
@@ -568,7 +544,7 @@ gst_amrnbenc_free_memory(MfwGstAmrnbEnc *enc)
   	for(i = 0; i <s16NumMemReqs; i++) {
         psMem = &(psEncConfig->sAMREMemInfo.asMemInfoSub[i]);
         if (NULL != psMem->pvAPPEBasePtr) {
-            g_free(psMem->pvAPPEBasePtr);
+            mfw_gst_aenc_mem_free(psMem->pvAPPEBasePtr);
             psMem->pvAPPEBasePtr = NULL;
         }
     }
@@ -599,9 +575,7 @@ gst_amrnbenc_state_change (GstElement * element, GstStateChange transition)
       }
       amrnbenc->rate = 0;
       amrnbenc->channels = 0;
-      amrnbenc->ts = 0;
-      amrnbenc->discont = FALSE;
-      gst_adapter_clear (amrnbenc->adapter);
+      mfw_gst_aenc_batch_flush (&amrnbenc->batch, amrnbenc->adapter);
       break;
     default:
       break;
@@ -612,6 +586,7 @@ gst_amrnbenc_state_change (GstElement * element, GstStateChange transition)
   switch (transition) {
     case GST_STATE_CHANGE_READY_TO_NULL:
       gst_amrnbenc_free_memory(amrnbenc);
+      mfw_gst_aenc_batch_free (&amrnbenc->batch);
       break;
     default:
       break;
@@ -29,6 +29,7 @@
 #include <gst/base/gstadapter.h>
 
 #include "nb_amr_enc_api.h"
+#include "mfw_gst_aenc.h"
 
 G_BEGIN_DECLS
 
@@ -51,10 +52,9 @@ struct _MfwGstAmrnbEnc {
 
   /* pads */
   GstPad *sinkpad, *srcpad;
-  GstClockTime ts;
-  gboolean discont;
 
   GstAdapter *adapter;
+  MfwGstAencBatch batch;
 
   /* input settings */
   sAMREEncoderConfigType   *psEncConfig; /* Pointer to encoder config structure */
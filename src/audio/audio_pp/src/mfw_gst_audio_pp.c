@@ -122,6 +122,8 @@ static Mem_Mgr mem_mgr = {0};
 
 #define PEQ_PARAMETERS_NUM  2
 
+#define AUDIO_PP_ENGINE_DEFAULT AUDIO_PP_ENGINE_CORE
+
 static GstStaticPadTemplate mfw_audio_pp_sink_factory =
     GST_STATIC_PAD_TEMPLATE (
     "sink",
@@ -144,6 +146,7 @@ enum {
     AUDIO_PP_ENABLED = 1, 
     PEQ_PREMODE,
     PEQ_ATTENUATION,
+    AUDIO_PP_ENGINE,
 };
 
 /*=============================================================================
@@ -254,6 +257,10 @@ mfw_gst_audio_pp_set_property (GObject *object, guint prop_id,
         filter->attenuation = g_value_get_int(value);
         filter->ppfeatureinstance[0].newparameterapplied = TRUE;
         break;
+
+    case AUDIO_PP_ENGINE:
+        filter->engine = g_value_get_int(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -276,6 +283,9 @@ mfw_gst_audio_pp_get_property (GObject *object, guint prop_id,
     case PEQ_ATTENUATION:
         g_value_set_int(value, filter->attenuation);
         break;        
+    case AUDIO_PP_ENGINE:
+        g_value_set_int(value, filter->engine);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -519,6 +529,109 @@ ErrClean:
     return FALSE;
 }
 
+static const PPFeatureOps parametric_eq_ops = {
+    parametric_eq_instancelize,
+    parametric_eq_set_parameter,
+    parametric_eq_do_process,
+};
+
+/*=============================================================================
+FUNCTION:    parametric_eq_open_instancelize
+
+DESCRIPTION: Create the built-in equalizer for the channels, width and rate
+             of the buffer caps, 16 or 32 bit and up to 8 channels.
+
+IMPORTANT NOTES:
+   	    None
+=============================================================================*/
+static gboolean parametric_eq_open_instancelize(PPFeatureInstance * pfinstance, GstBuffer * gstbuf)
+{
+    PEQ_OPEN_INSTANCE_CONTEXT * ctx;
+    GstCaps * caps;
+    GstStructure * structure;
+    gint channels = 2;
+    gint width = 16;
+    gint samplerate = 44100;
+
+    caps = gst_buffer_get_caps(gstbuf);
+    if (caps==NULL){
+        AUDIO_PP_FATAL_ERROR("No caps on buffer for PEQ\n");
+        return FALSE;
+    }
+    structure = gst_caps_get_structure(caps, 0);
+    gst_structure_get_int(structure, "channels", &channels);
+    gst_structure_get_int(structure, "width", &width);
+    gst_structure_get_int(structure, "rate", &samplerate);
+    gst_caps_unref(caps);
+
+    if (pfinstance->pmlist = AUDIO_PP_MALLOC(sizeof(PPFeatureParameter)*PEQ_PARAMETERS_NUM+sizeof(guint))){
+        memset(pfinstance->pmlist, 0, (sizeof(PPFeatureParameter)*PEQ_PARAMETERS_NUM+sizeof(guint)));
+    }else{
+        return FALSE;
+    }
+
+    ctx = AUDIO_PP_MALLOC(sizeof(PEQ_OPEN_INSTANCE_CONTEXT));
+    if ((ctx==NULL) || (!mfw_gst_peq_init(&ctx->peq, channels, width, samplerate))){
+        AUDIO_PP_FATAL_ERROR("PEQ of %d channels %d bit not supported\n",
+            channels, width);
+        if (ctx)
+            AUDIO_PP_FREE(ctx);
+        AUDIO_PP_FREE(pfinstance->pmlist);
+        pfinstance->pmlist = NULL;
+        return FALSE;
+    }
+    ctx->premode = PEQ_PREMODE_DEFAULT;
+    ctx->attenuation = PEQ_ATTENUATION_DEFAULT;
+    pfinstance->priv = ctx;
+
+    return TRUE;
+}
+
+static gboolean parametric_eq_open_set_parameter(PPFeatureInstance * pfinstance, PPFeatureParametersList* pmlist)
+{
+    PEQ_OPEN_INSTANCE_CONTEXT * ctx = (PEQ_OPEN_INSTANCE_CONTEXT *)pfinstance->priv;
+    MfwGstPeqBand bands[MFW_GST_PEQ_MAX_BANDS];
+    gint count;
+    int i;
+
+    for (i=0;i<pmlist->numofparater;i++){
+        switch(pmlist->parameters[i].pmid){
+            case PEQ_PREMODE:
+                ctx->premode = *((gint32 *)(pmlist->parameters[i].pparameter));
+                g_print(YELLOW_STR("Set effect: %s\n", effectname[ctx->premode]));
+                break;
+            case PEQ_ATTENUATION:
+                ctx->attenuation = *((gint32 *)(pmlist->parameters[i].pparameter));
+                g_print(YELLOW_STR("Set attenuation: %d\n", ctx->attenuation));
+                break;
+            default:
+                g_print(RED_STR("Unknown parameter id %d for PEQ\n", (pmlist->parameters[i].pmid)));
+                break;
+        }
+    }
+
+    /* eqmode 0 disables the equalizer, attenuation goes with an effect */
+    count = mfw_gst_peq_preset(ctx->premode, bands);
+    mfw_gst_peq_set_bands(&ctx->peq, bands, count,
+        (count ? ctx->attenuation : 0));
+    return TRUE;
+}
+
+static gboolean parametric_eq_open_do_process(PPFeatureInstance * pfinstance, GstBuffer * gstbuf)
+{
+    MfwGstPeqEngine * peq = &(((PEQ_OPEN_INSTANCE_CONTEXT *)pfinstance->priv)->peq);
+    guint frames = GST_BUFFER_SIZE(gstbuf)/(peq->width/8)/peq->channels;
+
+    mfw_gst_peq_process(peq, GST_BUFFER_DATA(gstbuf), frames);
+    return TRUE;
+}
+
+static const PPFeatureOps parametric_eq_open_ops = {
+    parametric_eq_open_instancelize,
+    parametric_eq_open_set_parameter,
+    parametric_eq_open_do_process,
+};
+
 /* chain function
  * this function does the actual processing
  */
@@ -535,7 +648,11 @@ mfw_gst_audio_pp_chain (GstPad *pad, GstBuffer *buf)
     if (filter->status==PP_ENABLED){
         PPFeatureInstance * pfeatureinstance0 = &filter->ppfeatureinstance[0];
         if (G_UNLIKELY(pfeatureinstance0->state==PP_EMPTY)){
-            if (parametric_eq_instancelize(pfeatureinstance0, buf)==TRUE){   
+            if (filter->engine==AUDIO_PP_ENGINE_OPEN)
+                pfeatureinstance0->ops = &parametric_eq_open_ops;
+            else
+                pfeatureinstance0->ops = &parametric_eq_ops;
+            if (pfeatureinstance0->ops->instancelize(pfeatureinstance0, buf)==TRUE){   
                 pfeatureinstance0->newparameterapplied = TRUE;
                 filter->caps_set=TRUE;
             }else{
@@ -556,11 +673,13 @@ mfw_gst_audio_pp_chain (GstPad *pad, GstBuffer *buf)
             pmlist->parameters[1].pmid = PEQ_ATTENUATION;
             pmlist->parameters[1].pparameter = (void *)&filter->attenuation;
 
-            parametric_eq_set_parameter(pfeatureinstance0,pmlist);
+            pfeatureinstance0->ops->set_parameter(pfeatureinstance0,pmlist);
             pfeatureinstance0->newparameterapplied = FALSE;
         }
+        /* processed in place */
+        buf = gst_buffer_make_writable(buf);
         pfeatureinstance0->state = PP_BUSY;
-        parametric_eq_do_process(pfeatureinstance0,buf);
+        pfeatureinstance0->ops->do_process(pfeatureinstance0,buf);
         pfeatureinstance0->state = PP_IDLE;
          
     }else{
@@ -685,6 +804,15 @@ mfw_gst_audio_pp_class_init (gpointer klass)
         PEQ_ATTENUATION_DEFAULT, G_PARAM_READWRITE)
     ); 
 
+    g_object_class_install_property (
+        G_OBJECT_CLASS (klass), 
+        AUDIO_PP_ENGINE, 
+        g_param_spec_int ("engine", "engine", 
+        "EQ implementation: 0, codec library; 1, built-in cascaded biquads", 
+        AUDIO_PP_ENGINE_CORE, AUDIO_PP_ENGINE_OPEN,
+        AUDIO_PP_ENGINE_DEFAULT, G_PARAM_READWRITE)
+    ); 
+
     return;
 }
 
@@ -759,6 +887,7 @@ mfw_gst_audio_pp_init	 (MfwGstAudioPP *filter,
 
     filter->premode = PEQ_PREMODE_DEFAULT;
     filter->attenuation = PEQ_ATTENUATION_DEFAULT;
+    filter->engine = AUDIO_PP_ENGINE_DEFAULT;
 
     #define MFW_GST_AUDIO_PP_PLUGIN VERSION
     PRINT_CORE_VERSION(PEQPPPVersionInfo());
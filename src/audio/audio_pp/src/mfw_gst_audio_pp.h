@@ -44,6 +44,7 @@
 #define __MFW_GST_AUDIO_PP_H__
 
 #include <gst/gst.h>
+#include "mfw_gst_peq_engine.h"
 
 
 
@@ -57,7 +58,11 @@
                                              ENUMS
 =============================================================================*/
 
-/* None. */
+typedef enum
+{
+    AUDIO_PP_ENGINE_CORE = 0,   /* peq_ppp_frame of the codec library */
+    AUDIO_PP_ENGINE_OPEN,       /* built-in cascaded biquads */
+}AUDIO_PP_ENGINE_TYPE;
   
 /*=============================================================================
                                             MACROS
@@ -103,6 +108,13 @@ typedef struct {
 }PEQ_INSTANCE_CONTEXT;
 
 
+typedef struct {
+    MfwGstPeqEngine peq;
+    gint32 premode;
+    gint32 attenuation;         /* pre gain in 0.1 dB */
+}PEQ_OPEN_INSTANCE_CONTEXT;
+
+
 typedef struct {
     guint pmid;
     guint pmtype;
@@ -116,12 +128,22 @@ typedef struct {
 }PPFeatureParametersList;
 
 
+typedef struct _PPFeatureInstance PPFeatureInstance;
+
 typedef struct {
+    gboolean (*instancelize)(PPFeatureInstance * pfinstance, GstBuffer * gstbuf);
+    gboolean (*set_parameter)(PPFeatureInstance * pfinstance, PPFeatureParametersList * pmlist);
+    gboolean (*do_process)(PPFeatureInstance * pfinstance, GstBuffer * gstbuf);
+}PPFeatureOps;
+
+
+struct _PPFeatureInstance {
     PP_STATE state;
     void * priv; 
     gboolean newparameterapplied;
     PPFeatureParametersList * pmlist;
-}PPFeatureInstance;
+    const PPFeatureOps * ops;   /* chosen when the instance is created */
+};
 
 
 typedef struct _MfwGstAudioPP
@@ -132,6 +154,7 @@ typedef struct _MfwGstAudioPP
     PP_STATUS status;
     gint32 premode;
     gint32 attenuation;   
+    gint engine;                /* AUDIO_PP_ENGINE_TYPE */
     PPFeatureInstance ppfeatureinstance[MAX_AUDIO_PP_FEATURE_INSTANCE];
 
 }MfwGstAudioPP;
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_peq_bench.c
+ *
+ * Description:    Equalizer throughput for 1 to 16 bands and 1 to 8
+ *                 channels, as times faster than real time and ns per
+ *                 sample per channel per band. Usage: mfw_gst_peq_bench
+ *                 [seconds of 48 kHz audio, default 10]
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+#include <math.h>
+#include <stdlib.h>
+
+#include "mfw_gst_peq_engine.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+#define PEQ_BENCH_RATE      48000
+#define PEQ_BENCH_SECONDS   10
+#define PEQ_BENCH_BUFFER    1024        /* frames per process call */
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+
+/* +6 dB peaks spread evenly over the octaves from 31 Hz to 16 kHz */
+static void
+peq_bench_bands (MfwGstPeqBand * bands, gint n)
+{
+  gint b;
+
+  for (b = 0; b < n; b++) {
+    bands[b].fc = (gint) (31.25 * pow (512.0, (b + 0.5) / n));
+    bands[b].gain = 60;
+    bands[b].q = 141;
+    bands[b].type = MFW_GST_PEQ_PEAK;
+  }
+}
+
+/* seconds spent on frames of data, in buffers as a pipeline would */
+static gdouble
+peq_bench_run (MfwGstPeqEngine * peq, guint8 * data, guint frames)
+{
+  GTimer *timer = g_timer_new ();
+  guint bytes = peq->channels * peq->width / 8;
+  guint off, n;
+  gdouble s;
+
+  for (off = 0; off < frames; off += n) {
+    n = MIN (frames - off, PEQ_BENCH_BUFFER);
+    mfw_gst_peq_process (peq, data + off * bytes, n);
+  }
+  s = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  return s;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const gint counts[] = { 1, 4, 10, 16 };
+  static const gint layouts[] = { 1, 2, 6, 8 };
+  MfwGstPeqBand bands[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqEngine peq;
+  GRand *rand;
+  guint8 *data;
+  guint frames, i, size;
+  gint seconds = PEQ_BENCH_SECONDS, width, n, c;
+
+  if (argc > 1)
+    seconds = MAX (atoi (argv[1]), 1);
+  frames = PEQ_BENCH_RATE * seconds;
+
+  /* quiet noise, +6 dB bands must not clip into the saturation path */
+  size = frames * MFW_GST_PEQ_MAX_CHANNELS * 4;
+  data = g_malloc (size);
+  rand = g_rand_new_with_seed (0);
+  for (i = 0; i < size; i++)
+    data[i] = ((i & 1) ? 0 : (guint8) g_rand_int (rand));
+  g_rand_free (rand);
+
+  g_print ("%d s of %d Hz audio in %d frame buffers\n", seconds,
+      PEQ_BENCH_RATE, PEQ_BENCH_BUFFER);
+  g_print ("%-6s %-6s %-9s %12s %12s\n", "width", "bands", "channels",
+      "x realtime", "ns/ch/band");
+  for (width = 16; width <= 32; width += 16) {
+    for (n = 0; n < G_N_ELEMENTS (counts); n++) {
+      peq_bench_bands (bands, counts[n]);
+      for (c = 0; c < G_N_ELEMENTS (layouts); c++) {
+        gdouble s;
+
+        mfw_gst_peq_init (&peq, layouts[c], width, PEQ_BENCH_RATE);
+        mfw_gst_peq_set_bands (&peq, bands, counts[n], 0);
+        s = peq_bench_run (&peq, data, frames);
+        mfw_gst_peq_free (&peq);
+
+        g_print ("%-6d %-6d %-9d %12.1f %12.2f\n", width, counts[n],
+            layouts[c], (s > 0) ? seconds / s : 0,
+            s * 1e9 / ((gdouble) frames * layouts[c] * counts[n]));
+      }
+    }
+  }
+
+  g_free (data);
+  return 0;
+}
@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_peq_engine.c
+ *
+ * Description:    Cascaded biquad parametric equalizer engine. Samples are
+ *                 converted to float a block at a time with the channels of
+ *                 a frame in groups of 4 lanes, so one vector operation
+ *                 filters 4 channels; all bands of a frame are run while it
+ *                 is in registers.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+#include <string.h>
+#include <math.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mfw_gst_peq_engine.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+#define PEQ_LANES           4
+#define PEQ_PRESET_BANDS    10
+#define PEQ_PRESET_Q        141 /* one octave */
+#define PEQ_DENORMAL        1e-20f
+
+#if defined(__ARM_NEON__)
+typedef float32x4_t PeqVec;
+#define PEQ_LOAD(p)         vld1q_f32 (p)
+#define PEQ_STORE(p, v)     vst1q_f32 ((p), (v))
+#define PEQ_DUP(x)          vdupq_n_f32 (x)
+#define PEQ_MLA(a, b, c)    vmlaq_f32 ((a), (b), (c))   /* a + b * c */
+#define PEQ_MLS(a, b, c)    vmlsq_f32 ((a), (b), (c))   /* a - b * c */
+#define PEQ_MUL(a, b)       vmulq_f32 ((a), (b))
+#elif defined(__SSE2__)
+typedef __m128 PeqVec;
+#define PEQ_LOAD(p)         _mm_loadu_ps (p)
+#define PEQ_STORE(p, v)     _mm_storeu_ps ((p), (v))
+#define PEQ_DUP(x)          _mm_set1_ps (x)
+#define PEQ_MLA(a, b, c)    _mm_add_ps ((a), _mm_mul_ps ((b), (c)))
+#define PEQ_MLS(a, b, c)    _mm_sub_ps ((a), _mm_mul_ps ((b), (c)))
+#define PEQ_MUL(a, b)       _mm_mul_ps ((a), (b))
+#else
+typedef struct
+{
+  gfloat v[PEQ_LANES];
+} PeqVec;
+
+static inline PeqVec
+peq_load (const gfloat * p)
+{
+  PeqVec r;
+  memcpy (r.v, p, sizeof (r.v));
+  return r;
+}
+
+static inline PeqVec
+peq_dup (gfloat x)
+{
+  PeqVec r = { {x, x, x, x} };
+  return r;
+}
+
+static inline PeqVec
+peq_mla (PeqVec a, PeqVec b, PeqVec c)
+{
+  gint i;
+  for (i = 0; i < PEQ_LANES; i++)
+    a.v[i] += b.v[i] * c.v[i];
+  return a;
+}
+
+static inline PeqVec
+peq_mls (PeqVec a, PeqVec b, PeqVec c)
+{
+  gint i;
+  for (i = 0; i < PEQ_LANES; i++)
+    a.v[i] -= b.v[i] * c.v[i];
+  return a;
+}
+
+static inline PeqVec
+peq_mul (PeqVec a, PeqVec b)
+{
+  gint i;
+  for (i = 0; i < PEQ_LANES; i++)
+    a.v[i] *= b.v[i];
+  return a;
+}
+
+#define PEQ_LOAD(p)         peq_load (p)
+#define PEQ_STORE(p, x)     memcpy ((p), (x).v, sizeof ((x).v))
+#define PEQ_DUP(x)          peq_dup (x)
+#define PEQ_MLA(a, b, c)    peq_mla ((a), (b), (c))
+#define PEQ_MLS(a, b, c)    peq_mls ((a), (b), (c))
+#define PEQ_MUL(a, b)       peq_mul ((a), (b))
+#endif
+
+/*=============================================================================
+                            LOCAL VARIABLES
+=============================================================================*/
+static const gint peq_preset_fc[PEQ_PRESET_BANDS] = {
+  31, 62, 125, 250, 500, 1000, 2000, 4000, 8000, 16000
+};
+
+/* gains in 0.1 dB of the predefined modes, in the order of the eqmode
+   property; user defined and flat have no band */
+static const gint16 peq_preset_gain[MFW_GST_PEQ_PRESETS][PEQ_PRESET_BANDS] = {
+  {0},                                                  /* user defined */
+  {50, 49, 40, 11, 18, 18, 35, 41, 35, 21},             /* acoustic */
+  {55, 43, 35, 25, 13, 0, 0, 0, 0, 0},                  /* bass booster */
+  {-55, -43, -35, -25, -13, 0, 0, 0, 0, 0},             /* bass reducer */
+  {48, 38, 30, 25, -15, -15, 0, 23, 33, 38},            /* classical */
+  {36, 66, 50, 0, 19, 37, 52, 45, 36, 0},               /* dance */
+  {50, 36, 18, 10, 29, 25, 15, -22, -36, -46},          /* deep */
+  {43, 38, 12, 0, -22, 23, 9, 13, 40, 48},              /* electronic */
+  {50, 43, 15, 30, -10, -10, 15, -5, 20, 30},           /* hip hop */
+  {40, 30, 15, 23, -15, -15, 0, 15, 30, 38},            /* jazz */
+  {45, 30, 0, 0, -15, -15, -15, 0, 30, 45},             /* latin */
+  {60, 40, 0, 0, -20, 0, -10, -50, 50, 10},             /* loudness */
+  {-30, -15, -5, 15, 40, 25, 0, -15, 20, 10},           /* lounge */
+  {30, 20, 0, 25, 30, 15, 35, 45, 30, 35},              /* piano */
+  {-15, -10, 0, 20, 40, 40, 20, 0, -10, -15},           /* pop */
+  {26, 69, 57, 13, -22, -15, 23, 27, 30, 38},           /* R&B */
+  {50, 40, 30, 15, -5, -10, 5, 25, 35, 45},             /* rock */
+  {55, 43, 35, 25, 13, 0, -13, -25, -35, -43},          /* small speakers */
+  {-35, -5, 0, 7, 35, 46, 48, 43, 25, 0},               /* spoken word */
+  {0, 0, 0, 0, 0, 13, 25, 35, 43, 55},                  /* treble booster */
+  {0, 0, 0, 0, 0, -13, -25, -35, -43, -55},             /* treble reducer */
+  {-15, -30, -30, 15, 38, 38, 30, 15, 0, -15},          /* vocal booster */
+  {0},                                                  /* flat */
+};
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+static void
+peq_identity (MfwGstPeqCoef * coef)
+{
+  coef->b0 = 1.0f;
+  coef->b1 = coef->b2 = coef->a1 = coef->a2 = 0.0f;
+}
+
+/*
+ * A band without poles (off, or only gain) takes the poles of the other
+ * end of a ramp and cancels them with its zeros. The response stays the
+ * same, and the ramp then only moves zeros instead of passing through
+ * resonances neither end has.
+ */
+static void
+peq_match_poles (MfwGstPeqCoef * coef, const MfwGstPeqCoef * other)
+{
+  if ((coef->a1 != 0.0f) || (coef->a2 != 0.0f) || (coef->b1 != 0.0f)
+      || (coef->b2 != 0.0f))
+    return;
+
+  coef->b1 = coef->b0 * other->a1;
+  coef->b2 = coef->b0 * other->a2;
+  coef->a1 = other->a1;
+  coef->a2 = other->a2;
+}
+
+/* run frames of one block through all bands, groups are independent */
+static void
+peq_run (MfwGstPeqEngine * peq, gfloat * buf, guint frames)
+{
+  PeqVec b0[MFW_GST_PEQ_MAX_BANDS], b1[MFW_GST_PEQ_MAX_BANDS];
+  PeqVec b2[MFW_GST_PEQ_MAX_BANDS], a1[MFW_GST_PEQ_MAX_BANDS];
+  PeqVec a2[MFW_GST_PEQ_MAX_BANDS];
+  PeqVec s1[MFW_GST_PEQ_MAX_BANDS], s2[MFW_GST_PEQ_MAX_BANDS];
+  PeqVec x, y;
+  gint bands = peq->bands;
+  gint stride = peq->groups * PEQ_LANES;
+  gint g, b;
+  guint f;
+
+  for (b = 0; b < bands; b++) {
+    b0[b] = PEQ_DUP (peq->cur[b].b0);
+    b1[b] = PEQ_DUP (peq->cur[b].b1);
+    b2[b] = PEQ_DUP (peq->cur[b].b2);
+    a1[b] = PEQ_DUP (peq->cur[b].a1);
+    a2[b] = PEQ_DUP (peq->cur[b].a2);
+  }
+
+  for (g = 0; g < peq->groups; g++) {
+    gfloat *p = buf + g * PEQ_LANES;
+
+    for (b = 0; b < bands; b++) {
+      s1[b] = PEQ_LOAD (&peq->state[b][0][g * PEQ_LANES]);
+      s2[b] = PEQ_LOAD (&peq->state[b][1][g * PEQ_LANES]);
+    }
+
+    for (f = 0; f < frames; f++, p += stride) {
+      x = PEQ_LOAD (p);
+      for (b = 0; b < bands; b++) {
+        y = PEQ_MLA (s1[b], b0[b], x);
+        s1[b] = PEQ_MLS (PEQ_MLA (s2[b], b1[b], x), a1[b], y);
+        s2[b] = PEQ_MLS (PEQ_MUL (b2[b], x), a2[b], y);
+        x = y;
+      }
+      PEQ_STORE (p, x);
+    }
+
+    for (b = 0; b < bands; b++) {
+      PEQ_STORE (&peq->state[b][0][g * PEQ_LANES], s1[b]);
+      PEQ_STORE (&peq->state[b][1][g * PEQ_LANES], s2[b]);
+    }
+  }
+}
+
+static void
+peq_ramp_step (MfwGstPeqEngine * peq)
+{
+  gint b;
+
+  /* bands ramped out stay until peq_drop_bands finds their state empty */
+  if (--peq->ramp == 0) {
+    memcpy (peq->cur, peq->target, sizeof (peq->cur));
+    return;
+  }
+
+  for (b = 0; b < peq->bands; b++) {
+    peq->cur[b].b0 += peq->step[b].b0;
+    peq->cur[b].b1 += peq->step[b].b1;
+    peq->cur[b].b2 += peq->step[b].b2;
+    peq->cur[b].a1 += peq->step[b].a1;
+    peq->cur[b].a2 += peq->step[b].a2;
+  }
+}
+
+/* an identity band drains its state in two frames, then it can go */
+static void
+peq_drop_bands (MfwGstPeqEngine * peq)
+{
+  gint i, b = peq->bands - 1;
+
+  while ((peq->ramp == 0) && (b >= peq->target_bands)) {
+    for (i = 0; i < MFW_GST_PEQ_MAX_CHANNELS; i++) {
+      if ((peq->state[b][0][i] != 0.0f) || (peq->state[b][1][i] != 0.0f))
+        return;
+    }
+    peq->bands = b--;
+  }
+}
+
+static void
+peq_to_float (MfwGstPeqEngine * peq, const guint8 * data, guint frames)
+{
+  gint stride = peq->groups * PEQ_LANES;
+  gint c, ch = peq->channels;
+  gfloat *dst = peq->scratch;
+  guint f;
+
+  if (peq->width == 16) {
+    const gint16 *src = (const gint16 *) data;
+    for (f = 0; f < frames; f++, src += ch, dst += stride)
+      for (c = 0; c < ch; c++)
+        dst[c] = src[c] * (1.0f / 32768.0f);
+  } else {
+    const gint32 *src = (const gint32 *) data;
+    for (f = 0; f < frames; f++, src += ch, dst += stride)
+      for (c = 0; c < ch; c++)
+        dst[c] = src[c] * (1.0f / 2147483648.0f);
+  }
+}
+
+static void
+peq_from_float (MfwGstPeqEngine * peq, guint8 * data, guint frames)
+{
+  gint stride = peq->groups * PEQ_LANES;
+  gint c, ch = peq->channels;
+  const gfloat *src = peq->scratch;
+  gfloat v;
+  guint f;
+
+  if (peq->width == 16) {
+    gint16 *dst = (gint16 *) data;
+    for (f = 0; f < frames; f++, src += stride, dst += ch) {
+      for (c = 0; c < ch; c++) {
+        v = CLAMP (src[c] * 32768.0f, -32768.0f, 32767.0f);
+        dst[c] = (gint16) ((v >= 0.0f) ? (v + 0.5f) : (v - 0.5f));
+      }
+    }
+  } else {
+    gint32 *dst = (gint32 *) data;
+    for (f = 0; f < frames; f++, src += stride, dst += ch) {
+      for (c = 0; c < ch; c++) {
+        /* largest float below 2^31 */
+        v = CLAMP (src[c] * 2147483648.0f, -2147483648.0f, 2147483520.0f);
+        dst[c] = (gint32) ((v >= 0.0f) ? (v + 0.5f) : (v - 0.5f));
+      }
+    }
+  }
+}
+
+/*=============================================================================
+                            GLOBAL FUNCTIONS
+=============================================================================*/
+
+gboolean
+mfw_gst_peq_init (MfwGstPeqEngine * peq, gint channels, gint width, gint rate)
+{
+  gint b;
+
+  if ((channels < 1) || (channels > MFW_GST_PEQ_MAX_CHANNELS)
+      || ((width != 16) && (width != 32)) || (rate <= 0))
+    return FALSE;
+
+  memset (peq, 0, sizeof (MfwGstPeqEngine));
+  peq->channels = channels;
+  peq->width = width;
+  peq->rate = rate;
+  peq->groups = (channels + PEQ_LANES - 1) / PEQ_LANES;
+  peq->scratch =
+      g_malloc0 (MFW_GST_PEQ_BLOCK * peq->groups * PEQ_LANES *
+      sizeof (gfloat));
+
+  for (b = 0; b < MFW_GST_PEQ_MAX_BANDS; b++) {
+    peq_identity (&peq->cur[b]);
+    peq_identity (&peq->target[b]);
+  }
+
+  return TRUE;
+}
+
+void
+mfw_gst_peq_free (MfwGstPeqEngine * peq)
+{
+  g_free (peq->scratch);
+  peq->scratch = NULL;
+}
+
+gint
+mfw_gst_peq_preset (gint premode, MfwGstPeqBand * bands)
+{
+  gint i;
+
+  if ((premode <= 0) || (premode >= MFW_GST_PEQ_PRESETS - 1))
+    return 0;
+
+  for (i = 0; i < PEQ_PRESET_BANDS; i++) {
+    bands[i].fc = peq_preset_fc[i];
+    bands[i].gain = peq_preset_gain[premode][i];
+    bands[i].q = PEQ_PRESET_Q;
+    bands[i].type = MFW_GST_PEQ_PEAK;
+  }
+  return PEQ_PRESET_BANDS;
+}
+
+/* Audio EQ Cookbook (R. Bristow-Johnson) filters, computed in double */
+void
+mfw_gst_peq_band_coef (const MfwGstPeqBand * band, gint rate,
+    MfwGstPeqCoef * coef)
+{
+  gdouble A, w0, cs, alpha, sa, q;
+  gdouble b0, b1, b2, a0, a1, a2;
+
+  if ((band->fc <= 0) || (band->fc * 2 >= rate) || (band->gain == 0)) {
+    peq_identity (coef);
+    return;
+  }
+
+  q = (band->q > 0) ? band->q / 100.0 : 0.707;
+  A = pow (10.0, band->gain / 400.0);
+  w0 = 2.0 * G_PI * band->fc / rate;
+  cs = cos (w0);
+  alpha = sin (w0) / (2.0 * q);
+  sa = 2.0 * sqrt (A) * alpha;
+
+  switch (band->type) {
+    case MFW_GST_PEQ_LOW_SHELF:
+      b0 = A * ((A + 1) - (A - 1) * cs + sa);
+      b1 = 2 * A * ((A - 1) - (A + 1) * cs);
+      b2 = A * ((A + 1) - (A - 1) * cs - sa);
+      a0 = (A + 1) + (A - 1) * cs + sa;
+      a1 = -2 * ((A - 1) + (A + 1) * cs);
+      a2 = (A + 1) + (A - 1) * cs - sa;
+      break;
+    case MFW_GST_PEQ_HIGH_SHELF:
+      b0 = A * ((A + 1) + (A - 1) * cs + sa);
+      b1 = -2 * A * ((A - 1) + (A + 1) * cs);
+      b2 = A * ((A + 1) + (A - 1) * cs - sa);
+      a0 = (A + 1) - (A - 1) * cs + sa;
+      a1 = 2 * ((A - 1) - (A + 1) * cs);
+      a2 = (A + 1) - (A - 1) * cs - sa;
+      break;
+    default:
+      b0 = 1 + alpha * A;
+      b1 = -2 * cs;
+      b2 = 1 - alpha * A;
+      a0 = 1 + alpha / A;
+      a1 = -2 * cs;
+      a2 = 1 - alpha / A;
+      break;
+  }
+
+  coef->b0 = b0 / a0;
+  coef->b1 = b1 / a0;
+  coef->b2 = b2 / a0;
+  coef->a1 = a1 / a0;
+  coef->a2 = a2 / a0;
+}
+
+void
+mfw_gst_peq_set_bands (MfwGstPeqEngine * peq, const MfwGstPeqBand * bands,
+    gint count, gint pregain)
+{
+  MfwGstPeqCoef *t = peq->target;
+  gfloat g;
+  gint b, n;
+
+  count = CLAMP (count, 0, MFW_GST_PEQ_MAX_BANDS);
+  n = MAX (count, 1);
+
+  for (b = 0; b < MFW_GST_PEQ_MAX_BANDS; b++) {
+    if (b < count)
+      mfw_gst_peq_band_coef (&bands[b], peq->rate, &t[b]);
+    else
+      peq_identity (&t[b]);
+  }
+
+  /* pre gain goes into the first band */
+  g = pow (10.0, pregain / 200.0);
+  t[0].b0 *= g;
+  t[0].b1 *= g;
+  t[0].b2 *= g;
+
+  peq->target_bands = n;
+
+  if (!peq->configured) {
+    memcpy (peq->cur, peq->target, sizeof (peq->cur));
+    peq->bands = n;
+    peq->ramp = 0;
+    peq->ramp_frames = 0;
+    peq->configured = TRUE;
+    return;
+  }
+
+  /* the stable region of (a1, a2) is convex, so every step is stable */
+  peq->bands = MAX (peq->bands, n);
+  for (b = 0; b < peq->bands; b++) {
+    peq_match_poles (&peq->cur[b], &t[b]);
+    peq_match_poles (&t[b], &peq->cur[b]);
+    peq->step[b].b0 = (t[b].b0 - peq->cur[b].b0) / MFW_GST_PEQ_RAMP_STEPS;
+    peq->step[b].b1 = (t[b].b1 - peq->cur[b].b1) / MFW_GST_PEQ_RAMP_STEPS;
+    peq->step[b].b2 = (t[b].b2 - peq->cur[b].b2) / MFW_GST_PEQ_RAMP_STEPS;
+    peq->step[b].a1 = (t[b].a1 - peq->cur[b].a1) / MFW_GST_PEQ_RAMP_STEPS;
+    peq->step[b].a2 = (t[b].a2 - peq->cur[b].a2) / MFW_GST_PEQ_RAMP_STEPS;
+  }
+  peq->ramp = MFW_GST_PEQ_RAMP_STEPS;
+  peq->ramp_frames = 0;
+}
+
+void
+mfw_gst_peq_process (MfwGstPeqEngine * peq, guint8 * data, guint frames)
+{
+  gint bytes = peq->width / 8;
+  gint stride = peq->groups * PEQ_LANES;
+  guint n, off, k;
+  gint b, i;
+
+  while (frames) {
+    n = MIN (frames, MFW_GST_PEQ_BLOCK);
+    peq_to_float (peq, data, n);
+
+    /* a step lasts MFW_GST_PEQ_RAMP_FRAMES frames across calls */
+    for (off = 0; off < n; off += k) {
+      if (peq->ramp && !peq->ramp_frames) {
+        peq_ramp_step (peq);
+        peq->ramp_frames = MFW_GST_PEQ_RAMP_FRAMES;
+      }
+      k = n - off;
+      if (peq->ramp) {
+        k = MIN (k, peq->ramp_frames);
+        peq->ramp_frames -= k;
+      }
+      peq_run (peq, peq->scratch + off * stride, k);
+    }
+
+    peq_from_float (peq, data, n);
+    data += n * peq->channels * bytes;
+    frames -= n;
+  }
+
+  /* decaying state would end in denormals on silence */
+  for (b = 0; b < peq->bands; b++) {
+    for (i = 0; i < stride; i++) {
+      if (fabsf (peq->state[b][0][i]) < PEQ_DENORMAL)
+        peq->state[b][0][i] = 0.0f;
+      if (fabsf (peq->state[b][1][i]) < PEQ_DENORMAL)
+        peq->state[b][1][i] = 0.0f;
+    }
+  }
+  peq_drop_bands (peq);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_peq_engine.h
+ *
+ * Description:    Cascaded biquad parametric equalizer engine
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __MFW_GST_PEQ_ENGINE_H__
+#define __MFW_GST_PEQ_ENGINE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define MFW_GST_PEQ_MAX_BANDS       16
+#define MFW_GST_PEQ_MAX_CHANNELS    8
+#define MFW_GST_PEQ_BLOCK           256 /* frames converted at a time */
+#define MFW_GST_PEQ_RAMP_FRAMES     32  /* frames per coefficient step */
+#define MFW_GST_PEQ_RAMP_STEPS      16  /* steps to reach new coefficients */
+#define MFW_GST_PEQ_PRESETS         23  /* premode 0 ~ 22 */
+
+typedef enum
+{
+  MFW_GST_PEQ_PEAK = 0,
+  MFW_GST_PEQ_LOW_SHELF,
+  MFW_GST_PEQ_HIGH_SHELF,
+} MfwGstPeqFilterType;
+
+/* band parameters, gain and q scaled as in the codec library band list */
+typedef struct
+{
+  gint fc;                      /* center or corner frequency in Hz */
+  gint gain;                    /* 0.1 dB */
+  gint q;                       /* Q * 100 */
+  gint type;                    /* MfwGstPeqFilterType */
+} MfwGstPeqBand;
+
+typedef struct
+{
+  gfloat b0, b1, b2, a1, a2;    /* normalized, a0 = 1 */
+} MfwGstPeqCoef;
+
+typedef struct
+{
+  gint channels;
+  gint width;                   /* 16 or 32 bit samples */
+  gint rate;
+  gint groups;                  /* channels in groups of 4 lanes */
+
+  gint bands;                   /* bands run, identity while ramping out */
+  gint target_bands;
+  gboolean configured;
+  MfwGstPeqCoef cur[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqCoef step[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqCoef target[MFW_GST_PEQ_MAX_BANDS];
+  gint ramp;                    /* steps left */
+  gint ramp_frames;             /* frames left on the current step */
+
+  /* transposed direct form II state, [band][s1/s2][lane] */
+  gfloat state[MFW_GST_PEQ_MAX_BANDS][2][MFW_GST_PEQ_MAX_CHANNELS];
+  gfloat *scratch;              /* MFW_GST_PEQ_BLOCK frames of groups * 4 */
+} MfwGstPeqEngine;
+
+/*!
+ * Set up for interleaved samples, the equalizer starts flat.
+ *
+ * @return  FALSE for an unsupported channel count, width or rate.
+ */
+gboolean mfw_gst_peq_init (MfwGstPeqEngine * peq, gint channels, gint width,
+    gint rate);
+
+void mfw_gst_peq_free (MfwGstPeqEngine * peq);
+
+/*!
+ * Bands of a predefined mode, 0 and 22 (flat) have none.
+ *
+ * @return  number of bands written, at most MFW_GST_PEQ_MAX_BANDS.
+ */
+gint mfw_gst_peq_preset (gint premode, MfwGstPeqBand * bands);
+
+/*!
+ * Coefficients of one band, identity at or above half the rate.
+ */
+void mfw_gst_peq_band_coef (const MfwGstPeqBand * band, gint rate,
+    MfwGstPeqCoef * coef);
+
+/*!
+ * Apply new bands and pre gain (0.1 dB). After the first call, the
+ * coefficients move to the new ones over MFW_GST_PEQ_RAMP_STEPS steps of
+ * MFW_GST_PEQ_RAMP_FRAMES frames, however the stream is split into
+ * buffers, so a change does not click.
+ */
+void mfw_gst_peq_set_bands (MfwGstPeqEngine * peq,
+    const MfwGstPeqBand * bands, gint count, gint pregain);
+
+/*!
+ * Equalize interleaved frames in place.
+ */
+void mfw_gst_peq_process (MfwGstPeqEngine * peq, guint8 * data, guint frames);
+
+G_END_DECLS
+
+#endif /* __MFW_GST_PEQ_ENGINE_H__ */
@@ -0,0 +1,475 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_peq_test.c
+ *
+ * Description:    Checks the equalizer engine against a double precision
+ *                 reference: the designed filters meet their gain at the
+ *                 center frequency or band edge, the measured response of
+ *                 sines run through the engine follows the reference
+ *                 design, the filtered samples follow a double
+ *                 precision filter run on the same coefficients, and a
+ *                 change of bands mid-stream follows a double precision
+ *                 ramp whatever the buffer sizes.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+#include <math.h>
+#include <string.h>
+
+#include "mfw_gst_peq_engine.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+#define PEQ_TEST_ANCHOR_DB      0.01    /* designed gain at fc, DC, Nyquist */
+#define PEQ_TEST_RESPONSE_DB    0.05    /* measured against the reference */
+/* float coefficients round poles close to z = 1, the bottom octave drifts */
+#define PEQ_TEST_BASS_DB        0.15
+#define PEQ_TEST_BASS_HZ        32
+#define PEQ_TEST_SAMPLE_ERROR   2e-4    /* against double filter, full scale */
+#define PEQ_TEST_AMPLITUDE      0.05    /* sines leave room for +12 dB */
+#define PEQ_TEST_PREGAIN        (-60)   /* 0.1 dB */
+#define PEQ_TEST_FRAMES         5000
+#define PEQ_TEST_SEED           0x5eed
+#define PEQ_TEST_RAMP_FRAMES    4000
+#define PEQ_TEST_RAMP_AT        1500    /* frame the bands change at */
+#define PEQ_TEST_RAMP_LEVEL     0.1
+#define PEQ_TEST_STEP_ERROR     2e-4    /* sample to sample, full scale */
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+
+/* magnitude of one biquad at w, in double */
+static gdouble
+peq_test_magnitude (gdouble b0, gdouble b1, gdouble b2, gdouble a1,
+    gdouble a2, gdouble w)
+{
+  gdouble nr = b0 + b1 * cos (w) + b2 * cos (2 * w);
+  gdouble ni = -b1 * sin (w) - b2 * sin (2 * w);
+  gdouble dr = 1 + a1 * cos (w) + a2 * cos (2 * w);
+  gdouble di = -a1 * sin (w) - a2 * sin (2 * w);
+
+  return sqrt ((nr * nr + ni * ni) / (dr * dr + di * di));
+}
+
+static gdouble
+peq_test_db (gdouble magnitude)
+{
+  return 20.0 * log10 (magnitude);
+}
+
+/* reference design of one band, the cookbook filters written out again */
+static gdouble
+peq_test_reference (const MfwGstPeqBand * band, gint rate, gdouble f)
+{
+  gdouble A, w0, cs, alpha, sa, q;
+  gdouble b0, b1, b2, a0, a1, a2;
+
+  if ((band->fc <= 0) || (band->fc * 2 >= rate) || (band->gain == 0))
+    return 1.0;
+
+  q = (band->q > 0) ? band->q / 100.0 : 0.707;
+  A = pow (10.0, band->gain / 400.0);
+  w0 = 2.0 * G_PI * band->fc / rate;
+  cs = cos (w0);
+  alpha = sin (w0) / (2.0 * q);
+  sa = 2.0 * sqrt (A) * alpha;
+
+  switch (band->type) {
+    case MFW_GST_PEQ_LOW_SHELF:
+      b0 = A * ((A + 1) - (A - 1) * cs + sa);
+      b1 = 2 * A * ((A - 1) - (A + 1) * cs);
+      b2 = A * ((A + 1) - (A - 1) * cs - sa);
+      a0 = (A + 1) + (A - 1) * cs + sa;
+      a1 = -2 * ((A - 1) + (A + 1) * cs);
+      a2 = (A + 1) + (A - 1) * cs - sa;
+      break;
+    case MFW_GST_PEQ_HIGH_SHELF:
+      b0 = A * ((A + 1) + (A - 1) * cs + sa);
+      b1 = -2 * A * ((A - 1) + (A + 1) * cs);
+      b2 = A * ((A + 1) + (A - 1) * cs - sa);
+      a0 = (A + 1) - (A - 1) * cs + sa;
+      a1 = 2 * ((A - 1) - (A + 1) * cs);
+      a2 = (A + 1) - (A - 1) * cs - sa;
+      break;
+    default:
+      b0 = 1 + alpha * A;
+      b1 = -2 * cs;
+      b2 = 1 - alpha * A;
+      a0 = 1 + alpha / A;
+      a1 = -2 * cs;
+      a2 = 1 - alpha / A;
+      break;
+  }
+
+  return peq_test_magnitude (b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0,
+      2.0 * G_PI * f / rate);
+}
+
+/* bands of every preset plus shelves and narrow peaks at both ends */
+static gint
+peq_test_bands (gint set, MfwGstPeqBand * bands)
+{
+  static const MfwGstPeqBand extra[] = {
+    {100, 90, 70, MFW_GST_PEQ_LOW_SHELF},
+    {8000, -90, 70, MFW_GST_PEQ_HIGH_SHELF},
+    {40, 120, 400, MFW_GST_PEQ_PEAK},
+    {15000, -120, 400, MFW_GST_PEQ_PEAK},
+  };
+
+  if (set < MFW_GST_PEQ_PRESETS)
+    return mfw_gst_peq_preset (set, bands);
+
+  memcpy (bands, extra, sizeof (extra));
+  return G_N_ELEMENTS (extra);
+}
+
+#define PEQ_TEST_SETS (MFW_GST_PEQ_PRESETS + 1)
+
+/* designed filters reach their gain where the cookbook says they do */
+static gint
+peq_test_anchors (gint rate)
+{
+  MfwGstPeqBand bands[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqCoef c;
+  gint set, b, n, failures = 0;
+  gdouble w, got;
+
+  for (set = 0; set < PEQ_TEST_SETS; set++) {
+    n = peq_test_bands (set, bands);
+    for (b = 0; b < n; b++) {
+      if ((bands[b].gain == 0) || (bands[b].fc * 2 >= rate))
+        continue;
+      mfw_gst_peq_band_coef (&bands[b], rate, &c);
+      switch (bands[b].type) {
+        case MFW_GST_PEQ_LOW_SHELF:
+          w = 0;
+          break;
+        case MFW_GST_PEQ_HIGH_SHELF:
+          w = G_PI;
+          break;
+        default:
+          w = 2.0 * G_PI * bands[b].fc / rate;
+          break;
+      }
+      got = peq_test_db (peq_test_magnitude (c.b0, c.b1, c.b2, c.a1, c.a2, w));
+      if (fabs (got - bands[b].gain / 10.0) > PEQ_TEST_ANCHOR_DB) {
+        g_printerr ("set %d band %d at %d Hz: %.3f dB, want %.1f dB\n", set,
+            b, rate, got, bands[b].gain / 10.0);
+        failures++;
+      }
+    }
+  }
+  return failures;
+}
+
+static void
+peq_test_write (guint8 * data, gint width, gint index, gdouble value)
+{
+  if (width == 16)
+    ((gint16 *) data)[index] = (gint16) lrint (value * 32768.0);
+  else
+    ((gint32 *) data)[index] = (gint32) lrint (value * 2147483648.0);
+}
+
+static gdouble
+peq_test_read (const guint8 * data, gint width, gint index)
+{
+  if (width == 16)
+    return ((const gint16 *) data)[index] / 32768.0;
+  return ((const gint32 *) data)[index] / 2147483648.0;
+}
+
+/*
+ * Run a sine of f through the engine and measure the amplitude of every
+ * channel over a whole number of periods once the filters settled.
+ */
+static gint
+peq_test_sine (MfwGstPeqEngine * peq, const MfwGstPeqBand * bands, gint n,
+    gint f, gdouble * worst)
+{
+  gint rate = peq->rate, channels = peq->channels;
+  gint settle = rate / 4, measure = rate / 4;
+  gint frames = settle + measure;
+  guint8 *data = g_malloc (frames * channels * 4);
+  gdouble want, got, s, c, w = 2.0 * G_PI * f / rate;
+  gint i, ch, b, failures = 0;
+
+  for (i = 0; i < frames; i++)
+    for (ch = 0; ch < channels; ch++)
+      peq_test_write (data, peq->width, i * channels + ch,
+          PEQ_TEST_AMPLITUDE * sin (w * i));
+
+  mfw_gst_peq_process (peq, data, frames);
+
+  want = pow (10.0, PEQ_TEST_PREGAIN / 200.0);
+  for (b = 0; b < n; b++)
+    want *= peq_test_reference (&bands[b], rate, f);
+
+  for (ch = 0; ch < channels; ch++) {
+    s = c = 0;
+    for (i = settle; i < frames; i++) {
+      gdouble y = peq_test_read (data, peq->width, i * channels + ch);
+      s += y * sin (w * i);
+      c += y * cos (w * i);
+    }
+    got = 2.0 * sqrt (s * s + c * c) / measure / PEQ_TEST_AMPLITUDE;
+    got = fabs (peq_test_db (got) - peq_test_db (want));
+    *worst = MAX (*worst, got);
+    if (got > ((f < PEQ_TEST_BASS_HZ) ? PEQ_TEST_BASS_DB :
+            PEQ_TEST_RESPONSE_DB)) {
+      g_printerr ("%d Hz, %d bit, channel %d: off by %.3f dB\n", f,
+          peq->width, ch, got);
+      failures++;
+    }
+  }
+
+  g_free (data);
+  return failures;
+}
+
+/* third octave frequencies rounded to whole periods in rate / 4 frames */
+static gint
+peq_test_response (gint rate, gint channels, gint width)
+{
+  MfwGstPeqBand bands[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqEngine peq;
+  gint set, n, f, failures = 0;
+  gdouble fc, worst = 0;
+
+  for (set = 0; set < PEQ_TEST_SETS; set++) {
+    n = peq_test_bands (set, bands);
+    for (fc = 20.0; fc < rate / 2 - 1000; fc *= pow (2.0, 1.0 / 3)) {
+      f = ((gint) fc + 2) / 4 * 4;
+      mfw_gst_peq_init (&peq, channels, width, rate);
+      mfw_gst_peq_set_bands (&peq, bands, n, PEQ_TEST_PREGAIN);
+      failures += peq_test_sine (&peq, bands, n, f, &worst);
+      mfw_gst_peq_free (&peq);
+    }
+  }
+
+  g_print ("response %d Hz %d ch %d bit: worst %.4f dB\n", rate, channels,
+      width, worst);
+  return failures;
+}
+
+/* the engine against a double precision direct form I run of its own
+   coefficients, for block boundaries, lanes and sample conversion */
+static gint
+peq_test_samples (GRand * rand, gint rate, gint channels, gint width)
+{
+  MfwGstPeqBand bands[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqEngine peq;
+  guint8 *data = g_malloc (PEQ_TEST_FRAMES * channels * 4);
+  gdouble *x = g_new (gdouble, PEQ_TEST_FRAMES * channels);
+  gdouble st[MFW_GST_PEQ_MAX_BANDS][4];
+  gdouble v, o, err, worst = 0;
+  gint set, n, i, ch, b, failures = 0;
+
+  for (set = 0; set < PEQ_TEST_SETS; set++) {
+    n = peq_test_bands (set, bands);
+    mfw_gst_peq_init (&peq, channels, width, rate);
+    mfw_gst_peq_set_bands (&peq, bands, n, PEQ_TEST_PREGAIN);
+
+    for (i = 0; i < PEQ_TEST_FRAMES * channels; i++) {
+      /* channels at different levels to tell the lanes apart */
+      v = g_rand_double_range (rand, -0.25, 0.25) * (i % channels + 1) /
+          channels;
+      peq_test_write (data, width, i, v);
+      x[i] = peq_test_read (data, width, i);
+    }
+
+    /* an odd split crosses the conversion blocks at another point */
+    mfw_gst_peq_process (&peq, data, 1001);
+    mfw_gst_peq_process (&peq, data + 1001 * channels * width / 8,
+        PEQ_TEST_FRAMES - 1001);
+
+    for (ch = 0; ch < channels; ch++) {
+      memset (st, 0, sizeof (st));
+      for (i = 0; i < PEQ_TEST_FRAMES; i++) {
+        v = x[i * channels + ch];
+        for (b = 0; b < peq.bands; b++) {
+          const MfwGstPeqCoef *c = &peq.cur[b];
+          o = c->b0 * v + c->b1 * st[b][0] + c->b2 * st[b][1]
+              - c->a1 * st[b][2] - c->a2 * st[b][3];
+          st[b][1] = st[b][0];
+          st[b][0] = v;
+          st[b][3] = st[b][2];
+          st[b][2] = o;
+          v = o;
+        }
+        err = fabs (peq_test_read (data, width, i * channels + ch) - v);
+        worst = MAX (worst, err);
+      }
+    }
+    mfw_gst_peq_free (&peq);
+  }
+
+  if (worst > PEQ_TEST_SAMPLE_ERROR) {
+    g_printerr ("samples %d Hz %d ch %d bit: error %g\n", rate, channels,
+        width, worst);
+    failures++;
+  }
+  g_free (data);
+  g_free (x);
+  return failures;
+}
+
+/* coefficients at frame f after the change, f < 0 is before it */
+static void
+peq_test_ramp_coef (const MfwGstPeqCoef * from, const MfwGstPeqCoef * to,
+    gint f, gdouble * c)
+{
+  gint s = (f < 0) ? 0 : f / MFW_GST_PEQ_RAMP_FRAMES + 1;
+  gdouble t = (gdouble) MIN (s, MFW_GST_PEQ_RAMP_STEPS) /
+      MFW_GST_PEQ_RAMP_STEPS;
+
+  c[0] = from->b0 + (to->b0 - from->b0) * t;
+  c[1] = from->b1 + (to->b1 - from->b1) * t;
+  c[2] = from->b2 + (to->b2 - from->b2) * t;
+  c[3] = from->a1 + (to->a1 - from->a1) * t;
+  c[4] = from->a2 + (to->a2 - from->a2) * t;
+}
+
+/*
+ * Change the bands mid-stream with the stream cut into buffers of odd
+ * sizes. The change from one sample to the next has to follow a double
+ * precision transposed direct form II run, the form of the engine, with
+ * the coefficients ramped by frame count: the ramp must neither depend on
+ * the buffer sizes nor jump.
+ */
+static gint
+peq_test_ramp (gint rate, gint channels, gint width, gint from_set,
+    gint to_set)
+{
+  static const guint chunks[] = { 1, 7, 31, 32, 33, 5, 300, 2 };
+  MfwGstPeqBand bands[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqCoef from[MFW_GST_PEQ_MAX_BANDS], to[MFW_GST_PEQ_MAX_BANDS];
+  MfwGstPeqEngine peq;
+  guint8 *data = g_malloc (PEQ_TEST_RAMP_FRAMES * channels * 4);
+  gdouble *x = g_new (gdouble, PEQ_TEST_RAMP_FRAMES * channels);
+  gdouble st[MFW_GST_PEQ_MAX_BANDS][2], c[5];
+  gdouble v, y, prev = 0, ref_prev = 0, err, worst = 0;
+  gint i, ch, b, failures = 0;
+  guint done, k, chunk = 0;
+
+  for (i = 0; i < PEQ_TEST_RAMP_FRAMES; i++) {
+    for (ch = 0; ch < channels; ch++) {
+      peq_test_write (data, width, i * channels + ch, PEQ_TEST_RAMP_LEVEL *
+          sin (2.0 * G_PI * (100 + 300 * ch) * i / rate));
+      x[i * channels + ch] = peq_test_read (data, width, i * channels + ch);
+    }
+  }
+
+  mfw_gst_peq_init (&peq, channels, width, rate);
+  mfw_gst_peq_set_bands (&peq, bands, peq_test_bands (from_set, bands),
+      PEQ_TEST_PREGAIN);
+
+  /* the ramp may rewrite bands without poles to the same response */
+  for (done = 0; done < PEQ_TEST_RAMP_FRAMES; done += k) {
+    if (done == PEQ_TEST_RAMP_AT) {
+      mfw_gst_peq_set_bands (&peq, bands, peq_test_bands (to_set, bands), 0);
+      memcpy (from, peq.cur, sizeof (from));
+      memcpy (to, peq.target, sizeof (to));
+    }
+    k = MIN (chunks[chunk++ % G_N_ELEMENTS (chunks)],
+        PEQ_TEST_RAMP_FRAMES - done);
+    if (done < PEQ_TEST_RAMP_AT)
+      k = MIN (k, PEQ_TEST_RAMP_AT - done);
+    mfw_gst_peq_process (&peq, data + done * channels * width / 8, k);
+  }
+
+  /* bands beyond either set are identity on both sides */
+  for (ch = 0; ch < channels; ch++) {
+    memset (st, 0, sizeof (st));
+    for (i = 0; i < PEQ_TEST_RAMP_FRAMES; i++) {
+      v = x[i * channels + ch];
+      for (b = 0; b < MFW_GST_PEQ_MAX_BANDS; b++) {
+        peq_test_ramp_coef (&from[b], &to[b], i - PEQ_TEST_RAMP_AT, c);
+        y = c[0] * v + st[b][0];
+        st[b][0] = c[1] * v - c[3] * y + st[b][1];
+        st[b][1] = c[2] * v - c[4] * y;
+        v = y;
+      }
+      y = peq_test_read (data, width, i * channels + ch);
+      if (i > 0) {
+        err = fabs ((y - prev) - (v - ref_prev));
+        worst = MAX (worst, err);
+      }
+      prev = y;
+      ref_prev = v;
+    }
+  }
+
+  if (worst > PEQ_TEST_STEP_ERROR) {
+    g_printerr ("ramp %d to %d, %d ch %d bit: step error %g\n", from_set,
+        to_set, channels, width, worst);
+    failures++;
+  }
+  mfw_gst_peq_free (&peq);
+  g_free (data);
+  g_free (x);
+  return failures;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const gint rates[] = { 44100, 48000 };
+  GRand *rand = g_rand_new_with_seed (PEQ_TEST_SEED);
+  gint r, ch, width, failures = 0;
+
+  for (r = 0; r < G_N_ELEMENTS (rates); r++) {
+    failures += peq_test_anchors (rates[r]);
+    for (width = 16; width <= 32; width += 16) {
+      failures += peq_test_response (rates[r], 2, width);
+      for (ch = 1; ch <= MFW_GST_PEQ_MAX_CHANNELS; ch++)
+        failures += peq_test_samples (rand, rates[r], ch, width);
+    }
+  }
+  failures += peq_test_response (48000, 6, 16);
+
+  /* more bands, the same count and bands ramped out */
+  for (width = 16; width <= 32; width += 16) {
+    for (ch = 1; ch <= MFW_GST_PEQ_MAX_CHANNELS; ch += 5) {
+      failures += peq_test_ramp (48000, ch, width, 22, 11);
+      failures += peq_test_ramp (48000, ch, width, 16, 3);
+      failures += peq_test_ramp (48000, ch, width, 1, PEQ_TEST_SETS - 1);
+    }
+  }
+
+  g_rand_free (rand);
+  g_print ("%d failures\n", failures);
+  return (failures == 0) ? 0 : 1;
+}
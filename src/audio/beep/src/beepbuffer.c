@@ -0,0 +1,317 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+
+/*
+ * Module Name:    beepbuffer.c
+ *
+ * Description:    Implementation of recycled output buffer pool for unified
+ *                 audio decoder. The buffers are a GstBuffer subclass whose
+ *                 finalize puts them back on the free list of their pool.
+ *                 Memory of the decoder core is recycled the same way.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#include <string.h>
+
+#include "beepbuffer.h"
+
+#define BEEP_TYPE_BUFFER (beep_buffer_get_type ())
+
+typedef struct
+{
+  GstBuffer buffer;
+  BeepBufferPool *pool;
+} BeepBuffer;
+
+struct _BeepBufferPool
+{
+  GMutex *lock;
+  gint refcount;                /* owner and every buffer allocated */
+  gboolean flushing;            /* owner is gone, free on last unref */
+  guint size;
+
+  GSList *free_list;
+  guint free_count;
+};
+
+/* ahead of every core block, keeps the data 8 bytes aligned */
+typedef struct _BeepMemBlock
+{
+  gsize size;
+  struct _BeepMemBlock *next;
+} BeepMemBlock;
+
+static GstMiniObjectClass *beep_buffer_parent_class = NULL;
+
+static GStaticMutex beep_mem_lock = G_STATIC_MUTEX_INIT;
+static BeepMemBlock *beep_mem_free_list = NULL;
+static guint beep_mem_free_count = 0;
+
+
+static void
+beep_buffer_pool_unref (BeepBufferPool * pool)
+{
+  if (g_atomic_int_dec_and_test (&pool->refcount)) {
+    g_mutex_free (pool->lock);
+    g_free (pool);
+  }
+}
+
+static void
+beep_buffer_finalize (BeepBuffer * beepbuf)
+{
+  BeepBufferPool *pool = beepbuf->pool;
+  GstBuffer *buffer = GST_BUFFER_CAST (beepbuf);
+
+  g_mutex_lock (pool->lock);
+  if ((!pool->flushing) && (pool->free_count < BEEP_BUFFER_POOL_MAX_FREE)) {
+    /* back to the pool as if just allocated */
+    gst_caps_replace (&GST_BUFFER_CAPS (buffer), NULL);
+    GST_BUFFER_FLAGS (buffer) = 0;
+    GST_BUFFER_DATA (buffer) = GST_BUFFER_MALLOCDATA (buffer);
+    GST_BUFFER_SIZE (buffer) = pool->size;
+    GST_BUFFER_TIMESTAMP (buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_DURATION (buffer) = GST_CLOCK_TIME_NONE;
+    GST_BUFFER_OFFSET (buffer) = GST_BUFFER_OFFSET_NONE;
+    GST_BUFFER_OFFSET_END (buffer) = GST_BUFFER_OFFSET_NONE;
+
+    pool->free_list = g_slist_prepend (pool->free_list, beepbuf);
+    pool->free_count++;
+    gst_buffer_ref (buffer);
+    g_mutex_unlock (pool->lock);
+    return;
+  }
+  g_mutex_unlock (pool->lock);
+
+  beepbuf->pool = NULL;
+  beep_buffer_pool_unref (pool);
+
+  /* data is released by the GstBuffer finalize */
+  beep_buffer_parent_class->finalize (GST_MINI_OBJECT_CAST (beepbuf));
+}
+
+static void
+beep_buffer_class_init (gpointer g_class, gpointer class_data)
+{
+  GstMiniObjectClass *mini_object_class = GST_MINI_OBJECT_CLASS (g_class);
+
+  beep_buffer_parent_class = g_type_class_peek_parent (g_class);
+  mini_object_class->finalize =
+      (GstMiniObjectFinalizeFunction) beep_buffer_finalize;
+}
+
+static GType
+beep_buffer_get_type (void)
+{
+  static GType beep_buffer_type = 0;
+
+  if (G_UNLIKELY (beep_buffer_type == 0)) {
+    static const GTypeInfo beep_buffer_info = {
+      sizeof (GstBufferClass),
+      NULL,
+      NULL,
+      beep_buffer_class_init,
+      NULL,
+      NULL,
+      sizeof (BeepBuffer),
+      0,
+      NULL,
+      NULL
+    };
+    beep_buffer_type = g_type_register_static (GST_TYPE_BUFFER,
+        "GstBeepBuffer", &beep_buffer_info, 0);
+  }
+  return beep_buffer_type;
+}
+
+
+BeepBufferPool *
+beep_buffer_pool_new (guint size)
+{
+  BeepBufferPool *pool = g_new0 (BeepBufferPool, 1);
+
+  pool->lock = g_mutex_new ();
+  pool->refcount = 1;
+  pool->size = size;
+
+  return pool;
+}
+
+void
+beep_buffer_pool_destroy (BeepBufferPool * pool)
+{
+  GSList *list;
+
+  g_mutex_lock (pool->lock);
+  pool->flushing = TRUE;
+  list = pool->free_list;
+  pool->free_list = NULL;
+  pool->free_count = 0;
+  g_mutex_unlock (pool->lock);
+
+  g_slist_foreach (list, (GFunc) gst_mini_object_unref, NULL);
+  g_slist_free (list);
+
+  beep_buffer_pool_unref (pool);
+}
+
+guint
+beep_buffer_pool_get_size (BeepBufferPool * pool)
+{
+  return pool->size;
+}
+
+GstBuffer *
+beep_buffer_pool_get (BeepBufferPool * pool)
+{
+  BeepBuffer *beepbuf = NULL;
+  GstBuffer *buffer;
+
+  g_mutex_lock (pool->lock);
+  if (pool->free_list) {
+    beepbuf = (BeepBuffer *) pool->free_list->data;
+    pool->free_list = g_slist_delete_link (pool->free_list, pool->free_list);
+    pool->free_count--;
+  }
+  g_mutex_unlock (pool->lock);
+
+  if (beepbuf)
+    return GST_BUFFER_CAST (beepbuf);
+
+  beepbuf = (BeepBuffer *) gst_mini_object_new (BEEP_TYPE_BUFFER);
+  buffer = GST_BUFFER_CAST (beepbuf);
+  GST_BUFFER_MALLOCDATA (buffer) = GST_BUFFER_DATA (buffer) =
+      g_malloc (pool->size);
+  GST_BUFFER_SIZE (buffer) = pool->size;
+
+  g_atomic_int_inc (&pool->refcount);
+  beepbuf->pool = pool;
+
+  return buffer;
+}
+
+
+gpointer
+beep_buffer_mem_alloc (guint size)
+{
+  BeepMemBlock *block, **link;
+
+  if (size == 0)
+    return NULL;
+
+  /* first idle block that fits without wasting more than half */
+  g_static_mutex_lock (&beep_mem_lock);
+  for (link = &beep_mem_free_list; (block = *link); link = &block->next) {
+    if ((block->size >= size) && (block->size / 2 <= size)) {
+      *link = block->next;
+      beep_mem_free_count--;
+      break;
+    }
+  }
+  g_static_mutex_unlock (&beep_mem_lock);
+
+  if (block == NULL) {
+    block = g_try_malloc (sizeof (BeepMemBlock) + size);
+    if (block == NULL)
+      return NULL;
+    block->size = size;
+  }
+
+  return block + 1;
+}
+
+gpointer
+beep_buffer_mem_calloc (guint num, guint size)
+{
+  gpointer ptr = beep_buffer_mem_alloc (num * size);
+
+  if (ptr)
+    memset (ptr, 0, num * size);
+  return ptr;
+}
+
+gpointer
+beep_buffer_mem_realloc (gpointer ptr, guint size)
+{
+  BeepMemBlock *block;
+  gpointer newptr;
+
+  if (ptr == NULL)
+    return beep_buffer_mem_alloc (size);
+
+  if (size == 0) {
+    beep_buffer_mem_free (ptr);
+    return NULL;
+  }
+
+  block = (BeepMemBlock *) ptr - 1;
+  if (block->size >= size)
+    return ptr;
+
+  newptr = beep_buffer_mem_alloc (size);
+  if (newptr) {
+    memcpy (newptr, ptr, block->size);
+    beep_buffer_mem_free (ptr);
+  }
+  return newptr;
+}
+
+void
+beep_buffer_mem_free (gpointer ptr)
+{
+  BeepMemBlock *block;
+
+  if (ptr == NULL)
+    return;
+
+  block = (BeepMemBlock *) ptr - 1;
+  if (block->size <= BEEP_BUFFER_MEM_MAX_CACHED) {
+    g_static_mutex_lock (&beep_mem_lock);
+    if (beep_mem_free_count < BEEP_BUFFER_MEM_MAX_FREE) {
+      block->next = beep_mem_free_list;
+      beep_mem_free_list = block;
+      beep_mem_free_count++;
+      block = NULL;
+    }
+    g_static_mutex_unlock (&beep_mem_lock);
+  }
+
+  g_free (block);
+}
+
+GstBuffer *
+beep_buffer_mem_wrap (gpointer ptr, guint size)
+{
+  GstBuffer *buffer = gst_buffer_new ();
+
+  GST_BUFFER_MALLOCDATA (buffer) = GST_BUFFER_DATA (buffer) = ptr;
+  GST_BUFFER_SIZE (buffer) = size;
+  GST_BUFFER_FREE_FUNC (buffer) = beep_buffer_mem_free;
+
+  return buffer;
+}
@@ -0,0 +1,80 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+
+
+/*
+ * Module Name:    beepbuffer.h
+ *
+ * Description:    Head file of recycled output buffer pool and core memory
+ *                 for unified audio decoder
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+
+#ifndef __BEEPBUFFER_H__
+#define __BEEPBUFFER_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define BEEP_BUFFER_POOL_MAX_FREE   (16)        /* idle buffers kept */
+#define BEEP_BUFFER_MEM_MAX_FREE    (16)        /* idle core blocks kept */
+#define BEEP_BUFFER_MEM_MAX_CACHED  (256 * 1024)        /* larger ones are freed */
+
+typedef struct _BeepBufferPool BeepBufferPool;
+
+/*
+ * Pool of output buffers with size bytes of data each. A buffer goes back
+ * to the pool when its last reference is dropped, buffers still held
+ * downstream when the pool is destroyed are freed on their last unref.
+ */
+BeepBufferPool *beep_buffer_pool_new (guint size);
+void beep_buffer_pool_destroy (BeepBufferPool * pool);
+
+guint beep_buffer_pool_get_size (BeepBufferPool * pool);
+
+/* writable buffer of the pool size, no caps and no timestamp */
+GstBuffer *beep_buffer_pool_get (BeepBufferPool * pool);
+
+/*
+ * Memory ops for the decoder core. A freed block is kept for the next
+ * allocation of about its size, so the output block of every frame is
+ * reused instead of going back to the heap.
+ */
+gpointer beep_buffer_mem_alloc (guint size);
+gpointer beep_buffer_mem_calloc (guint num, guint size);
+gpointer beep_buffer_mem_realloc (gpointer ptr, guint size);
+void beep_buffer_mem_free (gpointer ptr);
+
+/* buffer owning a core block, the block is recycled on the last unref */
+GstBuffer *beep_buffer_mem_wrap (gpointer ptr, guint size);
+
+G_END_DECLS
+
+#endif /* __BEEPBUFFER_H__ */
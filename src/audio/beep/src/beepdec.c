@@ -68,6 +68,8 @@
 
 #define BEEP_TIMEDIFF_DEFAULT_MS (1500)
 
+#define BEEP_MERGE_FRAMES_MAX (16)    /* decoded frames merged in one push */
+
 #define AUDIO_BYTES2SAMPLE(bytes, width, channels) \
   ( ((width) && (channels)) ? (bytes*8/width/channels) : 0)
 
@@ -89,6 +91,7 @@ enum
   PROP_RESYNC_THRESHOLD,
   PROP_RESET_WHEN_RESYNC,
   PROP_SET_OUTPUT_LAYOUT,
+  PROP_PUSH_LATENCY,
 };
 
 
@@ -127,6 +130,11 @@ static GstsutilsOptionEntry g_beepdec_option_table[] = {
         "enable/disable reset when resync",
         G_TYPE_BOOLEAN, G_STRUCT_OFFSET (BeepDecOption, reset_when_resync),
       "true"},
+  {PROP_PUSH_LATENCY, "push-latency", "push latency",
+        "max duration in ns of decoded audio merged into one push: 0, push every frame",
+        G_TYPE_INT64,
+        G_STRUCT_OFFSET (BeepDecOption, push_latency), "20000000", "0",
+      G_MAXINT64_STR},
 
   {-1, NULL, NULL, NULL, 0, 0, NULL}
 };
@@ -151,41 +159,29 @@ static BeepGTypeMap beep_gtype_maps[GST_BEEP_SUBELEMENT_MAX] =
     { {G_TYPE_INVALID, {0}, NULL} };
 
 
+/* core memory is recycled, output blocks are pushed without a copy */
 static void *
 beepdec_core_mem_alloc (uint32 size)
 {
-  void *ret = NULL;
-  if (size) {
-    ret = MM_MALLOC (size);
-  }
-  return ret;
+  return beep_buffer_mem_alloc (size);
 }
 
 static void
 beepdec_core_mem_free (void *ptr)
 {
-  MM_FREE (ptr);
+  beep_buffer_mem_free (ptr);
 }
 
 static void *
 beepdec_core_mem_calloc (uint32 numElements, uint32 size)
 {
-  uint32 alloc_size = size * numElements;
-  void *ret = NULL;
-  if (alloc_size) {
-    ret = MM_MALLOC (alloc_size);
-    if (ret) {
-      memset (ret, 0, alloc_size);
-    }
-  }
-  return ret;
+  return beep_buffer_mem_calloc (numElements, size);
 }
 
 static void *
 beepdec_core_mem_realloc (void *ptr, uint32 size)
 {
-  void *ret = MM_REALLOC (ptr, size);
-  return ret;
+  return beep_buffer_mem_realloc (ptr, size);
 }
 
 
@@ -795,6 +791,177 @@ error:
 }
 
 
+static GstFlowReturn
+gst_beepdec_push_pending (GstBeepDec * beepdec)
+{
+  GstBuffer *gstbuf = beepdec->pending;
+
+  if (gstbuf == NULL)
+    return GST_FLOW_OK;
+
+  beepdec->pending = NULL;
+  GST_BUFFER_SIZE (gstbuf) = beepdec->pending_size;
+
+  GST_LOG ("push sample %" GST_TIME_FORMAT " size %d",
+      GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (gstbuf)), GST_BUFFER_SIZE (gstbuf));
+
+  return gst_pad_push (beepdec->srcpad, gstbuf);
+}
+
+static void
+gst_beepdec_drop_pending (GstBeepDec * beepdec)
+{
+  if (beepdec->pending) {
+    gst_buffer_unref (beepdec->pending);
+    beepdec->pending = NULL;
+  }
+}
+
+static void
+gst_beepdec_release_pool (GstBeepDec * beepdec)
+{
+  if (beepdec->pool) {
+    beep_buffer_pool_destroy (beepdec->pool);
+    beepdec->pool = NULL;
+  }
+}
+
+/* a live source can not take the latency of merged pushes */
+static gboolean
+gst_beepdec_upstream_live (GstBeepDec * beepdec)
+{
+  GstQuery *query = gst_query_new_latency ();
+  gboolean live = FALSE;
+
+  if (gst_pad_peer_query (beepdec->sinkpad, query))
+    gst_query_parse_latency (query, &live, NULL, NULL);
+  gst_query_unref (query);
+
+  GST_INFO ("Upstream is %slive", live ? "" : "not ");
+  return live;
+}
+
+/* room for as many of the largest frames as fit in the push latency, 0 if
+   not more than one fits */
+static guint
+gst_beepdec_pool_size (GstBeepDec * beepdec)
+{
+  UniAcodecOutputPCMFormat *oformat = &beepdec->outputformat;
+  guint64 window;
+  guint frames;
+
+  if ((beepdec->live) || (beepdec->options.push_latency <= 0))
+    return 0;
+
+  window = gst_util_uint64_scale (beepdec->options.push_latency,
+      (guint64) oformat->samplerate * oformat->channels * oformat->width / 8,
+      GST_SECOND);
+  frames = MIN (window / beepdec->frame_max, BEEP_MERGE_FRAMES_MAX);
+  return (frames > 1) ? beepdec->frame_max * frames : 0;
+}
+
+/* takes obuf, it is pushed as it is when frames are not merged */
+static GstFlowReturn
+gst_beepdec_output (GstBeepDec * beepdec, uint8 * obuf, uint32 osize)
+{
+  GstFlowReturn ret;
+  GstBuffer *gstbuf;
+  gint samples;
+  GstClockTime duration;
+  guint size;
+
+  if (osize == 0) {
+    beepdec_core_mem_free (obuf);
+    return GST_FLOW_OK;
+  }
+
+  samples =
+      AUDIO_BYTES2SAMPLE (osize, beepdec->outputformat.width,
+      beepdec->outputformat.channels);
+  duration =
+      gst_util_uint64_scale (GST_SECOND, (guint64) samples,
+      (guint64) beepdec->outputformat.samplerate);
+
+  /* do not merge over a resync gap or beyond the pooled size */
+  if ((gstbuf = beepdec->pending)) {
+    if ((GST_BUFFER_TIMESTAMP_IS_VALID (gstbuf)
+            && (GST_BUFFER_TIMESTAMP (gstbuf) + GST_BUFFER_DURATION (gstbuf) !=
+                beepdec->time_offset))
+        || (beepdec->pending_size + osize > GST_BUFFER_SIZE (gstbuf))) {
+      ret = gst_beepdec_push_pending (beepdec);
+      if ((ret != GST_FLOW_OK) && (ret != GST_FLOW_NOT_LINKED)) {
+        beepdec_core_mem_free (obuf);
+        return ret;
+      }
+    }
+  }
+
+  if (osize > beepdec->frame_max) {
+    GST_INFO ("Output frame size %d", osize);
+    ret = gst_beepdec_push_pending (beepdec);
+    if ((ret != GST_FLOW_OK) && (ret != GST_FLOW_NOT_LINKED)) {
+      beepdec_core_mem_free (obuf);
+      return ret;
+    }
+    beepdec->frame_max = osize;
+    gst_beepdec_release_pool (beepdec);
+  }
+
+  if ((beepdec->pool == NULL) && (size = gst_beepdec_pool_size (beepdec)))
+    beepdec->pool = beep_buffer_pool_new (size);
+
+  if (beepdec->pool == NULL) {
+    /* nothing to merge with, the core block goes downstream */
+    gstbuf = beep_buffer_mem_wrap (obuf, osize);
+    GST_BUFFER_DURATION (gstbuf) = duration;
+    if (beepdec->new_buffer_timestamp) {
+      GST_BUFFER_TIMESTAMP (gstbuf) = beepdec->time_offset;
+      beepdec->new_buffer_timestamp = FALSE;
+    }
+    if (beepdec->options.resync_threshold >= 0) {
+      GST_BUFFER_TIMESTAMP (gstbuf) = beepdec->time_offset;
+    }
+    gst_buffer_set_caps (gstbuf, GST_PAD_CAPS (beepdec->srcpad));
+
+    beepdec->decoder_stat.uncompressed_samples += samples;
+    beepdec->time_offset += duration;
+
+    GST_LOG ("push sample %" GST_TIME_FORMAT " size %d",
+        GST_TIME_ARGS (GST_BUFFER_TIMESTAMP (gstbuf)), osize);
+    return gst_pad_push (beepdec->srcpad, gstbuf);
+  }
+
+  if ((gstbuf = beepdec->pending) == NULL) {
+    gstbuf = beepdec->pending = beep_buffer_pool_get (beepdec->pool);
+    beepdec->pending_size = 0;
+    GST_BUFFER_DURATION (gstbuf) = 0;
+    if (beepdec->new_buffer_timestamp) {
+      GST_BUFFER_TIMESTAMP (gstbuf) = beepdec->time_offset;
+      beepdec->new_buffer_timestamp = FALSE;
+    }
+    if (beepdec->options.resync_threshold >= 0) {
+      GST_BUFFER_TIMESTAMP (gstbuf) = beepdec->time_offset;
+    }
+    gst_buffer_set_caps (gstbuf, GST_PAD_CAPS (beepdec->srcpad));
+  }
+
+  memcpy (GST_BUFFER_DATA (gstbuf) + beepdec->pending_size, obuf, osize);
+  beepdec_core_mem_free (obuf);
+  beepdec->pending_size += osize;
+  GST_BUFFER_DURATION (gstbuf) += duration;
+
+  beepdec->decoder_stat.uncompressed_samples += samples;
+  beepdec->time_offset += duration;
+
+  if ((GST_BUFFER_DURATION (gstbuf) >= beepdec->options.push_latency)
+      || (beepdec->pending_size + beepdec->frame_max >
+          GST_BUFFER_SIZE (gstbuf))) {
+    return gst_beepdec_push_pending (beepdec);
+  }
+  return GST_FLOW_OK;
+}
+
+
 static GstFlowReturn
 gst_beepdec_chain (GstPad * pad, GstBuffer * buffer)
 {
@@ -899,8 +1066,16 @@ gst_beepdec_chain (GstPad * pad, GstBuffer * buffer)
           beepdec->handle, UNIA_OUTPUT_PCM_FORMAT, &parameter);
       if (memcmp (&parameter.outputFormat, &beepdec->outputformat,
               sizeof (UniAcodecOutputPCMFormat))) {
+        GstCaps *caps;
+        GstFlowReturn flow = gst_beepdec_push_pending (beepdec);
+        if ((flow != GST_FLOW_OK) && (flow != GST_FLOW_NOT_LINKED)) {
+          ret = flow;
+          goto bail;
+        }
+        gst_beepdec_release_pool (beepdec);
+        beepdec->live = gst_beepdec_upstream_live (beepdec);
         beepdec->outputformat = parameter.outputFormat;
-        GstCaps *caps = beepdec_outputformat_to_caps (beepdec);
+        caps = beepdec_outputformat_to_caps (beepdec);
         if (caps) {
           GST_INFO ("Set new srcpad caps %" GST_PTR_FORMAT, caps);
           gst_pad_set_caps (beepdec->srcpad, caps);
@@ -947,41 +1122,13 @@ gst_beepdec_chain (GstPad * pad, GstBuffer * buffer)
     }
 
     if (obuf) {
-      GstBuffer *gstbuf = gst_buffer_new ();
-      gint samples;
-      GstClockTime duration;
-      samples =
-          AUDIO_BYTES2SAMPLE (osize, beepdec->outputformat.width,
-          beepdec->outputformat.channels);
-
-      beepdec->decoder_stat.uncompressed_samples += samples;
-      duration =
-          gst_util_uint64_scale (GST_SECOND, (guint64) samples,
-          (guint64) beepdec->outputformat.samplerate);
-
-      GST_BUFFER_MALLOCDATA (gstbuf) = GST_BUFFER_DATA (gstbuf) = obuf;
-      GST_BUFFER_SIZE (gstbuf) = osize;
-      GST_BUFFER_DURATION (gstbuf) = duration;
-      GST_BUFFER_FREE_FUNC (gstbuf) = beepdec_core_mem_free;
-      if (beepdec->new_buffer_timestamp) {
-        GST_BUFFER_TIMESTAMP (gstbuf) = beepdec->time_offset;
-        beepdec->new_buffer_timestamp = FALSE;
-      }
-      if (beepdec->options.resync_threshold >= 0) {
-        GST_BUFFER_TIMESTAMP (gstbuf) = beepdec->time_offset;
-      }
-      gst_buffer_set_caps (gstbuf, GST_PAD_CAPS (beepdec->srcpad));
-
-      GST_LOG("push sample %"GST_TIME_FORMAT" size %d", GST_TIME_ARGS(GST_BUFFER_TIMESTAMP(gstbuf)), GST_BUFFER_SIZE(gstbuf));
-
-      if ((ret = gst_pad_push (beepdec->srcpad, gstbuf)) != GST_FLOW_OK) {
+      ret = gst_beepdec_output (beepdec, obuf, osize);
+      if (ret != GST_FLOW_OK) {
         GST_DEBUG ("Pad push failed, error = %d", ret);
         if (ret != GST_FLOW_NOT_LINKED) {
           goto bail;
         }
       }
-      beepdec->time_offset += duration;
-
     }
   } while (((status != ACODEC_NOT_ENOUGH_DATA)
           && (status != ACODEC_END_OF_STREAM) && (((inbuf_size)
@@ -1033,6 +1180,10 @@ gst_beepdec_state_change (GstElement * element, GstStateChange transition)
       memset (&beepdec->tp_stat, 0, sizeof (BeepTimeProfileStat));
 #endif
       beepdec->err_cnt = 0;
+      beepdec->pool = NULL;
+      beepdec->pending = NULL;
+      beepdec->frame_max = 0;
+      beepdec->live = FALSE;
       if (gst_pad_check_pull_range (beepdec->sinkpad)) {
         GstPad *peer_pad = NULL;
         GstFormat fmt = GST_FORMAT_BYTES;
@@ -1056,6 +1207,8 @@ gst_beepdec_state_change (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_READY_TO_NULL:
       break;
     case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_beepdec_drop_pending (beepdec);
+      gst_beepdec_release_pool (beepdec);
       beepdec_core_close (beepdec);
       MM_DEINIT_DBG_MEM ();
 #ifdef MFW_TIME_PROFILE
@@ -1081,6 +1234,7 @@ gst_beepdec_sink_event (GstPad * pad, GstEvent * event)
     case GST_EVENT_NEWSEGMENT:
     {
       GstFormat format = GST_FORMAT_TIME;
+      gst_beepdec_push_pending (beepdec);
       event = gst_beepdec_convert_segment (beepdec, event, &format);
       if (format == GST_FORMAT_TIME) {
         gint64 start, stop, position;
@@ -1099,6 +1253,7 @@ gst_beepdec_sink_event (GstPad * pad, GstEvent * event)
     case GST_EVENT_FLUSH_STOP:
     {
       uint32 core_ret;
+      gst_beepdec_drop_pending (beepdec);
       CORE_API (beepdec->beep_interface, resetDecoder, goto bail, core_ret,
           beepdec->handle);
       ret = gst_pad_event_default (pad, event);
@@ -1108,6 +1263,7 @@ gst_beepdec_sink_event (GstPad * pad, GstEvent * event)
     {
       GST_INFO ("EOS received");
       gst_beepdec_chain (pad, NULL);
+      gst_beepdec_push_pending (beepdec);
       ret = gst_pad_event_default (pad, event);
       break;
     }
@@ -46,6 +46,7 @@
 #include "fsl_unia.h"
 
 #include "beepregistry.h"
+#include "beepbuffer.h"
 
 #include "mfw_gst_utils.h"
 
@@ -66,6 +67,7 @@ typedef struct
   gint64 resync_threshold;
   gboolean reset_when_resync;
   gboolean set_layout;
+  gint64 push_latency;
 } BeepDecOption;
 
 typedef struct
@@ -111,6 +113,14 @@ struct _GstBeepDec
   UniACodec_Handle handle;
   gint err_cnt;
 
+  /* decoded frames are copied into a pooled buffer and pushed together,
+     without a pool the core blocks are pushed as they are */
+  BeepBufferPool *pool;
+  GstBuffer *pending;
+  guint pending_size;
+  guint frame_max;              /* largest decoded frame seen */
+  gboolean live;                /* upstream answers the latency query live */
+
   BeepDecStat decoder_stat;
   BeepDecOption options;
 #ifdef MFW_TIME_PROFILE
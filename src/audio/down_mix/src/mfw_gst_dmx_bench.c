@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_dmx_bench.c
+ *
+ * Description:    Downmix throughput of the vector and the scalar path, as
+ *                 channels processed per ms of CPU time, for the usual
+ *                 decoder layouts into stereo. Usage: mfw_gst_dmx_bench
+ *                 [seconds of 48 kHz audio, default 10]
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+#include <stdlib.h>
+
+#include "mfw_gst_dmx_engine.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+#define DMX_BENCH_RATE      48000
+#define DMX_BENCH_SECONDS   10
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+typedef void (*DmxBenchFunc) (const MfwGstDmxEngine * dmx, const guint8 * in,
+    guint8 * out, guint frames);
+
+/* channels per ms */
+static gdouble
+dmx_bench_run (DmxBenchFunc func, const MfwGstDmxEngine * dmx,
+    const guint8 * in, guint8 * out, guint frames)
+{
+  GTimer *timer = g_timer_new ();
+  gdouble ms;
+
+  func (dmx, in, out, frames);
+  ms = g_timer_elapsed (timer, NULL) * 1000.0;
+  g_timer_destroy (timer);
+
+  return (ms > 0) ? ((gdouble) frames * dmx->in_channels / ms) : 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const gint layouts[] = { 2, 4, 6, 8 };
+  MfwGstDmxGains gains = { MFW_GST_DMX_DEFAULT_CENTER_GAIN,
+    MFW_GST_DMX_DEFAULT_SURROUND_GAIN, MFW_GST_DMX_DEFAULT_LFE_GAIN, TRUE
+  };
+  MfwGstDmxEngine dmx;
+  GRand *rand;
+  guint8 *in, *out;
+  guint frames, i, size;
+  gint seconds = DMX_BENCH_SECONDS, width, n;
+
+  if (argc > 1)
+    seconds = MAX (atoi (argv[1]), 1);
+  frames = DMX_BENCH_RATE * seconds;
+
+  size = frames * MFW_GST_DMX_MAX_CHANNELS * 4;
+  in = g_malloc (size);
+  out = g_malloc (frames * 2 * 4);
+  rand = g_rand_new_with_seed (0);
+  for (i = 0; i < size; i++)
+    in[i] = (guint8) g_rand_int (rand);
+  g_rand_free (rand);
+
+  g_print ("%d s of %d Hz audio into stereo, channels per ms\n", seconds,
+      DMX_BENCH_RATE);
+  g_print ("%-6s %-6s %12s %12s %8s\n", "width", "in", "process", "reference",
+      "speedup");
+  for (width = 16; width <= 32; width += 16) {
+    for (n = 0; n < G_N_ELEMENTS (layouts); n++) {
+      gdouble fast, ref;
+
+      mfw_gst_dmx_init (&dmx, layouts[n], 2, width, &gains);
+      fast = dmx_bench_run (mfw_gst_dmx_process, &dmx, in, out, frames);
+      ref = dmx_bench_run (mfw_gst_dmx_process_ref, &dmx, in, out, frames);
+      g_print ("%-6d %-6d %12.0f %12.0f %8.2f\n", width, layouts[n], fast, ref,
+          (ref > 0) ? fast / ref : 0);
+    }
+  }
+
+  g_free (in);
+  g_free (out);
+  return 0;
+}
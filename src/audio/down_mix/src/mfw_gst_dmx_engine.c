@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_dmx_engine.c
+ *
+ * Description:    Fixed point channel downmix engine. A Q13 matrix is built
+ *                 from the channel layouts and gains, every output sample
+ *                 is a rounded and saturated dot product of the input frame
+ *                 with one matrix row.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+#include <string.h>
+
+#if defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "mfw_gst_dmx_engine.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+#define DMX_ONE     (1 << MFW_GST_DMX_COEF_SHIFT)
+#define DMX_ROUND   (1 << (MFW_GST_DMX_COEF_SHIFT - 1))
+#define DMX_HALF_SQRT2 0.7071f
+
+enum
+{
+  DMX_FL,
+  DMX_FR,
+  DMX_FC,
+  DMX_LFE,
+  DMX_RL,
+  DMX_RR,
+  DMX_SL,
+  DMX_SR,
+  DMX_RC,
+};
+
+/*=============================================================================
+                            LOCAL VARIABLES
+=============================================================================*/
+static const gint dmx_layouts[MFW_GST_DMX_MAX_CHANNELS + 1]
+    [MFW_GST_DMX_MAX_CHANNELS] = {
+  {0},
+  {DMX_FC},
+  {DMX_FL, DMX_FR},
+  {DMX_FL, DMX_FR, DMX_LFE},
+  {DMX_FL, DMX_FR, DMX_RL, DMX_RR},
+  {DMX_FL, DMX_FR, DMX_RL, DMX_RR, DMX_FC},
+  {DMX_FL, DMX_FR, DMX_RL, DMX_RR, DMX_FC, DMX_LFE},
+  {DMX_FL, DMX_FR, DMX_RL, DMX_RR, DMX_FC, DMX_LFE, DMX_RC},
+  {DMX_FL, DMX_FR, DMX_RL, DMX_RR, DMX_FC, DMX_LFE, DMX_SL, DMX_SR},
+};
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+static gint
+dmx_find (gint channels, gint pos)
+{
+  gint i;
+
+  for (i = 0; i < channels; i++) {
+    if (dmx_layouts[channels][i] == pos)
+      return i;
+  }
+  return -1;
+}
+
+static void
+dmx_add (gfloat m[][MFW_GST_DMX_MAX_CHANNELS], gint out_channels, gint pos,
+    gint in, gfloat gain)
+{
+  gint o = dmx_find (out_channels, pos);
+
+  if (o >= 0)
+    m[o][in] += gain;
+}
+
+/* channels missing in the output layout are folded into the nearest ones */
+static void
+dmx_route (gfloat m[][MFW_GST_DMX_MAX_CHANNELS], gint in_channels,
+    gint out_channels, const MfwGstDmxGains * g)
+{
+  gint i, pos, o;
+  gfloat gain;
+
+  for (i = 0; i < in_channels; i++) {
+    pos = dmx_layouts[in_channels][i];
+    if ((o = dmx_find (out_channels, pos)) >= 0) {
+      m[o][i] += 1.0f;
+      continue;
+    }
+    switch (pos) {
+      case DMX_FC:
+        /* a mono source keeps its level on both sides */
+        gain = (dmx_find (in_channels, DMX_FL) >= 0) ? g->center_gain : 1.0f;
+        dmx_add (m, out_channels, DMX_FL, i, gain);
+        dmx_add (m, out_channels, DMX_FR, i, gain);
+        break;
+      case DMX_LFE:
+        dmx_add (m, out_channels, DMX_FL, i, g->lfe_gain);
+        dmx_add (m, out_channels, DMX_FR, i, g->lfe_gain);
+        break;
+      case DMX_RL:
+        dmx_add (m, out_channels, DMX_FL, i, g->surround_gain);
+        break;
+      case DMX_RR:
+        dmx_add (m, out_channels, DMX_FR, i, g->surround_gain);
+        break;
+      case DMX_SL:
+        if (dmx_find (out_channels, DMX_RL) >= 0)
+          dmx_add (m, out_channels, DMX_RL, i, 1.0f);
+        else
+          dmx_add (m, out_channels, DMX_FL, i, g->surround_gain);
+        break;
+      case DMX_SR:
+        if (dmx_find (out_channels, DMX_RR) >= 0)
+          dmx_add (m, out_channels, DMX_RR, i, 1.0f);
+        else
+          dmx_add (m, out_channels, DMX_FR, i, g->surround_gain);
+        break;
+      case DMX_RC:
+        if (dmx_find (out_channels, DMX_RL) >= 0) {
+          dmx_add (m, out_channels, DMX_RL, i, DMX_HALF_SQRT2);
+          dmx_add (m, out_channels, DMX_RR, i, DMX_HALF_SQRT2);
+        } else {
+          gain = g->surround_gain * DMX_HALF_SQRT2;
+          dmx_add (m, out_channels, DMX_FL, i, gain);
+          dmx_add (m, out_channels, DMX_FR, i, gain);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+static inline gint16
+dmx_sat16 (gint32 v)
+{
+  if (v > G_MAXINT16)
+    return G_MAXINT16;
+  if (v < G_MININT16)
+    return G_MININT16;
+  return (gint16) v;
+}
+
+static inline gint32
+dmx_sat32 (gint64 v)
+{
+  if (v > G_MAXINT32)
+    return G_MAXINT32;
+  if (v < G_MININT32)
+    return G_MININT32;
+  return (gint32) v;
+}
+
+#if defined(__ARM_NEON__) || defined(__SSE2__)
+/*
+ * Every frame is loaded as 8 samples with zero coefficients past the last
+ * channel, a group of 4 dot products (4 / out_channels frames) is reduced
+ * and narrowed together. Returns the frames done, the rest is left to the
+ * scalar code, including the last frames whose load would pass the end.
+ */
+static guint
+dmx_process_s16_simd (const MfwGstDmxEngine * dmx, const gint16 * in,
+    gint16 * out, guint frames)
+{
+  gint ic = dmx->in_channels;
+  gint oc = dmx->out_channels;
+  guint step = 4 / oc;
+  guint done = 0;
+  gint k;
+
+  if ((4 % oc) || (frames < step))
+    return 0;
+
+#if defined(__ARM_NEON__)
+  {
+    int16x8_t coef[4];
+
+    for (k = 0; k < oc; k++)
+      coef[k] = vld1q_s16 (dmx->coef[k]);
+
+    for (; ((done + step - 1) * ic + 8 <= frames * ic)
+        && (done + step <= frames); done += step) {
+      int32x2_t x[4];
+
+      for (k = 0; k < 4; k++) {
+        int16x8_t v = vld1q_s16 (in + (done + k / oc) * ic);
+        int32x4_t p = vmull_s16 (vget_low_s16 (v),
+            vget_low_s16 (coef[k % oc]));
+        p = vmlal_s16 (p, vget_high_s16 (v), vget_high_s16 (coef[k % oc]));
+        x[k] = vadd_s32 (vget_low_s32 (p), vget_high_s32 (p));
+      }
+      vst1_s16 (out + done * oc,
+          vqrshrn_n_s32 (vcombine_s32 (vpadd_s32 (x[0], x[1]),
+                  vpadd_s32 (x[2], x[3])), MFW_GST_DMX_COEF_SHIFT));
+    }
+  }
+#else
+  {
+    __m128i coef[4];
+    const __m128i round = _mm_set1_epi32 (DMX_ROUND);
+
+    for (k = 0; k < oc; k++)
+      coef[k] = _mm_loadu_si128 ((const __m128i *) dmx->coef[k]);
+
+    for (; ((done + step - 1) * ic + 8 <= frames * ic)
+        && (done + step <= frames); done += step) {
+      __m128i x[4], s0, s1;
+
+      for (k = 0; k < 4; k++) {
+        __m128i v = _mm_loadu_si128 ((const __m128i *)
+            (in + (done + k / oc) * ic));
+        x[k] = _mm_madd_epi16 (v, coef[k % oc]);
+      }
+      /* transpose and add, lane k holds dot product k */
+      s0 = _mm_add_epi32 (_mm_unpacklo_epi32 (x[0], x[1]),
+          _mm_unpackhi_epi32 (x[0], x[1]));
+      s1 = _mm_add_epi32 (_mm_unpacklo_epi32 (x[2], x[3]),
+          _mm_unpackhi_epi32 (x[2], x[3]));
+      s0 = _mm_add_epi32 (_mm_unpacklo_epi64 (s0, s1),
+          _mm_unpackhi_epi64 (s0, s1));
+      s0 = _mm_srai_epi32 (_mm_add_epi32 (s0, round), MFW_GST_DMX_COEF_SHIFT);
+      _mm_storel_epi64 ((__m128i *) (out + done * oc),
+          _mm_packs_epi32 (s0, s0));
+    }
+  }
+#endif
+
+  return done;
+}
+#endif
+
+/*=============================================================================
+                            GLOBAL FUNCTIONS
+=============================================================================*/
+
+gboolean
+mfw_gst_dmx_init (MfwGstDmxEngine * dmx, gint in_channels, gint out_channels,
+    gint width, const MfwGstDmxGains * gains)
+{
+  gfloat m[MFW_GST_DMX_MAX_CHANNELS][MFW_GST_DMX_MAX_CHANNELS];
+  MfwGstDmxGains g = *gains;
+  gfloat sum;
+  gint o, i, q;
+
+  if ((in_channels < 1) || (in_channels > MFW_GST_DMX_MAX_CHANNELS)
+      || (out_channels < 1) || (out_channels > MFW_GST_DMX_MAX_CHANNELS)
+      || ((width != 16) && (width != 32)))
+    return FALSE;
+
+  g.center_gain = CLAMP (g.center_gain, 0.0f, 1.0f);
+  g.surround_gain = CLAMP (g.surround_gain, 0.0f, 1.0f);
+  g.lfe_gain = CLAMP (g.lfe_gain, 0.0f, 1.0f);
+
+  memset (m, 0, sizeof (m));
+  if ((out_channels == 1) && (in_channels > 1)) {
+    /* mono is the average of the stereo downmix */
+    dmx_route (m, in_channels, 2, &g);
+    for (i = 0; i < in_channels; i++) {
+      m[0][i] = (m[0][i] + m[1][i]) * 0.5f;
+      m[1][i] = 0.0f;
+    }
+  } else {
+    dmx_route (m, in_channels, out_channels, &g);
+  }
+
+  memset (dmx->coef, 0, sizeof (dmx->coef));
+  for (o = 0; o < out_channels; o++) {
+    sum = 0.0f;
+    for (i = 0; i < in_channels; i++)
+      sum += m[o][i];
+    if ((!g.normalize) || (sum <= 1.0f))
+      sum = 1.0f;
+    for (i = 0; i < in_channels; i++) {
+      q = (gint) (m[o][i] / sum * DMX_ONE + 0.5f);
+      dmx->coef[o][i] = CLAMP (q, 0, DMX_ONE);
+    }
+  }
+
+  dmx->in_channels = in_channels;
+  dmx->out_channels = out_channels;
+  dmx->width = width;
+  return TRUE;
+}
+
+void
+mfw_gst_dmx_process_ref (const MfwGstDmxEngine * dmx, const guint8 * in,
+    guint8 * out, guint frames)
+{
+  gint ic = dmx->in_channels;
+  gint oc = dmx->out_channels;
+  gint o, c;
+
+  /* a frame is read completely before its output is written */
+  if (dmx->width == 16) {
+    const gint16 *src = (const gint16 *) in;
+    gint16 *dst = (gint16 *) out;
+    gint32 acc[MFW_GST_DMX_MAX_CHANNELS];
+
+    while (frames--) {
+      for (o = 0; o < oc; o++) {
+        acc[o] = 0;
+        for (c = 0; c < ic; c++)
+          acc[o] += (gint32) dmx->coef[o][c] * src[c];
+      }
+      for (o = 0; o < oc; o++)
+        dst[o] = dmx_sat16 ((acc[o] + DMX_ROUND) >> MFW_GST_DMX_COEF_SHIFT);
+      src += ic;
+      dst += oc;
+    }
+  } else {
+    const gint32 *src = (const gint32 *) in;
+    gint32 *dst = (gint32 *) out;
+    gint64 acc[MFW_GST_DMX_MAX_CHANNELS];
+
+    while (frames--) {
+      for (o = 0; o < oc; o++) {
+        acc[o] = 0;
+        for (c = 0; c < ic; c++)
+          acc[o] += (gint64) dmx->coef[o][c] * src[c];
+      }
+      for (o = 0; o < oc; o++)
+        dst[o] = dmx_sat32 ((acc[o] + DMX_ROUND) >> MFW_GST_DMX_COEF_SHIFT);
+      src += ic;
+      dst += oc;
+    }
+  }
+}
+
+void
+mfw_gst_dmx_process (const MfwGstDmxEngine * dmx, const guint8 * in,
+    guint8 * out, guint frames)
+{
+  guint done = 0;
+  guint bytes = dmx->width / 8;
+
+#if defined(__ARM_NEON__) || defined(__SSE2__)
+  if (dmx->width == 16)
+    done = dmx_process_s16_simd (dmx, (const gint16 *) in, (gint16 *) out,
+        frames);
+#endif
+
+  if (done < frames)
+    mfw_gst_dmx_process_ref (dmx, in + done * dmx->in_channels * bytes,
+        out + done * dmx->out_channels * bytes, frames - done);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_dmx_engine.h
+ *
+ * Description:    Fixed point channel downmix engine
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+#ifndef __MFW_GST_DMX_ENGINE_H__
+#define __MFW_GST_DMX_ENGINE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define MFW_GST_DMX_MAX_CHANNELS    8
+#define MFW_GST_DMX_COEF_SHIFT      13  /* Q13 coefficients, 1.0 = 8192 */
+
+#define MFW_GST_DMX_DEFAULT_CENTER_GAIN     0.7071f     /* -3 dB */
+#define MFW_GST_DMX_DEFAULT_SURROUND_GAIN   0.7071f
+#define MFW_GST_DMX_DEFAULT_LFE_GAIN        0.0f
+
+typedef struct
+{
+  gfloat center_gain;           /* front center into front left/right */
+  gfloat surround_gain;         /* rear and side into front left/right */
+  gfloat lfe_gain;              /* LFE into front left/right */
+  gboolean normalize;           /* scale rows down to a sum of 1.0 */
+} MfwGstDmxGains;
+
+/*
+ * Channels are interleaved in the order the audio decoders output them:
+ * FL FR RL RR FC LFE SL SR, with FC alone for mono, FL FR LFE for 3 and
+ * a rear center as 7th channel. Gains are limited to [0, 1], so with at
+ * most 8 inputs a 16 bit row sums in 32 bits without overflow.
+ */
+typedef struct
+{
+  gint in_channels;
+  gint out_channels;
+  gint width;                   /* 16 or 32 bit samples */
+  gint16 coef[MFW_GST_DMX_MAX_CHANNELS][MFW_GST_DMX_MAX_CHANNELS];      /* [out][in] */
+} MfwGstDmxEngine;
+
+/*!
+ * Build the matrix for in_channels to out_channels.
+ *
+ * @return  FALSE for an unsupported channel count or sample width.
+ */
+gboolean mfw_gst_dmx_init (MfwGstDmxEngine * dmx, gint in_channels,
+    gint out_channels, gint width, const MfwGstDmxGains * gains);
+
+/*!
+ * Mix frames from in to out, NEON or SSE2 for 16 bit samples when built
+ * with them. Output may overwrite the input when out_channels is not
+ * larger than in_channels.
+ */
+void mfw_gst_dmx_process (const MfwGstDmxEngine * dmx, const guint8 * in,
+    guint8 * out, guint frames);
+
+/*!
+ * Scalar reference of mfw_gst_dmx_process, the result is bit exact.
+ */
+void mfw_gst_dmx_process_ref (const MfwGstDmxEngine * dmx,
+    const guint8 * in, guint8 * out, guint frames);
+
+G_END_DECLS
+
+#endif /* __MFW_GST_DMX_ENGINE_H__ */
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc. All rights reserved.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_dmx_test.c
+ *
+ * Description:    Checks that mfw_gst_dmx_process is bit exact with the
+ *                 scalar reference for every channel pair, both sample
+ *                 widths, frame counts around the vector length, in place
+ *                 processing and full scale input.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+#include <string.h>
+
+#include "mfw_gst_dmx_engine.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+#define DMX_TEST_MAX_FRAMES 40
+#define DMX_TEST_SEED       0x1234
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+/* random samples, or only the most positive and negative to saturate */
+static void
+dmx_test_fill (GRand * rand, guint8 * data, guint size, gint width,
+    gboolean full_scale)
+{
+  guint i;
+
+  if (!full_scale) {
+    for (i = 0; i < size; i++)
+      data[i] = (guint8) g_rand_int (rand);
+  } else if (width == 16) {
+    for (i = 0; i < size / 2; i++)
+      ((gint16 *) data)[i] = g_rand_boolean (rand) ? G_MAXINT16 : G_MININT16;
+  } else {
+    for (i = 0; i < size / 4; i++)
+      ((gint32 *) data)[i] = g_rand_boolean (rand) ? G_MAXINT32 : G_MININT32;
+  }
+}
+
+static gboolean
+dmx_test_case (GRand * rand, const MfwGstDmxEngine * dmx, guint frames,
+    gboolean full_scale)
+{
+  guint bytes = dmx->width / 8;
+  guint in_size = frames * dmx->in_channels * bytes;
+  guint out_size = frames * dmx->out_channels * bytes;
+  guint8 *in = g_malloc (in_size + 4);
+  guint8 *ref = g_malloc (out_size + 4);
+  guint8 *out = g_malloc (out_size + 4);
+  gboolean ok = TRUE;
+
+  dmx_test_fill (rand, in, in_size, dmx->width, full_scale);
+  mfw_gst_dmx_process_ref (dmx, in, ref, frames);
+  mfw_gst_dmx_process (dmx, in, out, frames);
+  if (memcmp (ref, out, out_size) != 0) {
+    g_printerr ("%d to %d channels, %d bit, %u frames: output differs\n",
+        dmx->in_channels, dmx->out_channels, dmx->width, frames);
+    ok = FALSE;
+  }
+
+  if (ok && (dmx->out_channels <= dmx->in_channels)) {
+    mfw_gst_dmx_process (dmx, in, in, frames);
+    if (memcmp (ref, in, out_size) != 0) {
+      g_printerr ("%d to %d channels, %d bit, %u frames: in place differs\n",
+          dmx->in_channels, dmx->out_channels, dmx->width, frames);
+      ok = FALSE;
+    }
+  }
+
+  g_free (in);
+  g_free (ref);
+  g_free (out);
+  return ok;
+}
+
+int
+main (int argc, char *argv[])
+{
+  MfwGstDmxGains gains = { MFW_GST_DMX_DEFAULT_CENTER_GAIN,
+    MFW_GST_DMX_DEFAULT_SURROUND_GAIN, MFW_GST_DMX_DEFAULT_LFE_GAIN, FALSE
+  };
+  MfwGstDmxEngine dmx;
+  GRand *rand = g_rand_new_with_seed (DMX_TEST_SEED);
+  gint in, out, width, failures = 0, cases = 0;
+  guint frames;
+
+  for (width = 16; width <= 32; width += 16) {
+    for (in = 1; in <= MFW_GST_DMX_MAX_CHANNELS; in++) {
+      for (out = 1; out <= MFW_GST_DMX_MAX_CHANNELS; out++) {
+        gains.normalize = (in + out) & 1;
+        gains.lfe_gain = (in & 1) ? 0.5f : 0.0f;
+        if (!mfw_gst_dmx_init (&dmx, in, out, width, &gains)) {
+          g_printerr ("%d to %d channels, %d bit: init failed\n", in, out,
+              width);
+          failures++;
+          continue;
+        }
+        for (frames = 0; frames <= DMX_TEST_MAX_FRAMES; frames++) {
+          cases += 2;
+          if (!dmx_test_case (rand, &dmx, frames, FALSE))
+            failures++;
+          if (!dmx_test_case (rand, &dmx, frames, TRUE))
+            failures++;
+        }
+      }
+    }
+  }
+
+  g_rand_free (rand);
+  g_print ("%d of %d downmix cases bit exact\n", cases - failures, cases);
+  return (failures == 0) ? 0 : 1;
+}
@@ -157,6 +157,21 @@ mfw_gst_downmix_set_property(GObject *object, guint prop_id,
     case PROPER_ID_OUTPUT_CHANNEL_NUMBER:
         filter->disiredOutChannels = g_value_get_int(value);
         break;
+    case PROPER_ID_ENGINE:
+        filter->engine = g_value_get_int(value);
+        break;
+    case PROPER_ID_CENTER_GAIN:
+        filter->gains.center_gain = g_value_get_float(value);
+        break;
+    case PROPER_ID_SURROUND_GAIN:
+        filter->gains.surround_gain = g_value_get_float(value);
+        break;
+    case PROPER_ID_LFE_GAIN:
+        filter->gains.lfe_gain = g_value_get_float(value);
+        break;
+    case PROPER_ID_NORMALIZE:
+        filter->gains.normalize = g_value_get_boolean(value);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -173,6 +188,21 @@ mfw_gst_downmix_get_property(GObject *object, guint prop_id,
     case PROPER_ID_OUTPUT_CHANNEL_NUMBER:
         g_value_set_int(value, filter->disiredOutChannels);
         break;
+    case PROPER_ID_ENGINE:
+        g_value_set_int(value, filter->engine);
+        break;
+    case PROPER_ID_CENTER_GAIN:
+        g_value_set_float(value, filter->gains.center_gain);
+        break;
+    case PROPER_ID_SURROUND_GAIN:
+        g_value_set_float(value, filter->gains.surround_gain);
+        break;
+    case PROPER_ID_LFE_GAIN:
+        g_value_set_float(value, filter->gains.lfe_gain);
+        break;
+    case PROPER_ID_NORMALIZE:
+        g_value_set_boolean(value, filter->gains.normalize);
+        break;
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
         break;
@@ -403,6 +433,97 @@ processErr:
     
 }
 
+/*=============================================================================
+ FUNCTION:          mfw_gst_downmix_open_init
+ DESCRIPTION:       Build the built-in engine matrix from the input caps and
+                    set the output caps, sample width and depth are kept.
+ IMPORTANT NOTES:   None
+=============================================================================*/
+static GstFlowReturn
+mfw_gst_downmix_open_init(MfwGstDownMix *filter, GstBuffer *buf)
+{
+    GstCaps * caps;
+    GstStructure * s;
+    gint width = DEFAULT_BITWIDTH;
+    gint depth = DEFAULT_BITDEPTH;
+    gint rate = 44100;
+    gint channels = DEFAULT_CHANNELS;
+
+    caps = gst_buffer_get_caps(buf);
+    if (caps == NULL)
+        return GST_FLOW_NOT_NEGOTIATED;
+
+    s = gst_caps_get_structure(caps, 0);
+    gst_structure_get_int(s, "width", &width);
+    gst_structure_get_int(s, "depth", &depth);
+    gst_structure_get_int(s, "rate", &rate);
+    gst_structure_get_int(s, "channels", &channels);
+    gst_caps_unref(caps);
+
+    if (!mfw_gst_dmx_init(&filter->dmx, channels, filter->disiredOutChannels,
+            width, &filter->gains)) {
+        DOWNMIX_FATAL_ERROR("downmix of %d channels %d bit not supported\n",
+            channels, width);
+        return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    caps = gst_caps_new_simple("audio/x-raw-int",
+        				       "endianness", G_TYPE_INT, G_BYTE_ORDER,
+        				       "signed", G_TYPE_BOOLEAN, TRUE,
+        				       "width", G_TYPE_INT, width,
+        				       "depth", G_TYPE_INT, depth,
+        				       "rate", G_TYPE_INT, rate,
+        				       "channels", G_TYPE_INT, filter->dmx.out_channels,
+        				       NULL);
+    gst_pad_set_caps(filter->srcpad, caps);
+    gst_caps_unref(caps);
+    filter->capsSet = TRUE;
+
+    return GST_FLOW_OK;
+}
+
+/*=============================================================================
+ FUNCTION:          mfw_gst_downmix_open_process_frame
+ DESCRIPTION:       Downmix with the built-in engine. A writable input with
+                    no more output than input channels is mixed in place,
+                    otherwise an output buffer is allocated downstream.
+ IMPORTANT NOTES:   None
+=============================================================================*/
+static GstFlowReturn
+mfw_gst_downmix_open_process_frame(MfwGstDownMix *filter, GstBuffer *buf)
+{
+    MfwGstDmxEngine * dmx = &filter->dmx;
+    gint bytes = dmx->width/8;
+    guint frames;
+    guint outsize;
+    GstBuffer * outb;
+    GstFlowReturn ret;
+
+    frames = GST_BUFFER_SIZE(buf)/bytes/dmx->in_channels;
+    outsize = frames*bytes*dmx->out_channels;
+
+    if ((dmx->out_channels<=dmx->in_channels) && gst_buffer_is_writable(buf)){
+        outb = buf;
+        mfw_gst_dmx_process(dmx, GST_BUFFER_DATA(buf), GST_BUFFER_DATA(outb),
+            frames);
+        GST_BUFFER_SIZE(outb) = outsize;
+        gst_buffer_set_caps(outb, GST_PAD_CAPS(filter->srcpad));
+    }else{
+        ret = gst_pad_alloc_buffer(filter->srcpad, 0, outsize,
+            GST_PAD_CAPS(filter->srcpad), &outb);
+        if (ret!=GST_FLOW_OK){
+            gst_buffer_unref(buf);
+            return ret;
+        }
+        mfw_gst_dmx_process(dmx, GST_BUFFER_DATA(buf), GST_BUFFER_DATA(outb),
+            frames);
+        gst_buffer_copy_metadata(outb, buf, GST_BUFFER_COPY_TIMESTAMPS);
+        gst_buffer_unref(buf);
+    }
+
+    return gst_pad_push(filter->srcpad, outb);
+}
+
 
 static GstFlowReturn
 mfw_gst_downmix_chain (GstPad *pad, GstBuffer *buf)
@@ -418,7 +539,11 @@ mfw_gst_downmix_chain (GstPad *pad, GstBuffer *buf)
 
     if (G_UNLIKELY(filter->init==FALSE)) {
         
-    	ret = mfw_gst_downmix_core_init(filter, buf);
+        filter->engineInUse = filter->engine;
+        if (filter->engineInUse==DOWNMIX_ENGINE_OPEN)
+            ret = mfw_gst_downmix_open_init(filter, buf);
+        else
+    	    ret = mfw_gst_downmix_core_init(filter, buf);
         if (ret!=GST_FLOW_OK){
             gst_buffer_unref(buf);
             DOWNMIX_FATAL_ERROR("mfw_gst_downmix_core_init failed with return %d\n", ret);
@@ -428,7 +553,10 @@ mfw_gst_downmix_chain (GstPad *pad, GstBuffer *buf)
         filter->init = TRUE;
     }
     
-    ret = mfw_gst_downmix_process_frame(filter, buf);
+    if (filter->engineInUse==DOWNMIX_ENGINE_OPEN)
+        ret = mfw_gst_downmix_open_process_frame(filter, buf);
+    else
+        ret = mfw_gst_downmix_process_frame(filter, buf);
     if (ret!=GST_FLOW_OK){
         GST_WARNING("mfw_gst_downmix_process_frame failed with ret=%d\n", ret);
     }
@@ -531,6 +659,50 @@ mfw_gst_downmix_class_init (gpointer klass)
         DEFAULT_CHANNELS, G_PARAM_READWRITE)
     );  
 
+    g_object_class_install_property (
+        G_OBJECT_CLASS (klass), 
+        PROPER_ID_ENGINE, 
+        g_param_spec_int ("engine", "engine", 
+        "Downmix implementation: 0, codec library; 1, built-in fixed point", 
+        DOWNMIX_ENGINE_CORE, DOWNMIX_ENGINE_OPEN,
+        DOWNMIX_ENGINE_CORE, G_PARAM_READWRITE)
+    );  
+
+    g_object_class_install_property (
+        G_OBJECT_CLASS (klass), 
+        PROPER_ID_CENTER_GAIN, 
+        g_param_spec_float ("center-gain", "center gain", 
+        "Gain of front center into front left/right (built-in engine)", 
+        0.0, 1.0,
+        MFW_GST_DMX_DEFAULT_CENTER_GAIN, G_PARAM_READWRITE)
+    );  
+
+    g_object_class_install_property (
+        G_OBJECT_CLASS (klass), 
+        PROPER_ID_SURROUND_GAIN, 
+        g_param_spec_float ("surround-gain", "surround gain", 
+        "Gain of rear and side into front left/right (built-in engine)", 
+        0.0, 1.0,
+        MFW_GST_DMX_DEFAULT_SURROUND_GAIN, G_PARAM_READWRITE)
+    );  
+
+    g_object_class_install_property (
+        G_OBJECT_CLASS (klass), 
+        PROPER_ID_LFE_GAIN, 
+        g_param_spec_float ("lfe-gain", "lfe gain", 
+        "Gain of LFE into front left/right, 0 drops it (built-in engine)", 
+        0.0, 1.0,
+        MFW_GST_DMX_DEFAULT_LFE_GAIN, G_PARAM_READWRITE)
+    );  
+
+    g_object_class_install_property (
+        G_OBJECT_CLASS (klass), 
+        PROPER_ID_NORMALIZE, 
+        g_param_spec_boolean ("normalize", "normalize", 
+        "Scale the gains of each output down so they sum to 1 (built-in engine)", 
+        TRUE, G_PARAM_READWRITE)
+    );  
+
     return;
 }
 
@@ -580,6 +752,11 @@ mfw_gst_downmix_init	 (MfwGstDownMix *filter,
 			       (mfw_gst_downmix_sink_event));
 
     filter->disiredOutChannels = DEFAULT_CHANNELS;
+    filter->engine = DOWNMIX_ENGINE_CORE;
+    filter->gains.center_gain = MFW_GST_DMX_DEFAULT_CENTER_GAIN;
+    filter->gains.surround_gain = MFW_GST_DMX_DEFAULT_SURROUND_GAIN;
+    filter->gains.lfe_gain = MFW_GST_DMX_DEFAULT_LFE_GAIN;
+    filter->gains.normalize = TRUE;
 
 #define MFW_GST_DOWNMIX_PLUGIN VERSION
     PRINT_CORE_VERSION(DownmixCodecVersionInfo());
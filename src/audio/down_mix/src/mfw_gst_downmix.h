@@ -43,6 +43,8 @@
 
 #include <gst/gst.h>
 
+#include "mfw_gst_dmx_engine.h"
+
 /*=============================================================================
                                            CONSTANTS
 =============================================================================*/
@@ -54,6 +56,17 @@
 /* plugin property ID */
 enum{
     PROPER_ID_OUTPUT_CHANNEL_NUMBER = 1,
+    PROPER_ID_ENGINE,
+    PROPER_ID_CENTER_GAIN,
+    PROPER_ID_SURROUND_GAIN,
+    PROPER_ID_LFE_GAIN,
+    PROPER_ID_NORMALIZE,
+};
+
+/* downmix implementation */
+enum{
+    DOWNMIX_ENGINE_CORE = 0,    /* dm_decode_frame of the codec library */
+    DOWNMIX_ENGINE_OPEN,        /* built-in fixed point matrix */
 };
 
 /*=============================================================================
@@ -86,6 +99,10 @@ typedef struct _MfwGstDownMix
     PPP_INPUTPARA *pppInput;
     PPP_INFO *pppInfo;
     guint disiredOutChannels;
+    gint engine;                /* selected by property */
+    gint engineInUse;           /* fixed when the first buffer comes */
+    MfwGstDmxGains gains;
+    MfwGstDmxEngine dmx;
 }MfwGstDownMix;
 
 typedef struct _MfwGstDownMixClass 
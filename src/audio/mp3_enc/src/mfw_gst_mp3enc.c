@@ -116,10 +116,6 @@ GST_STATIC_PAD_TEMPLATE ("src",
 
 #define NUM_SAMPLES 1152	/* 1152 samples per channel */
 
-#define MP3ENC_TRY_ENC(ret, enc, dofunc) \
-  while (((ret)==GST_FLOW_OK) && (gst_adapter_available((enc)->adapter)>=(enc)->sample_size)){\
-    (ret) = dofunc((enc));\
-  }
     
     
 
@@ -153,7 +149,8 @@ static gboolean mfw_gst_mp3enc_sink_event (GstPad * pad, GstEvent * event);
 static GstStateChangeReturn mfw_gst_mp3enc_change_state (GstElement * element,
 							 GstStateChange
 							 transition);
-static GstFlowReturn mfw_gst_mp3enc_encode_frame (MfwGstMp3EncInfo * mp3enc);
+static gint mfw_gst_mp3enc_encode_frame (gpointer user_data, guint8 * in,
+					guint8 * out, GstClockTime timestamp);
 static GstFlowReturn mfw_gst_mp3enc_chain (GstPad * pad, GstBuffer * buf);
 
 /*==================================================================================================
@@ -169,62 +166,32 @@ static GstFlowReturn mfw_gst_mp3enc_chain (GstPad * pad, GstBuffer * buf);
 
 
 
-void encoder_mem_info_alloc (MfwGstMp3EncInfo * mp3enc)
+static gboolean
+encoder_mem_info_alloc (MfwGstMp3EncInfo * mp3enc)
 {
-
     MP3E_Encoder_Config *enc_config = &mp3enc->enc_config;
-    int instance_id = enc_config->instance_id;
-
-    mp3enc->W1[instance_id] = (char *)g_malloc(sizeof(char)*enc_config->mem_info[0].size);       
-    enc_config->mem_info[0].ptr =  
-        (int*)((unsigned int )(&mp3enc->W1[instance_id][0] + 
-                   enc_config->mem_info[0].align - 1 )
-                   & (0xffffffff ^ (enc_config->mem_info[0].align - 1 )));
-
-    mp3enc->W2[instance_id] = (char *)g_malloc(sizeof(char)*enc_config->mem_info[1].size);
-    enc_config->mem_info[1].ptr =  
-        (int *)((unsigned int )(&mp3enc->W2[instance_id][0] 
-                                + enc_config->mem_info[1].align - 1 )
-    			& (0xffffffff ^ (enc_config->mem_info[1].align - 1 )));
-
-    mp3enc->W3[instance_id] = (char *)g_malloc(sizeof(char)*enc_config->mem_info[2].size);
-    enc_config->mem_info[2].ptr =  
-        (int *)((unsigned int )(&mp3enc->W3[instance_id][0] 
-                                + enc_config->mem_info[2].align - 1 ) 
-    			& (0xffffffff ^ (enc_config->mem_info[2].align - 1 )));
-
-    mp3enc->W4[instance_id] = (char *)g_malloc(sizeof(char)*enc_config->mem_info[3].size);
-    enc_config->mem_info[3].ptr =  
-        (int *)((unsigned int )(&mp3enc->W4[instance_id][0] 
-                                + enc_config->mem_info[3].align - 1 )
-    			& (0xffffffff ^ (enc_config->mem_info[3].align - 1 )));
-
-    mp3enc->W5[instance_id] = (char *)g_malloc(sizeof(char)*enc_config->mem_info[4].size);
-    enc_config->mem_info[4].ptr =  
-        (int *)((unsigned int )(&mp3enc->W5[instance_id][0] 
-                                + enc_config->mem_info[4].align - 1 )
-    			& (0xffffffff ^ (enc_config->mem_info[4].align - 1 )));
-
-    mp3enc->W6[instance_id] = (char *)g_malloc(sizeof(char)*enc_config->mem_info[5].size);
-    enc_config->mem_info[5].ptr =  
-        (int *)((unsigned int )(&mp3enc->W6[instance_id][0] 
-                                + enc_config->mem_info[5].align - 1 ) 
-    			& (0xffffffff ^ (enc_config->mem_info[5].align - 1 )));
-
+    gint i;
+
+    /* working memory comes from the pool shared by all encoder instances */
+    for (i = 0; i < MP3ENC_NUM_MEM_REQS; i++) {
+        mp3enc->mem[i] = mfw_gst_aenc_mem_alloc (enc_config->mem_info[i].size,
+            enc_config->mem_info[i].align);
+        if (mp3enc->mem[i] == NULL)
+            return FALSE;
+        enc_config->mem_info[i].ptr = (int *) mp3enc->mem[i];
+    }
+    return TRUE;
 }
 
-void encoder_mem_info_free (MfwGstMp3EncInfo * mp3enc)
+static void
+encoder_mem_info_free (MfwGstMp3EncInfo * mp3enc)
 {
+    gint i;
 
-    MP3E_Encoder_Config *enc_config = &mp3enc->enc_config;
-    int instance_id = enc_config->instance_id;
-
-    g_free(mp3enc->W1[instance_id]);
-    g_free(mp3enc->W2[instance_id]);
-    g_free(mp3enc->W3[instance_id]);
-    g_free(mp3enc->W4[instance_id]);
-    g_free(mp3enc->W5[instance_id]);
-    g_free(mp3enc->W6[instance_id]);
+    for (i = 0; i < MP3ENC_NUM_MEM_REQS; i++) {
+        mfw_gst_aenc_mem_free (mp3enc->mem[i]);
+        mp3enc->mem[i] = NULL;
+    }
 }
 
 
@@ -427,11 +394,16 @@ mfw_gst_mp3enc_sink_event (GstPad * pad, GstEvent * event)
       {
 
       GstFlowReturn gret=GST_FLOW_OK;
+      gint demo_mode = mp3enc->demo_mode;
 
-      MP3ENC_TRY_ENC(gret,mp3enc,mfw_gst_mp3enc_encode_frame);
+      gret = mfw_gst_aenc_batch_encode (&mp3enc->batch, mp3enc->adapter,
+          mfw_gst_mp3enc_encode_frame, mp3enc);
 
       gst_adapter_clear(mp3enc->adapter);
 
+    /* the demo ended in the last frames, EOS follows them */
+    if ((mp3enc->demo_mode == 2) && (demo_mode != 2))
+        return gst_pad_push_event (mp3enc->srcpad, event);
     if (mp3enc->demo_mode == 2)
         return GST_FLOW_ERROR;
 	ret =
@@ -489,6 +461,7 @@ mfw_gst_mp3enc_change_state (GstElement * element, GstStateChange transition)
     case GST_STATE_CHANGE_PAUSED_TO_READY:
 	{
         encoder_mem_info_free(mp3enc);
+        mfw_gst_aenc_batch_free (&mp3enc->batch);
         gst_adapter_clear(mp3enc->adapter);
         g_object_unref (G_OBJECT (mp3enc->adapter));
         mp3enc->encinit = FALSE;
@@ -501,63 +474,29 @@ mfw_gst_mp3enc_change_state (GstElement * element, GstStateChange transition)
   return ret;
 }
 
-static GstFlowReturn
-mfw_gst_mp3enc_encode_frame(MfwGstMp3EncInfo * mp3enc)
+/* encode one frame in place from the adapter into the batched output */
+static gint
+mfw_gst_mp3enc_encode_frame (gpointer user_data, guint8 * in, guint8 * out,
+    GstClockTime timestamp)
 {
-  GstBuffer *outbuf, *inbuf;
-  GstFlowReturn ret = GST_FLOW_OK;
-  guint8 *outdata;
-
-  GstClockTime timestamp;
-  
-  ret =
-      gst_pad_alloc_buffer_and_set_caps (mp3enc->srcpad, GST_BUFFER_OFFSET_NONE,
-                                         mp3enc->params.mp3e_outbuf_size,
-                                         GST_PAD_CAPS (mp3enc->srcpad), &outbuf);
-  if (ret != GST_FLOW_OK){
-    GST_WARNING ("Can not allocate buffer from next element!");
-    goto bail;
-  }
-  outdata = GST_BUFFER_DATA (outbuf);
-
-  inbuf = gst_adapter_take_buffer (mp3enc->adapter, mp3enc->sample_size);
-
-  timestamp = gst_adapter_prev_timestamp(mp3enc->adapter, NULL);
-
-
-  mp3e_encode_frame ((MP3E_INT16 *) (GST_BUFFER_DATA (inbuf)), &mp3enc->enc_config, outdata);
-  GST_BUFFER_TIMESTAMP (outbuf) = timestamp;
-  GST_BUFFER_DURATION (outbuf) = mp3enc->sample_duration;
-  GST_BUFFER_SIZE (outbuf) = mp3enc->enc_config.num_bytes;
-
-  if (GST_CLOCK_TIME_IS_VALID(timestamp)){
-    DEMO_LIVE_CHECK(mp3enc->demo_mode, 
-                    timestamp, 
-                    mp3enc->srcpad);
+  MfwGstMp3EncInfo *mp3enc = (MfwGstMp3EncInfo *) user_data;
+
+  /* the demo stops quietly: frames from the time limit on give no output,
+     EOS is sent after the frames of the batch before them are pushed */
+  if ((mp3enc->demo_mode == 1) && GST_CLOCK_TIME_IS_VALID(timestamp)
+      && ((timestamp / GST_SECOND) > DEMO_LIVE_TIME)){
+    GST_WARNING ("This is a demo version, and the time exceed 2 minutes.");
+    mp3enc->demo_mode = 2;
   }
   if (mp3enc->demo_mode == 2){
-    return GST_FLOW_OK;
-  }
-
-  GST_DEBUG ("time stamp is %lld, output bytes=%d", timestamp,GST_BUFFER_SIZE(outbuf));
-  if (GST_BUFFER_SIZE (outbuf) > 0){
-    ret = gst_pad_push (mp3enc->srcpad, outbuf);
-    outbuf = NULL;
-  }else{
-    gst_buffer_unref (outbuf);
-    outbuf = NULL;
+    return 0;
   }
 
-bail:
-  if (outbuf){
-    gst_buffer_unref(outbuf);
-  }
-
-  if (inbuf){
-    gst_buffer_unref(inbuf);
-  }
+  mp3e_encode_frame ((MP3E_INT16 *) in, &mp3enc->enc_config, out);
 
-  return ret;
+  GST_LOG ("time stamp is %lld, output bytes=%d", timestamp,
+      mp3enc->enc_config.num_bytes);
+  return mp3enc->enc_config.num_bytes;
 }
 
 /* chain function
@@ -596,7 +535,9 @@ mfw_gst_mp3enc_chain (GstPad * pad, GstBuffer * buf)
       gst_pad_set_caps (mp3enc->srcpad, caps);
       gst_caps_unref (caps);
 
-      mp3enc->enc_config.instance_id = 0;
+      /* instance_id only indexed the per-instance memory tables, the
+         working memory now comes from the shared pool */
+      memset (&mp3enc->enc_config, 0, sizeof (MP3E_Encoder_Config));
 
       /* memory setup */
       val = mp3e_query_mem (&mp3enc->enc_config);
@@ -605,7 +546,11 @@ mfw_gst_mp3enc_chain (GstPad * pad, GstBuffer * buf)
 	  GST_ERROR ("Query memory failed");
 	  return GST_FLOW_ERROR;
 	}
-      encoder_mem_info_alloc (mp3enc);
+      if (!encoder_mem_info_alloc (mp3enc))
+	{
+	  GST_ERROR ("Allocate memory failed");
+	  return GST_FLOW_ERROR;
+	}
 
       /*update the app mode */
       mp3enc->params.app_mode = ((mp3enc->channels % 2) & 0x3) +
@@ -631,6 +576,11 @@ mfw_gst_mp3enc_chain (GstPad * pad, GstBuffer * buf)
 
     mp3enc->sample_size = NUM_SAMPLES*2*mp3enc->channels; /* 16bit only */
 
+    /* the codec does not write its input, frames are read in place */
+    mfw_gst_aenc_batch_init (&mp3enc->batch, mp3enc->srcpad,
+        mp3enc->sample_size, mp3enc->params.mp3e_outbuf_size,
+        mp3enc->params.app_sampling_rate * 2 * mp3enc->channels, FALSE);
+
       mp3enc->encinit = TRUE;
     }
 
@@ -638,8 +588,14 @@ mfw_gst_mp3enc_chain (GstPad * pad, GstBuffer * buf)
 
   gst_adapter_push(mp3enc->adapter, buf);
 
-  MP3ENC_TRY_ENC(ret,mp3enc,mfw_gst_mp3enc_encode_frame);
+  ret = mfw_gst_aenc_batch_encode (&mp3enc->batch, mp3enc->adapter,
+      mfw_gst_mp3enc_encode_frame, mp3enc);
 
+  /* the demo ended in this buffer, later buffers are refused */
+  if (mp3enc->demo_mode == 2){
+    GST_WARNING ("Sending EOS event.");
+    gst_pad_push_event (mp3enc->srcpad, gst_event_new_eos ());
+  }
 
   return ret;
 }
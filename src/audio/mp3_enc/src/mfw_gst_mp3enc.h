@@ -43,6 +43,7 @@
 #include <gst/gst.h>
 #include <gst/base/gstadapter.h>
 #include "mp3_enc_interface.h"
+#include "mfw_gst_aenc.h"
 /*=============================================================================
                                            CONSTANTS
 =============================================================================*/
@@ -72,7 +73,7 @@ G_BEGIN_DECLS
 #define MFW_GST_IS_MP3ENC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass),MFW_GST_TYPE_MP3ENC))
 
-#define MAXIMUM_INSTANCES 	1          /* maximum number of instances supported*/
+#define MP3ENC_NUM_MEM_REQS 	6          /* working memory blocks of the codec */
 
 typedef struct _MfwGstMp3EncInfo     MfwGstMp3EncInfo;
 typedef struct _MfwGstMp3EncInfoClass MfwGstMp3EncInfoClass;
@@ -93,14 +94,10 @@ struct _MfwGstMp3EncInfo
   
   MP3E_Encoder_Parameter params; 
 
-    guint8* W1[MAXIMUM_INSTANCES]; 
-    guint8* W2[MAXIMUM_INSTANCES];
-    guint8* W3[MAXIMUM_INSTANCES];
-    guint8* W4[MAXIMUM_INSTANCES];
-    guint8* W5[MAXIMUM_INSTANCES];
-    guint8* W6[MAXIMUM_INSTANCES];
+  gpointer mem[MP3ENC_NUM_MEM_REQS];
 
   GstAdapter * adapter;
+  MfwGstAencBatch batch;
   guint64 sample_duration;
   gint sample_size;
 
@@ -142,8 +142,9 @@ static gboolean mfw_gst_spdifrx_set_caps(GstPad *pad, GstCaps *caps);
 static gboolean mfw_gst_spdifrx_sink_event(GstPad * pad, GstEvent * event);
 
 static GstFlowReturn mfw_gst_spdifrx_chain (GstPad *pad, GstBuffer *buf);
-static gboolean mfw_gst_spdifrx_push(MfwGstSpdifRX *filter);
-static gboolean mfw_gst_spdifrx_pushavail(MfwGstSpdifRX *filter); 
+static GstFlowReturn mfw_gst_spdifrx_parse(MfwGstSpdifRX *filter,
+                                           guint8 *data, guint len,
+                                           guint *consumed);
 
 
 /*=============================================================================
@@ -200,6 +201,49 @@ mfw_gst_spdifrx_get_property(GObject *object, guint prop_id,
     }
 }
 
+/*=============================================================================
+ FUNCTION:          mfw_gst_spdifrx_reset
+ DESCRIPTION:       Drop the burst being received and the queued input,
+                    parsing restarts with a sync search.
+=============================================================================*/
+static void
+mfw_gst_spdifrx_reset(MfwGstSpdifRX *filter)
+{
+    if (filter->outbuf) {
+        gst_buffer_unref(filter->outbuf);
+        filter->outbuf = NULL;
+    }
+    if (filter->pInAdapt)
+        gst_adapter_clear(filter->pInAdapt);
+    mfw_gst_iec61937_parser_reset(&filter->parser);
+}
+
+/*=============================================================================
+ FUNCTION:          mfw_gst_spdifrx_release
+ DESCRIPTION:       Free the stream resources, the next buffer detects the
+                    format again.
+=============================================================================*/
+static void
+mfw_gst_spdifrx_release(MfwGstSpdifRX *filter)
+{
+    mfw_gst_spdifrx_reset(filter);
+    if (filter->out_caps) {
+        gst_caps_unref(filter->out_caps);
+        filter->out_caps = NULL;
+    }
+    if (filter->pInAdapt) {
+        g_object_unref(filter->pInAdapt);
+        filter->pInAdapt = NULL;
+    }
+    if (filter->pOutAdapt) {
+        g_object_unref(filter->pOutAdapt);
+        filter->pOutAdapt = NULL;
+    }
+    filter->format = SPDIF_FORMAT_PCM;
+    filter->format_detected = FALSE;
+    filter->init = FALSE;
+}
+
 /*=============================================================================
  FUNCTION:      mfw_gst_spdifrx_sink_event
  DESCRIPTION:       Handles an event on the sink pad.
@@ -249,16 +293,20 @@ mfw_gst_spdifrx_sink_event(GstPad * pad, GstEvent * event)
         break;
     }
 
+    case GST_EVENT_FLUSH_STOP:
+    {
+        mfw_gst_spdifrx_reset(filter);
+        result = gst_pad_event_default(pad, event);
+        break;
+    }
+
     case GST_EVENT_EOS:
     {
-        gboolean ret;
         GST_DEBUG("\nSPDIF Receiver converter: Get EOS event\n");
-        if (filter->format == SPDIF_FORMAT_NONPCM) {
-            mfw_gst_spdifrx_push(filter);
-            while(ret == TRUE) {
-                ret = mfw_gst_spdifrx_push(filter);
-            };
-            mfw_gst_spdifrx_pushavail(filter);
+        /* a burst cut by the end of stream can not be decoded */
+        if (filter->outbuf) {
+            gst_buffer_unref(filter->outbuf);
+            filter->outbuf = NULL;
         }
         
         result = gst_pad_event_default(pad, event);
@@ -283,202 +331,128 @@ static GstFlowReturn
 mfw_gst_spdifrx_core_init(MfwGstSpdifRX *filter)
 {
     filter->status = SPDIF_STATE_NULL;
-    filter->sync1 = filter->sync2 = 0;
+    mfw_gst_iec61937_parser_init(&filter->parser, filter->width);
 
     return GST_FLOW_OK;
    
 }
 
-static void uint32to16(guint8 *in, guint8 *out,gint len)
-{
-
-    while (len > 3)
-    {
-        *out++ = *in++;
-        *out++ = *in++;
-        in +=2;
-        len -= 4;
-    }
-    return;
-}
-
-static GstFlowReturn spdif_tx_push(MfwGstSpdifRX *filter,
-                                   guint8 *data, gint len)
+/*=============================================================================
+ FUNCTION:          mfw_gst_spdifrx_burst_caps
+ DESCRIPTION:       Get the source caps of an IEC 61937 data type, the caps
+                    are kept while the type does not change.
+ RETURN VALUE:      the caps, NULL if the type is not supported
+=============================================================================*/
+static GstCaps *
+mfw_gst_spdifrx_burst_caps(MfwGstSpdifRX *filter, guint type)
 {
-    GstBuffer *buf;
-    GstFlowReturn ret;
-    guint8 *pReSData;
-    guint8 *pout;
-    burst_struct *burst;
-    GstCaps *caps = NULL;
-
-
-    pReSData = (guint8 *)SPDIFRX_MALLOC(len);
-
-    if (filter->width == 32)
-        uint32to16(data, pReSData, len);
-    else
-        memcpy(pReSData, data, len);
-
-    burst = (burst_struct *)pReSData;
-    GST_DEBUG("burst:%4X,%4X,%4X,%4X\n",burst->pa,burst->pb,burst->pc,burst->pd);
-
-    /* 
-     *  
-     * FIXME: Check the burst info, 
-     *   only support AC3 media type currently.
-     *
-     */
-
-    if (burst->pc & SPDIF_BURST_AC3_DATA) {
-        GST_DEBUG("Found AC3 data,len:%d.\n",burst->pd>>3);
-        filter->media_type = MEDIA_TYPE_AC3;
-
-        caps = gst_caps_new_simple("audio/x-ac3",
-                    "channel", G_TYPE_INT, 2, NULL);                    
-
-        ret = gst_pad_alloc_buffer_and_set_caps(filter->srcpad, 0,
-                                                burst->pd>>3,
-                                                caps, &buf);       
-
-        if (ret != GST_FLOW_OK) {
-            g_print("Could not alloc buffer, ret= %d.\n",ret);
-            return FALSE;
-        }   
-
-        pout = (guint8 *)GST_BUFFER_DATA(buf);
-        memcpy(pout, pReSData + DEFAULT_BURST_PREAMBLE_HEAD_LEN, (burst->pd>>3));
-        GST_BUFFER_SIZE(buf) = burst->pd >> 3;
-        GST_BUFFER_DATA(buf) = pout;
-
-        SPDIFRX_FREE(pReSData);
+    if (filter->out_caps && (filter->out_type == type))
+        return filter->out_caps;
 
+    if (filter->out_caps) {
+        gst_caps_unref(filter->out_caps);
+        filter->out_caps = NULL;
     }
-    else {
-        
-        SPDIFRX_FREE(pReSData);
-        
-    }
-
 
-    ret = gst_pad_push(filter->srcpad, buf);
-    if (ret != GST_FLOW_OK) {
-        GST_ERROR(" not able to push the data ,ret = %d.\n",ret);
-        return GST_FLOW_ERROR;
+    switch (type) {
+    case MFW_GST_IEC61937_AC3:
+        filter->out_caps = gst_caps_new_simple("audio/x-ac3",
+                    "channel", G_TYPE_INT, 2, NULL);
+        break;
+    case MFW_GST_IEC61937_EAC3:
+        filter->out_caps = gst_caps_new_simple("audio/x-eac3", NULL);
+        break;
+    case MFW_GST_IEC61937_DTS1:
+    case MFW_GST_IEC61937_DTS2:
+    case MFW_GST_IEC61937_DTS3:
+        filter->out_caps = gst_caps_new_simple("audio/x-dts", NULL);
+        break;
+    default:
+        GST_DEBUG("Skip burst of data type %d.\n", type);
+        return NULL;
     }
 
-    return GST_FLOW_OK;
-
+    filter->out_type = type;
+    return filter->out_caps;
 }
 
-static gboolean mfw_gst_spdifrx_push(MfwGstSpdifRX *filter) 
+/*=============================================================================
+ FUNCTION:          mfw_gst_spdifrx_parse
+ DESCRIPTION:       Depacketize the IEC 61937 bursts in the data. The payload
+                    is written straight into a buffer from downstream, which
+                    is pushed as soon as the burst is complete. A burst may
+                    span any number of calls.
+ ARGUMENTS PASSED:
+        consumed   -    bytes the parser took, less than len when
+                        downstream returned an error
+ RETURN VALUE:      GST_FLOW_OK, or the error of the downstream element
+=============================================================================*/
+static GstFlowReturn
+mfw_gst_spdifrx_parse(MfwGstSpdifRX *filter, guint8 *data, guint len,
+                      guint *consumed)
 {
-    guint len = gst_adapter_available(filter->pInAdapt);
-    guint8 *data = gst_adapter_peek(filter->pInAdapt, len);
-    guint8 *pout;
-    gint buf_size;
-    gint i;
-    GstFlowReturn ret;
-
-    i = 0;
-    len = len;
-    
-    while (i < len - 7) {
-        guint16 *pIn;
-        pIn = (guint16 *)(data + i);
-        switch (filter->status) {
-        case SPDIF_STATE_NULL:
-            /*
-             * FIXME:
-             * The second sync word's width could be 32 or 16,
-             * There is a case the sync word is 16bits while 
-             * the width is 32bits.
-             */
-            if ( (*pIn == SPDIF_IEC937_SYNC1) 
-                 && ((*(pIn+1) == SPDIF_IEC937_SYNC2) 
-                      || (*(pIn+2) == SPDIF_IEC937_SYNC2)) ) {
-                filter->status = SPDIF_STATE_SYNC1;
-                filter->sync1 = i;
-                GST_DEBUG("find sync word:%d\n",i);
- 
+    GstFlowReturn ret = GST_FLOW_OK;
+    MfwGstIec61937Result result;
+    GstCaps *caps;
+    guint used, size;
+
+    *consumed = len;
+    while (len > 0) {
+        result = mfw_gst_iec61937_parse(&filter->parser, data, len, &used);
+        data += used;
+        len -= used;
+
+        if (result == MFW_GST_IEC61937_BURST) {
+            size = mfw_gst_iec61937_parser_size(&filter->parser);
+            caps = mfw_gst_spdifrx_burst_caps(filter,
+                        mfw_gst_iec61937_parser_type(&filter->parser));
+            if (caps == NULL)
+                continue;
+
+            GST_DEBUG("Found burst type %d, len:%d.\n",
+                      filter->out_type, size);
+            ret = gst_pad_alloc_buffer_and_set_caps(filter->srcpad, 0,
+                                                    size, caps,
+                                                    &filter->outbuf);
+            if (ret != GST_FLOW_OK) {
+                GST_ERROR("Could not alloc buffer, ret= %d.\n", ret);
+                filter->outbuf = NULL;
+                *consumed -= len;
+                return ret;
+            }
+            mfw_gst_iec61937_parser_set_output(&filter->parser,
+                        GST_BUFFER_DATA(filter->outbuf));
+        }
+        else if ((result == MFW_GST_IEC61937_PAYLOAD) && filter->outbuf) {
+            GstBuffer *buf = filter->outbuf;
+
+            filter->outbuf = NULL;
+            GST_BUFFER_SIZE(buf) =
+                mfw_gst_iec61937_parser_size(&filter->parser);
+            ret = gst_pad_push(filter->srcpad, buf);
+            if (ret != GST_FLOW_OK) {
+                GST_ERROR(" not able to push the data ,ret = %d.\n", ret);
+                *consumed -= len;
+                return ret;
             }
-            break;
-        case SPDIF_STATE_SYNC1:
-            if ( (*pIn == SPDIF_IEC937_SYNC1) 
-                 && ((*(pIn+1) == SPDIF_IEC937_SYNC2) 
-                      || (*(pIn+2) == SPDIF_IEC937_SYNC2)) ) {
-                filter->sync2 = i;
-                buf_size = filter->sync2-filter->sync1;
-                GST_DEBUG("find 2 sync word:%d,dump validate data %d.\n",i,buf_size);
-                ret = spdif_tx_push(filter,data+filter->sync1, buf_size);
-                filter->status = SPDIF_STATE_NULL;
-                gst_adapter_flush(filter->pInAdapt,filter->sync2);
-                if (ret != GST_FLOW_OK)
-                    return  FALSE;
-                else
-                    return TRUE;            
-
-            }   
-            break;
-   
-        default:
-            break;
         }
-        i++;
     }
 
-    if (filter->status == SPDIF_STATE_SYNC1)
-        filter->status = SPDIF_STATE_NULL;
-
-    return FALSE;
-}
-
-static gboolean mfw_gst_spdifrx_pushavail(MfwGstSpdifRX *filter) 
-{
-    guint len = gst_adapter_available(filter->pInAdapt);
-    guint8 *data = gst_adapter_peek(filter->pInAdapt, len);
-    GstFlowReturn ret;
-    guint16 *pIn;
-
-    if (len == 0)
-        return TRUE;
-
-    pIn = (guint16 *)data;
-
-    if ( (*pIn == SPDIF_IEC937_SYNC1) 
-         && ((*(pIn+1) == SPDIF_IEC937_SYNC2) 
-              || (*(pIn+2) == SPDIF_IEC937_SYNC2)) ) {
-     ret = spdif_tx_push(filter,data, len);
-     gst_adapter_flush(filter->pInAdapt,len);
-
-    }    
-
-    return TRUE;
+    return ret;
 }
 
 gboolean mfw_gst_spdif_formatdetect(MfwGstSpdifRX *filter, guint8* data, gint len)
 {
-    gint i;
+    guint width;
 
     filter->format = SPDIF_FORMAT_PCM;
 
-    /* Check the first buffer if there is syncword of AC3 */
-    for (i = 0; i< len; i++)
-    {
-        guint16 *p16 = (guint16 *)(data + i);
-
-        if (*p16 == SPDIF_IEC937_SYNC1) {
-            if ((*(p16+1) == SPDIF_IEC937_SYNC2) || (*(p16+2) == SPDIF_IEC937_SYNC2))
-            {
-                filter->format = SPDIF_FORMAT_NONPCM;
-                if (*(p16+1) == SPDIF_IEC937_SYNC2)
-                    filter->width = 16;
-                else if (*(p16+1) == SPDIF_IEC937_SYNC2)
-                    filter->width = 32;
-                break;
-            }
-        } 
-
+    /* Check the first buffer if there is a burst preamble */
+    width = mfw_gst_iec61937_detect(data, len);
+    if (width) {
+        filter->format = SPDIF_FORMAT_NONPCM;
+        filter->width = width;
+        mfw_gst_iec61937_parser_init(&filter->parser, width);
     }
     
     g_print("\nDetect the spdif format:%d.\n",filter->format);
@@ -496,11 +470,12 @@ gboolean mfw_gst_spdif_formatdetect(MfwGstSpdifRX *filter, guint8* data, gint le
 static GstFlowReturn
 mfw_gst_spdifrx_process_frame(MfwGstSpdifRX *filter, GstBuffer *buf)
 {
-    gboolean ret;
+    GstFlowReturn ret;
     GstBuffer *outb;
     GstCaps *src_caps;
     guint len = gst_adapter_available(filter->pInAdapt);
     guint8 *data;
+    guint consumed;
 
     if (!filter->format_detected) {
         if (len < (DEFAULT_IEC_FRAME_LENGTH<<2)) {
@@ -520,9 +495,6 @@ mfw_gst_spdifrx_process_frame(MfwGstSpdifRX *filter, GstBuffer *buf)
 
     if (filter->format == SPDIF_FORMAT_PCM) {
         GstBuffer *buf;  
-        gst_pad_alloc_buffer_and_set_caps(filter->srcpad, 0,
-                                                len,
-                                                filter->src_caps, &buf);           
         buf = gst_adapter_take_buffer(filter->pInAdapt,len);
         ret = gst_pad_push(filter->srcpad, buf);
         if (ret != GST_FLOW_OK) {
@@ -532,11 +504,16 @@ mfw_gst_spdifrx_process_frame(MfwGstSpdifRX *filter, GstBuffer *buf)
 
     }
     else {
-        ret = mfw_gst_spdifrx_push(filter);
-
-        while(ret == TRUE) {
-            ret = mfw_gst_spdifrx_push(filter);
-        };
+        /* 
+         * The parser keeps its position, so the input is scanned once
+         * and flushed, normally a single buffer which is not copied.
+         * Input after a downstream error stays for the next buffer.
+         */
+        data = gst_adapter_peek(filter->pInAdapt, len);
+        ret = mfw_gst_spdifrx_parse(filter, data, len, &consumed);
+        gst_adapter_flush(filter->pInAdapt, consumed);
+        if (ret != GST_FLOW_OK)
+            return ret;
     }
     return GST_FLOW_OK;
   
@@ -581,6 +558,34 @@ mfw_gst_spdifrx_chain (GstPad *pad, GstBuffer *buf)
 
 
 
+static GstStateChangeReturn
+mfw_gst_spdifrx_change_state(GstElement *element, GstStateChange transition)
+{
+    MfwGstSpdifRX *filter = MFW_GST_SPDIFRX(element);
+    GstStateChangeReturn ret;
+
+    ret = GST_ELEMENT_CLASS(parent_class)->change_state(element, transition);
+
+    switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+        mfw_gst_spdifrx_release(filter);
+        break;
+    default:
+        break;
+    }
+
+    return ret;
+}
+
+static void
+mfw_gst_spdifrx_finalize(GObject *object)
+{
+    mfw_gst_spdifrx_release(MFW_GST_SPDIFRX(object));
+
+    G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+
 static void
 mfw_gst_spdifrx_base_init (gpointer klass)
 {
@@ -617,6 +622,9 @@ mfw_gst_spdifrx_class_init (gpointer klass)
 
     gobject_class->set_property = mfw_gst_spdifrx_set_property;
     gobject_class->get_property = mfw_gst_spdifrx_get_property;
+    gobject_class->finalize = mfw_gst_spdifrx_finalize;
+
+    gstelement_class->change_state = mfw_gst_spdifrx_change_state;
 
     return;
 }
@@ -42,6 +42,7 @@
 #define __MFW_GST_SPDIFRX_H__
 
 #include <gst/gst.h>
+#include "mfw_gst_iec61937.h"
 /*=============================================================================
                                            CONSTANTS
 =============================================================================*/
@@ -115,7 +116,10 @@ typedef struct _MfwGstSpdifRX
     gboolean init;
     GstAdapter * pInAdapt;
     GstAdapter * pOutAdapt;
-    gint sync1,sync2;
+    MfwGstIec61937Parser parser;
+    GstBuffer *outbuf;          /* burst being received */
+    GstCaps *out_caps;
+    guint out_type;
     GstCaps *src_caps;
     gint status;
     MEDIA_TYPE media_type;
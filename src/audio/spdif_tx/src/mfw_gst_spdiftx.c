@@ -67,7 +67,9 @@
         "rate=(int) {32000,44100,48000} "   
 
 #define MFW_GST_AC3_CAPS                    \
-        "audio/x-ac3 "     
+        "audio/x-ac3; "                     \
+        "audio/x-eac3; "                    \
+        "audio/x-dts "     
 
 
 #define MFW_GST_SRC_CAPS                                        \
@@ -76,7 +78,9 @@
         "signed = (boolean) true, "                             \
         "width = (gint) 16,  "                                  \
         "depth = (gint) 16,  "                                  \
-        "rate = (gint) { 32000,44100, 48000 }, "                \
+        "rate = (gint) { 8000, 11025, 12000, 16000, 22050, "    \
+        "24000, 32000, 44100, 48000, 64000, 88200, 96000, "     \
+        "128000, 176400, 192000 }, "                            \
         "channels = (gint) [ 1, 2 ]"
         
 #ifdef MEMORY_DEBUG
@@ -120,15 +124,14 @@ enum {
 #define SPDIF_IEC937_SYNC1  0xF872
 #define SPDIF_IEC937_SYNC2  0x4E1F
 
-#define AC3_SYNC_WORD_LSB   0x770B
-#define AC3_SYNC_WORD_MSB   0x0B77
-
 #define DEFAULT_AC3_FRAME_LENGTH        1536
 #define DEFAULT_BURST_PREAMBLE_HEAD_LEN 8
 
 #define SPDIF_BURST_AC3_DATA 0x01<<BURST_BIT_AC3_DATA
 #define SPDIF_BURST_PAUSE    0x01<<BURST_BIT_PAUSE
 
+#define SPDIFTX_MAX_BURSTS   32     /* bursts per output buffer */
+
 
 /*=============================================================================
                                       LOCAL VARIABLES
@@ -169,8 +172,8 @@ static gboolean mfw_gst_spdiftx_set_caps(GstPad *pad, GstCaps *caps);
 static gboolean mfw_gst_spdiftx_sink_event(GstPad * pad, GstEvent * event);
 
 static GstFlowReturn mfw_gst_spdiftx_chain (GstPad *pad, GstBuffer *buf);
-static gboolean mfw_gst_find_ac3sync(MfwGstSpdifTX *filter);
-static gboolean mfw_gst_spdiftx_pushavail(MfwGstSpdifTX *filter);
+static GstFlowReturn mfw_gst_spdiftx_pack_push(MfwGstSpdifTX *filter,
+                                               gboolean eos);
 
 
 /*=============================================================================
@@ -284,14 +287,10 @@ mfw_gst_spdiftx_sink_event(GstPad * pad, GstEvent * event)
 
     case GST_EVENT_EOS:
     {
-        gboolean ret;
         GST_DEBUG("\nSPDIF TX: Get EOS event\n");
-        if (filter->media_type == MEDIA_TYPE_AC3) {
-            ret = mfw_gst_find_ac3sync(filter);
-            while(ret == TRUE) {
-                ret = mfw_gst_find_ac3sync(filter);
-            };
-            mfw_gst_spdiftx_pushavail(filter);
+        if ((filter->media_type != MEDIA_TYPE_PCM) && filter->pInAdapt) {
+            mfw_gst_spdiftx_pack_push(filter, TRUE);
+            gst_adapter_clear(filter->pInAdapt);
         }        
         result = gst_pad_event_default(pad, event);
         if (result != TRUE) {
@@ -316,208 +315,205 @@ static GstFlowReturn
 mfw_gst_spdiftx_core_init(MfwGstSpdifTX *filter)
 {
     filter->status = SPDIF_STATE_NULL;
-    filter->sync1 = filter->sync2 = 0;
+    filter->rate = 0;
     return GST_FLOW_OK;
     
 }
-static void uint16to32(guint8 *in, guint8 *out,gint len)
-{
+/* a burst to pack, the payload is one frame or a group of E-AC-3 frames */
+typedef struct {
+    guint offset;
+    guint len;
+    guint type;
+    guint size;
+    gboolean le;
+} SpdifTxBurst;
 
-    while (len > 0)
-    {
-        *out++ = *in++;
-        *out++ = *in++;
-        *out++ = 0;
-        *out++ = 0;
-        len -= 2;
-    }
-    return;
-}
-
-static GstFlowReturn mfw_gst_spdif_ac3_repack_push(MfwGstSpdifTX *filter,
-                                   guint8 *data, guint32 len)
+/*=============================================================================
+ FUNCTION:          mfw_gst_spdiftx_set_rate
+ DESCRIPTION:       Set the src caps for the stream frame rate of the bursts.
+ RETURN VALUE:      FALSE if downstream does not accept the rate
+=============================================================================*/
+static gboolean
+mfw_gst_spdiftx_set_rate(MfwGstSpdifTX *filter, guint32 rate)
 {
-    GstBuffer *buf;
-    GstFlowReturn ret;
-    guint8 *pReSData;
-    guint8 *pout;
-    burst_struct *burst;
-    GstCaps *caps = NULL;
-
-    guint32 buf_len;
-
-    if (filter->width == 32)
-        buf_len = (DEFAULT_AC3_FRAME_LENGTH)<<(filter->channels+1);
-    else
-        buf_len = (DEFAULT_AC3_FRAME_LENGTH)<<(filter->channels);
+    GstCaps *caps;
+    gboolean ret;
 
-    GST_DEBUG("SPDIF buffered length is %d.\n",buf_len);
+    if (filter->capsSet && (filter->rate == rate))
+        return TRUE;
 
-    if (len > buf_len) {
-        GST_WARNING("AC3 data length is exceed \
-            the default SPDIF buffer length.\n");
-        return GST_FLOW_ERROR;
-    }
-    /* 
-     * Support width 16 and 32
-     * The burst preamble is LSB mode 
-     */
-    if (filter->width == 32) {
-        burst32_struct *burst;
-
-        pReSData = (guint8 *)SPDIFTX_MALLOC(buf_len);
-        memset(pReSData, 0, buf_len);
-        uint16to32(data, pReSData + 16, len);
-        burst = (burst32_struct *)pReSData;
-        burst->pa = SPDIF_IEC937_SYNC1;
-        burst->pb = SPDIF_IEC937_SYNC2;
-        burst->pc = SPDIF_BURST_AC3_DATA;
-        burst->pd = (len<<3);
-       
-    }
-    else if (filter->width == 16) {
-        pReSData = (guint8 *)SPDIFTX_MALLOC(DEFAULT_BURST_PREAMBLE_HEAD_LEN);
-        burst = (burst_struct *)pReSData;
-        memcpy((guint8 *)burst,(guint8 *)&filter->burst_info,sizeof(filter->burst_info));
-        burst->pd = (len<<3);
-        GST_DEBUG("Burst preamble:%4X,%4X,%4X,%4X\n",burst->pa,burst->pb,burst->pc,burst->pd);
-    }
-    else {
-        GST_WARNING("Not support this width:%d.",filter->width);
+    caps = gst_caps_new_simple("audio/x-raw-int",
+        "endianness", G_TYPE_INT, G_BYTE_ORDER, 
+        "signed",     G_TYPE_BOOLEAN, TRUE, 
+        "width",      G_TYPE_INT, filter->width, 
+        "depth",      G_TYPE_INT, SPDIF_DEFAULT_DEPTH, 
+        "rate",       G_TYPE_INT, rate,
+        "channels",   G_TYPE_INT, filter->channels, 
+        NULL);
+    ret = gst_pad_set_caps(filter->srcpad, caps);
+    gst_caps_unref(caps);
+    if (!ret) {
+        GST_ERROR("Could not set src caps for rate %d.\n", rate);
+        filter->capsSet = FALSE;
         return FALSE;
     }
-
-    if (!filter->capsSet) {
-        caps = gst_caps_new_simple("audio/x-raw-int",
-            "endianness", G_TYPE_INT, G_BYTE_ORDER, 
-            "signed",     G_TYPE_BOOLEAN, TRUE, 
-            "width",      G_TYPE_INT, filter->width, 
-            "depth",      G_TYPE_INT, SPDIF_DEFAULT_DEPTH, 
-            "rate",       G_TYPE_INT, SPDIF_DEFAULT_RATE,
-            "channels",   G_TYPE_INT, SPDIF_DEFAULT_CHANNELS, 
-            NULL);
-        gst_pad_set_caps(filter->srcpad, caps);
-        gst_caps_unref(caps);
-        filter->capsSet = TRUE;
-        
-    }
+    filter->capsSet = TRUE;
+    filter->rate = rate;
     filter->src_caps = GST_PAD_CAPS(filter->srcpad);
-
-    ret = gst_pad_alloc_buffer_and_set_caps(filter->srcpad, 0,
-                                            buf_len,
-                                            filter->src_caps, &buf);       
-
-    if (ret != GST_FLOW_OK) {
-        g_print("Could not alloc buffer, ret= %d.\n",ret);
-        return FALSE;
-    }   
-
-    pout = (guint8 *)GST_BUFFER_DATA(buf);
-    if (filter->width == 32) {
-        memcpy(pout, pReSData, buf_len);
-
-    }
-    else if (filter->width == 16) {
-        memset(pout, 0, buf_len);
-        memcpy(pout,pReSData, DEFAULT_BURST_PREAMBLE_HEAD_LEN);
-        memcpy(pout + DEFAULT_BURST_PREAMBLE_HEAD_LEN, data, len);
-    }
-
-    GST_BUFFER_SIZE(buf) = buf_len;
-    GST_BUFFER_DATA(buf) = pout;
-
-    SPDIFTX_FREE(pReSData);
-
-    ret = gst_pad_push(filter->srcpad, buf);
-    if (ret != GST_FLOW_OK) {
-        GST_ERROR(" not able to push the data ,ret = %d.\n",ret);
-        return GST_FLOW_ERROR;
-    }
-
-    return GST_FLOW_OK;
-
+    return TRUE;
 }
 
-static gboolean mfw_gst_spdiftx_pushavail(MfwGstSpdifTX *filter) 
+/*=============================================================================
+ FUNCTION:          mfw_gst_spdiftx_pack_push
+ DESCRIPTION:       Pack all complete frames in the adapter into IEC 61937
+                    bursts. The frames are walked by the size in their
+                    header, the bursts of one call are written in a single
+                    pass into one buffer from downstream, a new buffer is
+                    started when the rate changes. E-AC-3 frames are
+                    grouped into bursts of 6 audio blocks (1536 samples),
+                    together with the dependent substreams of the last
+                    independent frame, each padded to the 6144 frame
+                    period at 4 times the rate.
+ ARGUMENTS PASSED:
+        filter     -    pointer to the element
+        eos        -    pack an incomplete E-AC-3 group too
+ RETURN VALUE:      GST_FLOW_OK, or the error of the downstream element
+=============================================================================*/
+static GstFlowReturn
+mfw_gst_spdiftx_pack_push(MfwGstSpdifTX *filter, gboolean eos)
 {
-    guint len = gst_adapter_available(filter->pInAdapt);
-    guint8 *data = gst_adapter_peek(filter->pInAdapt, len);
-
-    guint16 *pIn = (guint16 *)data;
-
-    /* Check if there is available data to push */
-    if (len == 0)
-        return TRUE;
+    SpdifTxBurst bursts[SPDIFTX_MAX_BURSTS];
+    MfwGstIec61937Frame frame, next;
+    GstFlowReturn ret = GST_FLOW_OK;
+    GstBuffer *buf;
+    guint8 *data, *pout;
+    guint len, pos, end, total, samples, rate, brate, n, i;
+    guint bpf = filter->channels * (filter->width >> 3);
+    gboolean wait, more;
 
-    if ( (*pIn == AC3_SYNC_WORD_LSB) 
-         || (*pIn == AC3_SYNC_WORD_MSB) ) {
-         mfw_gst_spdif_ac3_repack_push(filter,data, len);
+    if ((filter->width != 16) && (filter->width != 32)) {
+        GST_WARNING("Not support this width:%d.",filter->width);
+        gst_adapter_clear(filter->pInAdapt);
+        return GST_FLOW_OK;
     }
-    gst_adapter_flush(filter->pInAdapt,len);
 
-    
-    return TRUE;
-}
+    do {
+        len = gst_adapter_available(filter->pInAdapt);
+        if (len < MFW_GST_IEC61937_FRAME_HEADER_LEN)
+            break;
+        data = (guint8 *)gst_adapter_peek(filter->pInAdapt, len);
+
+        pos = 0;
+        n = 0;
+        total = 0;
+        rate = 0;
+        more = FALSE;
+        while ((n < SPDIFTX_MAX_BURSTS)
+               && (len - pos >= MFW_GST_IEC61937_FRAME_HEADER_LEN)) {
+            SpdifTxBurst *burst = &bursts[n];
+
+            if (!mfw_gst_iec61937_frame_info(data + pos, len - pos, &frame)) {
+                pos += 1 + mfw_gst_iec61937_find_frame(data + pos + 1,
+                                                       len - pos - 1);
+                continue;
+            }
 
-static gboolean mfw_gst_find_ac3sync(MfwGstSpdifTX *filter) 
-{
-    guint len = gst_adapter_available(filter->pInAdapt);
-    guint8 *data = gst_adapter_peek(filter->pInAdapt, len);
-    guint8 *pout;
-    guint32 buf_size;
-    gint i;
-    GstFlowReturn ret;
+            burst->offset = pos;
+            burst->type = frame.type;
+            burst->le = frame.le;
+            end = pos + frame.size;
+            if (end > len)
+                break;
+
+            if (frame.type == MFW_GST_IEC61937_EAC3) {
+                /* group frames up to 6 audio blocks, the burst is padded
+                   to the repetition period, dependent substreams stay with
+                   their independent frame */
+                samples = frame.samples;
+                wait = FALSE;
+                while (TRUE) {
+                    if (len - end < MFW_GST_IEC61937_FRAME_HEADER_LEN) {
+                        wait = TRUE;
+                        break;
+                    }
+                    if ((!mfw_gst_iec61937_frame_info(data + end, len - end,
+                                                      &next))
+                        || (next.type != MFW_GST_IEC61937_EAC3))
+                        break;
+                    if ((samples >= MFW_GST_IEC61937_EAC3_SAMPLES)
+                        && (next.samples != 0))
+                        break;
+                    if (end + next.size > len) {
+                        wait = TRUE;
+                        break;
+                    }
+                    end += next.size;
+                    samples += next.samples;
+                }
+                if (wait && (!eos))
+                    break;
+            }
 
-    i = 0;
-  
-    while (i < len - 1) {
-        guint16 *pIn;
-        pIn = (guint16 *)(data + i);
-        switch (filter->status) {
-        case SPDIF_STATE_NULL:
-            if ( (*pIn == AC3_SYNC_WORD_LSB) 
-                 || (*pIn == AC3_SYNC_WORD_MSB) ) {
-                filter->status = SPDIF_STATE_SYNC1;
-                filter->sync1 = i;
-                GST_DEBUG("find sync word:%d\n",i);
+            burst->len = end - pos;
+            burst->size = mfw_gst_iec61937_period(burst->type) * bpf;
+            if ((((burst->len + 1) & ~1) + MFW_GST_IEC61937_HEADER_LEN)
+                * (filter->width >> 4) > burst->size) {
+                GST_WARNING("Frame length %d exceeds the burst length %d.\n",
+                            burst->len, burst->size);
+                pos = end;
+                continue;
             }
-            break;
-        case SPDIF_STATE_SYNC1:
-           if ( (*pIn == AC3_SYNC_WORD_LSB) 
-                 || (*pIn == AC3_SYNC_WORD_MSB) ) {
-                filter->sync2 = i;
-                if (filter->sync2 < filter->sync1)
-                {
-                    GST_WARNING("The second sync position is wrong");
-                    filter->status = SPDIF_STATE_NULL;
-                    gst_adapter_flush(filter->pInAdapt,filter->sync1);
-                    return FALSE;
-                    
-                }
-                buf_size = filter->sync2-filter->sync1;
-                GST_DEBUG("find 2 sync word:%d,get valid data %d.\n",i,buf_size);
-                ret = mfw_gst_spdif_ac3_repack_push(filter,
-                    data+filter->sync1, buf_size);
-                filter->status = SPDIF_STATE_NULL;
-                gst_adapter_flush(filter->pInAdapt,filter->sync2);
-                if (ret != GST_FLOW_OK)
-                    return  FALSE;
-                else
-                    return TRUE;            
-
-            }   
-            break;
-   
-        default:
+
+            /* E-AC-3 is sent at 4 times the sample rate */
+            brate = frame.rate ? frame.rate : SPDIF_DEFAULT_RATE;
+            if (burst->type == MFW_GST_IEC61937_EAC3)
+                brate *= 4;
+            if ((n > 0) && (brate != rate)) {
+                /* new caps, packed into the next buffer */
+                more = TRUE;
+                break;
+            }
+            rate = brate;
+            pos = end;
+            total += burst->size;
+            n++;
+        }
+
+        if (n == 0) {
+            gst_adapter_flush(filter->pInAdapt, pos);
             break;
         }
-        i++;
-    }
 
-    if (filter->status == SPDIF_STATE_SYNC1)
-        filter->status = SPDIF_STATE_NULL;
+        if (!mfw_gst_spdiftx_set_rate(filter, rate))
+            return GST_FLOW_NOT_NEGOTIATED;
+        ret = gst_pad_alloc_buffer_and_set_caps(filter->srcpad, 0,
+                                                total,
+                                                filter->src_caps, &buf);       
+        if (ret != GST_FLOW_OK) {
+            GST_ERROR("Could not alloc buffer, ret= %d.\n",ret);
+            return ret;
+        }   
+
+        pout = GST_BUFFER_DATA(buf);
+        for (i = 0; i < n; i++) {
+            mfw_gst_iec61937_pack(pout, bursts[i].size, filter->width,
+                                  bursts[i].type, data + bursts[i].offset,
+                                  bursts[i].len, bursts[i].le);
+            pout += bursts[i].size;
+        }
+        GST_BUFFER_SIZE(buf) = total;
+        GST_DEBUG("Packed %d bursts, %d bytes.\n", n, total);
+
+        gst_adapter_flush(filter->pInAdapt, pos);
+
+        ret = gst_pad_push(filter->srcpad, buf);
+        if (ret != GST_FLOW_OK) {
+            GST_ERROR(" not able to push the data ,ret = %d.\n",ret);
+            return ret;
+        }
+    } while (more || (n == SPDIFTX_MAX_BURSTS));
 
-    return FALSE;
+    return ret;
 }
 
 static GstFlowReturn
@@ -534,16 +530,11 @@ mfw_gst_spdiftx_process_frame(MfwGstSpdifTX *filter, GstBuffer *buf)
         }
         return GST_FLOW_OK;
     }
-    else if (filter->media_type == MEDIA_TYPE_AC3) {
-        /* AC3 type handling */
+    else if ((filter->media_type == MEDIA_TYPE_AC3)
+             || (filter->media_type == MEDIA_TYPE_DTS)) {
+        /* AC-3, E-AC-3 and DTS are packed by the frame headers */
         gst_adapter_push(filter->pInAdapt, buf);
-        ret = mfw_gst_find_ac3sync(filter);
-
-        while(ret == TRUE) {
-            ret = mfw_gst_find_ac3sync(filter);
-        };
-        return GST_FLOW_OK;
-        
+        return mfw_gst_spdiftx_pack_push(filter, FALSE);
         
     }
     else {
@@ -561,21 +552,25 @@ mfw_gst_spdiftx_process_frame(MfwGstSpdifTX *filter, GstBuffer *buf)
 gboolean mfw_gst_spdiftx_mediadetect(MfwGstSpdifTX *filter, GstBuffer *buf)
 {
     guint8 *data = GST_BUFFER_DATA(buf);
-    gint i;
+    guint len = GST_BUFFER_SIZE(buf);
+    MfwGstIec61937Frame frame;
+    guint i = 0;
 
     /* Set default media type is PCM */
     filter->media_type = MEDIA_TYPE_PCM;
 
-    /* Check the first buffer, if there is syncword of AC3 */
-    for (i = 0; i< GST_BUFFER_SIZE(buf); i++)
+    /* Check the first buffer, if there is a frame header */
+    while (i + MFW_GST_IEC61937_FRAME_HEADER_LEN <= len)
     {
-        
-        guint16 *p16 = (guint16 *)(data + i);
-        if ( (*p16 == AC3_SYNC_WORD_LSB) || (*p16 == AC3_SYNC_WORD_MSB))
-        {
-            filter->media_type = MEDIA_TYPE_AC3;
+        if (mfw_gst_iec61937_frame_info(data + i, len - i, &frame)) {
+            if ((frame.type == MFW_GST_IEC61937_AC3)
+                || (frame.type == MFW_GST_IEC61937_EAC3))
+                filter->media_type = MEDIA_TYPE_AC3;
+            else
+                filter->media_type = MEDIA_TYPE_DTS;
             break;
         }
+        i += 1 + mfw_gst_iec61937_find_frame(data + i + 1, len - i - 1);
     }
     
     GST_DEBUG("\nDetected media type is:%d.\n",filter->media_type);
@@ -607,28 +602,10 @@ mfw_gst_spdiftx_chain (GstPad *pad, GstBuffer *buf)
         /* Auto detect the input media type */
         mfw_gst_spdiftx_mediadetect(filter, buf);
 
-        if (filter->media_type == MEDIA_TYPE_AC3) {
+        if (filter->media_type != MEDIA_TYPE_PCM) {
+            /* src caps follow the rate of the first frame packed */
             GST_DEBUG
-                ("Set SRC pad to AC3 type, need iec937 repack.");
-            filter->burst_info.pa = SPDIF_IEC937_SYNC1;
-            filter->burst_info.pb = SPDIF_IEC937_SYNC2;
-            filter->burst_info.pc = SPDIF_BURST_AC3_DATA;
-
-            if (!filter->capsSet) {
-               caps = gst_caps_new_simple("audio/x-raw-int",
-                        "endianness", G_TYPE_INT, G_BYTE_ORDER, 
-                        "signed",     G_TYPE_BOOLEAN, TRUE, 
-                        "width",      G_TYPE_INT, filter->width, 
-                        "depth",      G_TYPE_INT, SPDIF_DEFAULT_DEPTH, 
-                        "rate",       G_TYPE_INT, SPDIF_DEFAULT_RATE,
-                        "channels",   G_TYPE_INT, SPDIF_DEFAULT_CHANNELS, 
-                        NULL);
-                gst_pad_set_caps(filter->srcpad, caps);
-                gst_caps_unref(caps);
-                filter->capsSet = TRUE;
-        
-            }
-
+                ("Set SRC pad to iec937 type, need iec937 repack.");
         }
         else if (filter->media_type == MEDIA_TYPE_PCM) {
             caps = gst_caps_new_simple("audio/x-raw-int",
@@ -708,8 +685,8 @@ mfw_gst_spdiftx_class_init (gpointer klass)
         G_OBJECT_CLASS (klass), 
         PROPER_ID_MEDIA_TYPE, 
         g_param_spec_int ("media-type", "input media type", 
-        "Input Media Type: 0: PCM, 1: AC3", 
-        0, 1,
+        "Input Media Type: 0: PCM, 1: AC3/E-AC3, 2: DTS", 
+        0, 2,
         SPDIF_DEFAULT_MEDIA_TYPE, G_PARAM_READWRITE)
     ); 
     
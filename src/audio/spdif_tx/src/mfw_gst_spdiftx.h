@@ -42,6 +42,7 @@
 #define __MFW_GST_SPDIFTX_H__
 
 #include <gst/gst.h>
+#include "mfw_gst_iec61937.h"
 
 /*=============================================================================
                                            CONSTANTS
@@ -96,7 +97,8 @@ enum {
 };
 typedef enum {
     MEDIA_TYPE_PCM = 0,
-    MEDIA_TYPE_AC3,
+    MEDIA_TYPE_AC3,             /* AC-3 and E-AC-3 */
+    MEDIA_TYPE_DTS,
 }MEDIA_TYPE;
 
 /*=============================================================================
@@ -124,14 +126,13 @@ typedef struct _MfwGstSpdifTX
     GstPad *sinkpad, *srcpad;
     gboolean capsSet;
     gboolean init;
-    burst_struct burst_info;
     guint8 depth;
     guint32 width;
     guint32 channels;
     guint32 frame_len;
     MEDIA_TYPE media_type;
     GstAdapter * pInAdapt;
-    gint sync1,sync2;
+    guint32 rate;               /* stream frame rate of the src caps */
     GstCaps *src_caps;
     gint status;
     
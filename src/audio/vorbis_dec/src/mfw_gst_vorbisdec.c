@@ -45,6 +45,7 @@
 #include <gst/base/gstadapter.h>
 #include <string.h>
 #include "oggvorbis_dec_api.h"
+#include "mfw_gst_blkts.h"
 #include "mfw_gst_vorbisdec.h"
 #include <gst/audio/multichannel.h>
 #include "mfw_gst_utils.h"
@@ -150,126 +151,6 @@ static MFW_GST_VORBISDEC_INFO_T *vorbisdec_global_ptr = NULL;
 =============================================================================*/
 
 
-#define COPY_BLOCK_TIMESTAMP(des, src) \
-    do { \
-        des->buflen = src->buflen; \
-        des->timestamp = src->timestamp; \
-    }while(0)
-
-void init_tsmanager(Timestamp_Manager *tm)
-{
-    memset(tm, 0, sizeof(Timestamp_Manager));
-}
-
-void deinit_tsmanager(Timestamp_Manager *tm)
-{
-    if (tm->allocatedbuffer){
-        g_free(tm->allocatedbuffer);
-    }
-    memset(tm, 0, sizeof(Timestamp_Manager));
-}
-
-void clear_tsmanager(Timestamp_Manager *tm)
-{
-    int i;
-    Block_Timestamp * bt = tm->allocatedbuffer;
-    tm->freelist = tm->head = tm->tail = NULL;
-    for (i=0;i<tm->allocatednum;i++){
-        bt->next = tm->freelist;
-        tm->freelist = bt;
-        bt++;
-    }
-}
-
-Block_Timestamp * new_block_timestamp(Timestamp_Manager *tm)
-{
-    Block_Timestamp * newbuffer;
-    if (tm->freelist){
-        newbuffer = tm->freelist;
-        tm->freelist = newbuffer->next;
-        return newbuffer;
-    }
-    if (tm->allocatednum)
-        tm->allocatednum <<=1;
-    else
-        tm->allocatednum = 4;
-    if (newbuffer=g_malloc(sizeof(Block_Timestamp)*tm->allocatednum)) {
-        Block_Timestamp *oldhead, *nb;
-        int i = 0;
-
-        oldhead = tm->head;
-        nb = newbuffer;
-        tm->freelist = tm->head = tm->tail = NULL;
-        for (i=0;i<(tm->allocatednum-1);i++){
-            if (oldhead){
-                COPY_BLOCK_TIMESTAMP(nb, oldhead);
-                nb->next = NULL;
-                if (tm->tail){
-                    (tm->tail)->next = nb;
-                    tm->tail = nb;
-                }else{
-                    tm->head = tm->tail = nb;
-                }
-                oldhead = oldhead->next;
-            }else{
-                nb->next = tm->freelist;
-                tm->freelist = nb;
-            }
-            nb++;
-        }
-        if (tm->allocatedbuffer){
-            g_free(tm->allocatedbuffer);
-        }
-        tm->allocatedbuffer = newbuffer;
-        return nb;
-    }else{
-        return newbuffer;
-    }
-}
-
-gboolean push_block_with_timestamp(Timestamp_Manager *tm, guint blen, GstClockTime timestamp)
-{
-    Block_Timestamp * bt;
-    if (bt = new_block_timestamp(tm)){
-        bt->buflen = blen;
-        bt->timestamp = timestamp;
-        bt->next = NULL;
-        if (tm->tail){
-            (tm->tail)->next = bt;
-            tm->tail = bt;
-        }else{
-            tm->head = tm->tail = bt;
-        }
-        return TRUE;
-    }else{
-        return FALSE;
-    }
-}
-
-GstClockTime get_timestamp_with_length(Timestamp_Manager *tm, guint length)
-{
-    GstClockTime ts = -1;
-    Block_Timestamp * bt = tm->head;
-    if (bt){
-        ts = bt->timestamp;
-        while(length>=bt->buflen){
-            length-=bt->buflen;
-            if (bt==tm->tail){
-                tm->tail=NULL;
-            }
-            tm->head = bt->next;
-            bt->next = tm->freelist;
-            tm->freelist = bt;
-            bt = tm->head;
-            if (!bt) break;
-        }
-        if (bt){
-            bt->buflen-=length;
-        }
-    }
-    return ts;
-}
-
 /***************************************************************************
 *
 *   FUNCTION NAME - vorbisd_free
@@ -525,6 +406,7 @@ mfw_gst_vorbisdec_data(MFW_GST_VORBISDEC_INFO_T * vordec_info,
     guint8 *inbuffer = NULL;
     GstFlowReturn res = GST_FLOW_ERROR;
     GstClockTime ts;
+    gboolean discont;
     guint64 time_duration = 0;
     sOggVorbisDecObj * psOVDecObj = NULL;
     guint8 *pcmout;
@@ -606,10 +488,14 @@ mfw_gst_vorbisdec_data(MFW_GST_VORBISDEC_INFO_T * vordec_info,
     /* The timestamp in nanoseconds     of the data     in the buffer. */
     GST_DEBUG(RED_STR("len = %d, samplerate = %d",psOVDecObj->outNumSamples, psOVDecObj->SampleRate));
 
-    ts = get_timestamp_with_length(&vordec_info->tsMgr, consumelen);
+    ts = mfw_gst_blkts_consume(&vordec_info->tsMgr, consumelen, &discont);
     if (GST_CLOCK_TIME_IS_VALID(ts)){
         //g_print(RED_STR("consumelen = %d time_offset = %lld ts = %lld \n", consumelen, vordec_info->time_offset, ts));
-        if ((ts>vordec_info->time_offset) && (ts-vordec_info->time_offset>TIMESTAMP_DIFF_MAX_IN_NS)){
+        if (discont){
+            GST_DEBUG(RED_STR("discont, resync to %lld", ts));
+            vordec_info->time_offset = ts;
+        }
+        else if ((ts>vordec_info->time_offset) && (ts-vordec_info->time_offset>TIMESTAMP_DIFF_MAX_IN_NS)){
             GST_DEBUG(RED_STR("error timestamp"));
             GST_DEBUG(RED_STR("time_offset=%lld, ts=%lld ",vordec_info->time_offset,ts));
             vordec_info->time_offset = ts;
@@ -702,9 +588,9 @@ mfw_gst_vorbisdec_chain(GstPad * pad, GstBuffer * buf)
             gst_adapter_push(vordec_info->pAdapter, gst_buffer_ref(vordec_info->codec_data));
             vordec_info->codec_data = NULL;
         }
+        mfw_gst_blkts_push(&vordec_info->tsMgr, GST_BUFFER_SIZE(buf),
+                           GST_BUFFER_TIMESTAMP(buf), GST_BUFFER_IS_DISCONT(buf));
         gst_adapter_push(vordec_info->pAdapter, buf);
-        push_block_with_timestamp(&vordec_info->tsMgr, GST_BUFFER_SIZE(buf),
-                                   GST_BUFFER_TIMESTAMP(buf));
 
         if ((inbuffsize = gst_adapter_available(vordec_info->pAdapter))<BS_BUF_SIZE)
             return GST_FLOW_OK;
@@ -774,9 +660,9 @@ mfw_gst_vorbisdec_chain(GstPad * pad, GstBuffer * buf)
         vordec_info->init_done = TRUE;
         return GST_FLOW_OK;
     }
+    mfw_gst_blkts_push(&vordec_info->tsMgr, GST_BUFFER_SIZE(buf),
+                       GST_BUFFER_TIMESTAMP(buf), GST_BUFFER_IS_DISCONT(buf));
     gst_adapter_push(vordec_info->pAdapter, buf);
-    push_block_with_timestamp(&vordec_info->tsMgr, GST_BUFFER_SIZE(buf),
-                               GST_BUFFER_TIMESTAMP(buf));
 
     while ((inbuffsize = gst_adapter_available(vordec_info->pAdapter))>(BS_BUF_SIZE)){
         gint flushlen;
@@ -858,7 +744,7 @@ mfw_gst_vorbisdec_change_state(GstElement * element,
            "sampling frequency (Hz)","sampling frequency (Hz)", NULL);
 
         vordec_info->pAdapter = gst_adapter_new();
-        init_tsmanager(&vordec_info->tsMgr);
+        mfw_gst_blkts_init(&vordec_info->tsMgr);
 
         break;
     case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
@@ -889,7 +775,7 @@ mfw_gst_vorbisdec_change_state(GstElement * element,
 
         gst_adapter_clear(vordec_info->pAdapter);
         g_object_unref(vordec_info->pAdapter);
-        deinit_tsmanager(&vordec_info->tsMgr);
+        mfw_gst_blkts_deinit(&vordec_info->tsMgr);
 
         break;
 
@@ -1492,7 +1378,7 @@ mfw_gst_vorbisdec_sink_event(GstPad * pad, GstEvent * event)
             GST_DEBUG("GST_EVENT_FLUSH_STOP");
 
             gst_adapter_clear(vordec_info->pAdapter);
-            clear_tsmanager(&vordec_info->tsMgr);
+            mfw_gst_blkts_clear(&vordec_info->tsMgr);
 
             result = gst_pad_push_event(vordec_info->srcpad, event);
             if (TRUE != result) {
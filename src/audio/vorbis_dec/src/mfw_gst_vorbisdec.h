@@ -75,21 +75,6 @@ G_BEGIN_DECLS
 /*=============================================================================
                                  STRUCTURES AND OTHER TYPEDEFS
 =============================================================================*/
- typedef struct _blocktimestamp{
-     struct _blocktimestamp * next;
-     guint buflen;
-     GstClockTime timestamp;
- }Block_Timestamp;
-
- typedef struct _timestampmanager{
-     Block_Timestamp * allocatedbuffer;
-     Block_Timestamp * freelist;
-     Block_Timestamp * head;
-     Block_Timestamp * tail;
-     guint  allocatednum;
- }Timestamp_Manager;
-
-
 typedef struct MFW_GST_VORBISDEC_INFO_S {
         GstElement element;
         GstPad *sinkpad;
@@ -111,7 +96,7 @@ typedef struct MFW_GST_VORBISDEC_INFO_S {
         guint64 buffer_time;
         gboolean corrupt_bs;
         GstAdapter * pAdapter;
-        Timestamp_Manager tsMgr;
+        MfwGstBlockTs tsMgr;
         gint error_cnt;
         gint packetised;
         GstBuffer *extra_codec_data;
@@ -141,6 +141,8 @@ static GstStateChangeReturn mfw_gst_wma8enc_change_state (GstElement * element,
 							 transition);
 static GstFlowReturn mfw_gst_wma8enc_encode_frame (MfwGstWma8EncInfo * wma8enc,
 						  gboolean eos);
+static gint mfw_gst_wma8enc_encode_packet (gpointer user_data, guint8 * in,
+						  guint8 * out, GstClockTime timestamp);
 static GstFlowReturn mfw_gst_wma8enc_chain (GstPad * pad, GstBuffer * buf);
 
 static void* alloc_align (int size);
@@ -488,14 +490,10 @@ mfw_gst_wma8enc_sink_event (GstPad * pad, GstEvent * event)
                 GstFlowReturn result = GST_FLOW_OK;
                 GstAdapter *adapter = wma8enc->adapter;
 
-                while (gst_adapter_available(adapter) >= wma8enc->frameSize) {
-                    wma8enc->inbuf = (guint8*)gst_adapter_peek(adapter, wma8enc->frameSize);
-                    wma8enc->total_input += wma8enc->frameSize;
-                    result = mfw_gst_wma8enc_encode_frame (wma8enc, FALSE);
-                    if (result != GST_FLOW_OK) 
-                        return result;
-                    gst_adapter_flush(adapter, wma8enc->frameSize);
-                }
+                result = mfw_gst_aenc_batch_encode (&wma8enc->batch, adapter,
+                        mfw_gst_wma8enc_encode_packet, wma8enc);
+                if (result != GST_FLOW_OK) 
+                    return result;
 
                 /* send the last frame */
                 wma8enc->inbuf = g_malloc(wma8enc->frameSize);
@@ -733,12 +731,12 @@ mfw_gst_wma8enc_chain (GstPad * pad, GstBuffer * buf)
         for(i = 0; i < nr; i++) {
             mem = &(psEncConfig->sWMAEMemInfo.sMemInfoSub[i]);
             if (mem->s32WMAEType == WMAE_FAST_MEMORY) {
-                mem->app_base_ptr = alloc_align (mem->s32WMAESize);
+                mem->app_base_ptr = mfw_gst_aenc_mem_alloc (mem->s32WMAESize, ALIGN);
                 if (mem->app_base_ptr == NULL)
                     return GST_FLOW_ERROR;
             }
             else {
-                mem->app_base_ptr = alloc_align (mem->s32WMAESize);
+                mem->app_base_ptr = mfw_gst_aenc_mem_alloc (mem->s32WMAESize, ALIGN);
                 if (mem->app_base_ptr == NULL)
                     return GST_FLOW_ERROR;
             }
@@ -863,6 +861,11 @@ mfw_gst_wma8enc_chain (GstPad * pad, GstBuffer * buf)
         result = mfw_gst_wma8enc_set_asf_header(wma8enc);
         if (result != GST_FLOW_OK) 
             return result;
+
+        /* frames are encoded in place from the adapter, the ASF byte
+         * stream carries no timestamps */
+        mfw_gst_aenc_batch_init (&wma8enc->batch, wma8enc->srcpad,
+                wma8enc->frameSize, psASFParams->g_asf_packet_size, 0, FALSE);
         wma8enc->init = TRUE;
     }
 
@@ -888,16 +891,9 @@ mfw_gst_wma8enc_chain (GstPad * pad, GstBuffer * buf)
     }
 }
 
-    while (gst_adapter_available(adapter) >= wma8enc->frameSize) {
-        wma8enc->inbuf = (guint8*)gst_adapter_peek(adapter, wma8enc->frameSize);
-        wma8enc->total_input += wma8enc->frameSize;
-        result = mfw_gst_wma8enc_encode_frame (wma8enc, FALSE);
-        if (result != GST_FLOW_OK) 
-            return result;
-        gst_adapter_flush(adapter, wma8enc->frameSize);
-    }
-
-	return GST_FLOW_OK;
+    /* the ASF packets of all complete frames go out in one buffer */
+    return mfw_gst_aenc_batch_encode (&wma8enc->batch, adapter,
+            mfw_gst_wma8enc_encode_packet, wma8enc);
 }
 
 
@@ -997,13 +993,15 @@ mfw_gst_wma8enc_deinit_resource(MfwGstWma8EncInfo *wma8enc)
     WMAEMemAllocInfoSub *mem;
     gint i, nr;
 
+    mfw_gst_aenc_batch_free (&wma8enc->batch);
+
     if (psEncConfig == NULL)
         return FALSE;
 
     nr = psEncConfig->sWMAEMemInfo.s32NumReqs;
     for (i = 0; i < nr; i++) {
         if(psEncConfig->sWMAEMemInfo.sMemInfoSub[i].app_base_ptr)
-            free_Aligned (psEncConfig->sWMAEMemInfo.sMemInfoSub[i].app_base_ptr);
+            mfw_gst_aenc_mem_free (psEncConfig->sWMAEMemInfo.sMemInfoSub[i].app_base_ptr);
     }
 
     if (psEncConfig->psEncodeParams)
@@ -1105,6 +1103,47 @@ mfw_gst_wma8enc_encode_frame (MfwGstWma8EncInfo * wma8enc, gboolean eos)
 }
 
 
+/* encode one frame read in place from the adapter, the ASF packet, if
+ * one is completed, is written to the batched output */
+static gint
+mfw_gst_wma8enc_encode_packet (gpointer user_data, guint8 * in, guint8 * out,
+    GstClockTime timestamp)
+{
+    MfwGstWma8EncInfo *wma8enc = (MfwGstWma8EncInfo *) user_data;
+    WMAEEncoderConfig *psEncConfig = wma8enc->psEncConfig;
+    WMAEEncoderParams *psEncParams = psEncConfig->psEncodeParams;
+    ASFParams *psASFParams = wma8enc->psASFParams;
+    tWMAEncodeStatus iStatus;
+    ASFRESULTS rcAsf;
+    gint size;
+
+    if (wma8enc->demo_mode == 2)
+        return -1;
+
+    wma8enc->total_input += wma8enc->frameSize;
+
+    iStatus = eWMAEncodeFrame(psEncConfig, in, wma8enc->outbuf, FALSE);
+    if((int)iStatus < 0) {
+        GST_ERROR("WMA Encode Frame Failed!\n");
+        return -1;
+    }
+
+    if (!psEncParams->WMAE_isPacketReady)
+        return 0;
+
+    rcAsf = asf_packetize (psASFParams, wma8enc->outbuf, out, TRUE, psEncParams->WMAE_nEncodeSamplesDone);
+    if(rcAsf != cASF_NoErr) {
+        GST_ERROR("Add Asf packet failed.\n");
+        return -1;
+    }
+
+    size = psASFParams->g_space_in_packet + ASF_HEADER;
+    psASFParams->asf_file_size += size;
+
+    return size;
+}
+
+
 static GstFlowReturn
 mfw_gst_wma8enc_set_asf_header(MfwGstWma8EncInfo * wma8enc)
 {
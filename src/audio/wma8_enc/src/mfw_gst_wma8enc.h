@@ -49,6 +49,7 @@
 #include <gst/base/gstadapter.h>
 #include "wma8_enc_interface.h"
 #include "asf.h"
+#include "mfw_gst_aenc.h"
 /*=============================================================================
                                            CONSTANTS
 =============================================================================*/
@@ -87,6 +88,7 @@ struct _MfwGstWma8EncInfo
   GstElement element;
   GstPad *sinkpad, *srcpad;
   GstAdapter *adapter;
+  MfwGstAencBatch batch;
 
   WMAEEncoderConfig *psEncConfig;
   ASFParams *psASFParams;
@@ -50,6 +50,7 @@
 #include <unistd.h>
 #include "linux/mxcfb.h"
 #include "gstbufmeta.h"
+#include "hwbuffer_allocator.h"
 #include "mfw_gst_video_surface.h"
 #include <sys/time.h>
 
@@ -87,6 +88,11 @@ typedef enum
   ISINK_PROP_COLORKEY_GREEN,
   ISINK_PROP_COLORKEY_BLUE,
 
+  ISINK_PROP_DUMP_LOCATION,
+  ISINK_PROP_DUMP_INTERVAL,
+  ISINK_PROP_DUMP_ROI,
+  ISINK_PROP_DUMP_DROPPED,
+
   /* display0 = LCD */
   ISINK_PROP_DISP_NAME_0,
   ISINK_PROP_DISP_MODE_0,
@@ -636,9 +642,59 @@ mfw_gst_isink_close (MfwGstISink * isink)
     isink->curbuf = NULL;
   }
 
+  if (isink->dump) {
+    mfw_gst_fdump_free (isink->dump);
+    isink->dump = NULL;
+  }
+
   isink->closed = TRUE;
 }
 
+static void
+mfw_gst_isink_dump_open (MfwGstISink * isink)
+{
+  if ((isink->dump_location == NULL) || (isink->dump))
+    return;
+
+  isink->dump = mfw_gst_fdump_new (isink->dump_location, 0);
+  if (isink->dump == NULL) {
+    GST_ERROR ("Could not open file \"%s\" for writing.",
+        isink->dump_location);
+    return;
+  }
+
+  mfw_gst_fdump_set_interval (isink->dump, isink->dump_interval);
+  mfw_gst_fdump_set_roi (isink->dump, isink->dump_roi[0], isink->dump_roi[1],
+      isink->dump_roi[2], isink->dump_roi[3]);
+}
+
+static void
+mfw_gst_isink_dump_frame (MfwGstISink * isink, GstBuffer * gstbuf)
+{
+  MfwGstDumpFrame frame;
+  SourceFmt *fmt;
+
+  /* buffers to be copied come in the original layout */
+  if (isink->need_force_copy)
+    fmt = &isink->icfg.origsrcfmt;
+  else
+    fmt = &isink->icfg.srcfmt;
+
+  frame.fourcc = fmt->fmt;
+  frame.data = GST_BUFFER_DATA (gstbuf);
+  frame.size = GST_BUFFER_SIZE (gstbuf);
+  frame.stride = fmt->croprect.width;
+  frame.plane_height = fmt->croprect.height;
+  frame.left = fmt->croprect.win.left;
+  frame.top = fmt->croprect.win.top;
+  frame.width = fmt->croprect.win.right - fmt->croprect.win.left;
+  frame.height = fmt->croprect.win.bottom - fmt->croprect.win.top;
+
+  if ((!mfw_gst_fdump_push (isink->dump, &frame))
+      && (!mfw_gst_fdump_post_error (isink->dump, GST_ELEMENT (isink))))
+    GST_LOG ("dump frame dropped");
+}
+
 #if 0
 void
 isink_free_external_frame (GstMfwBuffer * buf)
@@ -803,6 +859,7 @@ mfw_gst_isink_init_setting (MfwGstISink * isink, GstCaps * caps)
   }
 
 
+  mfw_gst_isink_dump_open (isink);
 
   isink->init = TRUE;
 }
@@ -911,11 +968,13 @@ mfw_gst_isink_buffer_alloc (GstBaseSink * bsink, guint64 offset,
     unsigned int *vaddr, *paddr;
     void *handle;
     if (!(handle =
-            mfw_new_hw_buffer (isink->icfg.framebufsize, &paddr, &vaddr, 0))) {
+            mfw_new_hw_buffer (isink->icfg.framebufsize, (void **) &paddr,
+                (void **) &vaddr, 0))) {
       GST_ERROR (">>I_SINK: Could not allocate hardware buffer");
       *buf = NULL;
       return GST_FLOW_ERROR;
     }
+    mfw_hw_buffer_set_owner (handle, "isink");
     ibuf = gst_buffer_new ();
     GST_BUFFER_SIZE (ibuf) = size;
     GST_BUFFER_DATA (ibuf) = vaddr;
@@ -1013,6 +1072,31 @@ mfw_gst_isink_set_property (GObject * object, guint prop_id,
     case ISINK_PROP_INPUT_CROP_BOTTOM:
       isink->cbottom = g_value_get_int (value);
       break;
+    case ISINK_PROP_DUMP_LOCATION:
+      if (isink->dump) {
+        g_warning ("Changing the `dump-location' property on isink when "
+            "a file is open not supported.");
+        break;
+      }
+      g_free (isink->dump_location);
+      isink->dump_location = g_value_dup_string (value);
+      break;
+    case ISINK_PROP_DUMP_INTERVAL:
+      isink->dump_interval = g_value_get_int (value);
+      if (isink->dump)
+        mfw_gst_fdump_set_interval (isink->dump, isink->dump_interval);
+      break;
+    case ISINK_PROP_DUMP_ROI:
+      if (!mfw_gst_fdump_parse_roi (g_value_get_string (value),
+              &isink->dump_roi[0], &isink->dump_roi[1], &isink->dump_roi[2],
+              &isink->dump_roi[3])) {
+        GST_WARNING ("invalid dump-roi, expect \"left,top,width,height\"");
+        memset (isink->dump_roi, 0, sizeof (isink->dump_roi));
+      }
+      if (isink->dump)
+        mfw_gst_fdump_set_roi (isink->dump, isink->dump_roi[0],
+            isink->dump_roi[1], isink->dump_roi[2], isink->dump_roi[3]);
+      break;
 
     default:
     {
@@ -1093,7 +1177,32 @@ static void
 mfw_gst_isink_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  MfwGstISink *isink = MFW_GST_ISINK (object);
+
+  switch (prop_id) {
+    case ISINK_PROP_DUMP_LOCATION:
+      g_value_set_string (value, isink->dump_location);
+      break;
+    case ISINK_PROP_DUMP_INTERVAL:
+      g_value_set_int (value, isink->dump_interval);
+      break;
+    case ISINK_PROP_DUMP_ROI:
+      g_value_take_string (value, g_strdup_printf ("%d,%d,%d,%d",
+              isink->dump_roi[0], isink->dump_roi[1], isink->dump_roi[2],
+              isink->dump_roi[3]));
+      break;
+    case ISINK_PROP_DUMP_DROPPED:
+    {
+      guint64 dropped = 0;
 
+      if (isink->dump)
+        mfw_gst_fdump_get_stats (isink->dump, NULL, &dropped, NULL);
+      g_value_set_uint64 (value, dropped);
+      break;
+    }
+    default:
+      break;
+  }
   return;
 }
 
@@ -1270,6 +1379,8 @@ mfw_gst_isink_show_frame (GstBaseSink * basesink, GstBuffer * gstbuf)
   gint index = G_N_ELEMENTS (gstbuf->_gst_reserved) - 1;
   GstBufferMeta *bufmeta = NULL;
 
+  if (isink->dump)
+    mfw_gst_isink_dump_frame (isink, gstbuf);
 
   if (isink->need_render_notify) {
     ISinkFrame *iframe = NULL;
@@ -1681,6 +1792,11 @@ mfw_gst_isink_init (MfwGstISink * isink, MfwGstISinkClass * klass)
   isink->colorkey_green = COLORKEY_GREEN;
   isink->colorkey_blue = COLORKEY_BLUE;
 
+  isink->dump_location = NULL;
+  isink->dump = NULL;
+  isink->dump_interval = 1;
+  memset (isink->dump_roi, 0, sizeof (isink->dump_roi));
+
 #ifdef USE_X11
   mfw_gst_fb0_set_colorkey (isink);
 #endif
@@ -1700,6 +1816,11 @@ mfw_gst_isink_finalize (GObject * object)
     isink->free_pool = g_list_remove (isink->free_pool, data);
     g_free (data);
   }
+  if (isink->dump) {
+    mfw_gst_fdump_free (isink->dump);
+    isink->dump = NULL;
+  }
+  g_free (isink->dump_location);
   PRINT_FINALIZE ("isink");
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -1794,6 +1915,29 @@ mfw_gst_isink_class_init (MfwGstISinkClass * klass)
           "set blue for colorkey",
           0, 255, COLORKEY_BLUE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, ISINK_PROP_DUMP_LOCATION,
+      g_param_spec_string ("dump-location",
+          "dump location",
+          "location of the file to write the input frames, the visible "
+          "rectangle of each frame is written by a background thread",
+          NULL, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, ISINK_PROP_DUMP_INTERVAL,
+      g_param_spec_int ("dump-interval",
+          "dump interval",
+          "dump one frame of every dump-interval frames",
+          1, G_MAXINT, 1, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, ISINK_PROP_DUMP_ROI,
+      g_param_spec_string ("dump-roi",
+          "dump region of interest",
+          "region of the visible image to dump as \"left,top,width,height\", "
+          "a zero width or height dumps the whole image",
+          NULL, G_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class, ISINK_PROP_DUMP_DROPPED,
+      g_param_spec_uint64 ("dump-dropped",
+          "dump dropped",
+          "frames not dumped because the writer could not keep up",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
 #if 1
   for (i = 0; i < VD_MAX + 1; i++) {
     if (queryVideoDevice (i, &klass->vd_desc[i]) != 0) {
@@ -42,6 +42,7 @@
 #include <gst/video/gstvideosink.h>
 
 #include "mfw_gst_video_surface.h"
+#include "mfw_gst_fdump.h"
 
 
 /*=============================================================================
@@ -196,6 +197,10 @@ struct _MfwGstISink
   gboolean need_use_ex_buffer;
   gboolean need_force_copy;
 
+  gchar *dump_location;         /* dump input frames to file */
+  MfwGstFrameDump *dump;
+  gint dump_interval;
+  gint dump_roi[4];             /* left, top, width, height */
 };
 
 /*=============================================================================
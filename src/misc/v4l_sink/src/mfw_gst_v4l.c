@@ -94,11 +94,13 @@ dumpfile_open (MFW_GST_V4LSINK_INFO_T * v4l_info)
   if (v4l_info->dump_location == NULL || v4l_info->dump_location[0] == '\0')
     goto no_dumpfilename;
 
-  v4l_info->dumpfile = fopen (v4l_info->dump_location, "wb");
-  if (v4l_info->dumpfile == NULL)
+  v4l_info->dump = mfw_gst_fdump_new (v4l_info->dump_location, 0);
+  if (v4l_info->dump == NULL)
     goto open_failed;
 
-  v4l_info->dump_length = 0;
+  mfw_gst_fdump_set_interval (v4l_info->dump, v4l_info->dump_interval);
+  mfw_gst_fdump_set_roi (v4l_info->dump, v4l_info->dump_roi[0],
+      v4l_info->dump_roi[1], v4l_info->dump_roi[2], v4l_info->dump_roi[3]);
 
   GST_DEBUG_OBJECT (v4l_info, "opened file %s", v4l_info->dump_location);
 
@@ -121,7 +123,8 @@ open_failed:
 /*=============================================================================
 FUNCTION:           dumpfile_close
 
-DESCRIPTION:        This function will close the location file.
+DESCRIPTION:        This function will write the pending frames and close the
+                    location file.
 
 ARGUMENTS PASSED:
 
@@ -134,20 +137,16 @@ IMPORTANT NOTES:    None
 void
 dumpfile_close (MFW_GST_V4LSINK_INFO_T * v4l_info)
 {
-  if (v4l_info->dumpfile) {
-    if (fclose (v4l_info->dumpfile) != 0)
-      goto close_failed;
+  if (v4l_info->dump) {
+    guint64 written, dropped, bytes;
 
-    GST_DEBUG_OBJECT (v4l_info, "closed file");
-    v4l_info->dumpfile = NULL;
-  }
-  return;
+    mfw_gst_fdump_get_stats (v4l_info->dump, &written, &dropped, &bytes);
+    mfw_gst_fdump_free (v4l_info->dump);
+    v4l_info->dump = NULL;
 
-  /* ERRORS */
-close_failed:
-  {
-    GST_ERROR ("Error closing file:%s", v4l_info->dump_location);
-    return;
+    GST_DEBUG_OBJECT (v4l_info, "closed file, %" G_GUINT64_FORMAT
+        " frames %" G_GUINT64_FORMAT " bytes written, %" G_GUINT64_FORMAT
+        " frames dropped", written, bytes, dropped);
   }
 }
 
@@ -168,7 +167,7 @@ gboolean
 dumpfile_set_location (MFW_GST_V4LSINK_INFO_T * v4l_info,
     const gchar * location)
 {
-  if (v4l_info->dumpfile)
+  if (v4l_info->dump)
     goto was_open;
 
   g_free (v4l_info->dump_location);
@@ -194,7 +193,9 @@ was_open:
 /*=============================================================================
 FUNCTION:           dumpfile_write
 
-DESCRIPTION:        This function write the image to file.
+DESCRIPTION:        This function copy the image to the dump writer, the
+                    file is written in background. The frame is dropped if
+                    the writer can not keep up.
 
 ARGUMENTS PASSED:
 
@@ -207,78 +208,61 @@ IMPORTANT NOTES:    None
 gboolean
 dumpfile_write (MFW_GST_V4LSINK_INFO_T * v4l_info, GstBuffer * buffer)
 {
-  guint64 cur_pos;
-  guint size;
-
-  size = GST_BUFFER_SIZE (buffer);
-
-  cur_pos = v4l_info->dump_length;
-
-  GST_DEBUG_OBJECT (v4l_info, "writing %u bytes at %" G_GUINT64_FORMAT,
-      size, cur_pos);
-
-  if (size > 0 && GST_BUFFER_DATA (buffer) != NULL) {
-    if (v4l_info->cr_left_bypixel != 0 || v4l_info->cr_right_bypixel != 0
-        || v4l_info->cr_top_bypixel != 0 || v4l_info->cr_bottom_bypixel != 0) {
-      /* remove black edge */
-      gint y;
-      char *p;
-      gint cr_left = v4l_info->cr_left_bypixel_orig;
-      gint cr_right = v4l_info->cr_right_bypixel_orig;
-      gint cr_top = v4l_info->cr_top_bypixel_orig;
-      gint cr_bottom = v4l_info->cr_bottom_bypixel_orig;
-      gint stride = v4l_info->width + cr_left + cr_right;
-
-      /* Y */
-      for (y = cr_top; y < v4l_info->height + cr_top; y++) {
-        p = (char *) (GST_BUFFER_DATA (buffer)) + y * stride + cr_left;
-        fwrite (p, 1, v4l_info->width, v4l_info->dumpfile);
-        v4l_info->dump_length += v4l_info->width;
-      }
-
-      /* U */
-      for (y = cr_top / 2; y < (v4l_info->height + cr_top) / 2; y++) {
-        p = (char *) (GST_BUFFER_DATA (buffer)) +
-            stride * (v4l_info->height + cr_top + cr_bottom) +
-            (y * stride + cr_left) / 2;
-        fwrite (p, 1, v4l_info->width / 2, v4l_info->dumpfile);
-        v4l_info->dump_length += (v4l_info->width / 2);
-      }
+  MfwGstDumpFrame frame;
+
+  if ((v4l_info->dump == NULL) || (GST_BUFFER_DATA (buffer) == NULL)
+      || (GST_BUFFER_SIZE (buffer) == 0))
+    return TRUE;
+
+  switch (v4l_info->outformat) {
+    case V4L2_PIX_FMT_YUV420:
+      frame.fourcc = GST_MAKE_FOURCC ('I', '4', '2', '0');
+      break;
+    case V4L2_PIX_FMT_YVU420:
+      frame.fourcc = GST_MAKE_FOURCC ('Y', 'V', '1', '2');
+      break;
+    case V4L2_PIX_FMT_NV12:
+      frame.fourcc = GST_MAKE_FOURCC ('N', 'V', '1', '2');
+      break;
+    case V4L2_PIX_FMT_YUYV:
+      frame.fourcc = GST_MAKE_FOURCC ('Y', 'U', 'Y', '2');
+      break;
+    case V4L2_PIX_FMT_UYVY:
+      frame.fourcc = GST_MAKE_FOURCC ('U', 'Y', 'V', 'Y');
+      break;
+    default:
+      frame.fourcc = 0;
+      break;
+  }
 
-      /* V */
-      for (y = cr_top / 2; y < (v4l_info->height + cr_top) / 2; y++) {
-        p = (char *) (GST_BUFFER_DATA (buffer)) +
-            stride * (v4l_info->height + cr_top + cr_bottom) * 5 / 4 +
-            (y * stride + cr_left) / 2;
-        fwrite (p, 1, v4l_info->width / 2, v4l_info->dumpfile);
-        v4l_info->dump_length += (v4l_info->width / 2);
-      }
-    } else {
-      if (fwrite (GST_BUFFER_DATA (buffer), size, 1, v4l_info->dumpfile)
-          != 1)
-        goto handle_error;
+  frame.data = GST_BUFFER_DATA (buffer);
+  frame.size = GST_BUFFER_SIZE (buffer);
+  frame.width = v4l_info->width;
+  frame.height = v4l_info->height;
+
+  if (v4l_info->cr_left_bypixel != 0 || v4l_info->cr_right_bypixel != 0
+      || v4l_info->cr_top_bypixel != 0 || v4l_info->cr_bottom_bypixel != 0) {
+    /* remove black edge */
+    frame.left = v4l_info->cr_left_bypixel_orig;
+    frame.top = v4l_info->cr_top_bypixel_orig;
+    frame.stride = v4l_info->width + v4l_info->cr_left_bypixel_orig
+        + v4l_info->cr_right_bypixel_orig;
+    frame.plane_height = v4l_info->height + v4l_info->cr_top_bypixel_orig
+        + v4l_info->cr_bottom_bypixel_orig;
+  } else {
+    frame.left = 0;
+    frame.top = 0;
+    frame.stride = v4l_info->width;
+    frame.plane_height = v4l_info->height;
+  }
 
-      v4l_info->dump_length += size;
-    }
+  if (!mfw_gst_fdump_push (v4l_info->dump, &frame)) {
+    if (mfw_gst_fdump_post_error (v4l_info->dump, GST_ELEMENT (v4l_info)))
+      return FALSE;
+    GST_LOG_OBJECT (v4l_info, "dump frame dropped");
   }
 
   return TRUE;
-
-handle_error:
-  {
-    switch (errno) {
-      case ENOSPC:{
-        GST_ELEMENT_ERROR (v4l_info, RESOURCE, NO_SPACE_LEFT, (NULL), (NULL));
-        break;
-      }
-      default:{
-        GST_ELEMENT_ERROR (v4l_info, RESOURCE, WRITE,
-            (("Error while writing to file \"%s\"."),
-                v4l_info->dump_location), ("%s", g_strerror (errno)));
-      }
-    }
-    return FALSE;
-  }
 }
 
 #if defined(ENABLE_TVOUT) && (defined (_MX31) || defined (_MX35))
@@ -1636,6 +1620,9 @@ mfw_gst_v4l2_streamon (MFW_GST_V4LSINK_INFO_T * v4l_info)
 #endif
 
   v4l_info->stream_on = TRUE;
+
+  /* displayed buffers are dqueued by the thread from now on */
+  mfw_gst_v4l2_start_dq_thread (v4l_info);
   return TRUE;
 }
 
@@ -1660,6 +1647,8 @@ mfw_gst_v4l2_streamoff (MFW_GST_V4LSINK_INFO_T * v4l_info)
   gint type;
   gint err;
   if (v4l_info->stream_on) {
+    mfw_gst_v4l2_stop_dq_thread (v4l_info);
+
     type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
 #if defined (VL4_STREAM_CALLBACK)
     g_signal_emit (G_OBJECT (v4l_info),
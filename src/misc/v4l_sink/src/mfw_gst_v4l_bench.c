@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_v4l_bench.c
+ *
+ * Description:    Queue and dequeue throughput and render latency of the
+ *                 V4L sink on the mock V4L2 device, no display hardware is
+ *                 needed. videotestsrc feeds the sink unsynchronized, once
+ *                 with a 60 Hz display and once with a display that shows
+ *                 every frame at once, so the sink is the only limit.
+ *                 Usage: mfw_gst_v4l_bench [frames] [width] [height]
+ *                 [plugin file, default .libs/libmfw_gst_v4lsink.so]
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+
+#include <stdlib.h>
+#include <gst/gst.h>
+
+#include "mfw_gst_v4l_mock.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+
+#define V4L_BENCH_FRAMES    600
+#define V4L_BENCH_WIDTH     640
+#define V4L_BENCH_HEIGHT    480
+#define V4L_BENCH_PLUGIN    ".libs/libmfw_gst_v4lsink.so"
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+
+static gboolean
+v4l_bench_probe (GstPad * pad, GstBuffer * buffer, gpointer data)
+{
+  mfw_gst_v4l_mock_render_begin ();
+  return TRUE;
+}
+
+/*=============================================================================
+FUNCTION:           v4l_bench_run
+
+DESCRIPTION:        Plays frames through the sink on a mock display with the
+                    given refresh period and prints one line of results.
+
+ARGUMENTS PASSED:
+        frames      -   frames to render
+        width       -   frame width
+        height      -   frame height
+        period      -   mock display refresh period, 0 shows at once
+
+RETURN VALUE:       FALSE if the pipeline failed
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+static gboolean
+v4l_bench_run (gint frames, gint width, gint height, GstClockTime period)
+{
+  GstElement *pipeline, *sink;
+  GstMessage *msg;
+  GstPad *pad;
+  GTimer *timer;
+  GError *error = NULL;
+  MfwV4lMockStats stats;
+  gchar *desc, *sinkstats = NULL;
+  gdouble seconds;
+  gboolean ret;
+
+  mfw_gst_v4l_mock_set_period (period);
+  mfw_gst_v4l_mock_get_stats (&stats);
+
+  desc = g_strdup_printf ("videotestsrc num-buffers=%d ! "
+      "video/x-raw-yuv,format=(fourcc)I420,width=%d,height=%d,"
+      "framerate=30/1 ! mfw_v4lsink name=sink sync=false", frames, width,
+      height);
+  pipeline = gst_parse_launch (desc, &error);
+  g_free (desc);
+  if (pipeline == NULL) {
+    g_printerr ("pipeline: %s\n", error ? error->message : "unknown");
+    if (error)
+      g_error_free (error);
+    return FALSE;
+  }
+
+  sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  pad = gst_element_get_static_pad (sink, "sink");
+  gst_pad_add_buffer_probe (pad, G_CALLBACK (v4l_bench_probe), NULL);
+  gst_object_unref (pad);
+
+  timer = g_timer_new ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (GST_ELEMENT_BUS (pipeline),
+      GST_CLOCK_TIME_NONE, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  seconds = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  ret = (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+  if (!ret) {
+    gst_message_parse_error (msg, &error, NULL);
+    g_printerr ("error: %s\n", error->message);
+    g_error_free (error);
+  }
+  gst_message_unref (msg);
+
+  g_object_get (sink, "stats", &sinkstats, NULL);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  mfw_gst_v4l_mock_get_stats (&stats);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+
+  g_print ("%-8.1f %8.1f %10.3f %10.3f %8u %8u %8u %8u\n",
+      period ? (gdouble) GST_SECOND / period : 0.0,
+      (seconds > 0) ? stats.queued / seconds : 0.0,
+      stats.rendered ? (gdouble) stats.render_sum / stats.rendered /
+      GST_MSECOND : 0.0, (gdouble) stats.render_max / GST_MSECOND,
+      stats.queued, stats.dequeued, stats.render_dequeues, stats.repeated);
+  if (sinkstats)
+    g_print ("  %s\n", sinkstats);
+  g_free (sinkstats);
+
+  return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static const GstClockTime periods[] = { GST_SECOND / 60, 0 };
+  const gchar *file = V4L_BENCH_PLUGIN;
+  gint frames = V4L_BENCH_FRAMES, width = V4L_BENCH_WIDTH;
+  gint height = V4L_BENCH_HEIGHT, i;
+  GError *error = NULL;
+  GstPlugin *plugin;
+  gboolean ok = TRUE;
+
+  gst_init (&argc, &argv);
+
+  if (argc > 1)
+    frames = MAX (atoi (argv[1]), 1);
+  if (argc > 3) {
+    width = MAX (atoi (argv[2]), 16);
+    height = MAX (atoi (argv[3]), 16);
+  }
+  if (argc > 4)
+    file = argv[4];
+
+  /* the mock must be up before the plugin probes the devices */
+  mfw_gst_v4l_mock_set_period (periods[0]);
+  plugin = gst_plugin_load_file (file, &error);
+  if (plugin == NULL) {
+    g_printerr ("%s: %s\n", file, error ? error->message : "unknown");
+    if (error)
+      g_error_free (error);
+    return 1;
+  }
+  gst_object_unref (plugin);
+
+  g_print ("%d frames of %dx%d I420, sync off\n", frames, width, height);
+  g_print ("%-8s %8s %10s %10s %8s %8s %8s %8s\n", "vsync Hz", "fps",
+      "render ms", "max ms", "queued", "dqueued", "dq in rd", "repeats");
+  for (i = 0; i < G_N_ELEMENTS (periods); i++)
+    ok &= v4l_bench_run (frames, width, height, periods[i]);
+
+  return ok ? 0 : 1;
+}
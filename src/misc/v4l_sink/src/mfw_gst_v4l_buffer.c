@@ -41,6 +41,7 @@
                             INCLUDE FILES
 =============================================================================*/
 #include <errno.h>
+#include <poll.h>
 #include <gst/gst.h>
 
 #include "mfw_gst_fb.h"
@@ -85,11 +86,9 @@ mfw_gst_v4lsink_buffer_finalize (MFWGstV4LSinkBuffer * v4lsink_buffer_released)
           GST_LOG ("Push to reserved buffer pool:%d",
               g_slist_length ((v4l_info)->reservedhwbuffer_list));
         } else {
-          v4l_info->free_pool =
-              g_slist_append (v4l_info->free_pool, v4lsink_buffer_released);
-          GST_LOG ("Push to free buffer pool:%d",
-              g_slist_length ((v4l_info)->free_pool));
-
+          PUSH_FREE_HWBUFFER (v4l_info, v4lsink_buffer_released);
+          GST_LOG ("Push to free buffer pool:%d", v4l_info->free_count);
+          g_cond_broadcast (v4l_info->dq_cond);
         }
         gst_buffer_ref (GST_BUFFER_CAST (v4lsink_buffer_released));
 
@@ -140,6 +139,10 @@ mfw_gst_v4lsink_buffer_finalize (MFWGstV4LSinkBuffer * v4lsink_buffer_released)
         /* close the v4l driver */
         g_free (v4l_info->all_buffer_pool);
         v4l_info->all_buffer_pool = NULL;
+        g_free (v4l_info->free_stack);
+        v4l_info->free_stack = NULL;
+        g_free (v4l_info->v4lqueuedmap);
+        v4l_info->v4lqueuedmap = NULL;
         GST_INFO ("--> All v4l2 buffer freed.");
 #if 0
         system ("cat /dev/zero > /dev/fb2\n");
@@ -378,31 +381,48 @@ IMPORTANT NOTES:    None
 MFWGstV4LSinkBuffer *
 mfw_gst_v4l2_new_buffer (MFW_GST_V4LSINK_INFO_T * v4l_info)
 {
-  gint type = 0;
   MFWGstV4LSinkBuffer *v4lsink_buffer = NULL;
-  struct v4l2_buffer *v4lbuf = NULL;
-  {
-    int loopcount = 0;
-    GSList *tmp;
-    int ret;
-    struct v4l2_buffer v4l2buf;
+  int loopcount = 0;
+  int ret;
 
+  if (v4l_info->dq_thread == NULL) {
     while (v4l_info->v4lqueued > MIN_QUEUE_NUM) {
       mfw_gst_v4l2_dq_buffer (v4l_info);
     }
+  }
 
-    g_mutex_lock (v4l_info->pool_lock);
+  g_mutex_lock (v4l_info->pool_lock);
+
+  if ((IS_RESERVED_HWBUFFER_FULL (v4l_info)) && HAS_FREE_HWBUFFER (v4l_info)) {
+    v4lsink_buffer = POP_FREE_HWBUFFER (v4l_info);
+    v4lsink_buffer->bufstate = BUF_STATE_ALLOCATED;
+    g_mutex_unlock (v4l_info->pool_lock);
+    GST_LOG ("Assign a buffer from queue, available :%d.",
+        v4l_info->free_count);
+    return v4lsink_buffer;
+  }
+
+  if (v4l_info->dq_thread) {
+    /* buffers are returned by the dequeue thread, just wait for one */
+    GTimeVal abstime;
+
+    g_get_current_time (&abstime);
+    g_time_val_add (&abstime, NEW_BUFFER_WAIT_MSEC * 1000);
+    while ((!HAS_FREE_HWBUFFER (v4l_info)) && (!v4l_info->dq_thread_exit)) {
+      if (!g_cond_timed_wait (v4l_info->dq_cond, v4l_info->pool_lock,
+              &abstime))
+        break;
+    }
 
-    if ((IS_RESERVED_HWBUFFER_FULL (v4l_info)) && (tmp = v4l_info->free_pool)) {
-      v4lsink_buffer = (MFWGstV4LSinkBuffer *) tmp->data;
+    if (HAS_FREE_HWBUFFER (v4l_info)) {
+      v4lsink_buffer = POP_FREE_HWBUFFER (v4l_info);
       v4lsink_buffer->bufstate = BUF_STATE_ALLOCATED;
-      v4l_info->free_pool = g_slist_delete_link (v4l_info->free_pool, tmp);
       g_mutex_unlock (v4l_info->pool_lock);
-      GST_LOG ("Assign a buffer from queue, available :%d.",
-          g_slist_length (v4l_info->free_pool));
+      GST_DEBUG ("Wait dq thread, assign a hw buffer,queued:%d, left:%d.",
+          v4l_info->v4lqueued, v4l_info->free_count);
       return v4lsink_buffer;
     }
-
+  } else {
     while ((loopcount++) < BUFFER_NEW_RETRY_MAX) {
       ret = 0;
 
@@ -413,14 +433,13 @@ mfw_gst_v4l2_new_buffer (MFW_GST_V4LSINK_INFO_T * v4l_info)
 
       }
 
-      if (tmp = v4l_info->free_pool) {
-        v4lsink_buffer = (MFWGstV4LSinkBuffer *) tmp->data;
+      if (HAS_FREE_HWBUFFER (v4l_info)) {
+        v4lsink_buffer = POP_FREE_HWBUFFER (v4l_info);
         v4lsink_buffer->bufstate = BUF_STATE_ALLOCATED;
-        v4l_info->free_pool = g_slist_delete_link (v4l_info->free_pool, tmp);
         g_mutex_unlock (v4l_info->pool_lock);
         GST_DEBUG
             ("After DQ, assign a hw buffer from queue,queued:%d, left:%d.",
-            v4l_info->v4lqueued, g_slist_length (v4l_info->free_pool));
+            v4l_info->v4lqueued, v4l_info->free_count);
         return v4lsink_buffer;
       }
       if (ret < 0) {
@@ -429,19 +448,19 @@ mfw_gst_v4l2_new_buffer (MFW_GST_V4LSINK_INFO_T * v4l_info)
         g_mutex_lock (v4l_info->pool_lock);
       }
     }
+  }
 
 
-    GST_WARNING ("Try new buffer failed, ret %d %s queued %d",
-        errno, strerror (errno), v4l_info->v4lqueued);
+  GST_WARNING ("Try new buffer failed, ret %d %s queued %d",
+      errno, strerror (errno), v4l_info->v4lqueued);
 
-    v4lsink_buffer = mfw_gst_v4l2_new_swbuffer (v4l_info);
-    v4lsink_buffer->bufstate = BUF_STATE_ALLOCATED;
-    GST_DEBUG ("Finally assign a sw buffer from queue, left:%d.",
-        g_slist_length (v4l_info->free_pool));
+  v4lsink_buffer = mfw_gst_v4l2_new_swbuffer (v4l_info);
+  v4lsink_buffer->bufstate = BUF_STATE_ALLOCATED;
+  GST_DEBUG ("Finally assign a sw buffer from queue, left:%d.",
+      v4l_info->free_count);
 
-    g_mutex_unlock (v4l_info->pool_lock);
-    return v4lsink_buffer;
-  }
+  g_mutex_unlock (v4l_info->pool_lock);
+  return v4lsink_buffer;
 }
 
 
@@ -591,6 +610,8 @@ mfw_gst_v4l2_clear_showingbuf (MFW_GST_V4LSINK_INFO_T * v4l_info)
 
           g_mutex_lock (v4l_info->pool_lock);
           v4l_info->v4lqueued--;
+          if (v4l_info->v4lqueuedmap)
+            v4l_info->v4lqueuedmap[i] = 0;
         }
       }
     }
@@ -627,10 +648,15 @@ mfw_gst_v4l2_dq_buffer (MFW_GST_V4LSINK_INFO_T * v4l_info)
 
     MFWGstV4LSinkBuffer *v4lsinkbuffer;
     v4l_info->v4lqueued--;
-    v4l_info->v4llist =
-        g_list_remove (v4l_info->v4llist, (gpointer) (v4l2buf.index));
-    if (g_list_find (v4l_info->v4llist, (gpointer) (v4l2buf.index)))
-      g_print ("something wrong here, line:%d\n", __LINE__);
+    if ((v4l2buf.index < v4l_info->buffers_required)
+        && (v4l_info->v4lqueuedmap[v4l2buf.index])) {
+      v4l_info->v4lqueuedmap[v4l2buf.index] = 0;
+    } else {
+      GST_WARNING ("Dqueued buffer %d is not in queue", v4l2buf.index);
+    }
+    g_cond_broadcast (v4l_info->dq_cond);
+    mfw_gst_v4l_stats_dequeued (&v4l_info->stats, v4l2buf.index,
+        (v4l_info->v4lqueued <= MIN_QUEUE_NUM));
     v4lsinkbuffer =
         (MFWGstV4LSinkBuffer *) (v4l_info->all_buffer_pool[v4l2buf.index]);
     if ((v4lsinkbuffer) && (v4lsinkbuffer->bufstate == BUF_STATE_SHOWING)) {
@@ -653,6 +679,197 @@ mfw_gst_v4l2_dq_buffer (MFW_GST_V4LSINK_INFO_T * v4l_info)
   return ret;
 }
 
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_mark_queued
+
+DESCRIPTION:        This function records a buffer queued into the v4l device
+                    and wakes up the dequeue thread.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+        index       -   v4l index of the buffer
+
+RETURN VALUE:       FALSE if the buffer is already in the device queue
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+
+gboolean
+mfw_gst_v4l2_mark_queued (MFW_GST_V4LSINK_INFO_T * v4l_info, guint index)
+{
+  gboolean ret = FALSE;
+
+  g_mutex_lock (v4l_info->pool_lock);
+  if ((index < v4l_info->buffers_required)
+      && (!v4l_info->v4lqueuedmap[index])) {
+    v4l_info->v4lqueuedmap[index] = 1;
+    v4l_info->v4lqueued++;
+    g_cond_broadcast (v4l_info->dq_cond);
+    ret = TRUE;
+  }
+  g_mutex_unlock (v4l_info->pool_lock);
+
+  return ret;
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_unmark_queued
+
+DESCRIPTION:        This function drops the queued record of a buffer which
+                    failed to be queued into the v4l device.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+        index       -   v4l index of the buffer
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+
+void
+mfw_gst_v4l2_unmark_queued (MFW_GST_V4LSINK_INFO_T * v4l_info, guint index)
+{
+  g_mutex_lock (v4l_info->pool_lock);
+  if ((index < v4l_info->buffers_required)
+      && (v4l_info->v4lqueuedmap[index])) {
+    v4l_info->v4lqueuedmap[index] = 0;
+    v4l_info->v4lqueued--;
+  }
+  g_mutex_unlock (v4l_info->pool_lock);
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_dq_thread_func
+
+DESCRIPTION:        Dequeue thread, polls the v4l device and dqueues the
+                    displayed buffers, so that the render path never waits
+                    for the display.
+
+ARGUMENTS PASSED:
+        data        -   pointer to MFW_GST_V4LSINK_INFO_T
+
+RETURN VALUE:       NULL
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+
+static gpointer
+mfw_gst_v4l2_dq_thread_func (gpointer data)
+{
+  MFW_GST_V4LSINK_INFO_T *v4l_info = (MFW_GST_V4LSINK_INFO_T *) data;
+  struct pollfd pfd;
+  GTimeVal abstime;
+
+  pfd.fd = v4l_info->v4l_id;
+  pfd.events = POLLOUT;
+
+  GST_INFO ("dqueue thread start");
+
+  g_mutex_lock (v4l_info->pool_lock);
+  while (!v4l_info->dq_thread_exit) {
+    /* keep MIN_QUEUE_NUM buffers in the device for display */
+    if (v4l_info->v4lqueued <= MIN_QUEUE_NUM) {
+      g_cond_wait (v4l_info->dq_cond, v4l_info->pool_lock);
+      continue;
+    }
+    g_mutex_unlock (v4l_info->pool_lock);
+
+    pfd.revents = 0;
+    if ((poll (&pfd, 1, DQ_THREAD_POLL_MSEC) > 0)
+        && (mfw_gst_v4l2_dq_buffer (v4l_info))) {
+      g_mutex_lock (v4l_info->pool_lock);
+      continue;
+    }
+
+    g_mutex_lock (v4l_info->pool_lock);
+    /* nothing displayed yet, or driver reports ready without poll support */
+    if (!v4l_info->dq_thread_exit) {
+      g_get_current_time (&abstime);
+      g_time_val_add (&abstime, DQ_THREAD_RETRY_MSEC * 1000);
+      g_cond_timed_wait (v4l_info->dq_cond, v4l_info->pool_lock, &abstime);
+    }
+  }
+  g_mutex_unlock (v4l_info->pool_lock);
+
+  GST_INFO ("dqueue thread exit");
+  return NULL;
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_start_dq_thread
+
+DESCRIPTION:        This function starts the thread which polls the v4l
+                    device and dqueues the displayed buffers.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+
+RETURN VALUE:       TRUE if the thread is running
+
+PRE-CONDITIONS:     Device is streaming on
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+
+gboolean
+mfw_gst_v4l2_start_dq_thread (MFW_GST_V4LSINK_INFO_T * v4l_info)
+{
+  GError *error = NULL;
+
+  if (v4l_info->dq_thread)
+    return TRUE;
+
+  v4l_info->dq_thread_exit = FALSE;
+  v4l_info->dq_thread =
+      g_thread_create (mfw_gst_v4l2_dq_thread_func, v4l_info, TRUE, &error);
+  if (v4l_info->dq_thread == NULL) {
+    GST_WARNING ("Can not create dqueue thread: %s, dqueue in render",
+        error ? error->message : "unknown");
+    if (error)
+      g_error_free (error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_stop_dq_thread
+
+DESCRIPTION:        This function stops the dequeue thread and waits for it.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    Call without pool_lock
+=============================================================================*/
+
+void
+mfw_gst_v4l2_stop_dq_thread (MFW_GST_V4LSINK_INFO_T * v4l_info)
+{
+  if (v4l_info->dq_thread == NULL)
+    return;
+
+  g_mutex_lock (v4l_info->pool_lock);
+  v4l_info->dq_thread_exit = TRUE;
+  g_cond_broadcast (v4l_info->dq_cond);
+  g_mutex_unlock (v4l_info->pool_lock);
+
+  g_thread_join (v4l_info->dq_thread);
+  v4l_info->dq_thread = NULL;
+}
+
 /*=============================================================================
 FUNCTION:           mfw_gst_v4l2_queue_buffer
 
@@ -693,6 +910,13 @@ mfw_gst_v4l2_buffer_init (MFW_GST_V4LSINK_INFO_T * v4l_info)
     return GST_FLOW_ERROR;
   }
 
+  g_free (v4l_info->free_stack);
+  v4l_info->free_stack = g_new0 (gint, v4l_info->buffers_required);
+  v4l_info->free_count = 0;
+
+  g_free (v4l_info->v4lqueuedmap);
+  v4l_info->v4lqueuedmap = g_new0 (guint8, v4l_info->buffers_required);
+
   /* no software buffer at all, no reserved needed */
 
   v4l_info->swbuffer_count = 0;
@@ -717,7 +941,7 @@ mfw_gst_v4l2_buffer_init (MFW_GST_V4LSINK_INFO_T * v4l_info)
     while (v4l_info->querybuf_index < v4l_info->buffers_required) {
       tmpbuffer = mfw_gst_v4l2_new_hwbuffer (v4l_info);
       if (tmpbuffer) {
-        v4l_info->free_pool = g_slist_prepend (v4l_info->free_pool, tmpbuffer);
+        PUSH_FREE_HWBUFFER (v4l_info, tmpbuffer);
       } else {
         break;
       }
@@ -765,10 +989,6 @@ mfw_gst_v4l2_free_buffers (MFW_GST_V4LSINK_INFO_T * v4l_info)
 
         if ((v4lsink_buffer->bufstate == BUF_STATE_IDLE) ||
             (v4lsink_buffer->bufstate == BUF_STATE_SHOWING)) {
-          if (v4lsink_buffer->bufstate == BUF_STATE_IDLE) {
-            v4l_info->free_pool =
-                g_slist_remove (v4l_info->free_pool, v4lsink_buffer);
-          }
           v4lsink_buffer->bufstate = BUF_STATE_FREE;
           gst_buffer_unref (GST_BUFFER_CAST (v4lsink_buffer));
         } else {
@@ -777,10 +997,10 @@ mfw_gst_v4l2_free_buffers (MFW_GST_V4LSINK_INFO_T * v4l_info)
       }
     }
 
-    if (v4l_info->v4llist){
-      g_list_free (v4l_info->v4llist);
-      v4l_info->v4llist = NULL;
-    }
+    /* all idle buffers are unrefed above */
+    v4l_info->free_count = 0;
+    if (v4l_info->v4lqueuedmap)
+      memset (v4l_info->v4lqueuedmap, 0, v4l_info->buffers_required);
   }
 
 }
@@ -51,6 +51,20 @@
 #define DQUEUE_MAX_LOOP		200
 #define NEXTDQ_WAIT_MSEC	30
 
+#define DQ_THREAD_POLL_MSEC     100 /* poll timeout of the dequeue thread */
+#define DQ_THREAD_RETRY_MSEC    2   /* wait before retry when dqueue failed */
+#define NEW_BUFFER_WAIT_MSEC    500 /* max wait for a buffer released by the dequeue thread */
+
+/* free hw buffers are kept as a stack of v4l index, call with pool_lock */
+#define HAS_FREE_HWBUFFER(v4linfo) ((v4linfo)->free_count > 0)
+
+#define PUSH_FREE_HWBUFFER(v4linfo, buffer) \
+    ((v4linfo)->free_stack[(v4linfo)->free_count++] = (buffer)->v4l_buf.index)
+
+#define POP_FREE_HWBUFFER(v4linfo) \
+    ((MFWGstV4LSinkBuffer *)((v4linfo)->all_buffer_pool[\
+        (v4linfo)->free_stack[--(v4linfo)->free_count]]))
+
 #define IS_RESERVED_HWBUFFER_FULL(v4linfo) \
     (g_slist_length((v4linfo)->reservedhwbuffer_list)>=RESERVEDHWBUFFER_DEPTH)
 
@@ -177,6 +191,94 @@ IMPORTANT NOTES:    None
 void mfw_gst_v4l2_free_buffers(MFW_GST_V4LSINK_INFO_T *v4l_info);
 
 
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_dq_buffer
+
+DESCRIPTION:        This function try to dqueue buffer from v4l device.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+
+RETURN VALUE:       TRUE if one buffer dqueued
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+gboolean mfw_gst_v4l2_dq_buffer(MFW_GST_V4LSINK_INFO_T *v4l_info);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_mark_queued
+
+DESCRIPTION:        This function records a buffer queued into the v4l device
+                    and wakes up the dequeue thread.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+        index       -   v4l index of the buffer
+
+RETURN VALUE:       FALSE if the buffer is already in the device queue
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+gboolean mfw_gst_v4l2_mark_queued(MFW_GST_V4LSINK_INFO_T *v4l_info,
+                                  guint index);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_unmark_queued
+
+DESCRIPTION:        This function drops the queued record of a buffer which
+                    failed to be queued into the v4l device.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+        index       -   v4l index of the buffer
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l2_unmark_queued(MFW_GST_V4LSINK_INFO_T *v4l_info,
+                                guint index);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_start_dq_thread
+
+DESCRIPTION:        This function starts the thread which polls the v4l
+                    device and dqueues the displayed buffers.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+
+RETURN VALUE:       TRUE if the thread is running
+
+PRE-CONDITIONS:     Device is streaming on
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+gboolean mfw_gst_v4l2_start_dq_thread(MFW_GST_V4LSINK_INFO_T *v4l_info);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l2_stop_dq_thread
+
+DESCRIPTION:        This function stops the dequeue thread and waits for it.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    Call without pool_lock
+=============================================================================*/
+void mfw_gst_v4l2_stop_dq_thread(MFW_GST_V4LSINK_INFO_T *v4l_info);
+
+
 G_END_DECLS
 
 #endif				/* _MFW_GST_V4L_BUFFER_H_ */
@@ -0,0 +1,816 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_v4l_mock.c
+ *
+ * Description:    In-process V4L2 output device for benchmarks. The program
+ *                 linking this file defines open, close, ioctl, poll and
+ *                 mmap, so the V4L sink plugin it loads talks to them
+ *                 instead of the kernel for /dev/video* and /dev/fb*. All
+ *                 other files go to the C library. Queued frames are shown
+ *                 one per vsync of the mock display and a frame is released
+ *                 for dequeue when the next one goes on screen, as the
+ *                 IPU output driver does.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+
+/* open64 and mmap64 are defined next to open and mmap, the C library
+   must not redirect or wrap either */
+#define _GNU_SOURCE
+#undef _FILE_OFFSET_BITS
+#undef _FORTIFY_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/fb.h>
+#include <linux/videodev2.h>
+#include <gst/gst.h>
+
+#include "mfw_gst_v4l_mock.h"
+
+/*=============================================================================
+                            LOCAL MACROS
+=============================================================================*/
+
+#define V4L_MOCK_MAX_FDS        16
+#define V4L_MOCK_OFFSET_BASE    0x10000000      /* physical address of buffer 0 */
+#define V4L_MOCK_ALIGN(x)       (((x) + 4095) & ~4095)
+
+/*=============================================================================
+                LOCAL TYPEDEFS (STRUCTURES, UNIONS, ENUMS)
+=============================================================================*/
+
+typedef enum
+{
+  V4L_MOCK_NONE,
+  V4L_MOCK_VIDEO,
+  V4L_MOCK_FB,
+} V4lMockKind;
+
+typedef struct
+{
+  guint8 *data;
+  guint32 length;
+  guint32 offset;
+  gboolean queued;
+} V4lMockBuffer;
+
+typedef struct
+{
+  GMutex *lock;
+  GCond *cond;
+  GstClockTime period;
+
+  gint fds[V4L_MOCK_MAX_FDS];
+  V4lMockKind kinds[V4L_MOCK_MAX_FDS];
+
+  struct v4l2_format fmt;
+  struct v4l2_crop crop;
+  V4lMockBuffer buffers[V4L_MOCK_MAX_BUFFERS];
+  guint nbuffers;
+
+  /* display, pending frames wait for a vsync, done ones for dequeue */
+  gboolean streaming;
+  guint pending[V4L_MOCK_MAX_BUFFERS];
+  guint npending;
+  guint done[V4L_MOCK_MAX_BUFFERS];
+  guint ndone;
+  gint shown;
+  GstClockTime next_vsync;
+  guint sequence;
+
+  GThread *render_thread;       /* last thread to queue a buffer */
+  GThread *begin_thread;
+  GstClockTime begin;
+
+  MfwV4lMockStats stats;
+} V4lMock;
+
+/*=============================================================================
+                            LOCAL VARIABLES
+=============================================================================*/
+
+static V4lMock mock = { NULL };
+
+static const guint32 mock_formats[] = {
+  V4L2_PIX_FMT_YUV420, V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_UYVY,
+  V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_RGB565, V4L2_PIX_FMT_RGB24,
+  V4L2_PIX_FMT_RGB32,
+};
+
+static int (*real_open) (const char *, int, ...);
+static int (*real_open64) (const char *, int, ...);
+static int (*real_close) (int);
+static int (*real_ioctl) (int, unsigned long, ...);
+static int (*real_poll) (struct pollfd *, nfds_t, int);
+static void *(*real_mmap) (void *, size_t, int, int, int, off_t);
+static void *(*real_mmap64) (void *, size_t, int, int, int, off64_t);
+static int (*real_munmap) (void *, size_t);
+
+/*=============================================================================
+                            LOCAL FUNCTIONS
+=============================================================================*/
+
+/* the C library functions behind the ones defined here */
+static void
+v4l_mock_resolve (void)
+{
+  real_open = dlsym (RTLD_NEXT, "open");
+  real_open64 = dlsym (RTLD_NEXT, "open64");
+  real_close = dlsym (RTLD_NEXT, "close");
+  real_ioctl = dlsym (RTLD_NEXT, "ioctl");
+  real_poll = dlsym (RTLD_NEXT, "poll");
+  real_mmap = dlsym (RTLD_NEXT, "mmap");
+  real_mmap64 = dlsym (RTLD_NEXT, "mmap64");
+  real_munmap = dlsym (RTLD_NEXT, "munmap");
+}
+
+#define V4L_MOCK_RESOLVE() \
+  G_STMT_START { \
+    if (G_UNLIKELY (real_munmap == NULL)) \
+      v4l_mock_resolve (); \
+  } G_STMT_END
+
+/* call with the lock */
+static V4lMockKind
+v4l_mock_kind (int fd)
+{
+  gint i;
+
+  for (i = 0; i < V4L_MOCK_MAX_FDS; i++)
+    if ((mock.kinds[i] != V4L_MOCK_NONE) && (mock.fds[i] == fd))
+      return mock.kinds[i];
+  return V4L_MOCK_NONE;
+}
+
+static V4lMockKind
+v4l_mock_lookup (int fd)
+{
+  V4lMockKind kind;
+
+  if (mock.lock == NULL)
+    return V4L_MOCK_NONE;
+  g_mutex_lock (mock.lock);
+  kind = v4l_mock_kind (fd);
+  g_mutex_unlock (mock.lock);
+  return kind;
+}
+
+static V4lMockKind
+v4l_mock_path_kind (const char *path)
+{
+  if ((mock.lock == NULL) || (path == NULL))
+    return V4L_MOCK_NONE;
+  if (strncmp (path, "/dev/video", 10) == 0)
+    return V4L_MOCK_VIDEO;
+  if (strncmp (path, "/dev/fb", 7) == 0)
+    return V4L_MOCK_FB;
+  return V4L_MOCK_NONE;
+}
+
+/* a placeholder fd from /dev/null keeps the numbers unique */
+static int
+v4l_mock_open (V4lMockKind kind)
+{
+  int fd = real_open ("/dev/null", O_RDWR);
+  gint i;
+
+  if (fd < 0)
+    return fd;
+
+  g_mutex_lock (mock.lock);
+  for (i = 0; i < V4L_MOCK_MAX_FDS; i++) {
+    if (mock.kinds[i] == V4L_MOCK_NONE) {
+      mock.fds[i] = fd;
+      mock.kinds[i] = kind;
+      break;
+    }
+  }
+  g_mutex_unlock (mock.lock);
+
+  if (i == V4L_MOCK_MAX_FDS) {
+    real_close (fd);
+    errno = EMFILE;
+    return -1;
+  }
+  return fd;
+}
+
+/* call with the lock */
+static void
+v4l_mock_stop (void)
+{
+  guint i;
+
+  for (i = 0; i < mock.nbuffers; i++)
+    mock.buffers[i].queued = FALSE;
+  mock.npending = mock.ndone = 0;
+  mock.shown = -1;
+  mock.streaming = FALSE;
+}
+
+/* call with the lock */
+static void
+v4l_mock_free_buffers (void)
+{
+  guint i;
+
+  v4l_mock_stop ();
+  for (i = 0; i < mock.nbuffers; i++)
+    g_free (mock.buffers[i].data);
+  mock.nbuffers = 0;
+}
+
+/* one vsync: the next pending frame goes on screen, the last one is done */
+static void
+v4l_mock_vsync (void)
+{
+  if (mock.npending == 0) {
+    if (mock.shown >= 0)
+      mock.stats.repeated++;
+    return;
+  }
+
+  if (mock.shown >= 0)
+    mock.done[mock.ndone++] = mock.shown;
+  mock.shown = mock.pending[0];
+  mock.npending--;
+  memmove (mock.pending, mock.pending + 1, mock.npending * sizeof (guint));
+  mock.stats.shown++;
+}
+
+/* run the vsyncs up to now, call with the lock */
+static void
+v4l_mock_advance (GstClockTime now)
+{
+  guint64 n, i;
+
+  if (!mock.streaming)
+    return;
+
+  if (mock.period == 0) {
+    while (mock.npending)
+      v4l_mock_vsync ();
+    return;
+  }
+
+  if (now < mock.next_vsync)
+    return;
+
+  /* after the pending frames further vsyncs only repeat the last one */
+  n = (now - mock.next_vsync) / mock.period + 1;
+  for (i = 0; i < MIN (n, mock.npending + 1); i++)
+    v4l_mock_vsync ();
+  if (n > i)
+    mock.stats.repeated += n - i;
+  mock.next_vsync += n * mock.period;
+}
+
+static int
+v4l_mock_video_ioctl (unsigned long request, void *arg)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  guint i;
+
+  switch (request) {
+    case VIDIOC_QUERYCAP:{
+      struct v4l2_capability *cap = arg;
+
+      memset (cap, 0, sizeof (*cap));
+      strcpy ((char *) cap->driver, "v4l_mock");
+      strcpy ((char *) cap->card, "mock output");
+      cap->capabilities = V4L2_CAP_VIDEO_OUTPUT |
+          V4L2_CAP_VIDEO_OUTPUT_OVERLAY | V4L2_CAP_STREAMING;
+      return 0;
+    }
+
+    case VIDIOC_ENUM_FMT:{
+      struct v4l2_fmtdesc *desc = arg;
+
+      if (desc->index >= G_N_ELEMENTS (mock_formats))
+        break;
+      desc->pixelformat = mock_formats[desc->index];
+      g_snprintf ((char *) desc->description, sizeof (desc->description),
+          "mock %" GST_FOURCC_FORMAT, GST_FOURCC_ARGS (desc->pixelformat));
+      return 0;
+    }
+
+    case VIDIOC_S_FMT:{
+      struct v4l2_format *fmt = arg;
+      struct v4l2_pix_format *pix = &fmt->fmt.pix;
+
+      if (fmt->type != V4L2_BUF_TYPE_VIDEO_OUTPUT)
+        return 0;
+      switch (pix->pixelformat) {
+        case V4L2_PIX_FMT_YUV420:
+        case V4L2_PIX_FMT_NV12:
+          pix->bytesperline = pix->width;
+          pix->sizeimage = pix->width * pix->height * 3 / 2;
+          break;
+        case V4L2_PIX_FMT_RGB24:
+          pix->bytesperline = pix->width * 3;
+          pix->sizeimage = pix->bytesperline * pix->height;
+          break;
+        case V4L2_PIX_FMT_RGB32:
+          pix->bytesperline = pix->width * 4;
+          pix->sizeimage = pix->bytesperline * pix->height;
+          break;
+        default:
+          pix->bytesperline = pix->width * 2;
+          pix->sizeimage = pix->bytesperline * pix->height;
+          break;
+      }
+      mock.fmt = *fmt;
+      return 0;
+    }
+
+    case VIDIOC_G_FMT:{
+      struct v4l2_format *fmt = arg;
+
+      if (fmt->type == V4L2_BUF_TYPE_VIDEO_OUTPUT)
+        *fmt = mock.fmt;
+      return 0;
+    }
+
+    case VIDIOC_REQBUFS:{
+      struct v4l2_requestbuffers *req = arg;
+      guint32 length = V4L_MOCK_ALIGN (mock.fmt.fmt.pix.sizeimage);
+
+      if (mock.streaming) {
+        errno = EBUSY;
+        return -1;
+      }
+      v4l_mock_free_buffers ();
+      req->count = MIN (req->count, V4L_MOCK_MAX_BUFFERS);
+      for (i = 0; i < req->count; i++) {
+        mock.buffers[i].data = g_malloc0 (length);
+        mock.buffers[i].length = length;
+        mock.buffers[i].offset = V4L_MOCK_OFFSET_BASE + i * length;
+        mock.buffers[i].queued = FALSE;
+      }
+      mock.nbuffers = req->count;
+      return 0;
+    }
+
+    case VIDIOC_QUERYBUF:{
+      struct v4l2_buffer *buf = arg;
+
+      if (buf->index >= mock.nbuffers)
+        break;
+      buf->length = mock.buffers[buf->index].length;
+      buf->m.offset = mock.buffers[buf->index].offset;
+      buf->flags = mock.buffers[buf->index].queued ? V4L2_BUF_FLAG_QUEUED : 0;
+      return 0;
+    }
+
+    case VIDIOC_QBUF:{
+      struct v4l2_buffer *buf = arg;
+      GThread *self = g_thread_self ();
+
+      if ((buf->index >= mock.nbuffers) || mock.buffers[buf->index].queued)
+        break;
+      mock.buffers[buf->index].queued = TRUE;
+      mock.pending[mock.npending++] = buf->index;
+      mock.stats.queued++;
+
+      if ((mock.begin_thread == self) && GST_CLOCK_TIME_IS_VALID (mock.begin)) {
+        GstClockTime spent = now - mock.begin;
+
+        mock.stats.rendered++;
+        mock.stats.render_sum += spent;
+        mock.stats.render_max = MAX (mock.stats.render_max, spent);
+        mock.begin = GST_CLOCK_TIME_NONE;
+      }
+      mock.render_thread = self;
+      g_cond_broadcast (mock.cond);
+      return 0;
+    }
+
+    case VIDIOC_DQBUF:{
+      struct v4l2_buffer *buf = arg;
+
+      v4l_mock_advance (now);
+      if (mock.ndone == 0) {
+        errno = EAGAIN;
+        return -1;
+      }
+      buf->index = mock.done[0];
+      mock.ndone--;
+      memmove (mock.done, mock.done + 1, mock.ndone * sizeof (guint));
+      mock.buffers[buf->index].queued = FALSE;
+      buf->flags = V4L2_BUF_FLAG_DONE;
+      buf->sequence = mock.sequence++;
+      buf->timestamp.tv_sec = now / GST_SECOND;
+      buf->timestamp.tv_usec = (now % GST_SECOND) / GST_USECOND;
+
+      mock.stats.dequeued++;
+      if (g_thread_self () == mock.render_thread)
+        mock.stats.render_dequeues++;
+      return 0;
+    }
+
+    case VIDIOC_STREAMON:
+      mock.streaming = TRUE;
+      mock.next_vsync = now + mock.period;
+      g_cond_broadcast (mock.cond);
+      return 0;
+
+    case VIDIOC_STREAMOFF:
+      /* the driver gives every buffer back without dequeue */
+      v4l_mock_stop ();
+      return 0;
+
+    case VIDIOC_CROPCAP:{
+      struct v4l2_cropcap *cap = arg;
+
+      cap->bounds.left = cap->bounds.top = 0;
+      cap->bounds.width = V4L_MOCK_SCREEN_WIDTH;
+      cap->bounds.height = V4L_MOCK_SCREEN_HEIGHT;
+      cap->defrect = cap->bounds;
+      return 0;
+    }
+
+    case VIDIOC_S_CROP:
+      mock.crop = *(struct v4l2_crop *) arg;
+      return 0;
+
+    case VIDIOC_G_CROP:
+      *(struct v4l2_crop *) arg = mock.crop;
+      return 0;
+
+    default:
+      /* controls, outputs and overlay settings are taken as they come */
+      return 0;
+  }
+
+  errno = EINVAL;
+  return -1;
+}
+
+static int
+v4l_mock_fb_ioctl (unsigned long request, void *arg)
+{
+  switch (request) {
+    case FBIOGET_VSCREENINFO:{
+      struct fb_var_screeninfo *var = arg;
+
+      memset (var, 0, sizeof (*var));
+      var->xres = var->xres_virtual = V4L_MOCK_SCREEN_WIDTH;
+      var->yres = V4L_MOCK_SCREEN_HEIGHT;
+      var->yres_virtual = V4L_MOCK_SCREEN_HEIGHT * 2;
+      var->bits_per_pixel = 16;
+      return 0;
+    }
+
+    case FBIOGET_FSCREENINFO:{
+      struct fb_fix_screeninfo *fix = arg;
+
+      memset (fix, 0, sizeof (*fix));
+      fix->line_length = V4L_MOCK_SCREEN_WIDTH * 2;
+      fix->smem_len = fix->line_length * V4L_MOCK_SCREEN_HEIGHT * 2;
+      return 0;
+    }
+
+    default:
+      return 0;
+  }
+}
+
+static void *
+v4l_mock_mmap (size_t length, int prot, int fd, off64_t offset)
+{
+  V4lMockKind kind = v4l_mock_lookup (fd);
+  void *ret = MAP_FAILED;
+  guint i;
+
+  if (kind == V4L_MOCK_FB)
+    return real_mmap (NULL, length, prot,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  g_mutex_lock (mock.lock);
+  for (i = 0; i < mock.nbuffers; i++) {
+    if ((mock.buffers[i].offset == offset)
+        && (length <= mock.buffers[i].length)) {
+      ret = mock.buffers[i].data;
+      break;
+    }
+  }
+  g_mutex_unlock (mock.lock);
+
+  if (ret == MAP_FAILED)
+    errno = EINVAL;
+  return ret;
+}
+
+/*=============================================================================
+                            GLOBAL FUNCTIONS
+=============================================================================*/
+
+int
+open (const char *path, int flags, ...)
+{
+  V4lMockKind kind = v4l_mock_path_kind (path);
+  mode_t mode = 0;
+  va_list ap;
+
+  V4L_MOCK_RESOLVE ();
+
+  if (kind != V4L_MOCK_NONE)
+    return v4l_mock_open (kind);
+
+  if (flags & O_CREAT) {
+    va_start (ap, flags);
+    mode = va_arg (ap, mode_t);
+    va_end (ap);
+  }
+  return real_open (path, flags, mode);
+}
+
+int
+open64 (const char *path, int flags, ...)
+{
+  V4lMockKind kind = v4l_mock_path_kind (path);
+  mode_t mode = 0;
+  va_list ap;
+
+  V4L_MOCK_RESOLVE ();
+
+  if (kind != V4L_MOCK_NONE)
+    return v4l_mock_open (kind);
+
+  if (flags & O_CREAT) {
+    va_start (ap, flags);
+    mode = va_arg (ap, mode_t);
+    va_end (ap);
+  }
+  return real_open64 (path, flags, mode);
+}
+
+int
+close (int fd)
+{
+  V4lMockKind kind = V4L_MOCK_NONE;
+  gint i, videos = 0;
+
+  V4L_MOCK_RESOLVE ();
+
+  if (mock.lock) {
+    g_mutex_lock (mock.lock);
+    for (i = 0; i < V4L_MOCK_MAX_FDS; i++) {
+      if ((mock.kinds[i] != V4L_MOCK_NONE) && (mock.fds[i] == fd)) {
+        kind = mock.kinds[i];
+        mock.kinds[i] = V4L_MOCK_NONE;
+      } else if (mock.kinds[i] == V4L_MOCK_VIDEO) {
+        videos++;
+      }
+    }
+    /* buffers live until the last video fd is closed */
+    if ((kind == V4L_MOCK_VIDEO) && (videos == 0))
+      v4l_mock_free_buffers ();
+    g_mutex_unlock (mock.lock);
+  }
+  return real_close (fd);
+}
+
+int
+ioctl (int fd, unsigned long request, ...)
+{
+  V4lMockKind kind = v4l_mock_lookup (fd);
+  void *arg;
+  va_list ap;
+  int ret;
+
+  V4L_MOCK_RESOLVE ();
+
+  va_start (ap, request);
+  arg = va_arg (ap, void *);
+  va_end (ap);
+
+  switch (kind) {
+    case V4L_MOCK_VIDEO:
+      g_mutex_lock (mock.lock);
+      ret = v4l_mock_video_ioctl (request, arg);
+      g_mutex_unlock (mock.lock);
+      return ret;
+    case V4L_MOCK_FB:
+      return v4l_mock_fb_ioctl (request, arg);
+    default:
+      return real_ioctl (fd, request, arg);
+  }
+}
+
+int
+poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  GstClockTime now, deadline, wake;
+  GTimeVal abstime;
+  nfds_t i, videos = 0;
+  int ret = 0;
+
+  V4L_MOCK_RESOLVE ();
+
+  if (mock.lock == NULL)
+    return real_poll (fds, nfds, timeout);
+
+  g_mutex_lock (mock.lock);
+  for (i = 0; i < nfds; i++)
+    if (v4l_mock_kind (fds[i].fd) == V4L_MOCK_VIDEO)
+      videos++;
+  if (videos == 0) {
+    g_mutex_unlock (mock.lock);
+    return real_poll (fds, nfds, timeout);
+  }
+
+  /* only the mock fds are polled, a video fd is writable with a done frame */
+  now = gst_util_get_timestamp ();
+  deadline = (timeout < 0) ? GST_CLOCK_TIME_NONE :
+      now + timeout * GST_MSECOND;
+  for (i = 0; i < nfds; i++)
+    fds[i].revents = 0;
+  for (;;) {
+    v4l_mock_advance (now);
+    if (mock.ndone) {
+      for (i = 0; i < nfds; i++) {
+        if (v4l_mock_kind (fds[i].fd) == V4L_MOCK_VIDEO) {
+          fds[i].revents = fds[i].events & (POLLOUT | POLLWRNORM);
+          ret += (fds[i].revents != 0);
+        }
+      }
+      break;
+    }
+    if (GST_CLOCK_TIME_IS_VALID (deadline) && (now >= deadline))
+      break;
+
+    wake = deadline;
+    if (mock.streaming && mock.period)
+      wake = GST_CLOCK_TIME_IS_VALID (wake) ?
+          MIN (wake, mock.next_vsync) : mock.next_vsync;
+    if (GST_CLOCK_TIME_IS_VALID (wake)) {
+      g_get_current_time (&abstime);
+      g_time_val_add (&abstime, (wake - now) / GST_USECOND + 1);
+      g_cond_timed_wait (mock.cond, mock.lock, &abstime);
+    } else {
+      g_cond_wait (mock.cond, mock.lock);
+    }
+    now = gst_util_get_timestamp ();
+  }
+  g_mutex_unlock (mock.lock);
+
+  return ret;
+}
+
+void *
+mmap (void *addr, size_t length, int prot, int flags, int fd, off_t offset)
+{
+  V4L_MOCK_RESOLVE ();
+
+  if (v4l_mock_lookup (fd) != V4L_MOCK_NONE)
+    return v4l_mock_mmap (length, prot, fd, offset);
+  return real_mmap (addr, length, prot, flags, fd, offset);
+}
+
+void *
+mmap64 (void *addr, size_t length, int prot, int flags, int fd,
+    off64_t offset)
+{
+  V4L_MOCK_RESOLVE ();
+
+  if (v4l_mock_lookup (fd) != V4L_MOCK_NONE)
+    return v4l_mock_mmap (length, prot, fd, offset);
+  return real_mmap64 (addr, length, prot, flags, fd, offset);
+}
+
+int
+munmap (void *addr, size_t length)
+{
+  guint i;
+
+  V4L_MOCK_RESOLVE ();
+
+  if (mock.lock) {
+    g_mutex_lock (mock.lock);
+    for (i = 0; i < mock.nbuffers; i++) {
+      if (mock.buffers[i].data == addr) {
+        g_mutex_unlock (mock.lock);
+        return 0;
+      }
+    }
+    g_mutex_unlock (mock.lock);
+  }
+  return real_munmap (addr, length);
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_mock_set_period
+
+DESCRIPTION:        This function sets the refresh period of the mock
+                    display. The first call turns the mock device on, it
+                    must come after gst_init and before the plugin is
+                    loaded.
+
+ARGUMENTS PASSED:
+        period      -   time between two vsyncs
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void
+mfw_gst_v4l_mock_set_period (GstClockTime period)
+{
+  if (mock.lock == NULL) {
+    mock.cond = g_cond_new ();
+    mock.shown = -1;
+    mock.begin = GST_CLOCK_TIME_NONE;
+    mock.lock = g_mutex_new ();
+  }
+
+  g_mutex_lock (mock.lock);
+  mock.period = period;
+  g_mutex_unlock (mock.lock);
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_mock_render_begin
+
+DESCRIPTION:        This function marks the start of a render in the calling
+                    thread, the next VIDIOC_QBUF from that thread ends it.
+
+ARGUMENTS PASSED:   None
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void
+mfw_gst_v4l_mock_render_begin (void)
+{
+  g_mutex_lock (mock.lock);
+  mock.begin_thread = g_thread_self ();
+  mock.begin = gst_util_get_timestamp ();
+  g_mutex_unlock (mock.lock);
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_mock_get_stats
+
+DESCRIPTION:        This function reads and clears the mock device counters.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lMockStats to fill
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void
+mfw_gst_v4l_mock_get_stats (MfwV4lMockStats * stats)
+{
+  g_mutex_lock (mock.lock);
+  *stats = mock.stats;
+  memset (&mock.stats, 0, sizeof (MfwV4lMockStats));
+  g_mutex_unlock (mock.lock);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_v4l_mock.h
+ *
+ * Description:    Header file of the in-process V4L2 output device used to
+ *                 benchmark the V4L sink without display hardware.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                                INCLUDE FILES
+=============================================================================*/
+
+#ifndef _MFW_GST_V4L_MOCK_H_
+#define _MFW_GST_V4L_MOCK_H_
+
+#include <gst/gst.h>
+
+/*=============================================================================
+                                MACROS
+=============================================================================*/
+
+#define V4L_MOCK_MAX_BUFFERS     32
+#define V4L_MOCK_SCREEN_WIDTH    1024
+#define V4L_MOCK_SCREEN_HEIGHT   768
+
+/*=============================================================================
+                LOCAL TYPEDEFS (STRUCTURES, UNIONS, ENUMS)
+=============================================================================*/
+
+typedef struct
+{
+  guint queued;                 /* VIDIOC_QBUF calls */
+  guint dequeued;               /* VIDIOC_DQBUF calls returning a buffer */
+  guint render_dequeues;        /* of those, made by the queueing thread */
+  guint shown;                  /* frames put on screen */
+  guint repeated;               /* vsyncs with no new frame to show */
+  guint rendered;               /* renders timed */
+  GstClockTime render_sum;      /* render start to VIDIOC_QBUF */
+  GstClockTime render_max;
+} MfwV4lMockStats;
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_mock_set_period
+
+DESCRIPTION:        This function sets the refresh period of the mock
+                    display. At 0 a queued frame is shown at once, and the
+                    frame before it is released, so only the sink limits the
+                    frame rate.
+
+ARGUMENTS PASSED:
+        period      -   time between two vsyncs
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_mock_set_period (GstClockTime period);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_mock_render_begin
+
+DESCRIPTION:        This function marks the start of a render in the calling
+                    thread, the next VIDIOC_QBUF from that thread ends it.
+
+ARGUMENTS PASSED:   None
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_mock_render_begin (void);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_mock_get_stats
+
+DESCRIPTION:        This function reads and clears the mock device counters.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lMockStats to fill
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_mock_get_stats (MfwV4lMockStats * stats);
+
+#endif /* _MFW_GST_V4L_MOCK_H_ */
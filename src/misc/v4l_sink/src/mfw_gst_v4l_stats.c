@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_v4l_stats.c
+ *
+ * Description:    Display pacing statistics of V4L Sink Plugin. Frames are
+ *                 recorded when queued and dequeued; the V4L output queue
+ *                 is a fifo, so the dequeue of a frame is taken as the
+ *                 moment the next frame goes on screen and as the vsync
+ *                 estimate.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                            INCLUDE FILES
+=============================================================================*/
+
+#include <string.h>
+#include <gst/gst.h>
+
+#include "mfw_gst_v4l_stats.h"
+
+GST_DEBUG_CATEGORY_EXTERN (mfw_gst_v4lsink_debug);
+#define GST_CAT_DEFAULT mfw_gst_v4lsink_debug
+
+#define RECORD_OF(stats, seq) (&(stats)->records[(seq) & (V4L_STATS_RECORDS - 1)])
+
+/*=============================================================================
+                             LOCAL FUNCTIONS
+=============================================================================*/
+
+static void
+mfw_gst_v4l_stats_clear (MfwV4lStats * stats)
+{
+  memset (stats->records, 0, sizeof (stats->records));
+  memset (stats->seqmap, 0, sizeof (stats->seqmap));
+  stats->qseq = 0;
+
+  stats->frames = 0;
+  stats->late = 0;
+  stats->underruns = 0;
+  memset (stats->histogram, 0, sizeof (stats->histogram));
+  stats->latency_sum = 0;
+  stats->latency_max = 0;
+  stats->jitter_sum = 0;
+  stats->jitter_max = 0;
+  stats->jitter_count = 0;
+  stats->last_shown.shown = GST_CLOCK_TIME_NONE;
+}
+
+static void
+mfw_gst_v4l_stats_shown (MfwV4lStats * stats, MfwV4lFrameRecord * rec,
+    GstClockTime now)
+{
+  GstClockTime latency = 0, period;
+  guint bin;
+
+  rec->shown = now;
+  stats->frames++;
+
+  if (now > rec->intended)
+    latency = now - rec->intended;
+
+  bin = latency / V4L_STATS_BIN_WIDTH;
+  if (bin >= V4L_STATS_BINS)
+    bin = V4L_STATS_BINS - 1;
+  stats->histogram[bin]++;
+
+  stats->latency_sum += latency;
+  if (latency > stats->latency_max)
+    stats->latency_max = latency;
+
+  period = GST_CLOCK_TIME_IS_VALID (stats->period) ?
+      stats->period : V4L_STATS_PERIOD_DEFAULT;
+  if (latency > period)
+    stats->late++;
+
+  /* jitter is the difference between shown and intended frame interval */
+  if (GST_CLOCK_TIME_IS_VALID (stats->last_shown.shown)
+      && (rec->intended >= stats->last_shown.intended)) {
+    GstClockTimeDiff shown_int = GST_CLOCK_DIFF (stats->last_shown.shown, now);
+    GstClockTimeDiff intended_int =
+        GST_CLOCK_DIFF (stats->last_shown.intended, rec->intended);
+    GstClockTime jitter = ABS (shown_int - intended_int);
+
+    stats->jitter_sum += jitter;
+    if (jitter > stats->jitter_max)
+      stats->jitter_max = jitter;
+    stats->jitter_count++;
+  }
+
+  stats->last_shown = *rec;
+}
+
+static void
+mfw_gst_v4l_stats_update_period (MfwV4lStats * stats, GstClockTime now)
+{
+  if (GST_CLOCK_TIME_IS_VALID (stats->last_dq) && (now > stats->last_dq)) {
+    GstClockTime interval = now - stats->last_dq;
+
+    /* dequeue happens on vsync, the shortest interval is the period */
+    if ((interval >= V4L_STATS_PERIOD_MIN)
+        && ((!GST_CLOCK_TIME_IS_VALID (stats->period_min))
+            || (interval < stats->period_min)))
+      stats->period_min = interval;
+
+    stats->period_count++;
+    if ((stats->period_count >= V4L_STATS_PERIOD_WINDOW)
+        || ((!GST_CLOCK_TIME_IS_VALID (stats->period))
+            && (stats->period_count >= V4L_STATS_PERIOD_WINDOW / 8))) {
+      if (GST_CLOCK_TIME_IS_VALID (stats->period_min)) {
+        stats->period = stats->period_min;
+        GST_LOG ("refresh period estimate %" GST_TIME_FORMAT,
+            GST_TIME_ARGS (stats->period));
+      }
+      stats->period_min = GST_CLOCK_TIME_NONE;
+      stats->period_count = 0;
+    }
+  }
+  stats->last_dq = now;
+}
+
+/*=============================================================================
+                             GLOBAL FUNCTIONS
+=============================================================================*/
+
+void
+mfw_gst_v4l_stats_init (MfwV4lStats * stats)
+{
+  memset (stats, 0, sizeof (MfwV4lStats));
+  stats->lock = g_mutex_new ();
+  stats->last_dq = GST_CLOCK_TIME_NONE;
+  stats->period = GST_CLOCK_TIME_NONE;
+  stats->period_min = GST_CLOCK_TIME_NONE;
+  mfw_gst_v4l_stats_clear (stats);
+}
+
+void
+mfw_gst_v4l_stats_free (MfwV4lStats * stats)
+{
+  if (stats->lock) {
+    g_mutex_free (stats->lock);
+    stats->lock = NULL;
+  }
+}
+
+void
+mfw_gst_v4l_stats_reset (MfwV4lStats * stats)
+{
+  g_mutex_lock (stats->lock);
+  mfw_gst_v4l_stats_clear (stats);
+  g_mutex_unlock (stats->lock);
+}
+
+void
+mfw_gst_v4l_stats_queued (MfwV4lStats * stats, guint index,
+    GstClockTime intended, GstClockTime queued)
+{
+  MfwV4lFrameRecord *rec;
+
+  if (index >= V4L_STATS_MAX_INDEX)
+    return;
+
+  g_mutex_lock (stats->lock);
+  rec = RECORD_OF (stats, stats->qseq);
+  rec->index = index;
+  rec->intended = intended;
+  rec->queued = queued;
+  rec->dequeued = GST_CLOCK_TIME_NONE;
+  rec->shown = GST_CLOCK_TIME_NONE;
+  /* 0 is for not queued */
+  stats->seqmap[index] = ++stats->qseq;
+  g_mutex_unlock (stats->lock);
+}
+
+void
+mfw_gst_v4l_stats_dequeued (MfwV4lStats * stats, guint index,
+    gboolean starved)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  guint64 seq;
+
+  g_mutex_lock (stats->lock);
+
+  mfw_gst_v4l_stats_update_period (stats, now);
+
+  if (starved)
+    stats->underruns++;
+
+  if ((index < V4L_STATS_MAX_INDEX) && (stats->seqmap[index])) {
+    seq = stats->seqmap[index] - 1;
+    stats->seqmap[index] = 0;
+
+    /* record still in the ring */
+    if (seq + V4L_STATS_RECORDS > stats->qseq) {
+      RECORD_OF (stats, seq)->dequeued = now;
+
+      if ((seq + 1 < stats->qseq)
+          && (!GST_CLOCK_TIME_IS_VALID (RECORD_OF (stats, seq + 1)->shown)))
+        mfw_gst_v4l_stats_shown (stats, RECORD_OF (stats, seq + 1), now);
+    }
+  }
+
+  g_mutex_unlock (stats->lock);
+}
+
+GstClockTime
+mfw_gst_v4l_stats_pace (MfwV4lStats * stats, GstClockTime intended)
+{
+  GstClockTime ret = GST_CLOCK_TIME_NONE;
+  GstClockTime slot;
+  guint64 n;
+
+  g_mutex_lock (stats->lock);
+  if (GST_CLOCK_TIME_IS_VALID (stats->period)
+      && GST_CLOCK_TIME_IS_VALID (stats->last_dq)
+      && (intended > stats->last_dq)) {
+    /* vsync nearest to the intended time, queue half a period before */
+    n = (intended - stats->last_dq + stats->period / 2) / stats->period;
+    if (n > 0) {
+      slot = stats->last_dq + n * stats->period;
+      ret = slot - stats->period / 2;
+    }
+  }
+  g_mutex_unlock (stats->lock);
+
+  return ret;
+}
+
+GstStructure *
+mfw_gst_v4l_stats_get_structure (MfwV4lStats * stats)
+{
+  GstStructure *s;
+  GValue array = { 0 };
+  GValue item = { 0 };
+  gint i;
+
+  g_value_init (&array, GST_TYPE_ARRAY);
+
+  g_mutex_lock (stats->lock);
+
+  for (i = 0; i < V4L_STATS_BINS; i++) {
+    g_value_init (&item, G_TYPE_UINT);
+    g_value_set_uint (&item, stats->histogram[i]);
+    gst_value_array_append_value (&array, &item);
+    g_value_unset (&item);
+  }
+
+  s = gst_structure_new ("v4lsink-stats",
+      "frames", G_TYPE_UINT, stats->frames,
+      "late", G_TYPE_UINT, stats->late,
+      "underruns", G_TYPE_UINT, stats->underruns,
+      "latency-avg", G_TYPE_UINT64,
+      stats->frames ? stats->latency_sum / stats->frames : 0,
+      "latency-max", G_TYPE_UINT64, stats->latency_max,
+      "jitter-avg", G_TYPE_UINT64,
+      stats->jitter_count ? stats->jitter_sum / stats->jitter_count : 0,
+      "jitter-max", G_TYPE_UINT64, stats->jitter_max,
+      "refresh-period", G_TYPE_UINT64,
+      GST_CLOCK_TIME_IS_VALID (stats->period) ? stats->period : 0,
+      "bin-width", G_TYPE_UINT64, (guint64) V4L_STATS_BIN_WIDTH, NULL);
+
+  g_mutex_unlock (stats->lock);
+
+  gst_structure_set_value (s, "histogram", &array);
+  g_value_unset (&array);
+
+  return s;
+}
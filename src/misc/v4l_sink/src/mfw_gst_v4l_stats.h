@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2012, Freescale Semiconductor, Inc.
+ *
+ */
+
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Module Name:    mfw_gst_v4l_stats.h
+ *
+ * Description:    Header file of V4L sink display pacing statistics.
+ *
+ * Portability:    This code is written for Linux OS and Gstreamer
+ */
+
+/*
+ * Changelog:
+ *
+ */
+
+/*=============================================================================
+                                INCLUDE FILES
+=============================================================================*/
+
+#ifndef _MFW_GST_V4L_STATS_H_
+#define _MFW_GST_V4L_STATS_H_
+
+#include <gst/gst.h>
+
+/*=============================================================================
+                                MACROS
+=============================================================================*/
+
+#define V4L_STATS_RECORDS        64  /* per frame records kept, power of 2 */
+#define V4L_STATS_MAX_INDEX      64  /* max v4l buffer index tracked */
+#define V4L_STATS_BINS           16  /* latency histogram bins */
+#define V4L_STATS_BIN_WIDTH      (2 * GST_MSECOND)
+#define V4L_STATS_PERIOD_WINDOW  64  /* dequeues per refresh period estimate */
+#define V4L_STATS_PERIOD_MIN     (4 * GST_MSECOND)
+#define V4L_STATS_PERIOD_DEFAULT (GST_SECOND / 60)
+
+/*=============================================================================
+                LOCAL TYPEDEFS (STRUCTURES, UNIONS, ENUMS)
+=============================================================================*/
+
+/* All times are from gst_util_get_timestamp () */
+typedef struct
+{
+  guint index;                  /* v4l buffer index */
+  GstClockTime intended;        /* time the frame should be on screen */
+  GstClockTime queued;          /* time queued to the device */
+  GstClockTime dequeued;        /* time dequeued from the device */
+  GstClockTime shown;           /* time it went on screen, estimated by the
+                                   dequeue of the previous frame */
+} MfwV4lFrameRecord;
+
+typedef struct
+{
+  GMutex *lock;
+
+  MfwV4lFrameRecord records[V4L_STATS_RECORDS];
+  guint64 seqmap[V4L_STATS_MAX_INDEX];  /* last sequence queued by index */
+  guint64 qseq;                 /* next sequence to be queued */
+
+  /* vsync estimate from dequeue timestamps */
+  GstClockTime last_dq;
+  GstClockTime period;
+  GstClockTime period_min;
+  guint period_count;
+
+  /* accumulated result */
+  guint frames;                 /* frames shown */
+  guint late;                   /* frames shown later than one period */
+  guint underruns;              /* no frame pending when one is dequeued */
+  guint histogram[V4L_STATS_BINS];
+  GstClockTime latency_sum;
+  GstClockTime latency_max;
+  GstClockTime jitter_sum;
+  GstClockTime jitter_max;
+  guint jitter_count;
+  MfwV4lFrameRecord last_shown;
+} MfwV4lStats;
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_stats_init
+
+DESCRIPTION:        This function initializes the statistics context.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lStats
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_stats_init (MfwV4lStats * stats);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_stats_free
+
+DESCRIPTION:        This function releases the statistics context.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lStats
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_stats_free (MfwV4lStats * stats);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_stats_reset
+
+DESCRIPTION:        This function clears the records and the accumulated
+                    result, the refresh period estimate is kept.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lStats
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_stats_reset (MfwV4lStats * stats);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_stats_queued
+
+DESCRIPTION:        This function records a frame queued to the device.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lStats
+        index       -   v4l buffer index
+        intended    -   time the frame should be on screen
+        queued      -   time the frame is queued
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_stats_queued (MfwV4lStats * stats, guint index,
+    GstClockTime intended, GstClockTime queued);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_stats_dequeued
+
+DESCRIPTION:        This function records a frame dequeued from the device,
+                    the next queued frame is taken as shown at this time.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lStats
+        index       -   v4l buffer index
+        starved     -   TRUE if no frame is pending in the device
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+void mfw_gst_v4l_stats_dequeued (MfwV4lStats * stats, guint index,
+    gboolean starved);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_stats_pace
+
+DESCRIPTION:        This function computes when a frame should be queued so
+                    that it is shown on the vsync nearest to its intended
+                    time.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lStats
+        intended    -   time the frame should be on screen
+
+RETURN VALUE:       time to queue the frame, GST_CLOCK_TIME_NONE if the
+                    vsync is not known yet
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+GstClockTime mfw_gst_v4l_stats_pace (MfwV4lStats * stats,
+    GstClockTime intended);
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4l_stats_get_structure
+
+DESCRIPTION:        This function returns the accumulated result as a new
+                    "v4lsink-stats" structure.
+
+ARGUMENTS PASSED:
+        stats       -   pointer to MfwV4lStats
+
+RETURN VALUE:       new GstStructure, free with gst_structure_free
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+GstStructure *mfw_gst_v4l_stats_get_structure (MfwV4lStats * stats);
+
+#endif /* _MFW_GST_V4L_STATS_H_ */
@@ -89,6 +89,7 @@ void mfw_gst_v4l2_suspend(MFW_GST_V4LSINK_INFO_T *v4l_info)
     type = V4L2_BUF_TYPE_VIDEO_OUTPUT;
     if (v4l_info->stream_on){
         v4l_info->stream_on = FALSE;
+        mfw_gst_v4l2_stop_dq_thread(v4l_info);
         mfw_gst_v4l2_clear_showingbuf(v4l_info);
         v4l_info->qbuff_count = 0;
     }
@@ -117,7 +118,8 @@ void mfw_gst_v4l2_resume(MFW_GST_V4LSINK_INFO_T *v4l_info)
     if (v4l_info->stream_on){
  
         v4l_info->stream_on = FALSE;
-		
+        mfw_gst_v4l2_stop_dq_thread(v4l_info);
+
         mfw_gst_v4l2_clear_showingbuf(v4l_info);
 
         v4l_info->qbuff_count = 0;
@@ -143,6 +143,9 @@ enum
   TV_MODE,
 #endif
   DUMP_LOCATION,
+  DUMP_INTERVAL,
+  DUMP_ROI,
+  DUMP_DROPPED,
   ADDITIONAL_BUFFER_DEPTH,
   SETPARA,
   PROP_STRETCH,
@@ -161,6 +164,9 @@ enum
   PROP_DEVICE_NAME,
   PROP_DEINTERLACE_MOTION,
   PROP_DEINTERLACE_ENABLE,
+  PROP_PACING,
+  PROP_STATS_INTERVAL,
+  PROP_STATS,
 };
 
 
@@ -193,6 +199,7 @@ static guint mfw_gst_v4lsink_signals[SIGNAL_LAST] = { 0 };
 #define HW_DEINTERLACE
 #define QUEUE_SIZE_HIGH 5
 #define DEQUEUE_TIMES_IN_SHOW 10000
+#define V4L_PACING_MAX_WAIT (50 * GST_MSECOND)
 
 /*=============================================================================
                               LOCAL MACROS
@@ -703,6 +710,9 @@ mfw_gst_v4lsink_close (MFW_GST_V4LSINK_INFO_T * v4l_info)
     return;
   }
 
+  /* the dequeue thread takes pool_lock, stop it before */
+  mfw_gst_v4l2_stop_dq_thread (v4l_info);
+
   g_mutex_lock (v4l_info->pool_lock);
 
   if (v4l_info->init) {
@@ -822,6 +832,23 @@ mfw_gst_v4lsink_set_property (GObject * object, guint prop_id,
     case DUMP_LOCATION:
       dumpfile_set_location (v4l_info, g_value_get_string (value));
       break;
+    case DUMP_INTERVAL:
+      v4l_info->dump_interval = g_value_get_int (value);
+      if (v4l_info->dump)
+        mfw_gst_fdump_set_interval (v4l_info->dump, v4l_info->dump_interval);
+      break;
+    case DUMP_ROI:
+      if (!mfw_gst_fdump_parse_roi (g_value_get_string (value),
+              &v4l_info->dump_roi[0], &v4l_info->dump_roi[1],
+              &v4l_info->dump_roi[2], &v4l_info->dump_roi[3])) {
+        GST_WARNING ("invalid dump-roi, expect \"left,top,width,height\"");
+        memset (v4l_info->dump_roi, 0, sizeof (v4l_info->dump_roi));
+      }
+      if (v4l_info->dump)
+        mfw_gst_fdump_set_roi (v4l_info->dump, v4l_info->dump_roi[0],
+            v4l_info->dump_roi[1], v4l_info->dump_roi[2],
+            v4l_info->dump_roi[3]);
+      break;
     case SETPARA:
       v4l_info->setpara |= g_value_get_int (value);
       break;
@@ -867,6 +894,14 @@ mfw_gst_v4lsink_set_property (GObject * object, guint prop_id,
       v4l_info->enable_deinterlace = g_value_get_boolean(value);
       break;
 
+    case PROP_PACING:
+      v4l_info->pacing = g_value_get_boolean (value);
+      break;
+
+    case PROP_STATS_INTERVAL:
+      v4l_info->stats_interval = g_value_get_int (value);
+      break;
+
     default:
       GST_DEBUG ("unkwown id:%d", prop_id);
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -939,6 +974,23 @@ mfw_gst_v4lsink_get_property (GObject * object, guint prop_id,
     case DUMP_LOCATION:
       g_value_set_string (value, v4l_info->dump_location);
       break;
+    case DUMP_INTERVAL:
+      g_value_set_int (value, v4l_info->dump_interval);
+      break;
+    case DUMP_ROI:
+      g_value_take_string (value, g_strdup_printf ("%d,%d,%d,%d",
+              v4l_info->dump_roi[0], v4l_info->dump_roi[1],
+              v4l_info->dump_roi[2], v4l_info->dump_roi[3]));
+      break;
+    case DUMP_DROPPED:
+    {
+      guint64 dropped = 0;
+
+      if (v4l_info->dump)
+        mfw_gst_fdump_get_stats (v4l_info->dump, NULL, &dropped, NULL);
+      g_value_set_uint64 (value, dropped);
+      break;
+    }
     case SETPARA:
       g_value_set_int (value, v4l_info->setpara);
       break;
@@ -981,6 +1033,22 @@ mfw_gst_v4lsink_get_property (GObject * object, guint prop_id,
       g_value_set_boolean(value, v4l_info->enable_deinterlace);
       break;
 
+    case PROP_PACING:
+      g_value_set_boolean (value, v4l_info->pacing);
+      break;
+
+    case PROP_STATS_INTERVAL:
+      g_value_set_int (value, v4l_info->stats_interval);
+      break;
+
+    case PROP_STATS:
+    {
+      GstStructure *stats = mfw_gst_v4l_stats_get_structure (&v4l_info->stats);
+      g_value_take_string (value, gst_structure_to_string (stats));
+      gst_structure_free (stats);
+      break;
+    }
+
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -993,6 +1061,11 @@ static gboolean
 mfw_gst_v4l2_try_dq_buffer(MFW_GST_V4LSINK_INFO_T *v4l_info, int cntout)
 {
   gint cnt;
+
+  /* displayed buffers are returned by the dequeue thread */
+  if (v4l_info->dq_thread)
+    return TRUE;
+
   for (cnt = 0; cnt < cntout; cnt++) {
     if (v4l_info->v4lqueued <= MIN_QUEUE_NUM) {
       return TRUE;
@@ -1005,6 +1078,89 @@ mfw_gst_v4l2_try_dq_buffer(MFW_GST_V4LSINK_INFO_T *v4l_info, int cntout)
   GST_WARNING("Dqueue failed, %d buffers in v4l2 queue", v4l_info->v4lqueued);
   return FALSE;
 }
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4lsink_intended_time
+
+DESCRIPTION:        This function converts the buffer timestamp to the time
+                    it should be on screen, in gst_util_get_timestamp () base.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+        buf         -   buffer to display
+        now         -   current gst_util_get_timestamp ()
+
+RETURN VALUE:       intended display time, now if it is not known
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+static GstClockTime
+mfw_gst_v4lsink_intended_time (MFW_GST_V4LSINK_INFO_T * v4l_info,
+    GstBuffer * buf, GstClockTime now)
+{
+  GstBaseSink *basesink = GST_BASE_SINK (v4l_info);
+  GstClockTime running, target;
+  GstClockTimeDiff diff;
+  GstClock *clock;
+
+  if (!GST_BUFFER_TIMESTAMP_IS_VALID (buf))
+    return now;
+
+  running = gst_segment_to_running_time (&basesink->segment, GST_FORMAT_TIME,
+      GST_BUFFER_TIMESTAMP (buf));
+  if (!GST_CLOCK_TIME_IS_VALID (running))
+    return now;
+
+  clock = gst_element_get_clock (GST_ELEMENT (v4l_info));
+  if (clock == NULL)
+    return now;
+
+  target = running + GST_ELEMENT_CAST (v4l_info)->base_time
+      + gst_base_sink_get_latency (basesink);
+  diff = GST_CLOCK_DIFF (gst_clock_get_time (clock), target);
+  gst_object_unref (clock);
+
+  if ((diff < 0) && ((GstClockTime) (-diff) > now))
+    return 0;
+  return now + diff;
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_v4lsink_pace
+
+DESCRIPTION:        This function holds the frame until its vsync slot
+                    when pacing is enabled.
+
+ARGUMENTS PASSED:
+        v4l_info    -   pointer to MFW_GST_V4LSINK_INFO_T
+        intended    -   intended display time of the frame
+
+RETURN VALUE:       None
+
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    The wait is bounded by V4L_PACING_MAX_WAIT
+=============================================================================*/
+static void
+mfw_gst_v4lsink_pace (MFW_GST_V4LSINK_INFO_T * v4l_info,
+    GstClockTime intended)
+{
+  GstClockTime slot, now, wait;
+
+  slot = mfw_gst_v4l_stats_pace (&v4l_info->stats, intended);
+  if (!GST_CLOCK_TIME_IS_VALID (slot))
+    return;
+
+  now = gst_util_get_timestamp ();
+  if (slot <= now)
+    return;
+
+  wait = MIN (slot - now, V4L_PACING_MAX_WAIT);
+  GST_LOG ("pacing wait %" GST_TIME_FORMAT, GST_TIME_ARGS (wait));
+  g_usleep (GST_TIME_AS_USECONDS (wait));
+}
 /*=============================================================================
 FUNCTION:           mfw_gst_v4lsink_show_frame
 
@@ -1026,6 +1182,7 @@ mfw_gst_v4lsink_show_frame (GstBaseSink * basesink, GstBuffer * buf)
   struct v4l2_buffer *v4l_buf = NULL;
   GstBuffer *outbuffer = NULL;
   GSList *searchlist;
+  GstClockTime intended;
 
   guint8 i = 0;
   MFWGstV4LSinkBuffer *v4lsink_buffer = NULL;
@@ -1085,12 +1242,8 @@ mfw_gst_v4lsink_show_frame (GstBaseSink * basesink, GstBuffer * buf)
       /* Clear the buffer in queue */
 #if 0
       {
-        gint i;
-        i = g_list_length (v4l_info->v4llist);
-        while (i > 1) {
+        while (v4l_info->v4lqueued > 1) {
           mfw_gst_v4l2_dq_buffer (v4l_info);
-          i = g_list_length (v4l_info->v4llist);
-
         }
         mfw_gst_v4l2_streamoff (v4l_info);
         mfw_gst_v4l2_clear_showingbuf (v4l_info);
@@ -1157,7 +1310,8 @@ mfw_gst_v4lsink_show_frame (GstBaseSink * basesink, GstBuffer * buf)
       ((MFWGstV4LSinkBuffer *) outbuffer)->bufstate = BUF_STATE_SHOWED;
     } else {
       //try to dq once only
-      if (v4l_info->v4lqueued > MIN_QUEUE_NUM) {
+      if ((v4l_info->dq_thread == NULL)
+          && (v4l_info->v4lqueued > MIN_QUEUE_NUM)) {
         mfw_gst_v4l2_dq_buffer (v4l_info);
       }
 
@@ -1192,6 +1346,11 @@ mfw_gst_v4lsink_show_frame (GstBaseSink * basesink, GstBuffer * buf)
 
   }
 
+  intended = mfw_gst_v4lsink_intended_time (v4l_info, buf,
+      gst_util_get_timestamp ());
+  if (v4l_info->pacing)
+    mfw_gst_v4lsink_pace (v4l_info, intended);
+
   {
     /*display immediately */
     struct timeval queuetime;
@@ -1212,41 +1371,35 @@ mfw_gst_v4lsink_show_frame (GstBaseSink * basesink, GstBuffer * buf)
 
   v4lsink_buffer->showcnt++;
   v4l_info->rendered++;
-  if (g_list_find (v4l_info->v4llist, (gpointer) v4l_buf->index)) {
-    GST_WARNING ("Try to display frame %s(state %d) which already in displaying queue!",
+  if (!mfw_gst_v4l2_mark_queued (v4l_info, v4l_buf->index)) {
+    GST_WARNING ("Try to display frame %d(state %d) which already in displaying queue!",
             v4l_buf->index, v4lsink_buffer->bufstate );
 
     gst_buffer_unref(v4lsink_buffer);
     goto trydq;
 
-  } else {
-    v4l_info->v4llist =
-        g_list_append (v4l_info->v4llist, (gpointer) v4l_buf->index);
-    gint i;
-    GST_LOG ("total queued:%d", g_list_length (v4l_info->v4llist));
-    for (i = 0; i < g_list_length (v4l_info->v4llist); i++) {
-      GST_LOG ("\t:%d", (gint) (g_list_nth_data (v4l_info->v4llist, i)));
-    }
   }
+  GST_LOG ("total queued:%d", v4l_info->v4lqueued);
 
   int err_num = ioctl (v4l_info->v4l_id, VIDIOC_QBUF, v4l_buf);
   if (G_UNLIKELY (err_num < 0)) {
-    gint i;
-    gpointer data;
+    mfw_gst_v4l2_unmark_queued (v4l_info, v4l_buf->index);
     GST_ERROR ("VIDIOC_QBUF:%d failed, error:%d, queued:%d\n", v4l_buf->index,
         err_num, v4l_info->v4lqueued);
-    GST_ERROR ("total queued:%d", g_list_length (v4l_info->v4llist));
-    for (i = 0; i < g_list_length (v4l_info->v4llist); i++) {
-      data = g_list_nth_data (v4l_info->v4llist, i);
-      GST_ERROR ("\t:%d", (gint) data);
-    }
-    g_mutex_unlock (v4l_info->pool_lock);
     return GST_FLOW_ERROR;
   } else
     GST_LOG ("queued: %d", v4l_buf->index);
 
   v4lsink_buffer->bufstate = BUF_STATE_SHOWING;
-  v4l_info->v4lqueued++;
+  mfw_gst_v4l_stats_queued (&v4l_info->stats, v4l_buf->index, intended,
+      gst_util_get_timestamp ());
+
+  if ((v4l_info->stats_interval > 0)
+      && ((v4l_info->rendered % v4l_info->stats_interval) == 0)) {
+    gst_element_post_message (GST_ELEMENT (v4l_info),
+        gst_message_new_element (GST_OBJECT (v4l_info),
+            mfw_gst_v4l_stats_get_structure (&v4l_info->stats)));
+  }
 
   /* Switch on the stream display as soon as there are more than 1 buffer
      in the V4L queue */
@@ -1308,15 +1461,6 @@ trydq:
       mfw_gst_v4l2_try_dq_buffer(v4l_info, DEQUEUE_TIMES_IN_SHOW);
     }
   }
-#if 0
-  {
-    gint i;
-    GST_LOG ("total queued:%d", g_list_length (v4l_info->v4llist));
-    for (i = 0; i < g_list_length (v4l_info->v4llist); i++) {
-      GST_LOG ("\t:%d", (gint) (g_list_nth_data (v4l_info->v4llist, i)));
-    }
-  }
-#endif
   return GST_FLOW_OK;
 }
 
@@ -1480,10 +1624,10 @@ mfw_gst_v4lsink_change_state (GstElement * element, GstStateChange transition)
 
       v4l_info->init = FALSE;
       v4l_info->buffer_alloc_called = FALSE;
-      v4l_info->free_pool = NULL;
+      v4l_info->free_count = 0;
       v4l_info->reservedhwbuffer_list = NULL;
       v4l_info->v4lqueued = 0;
-      // v4l_info->v4llist = g_list_alloc();
+      mfw_gst_v4l_stats_reset (&v4l_info->stats);
 
       v4l_info->swbuffer_count = 0;
       v4l_info->frame_dropped = 0;
@@ -1609,9 +1753,16 @@ mfw_gst_v4lsink_finalize (GObject * object)
 {
   MFW_GST_V4LSINK_INFO_T *v4l_info = MFW_GST_V4LSINK (object);
 
+  mfw_gst_v4l2_stop_dq_thread (v4l_info);
+
   g_mutex_free (v4l_info->pool_lock);
   v4l_info->pool_lock = NULL;
 
+  g_cond_free (v4l_info->dq_cond);
+  v4l_info->dq_cond = NULL;
+
+  mfw_gst_v4l_stats_free (&v4l_info->stats);
+
   g_mutex_free (v4l_info->flow_lock);
   v4l_info->flow_lock = NULL;
 
@@ -1624,7 +1775,7 @@ mfw_gst_v4lsink_finalize (GObject * object)
 
   mfw_gst_v4l2_close (v4l_info);
 
-  MFW_WEAK_ASSERT (v4l_info->free_pool == NULL);
+  MFW_WEAK_ASSERT (v4l_info->free_count == 0);
 
   PRINT_FINALIZE ("v4l_sink");
   G_OBJECT_CLASS (parent_class)->finalize (object);
@@ -1675,8 +1826,9 @@ mfw_gst_v4lsink_init (MFW_GST_V4LSINK_INFO_T * v4l_info,
   /* Initialization for the dump image to local file */
   v4l_info->enable_dump = FALSE;
   v4l_info->dump_location = NULL;
-  v4l_info->dumpfile = NULL;
-  v4l_info->dump_length = 0;
+  v4l_info->dump = NULL;
+  v4l_info->dump_interval = 1;
+  memset (v4l_info->dump_roi, 0, sizeof (v4l_info->dump_roi));
   v4l_info->cr_left_bypixel_orig = 0;
   v4l_info->cr_right_bypixel_orig = 0;
   v4l_info->cr_top_bypixel_orig = 0;
@@ -1685,6 +1837,17 @@ mfw_gst_v4lsink_init (MFW_GST_V4LSINK_INFO_T * v4l_info,
   v4l_info->pool_lock = g_mutex_new ();
   v4l_info->flow_lock = g_mutex_new ();
 
+  v4l_info->free_stack = NULL;
+  v4l_info->free_count = 0;
+  v4l_info->v4lqueuedmap = NULL;
+  v4l_info->dq_thread = NULL;
+  v4l_info->dq_thread_exit = FALSE;
+  v4l_info->dq_cond = g_cond_new ();
+
+  mfw_gst_v4l_stats_init (&v4l_info->stats);
+  v4l_info->stats_interval = 0;
+  v4l_info->pacing = FALSE;
+
   v4l_info->setpara = PARAM_NULL;
   v4l_info->outformat = V4L2_PIX_FMT_YUV420;
 
@@ -1858,6 +2021,25 @@ mfw_gst_v4lsink_class_init (MFW_GST_V4LSINK_INFO_CLASS_T * klass)
           "Enable it will output image to file instead of V4L device",
           NULL, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, DUMP_INTERVAL,
+      g_param_spec_int ("dump-interval",
+          "Dump Interval",
+          "Dump one frame of every dump-interval frames",
+          1, G_MAXINT, 1, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, DUMP_ROI,
+      g_param_spec_string ("dump-roi",
+          "Dump Region Of Interest",
+          "Region of the visible image to dump as \"left,top,width,height\", "
+          "a zero width or height dumps the whole image",
+          NULL, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, DUMP_DROPPED,
+      g_param_spec_uint64 ("dump-dropped",
+          "Dump Dropped",
+          "Frames not dumped because the writer could not keep up",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE));
+
 
   g_object_class_install_property (gobject_class, PROP_FORCE_ASPECT_RATIO,
       g_param_spec_boolean
@@ -1920,6 +2102,23 @@ mfw_gst_v4lsink_class_init (MFW_GST_V4LSINK_INFO_CLASS_T * klass)
       g_param_spec_boolean ("deinterlace", "deinterlace",
           "set deinterlace enabled", FALSE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_PACING,
+      g_param_spec_boolean ("pacing", "pacing",
+          "Hold frames until the vsync nearest to their timestamp, "
+          "the vsync is estimated from the dequeue time",
+          FALSE, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_int ("stats-interval", "stats interval",
+          "Post a v4lsink-stats element message every N frames, 0: disable",
+          0, G_MAXINT, 0, G_PARAM_READWRITE));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_string ("stats", "stats",
+          "Display pacing statistics: frames, late frames, underruns, "
+          "latency/jitter in ns and latency histogram",
+          NULL, G_PARAM_READABLE));
+
 
   return;
 
@@ -64,6 +64,8 @@ struct v4l2_mxc_offset
 #include <string.h>
 
 #include "mfw_gst_utils.h"
+#include "mfw_gst_v4l_stats.h"
+#include "mfw_gst_fdump.h"
 
 #ifdef USE_X11
 #include "mfw_gst_xlib.h"
@@ -248,8 +250,9 @@ typedef struct MFW_GST_V4LSINK_INFO_S
   gint cr_bottom_bypixel_orig;  /* original crop bottom offset set by decoder in caps */
   gboolean enable_dump;
   gchar *dump_location;
-  FILE *dumpfile;
-  guint64 dump_length;
+  MfwGstFrameDump *dump;        /* background writer of dump_location */
+  gint dump_interval;           /* dump one frame every dump_interval */
+  gint dump_roi[4];             /* dump region: left, top, width, height */
 
 
   gint qbuff_count;             /* buffer counter, increase when frame queued to v4l device */
@@ -261,12 +264,17 @@ typedef struct MFW_GST_V4LSINK_INFO_S
   gint swbuffer_count;          /* pre-allocated sw buffer counter */
 
   GMutex *pool_lock;            /* lock for buffer pool operation */
-  GSList *free_pool;            /* pool for free v4l buffer */
+  gint *free_stack;             /* stack of free hw buffer index, O(1) push/pop */
+  gint free_count;              /* number of index in free_stack */
 
   void *reservedhwbuffer_list;  /* list to a hw v4l buffer reserved for render a swbuffer
                                  */
   gint v4lqueued;               /* counter for queued v4l buffer in device queue */
-  GList *v4llist;
+  guint8 *v4lqueuedmap;         /* queued flag of each hw buffer, by v4l index */
+
+  GThread *dq_thread;           /* thread polling the device and dequeuing buffers */
+  gboolean dq_thread_exit;      /* request the dequeue thread to exit */
+  GCond *dq_cond;               /* signaled on queue/dequeue, protected by pool_lock */
   void **all_buffer_pool;       /* malloced array to store all hw/sw buffers */
   int additional_buffer_depth;
   int frame_dropped;
@@ -312,6 +320,10 @@ typedef struct MFW_GST_V4LSINK_INFO_S
   gint motion;
 
   gboolean enable_deinterlace;
+
+  MfwV4lStats stats;            /* display pacing statistics */
+  gint stats_interval;          /* frames between stats bus message, 0 off */
+  gboolean pacing;              /* hold frames until their vsync slot */
 } MFW_GST_V4LSINK_INFO_T;
 
 
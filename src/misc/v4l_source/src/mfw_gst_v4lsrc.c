@@ -318,6 +318,34 @@ mfw_gst_v4lsrc_start_capturing (MFWGstV4LSrc * v4l_src)
   MFWGstV4LSrcBuffer *v4lsrc_buf = NULL;
   enum v4l2_buf_type type;
 
+  struct v4l2_format fmt;
+  guint offsets[3], strides[3];
+  guint n_planes = 0;
+  guint32 fourcc = 0;
+
+  /* plane layout of the captured frames, the border left by crop_pixel is
+     addressed by the driver offsets and not described */
+  memset (&fmt, 0, sizeof (fmt));
+  fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+  if ((v4l_src->crop_pixel == 0) && (ioctl (v4l_src->fd_v4l, VIDIOC_G_FMT,
+              &fmt) == 0)) {
+    guint ysize = fmt.fmt.pix.bytesperline * fmt.fmt.pix.height;
+    offsets[0] = 0;
+    strides[0] = fmt.fmt.pix.bytesperline;
+    if (fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_NV12) {
+      fourcc = GST_MAKE_FOURCC ('N', 'V', '1', '2');
+      n_planes = 2;
+      offsets[1] = ysize;
+      strides[1] = strides[0];
+    } else if (fmt.fmt.pix.pixelformat == V4L2_PIX_FMT_YUV420) {
+      fourcc = GST_MAKE_FOURCC ('I', '4', '2', '0');
+      n_planes = 3;
+      offsets[1] = ysize;
+      offsets[2] = ysize + ysize / 4;
+      strides[1] = strides[2] = strides[0] / 2;
+    }
+  }
+
   v4l_src->buffers = g_malloc (v4l_src->queue_size * sizeof (GstBuffer *));
   // query for v4l_src->queue_size number of buffers to store the captured data 
   for (i = 0; i < v4l_src->queue_size; i++) {
@@ -352,6 +380,13 @@ mfw_gst_v4lsrc_start_capturing (MFWGstV4LSrc * v4l_src)
       index = G_N_ELEMENTS (v4l_src->buffers[i]->_gst_reserved) - 1;
       meta = gst_buffer_meta_new ();
       meta->physical_data = (gpointer) (buf->m.offset);
+      if (n_planes) {
+        gst_buffer_meta_set_layout (meta, fourcc,
+            GST_BUFFER_DATA (v4l_src->buffers[i]), strides[0],
+            fmt.fmt.pix.height, n_planes, offsets, strides);
+        gst_buffer_meta_set_crop (meta, 0, 0, fmt.fmt.pix.width,
+            fmt.fmt.pix.height);
+      }
       v4l_src->buffers[i]->_gst_reserved[index] = meta;
     }
 
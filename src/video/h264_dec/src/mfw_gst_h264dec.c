@@ -45,6 +45,7 @@
 #include "avcd_dec_api.h"
 
 #include "mfw_gst_utils.h"
+#include "mfw_gst_nalconv.h"
 
 #include "mfw_gst_h264dec.h"
 
@@ -162,90 +163,75 @@ IMPORTANT NOTES:
 static void mfw_gst_calculate_nal_units(MFW_GST_H264DEC_INFO_T *
 					h264dec_struct)
 {
-    gint32 i = 0;
-    guint8 *temp = NULL;
-    temp = GST_BUFFER_DATA(h264dec_struct->input_buffer);
+    guint8 *data = GST_BUFFER_DATA(h264dec_struct->input_buffer);
+    guint8 *end = data + GST_BUFFER_SIZE(h264dec_struct->input_buffer);
+    const guint8 *scan = data;
+    const guint8 *payload = data;
+    const guint8 *code;
+    gint32 count = 0;
 
     /* parses the NAL Header and find out how many NAL units are there in a
-       chunk and numbers of bytes in each NAL units */
-    while (i < GST_BUFFER_SIZE(h264dec_struct->input_buffer)) {
-	if (temp[i] == 0x00 && temp[i + 1] == 0x00 &&
-	    temp[i + 2] == 0x00 && temp[i + 3] == 0x01) {
-	    GST_DEBUG("\nFound a NAL Unit in the given buffer\n");
-	    h264dec_struct->number_of_nal_units += 1;
-	    h264dec_struct->nal_size[h264dec_struct->number_of_nal_units] =
-		0;
-	    i += NAL_HEADER_SIZE;
-	} else {
-	    i++;
-	    h264dec_struct->nal_size[h264dec_struct->
-				     number_of_nal_units] += 1;
-	}
-
+       chunk and numbers of bytes in each NAL units, nal_size[0] holds the
+       bytes in front of the first NAL header */
+    while ((code = mfw_nalconv_find_startcode(scan, end)) != NULL) {
+	scan = code + 3;
+	/* only the 4 bytes start code delimits a NAL unit */
+	if ((code == data) || (code[-1] != 0x00))
+	    continue;
+	if (count + 1 >= MAX_NAL)
+	    break;
+	GST_DEBUG("\nFound a NAL Unit in the given buffer\n");
+	h264dec_struct->nal_size[count] = (code - 1) - payload;
+	count++;
+	payload = code + 3;
     }
+    h264dec_struct->nal_size[count] = end - payload;
+    h264dec_struct->number_of_nal_units = count;
 }
 
-static void mfw_gst_AVC_Create_NALheader(GstBuffer **buffer)
-{
-    guint32 jump, startcode;
-    guint16 len;
-    unsigned char * buf = GST_BUFFER_DATA(*buffer);
-    guint32 end = GST_BUFFER_DATA(*buffer)+GST_BUFFER_SIZE(*buffer)-4;
-    unsigned char *bufout = NULL;
-    GstBuffer *hdrBuf;
-    GstBuffer *preBuf,*nxtBuf;
-    guint32 offset = 0;
-
-    /*
-     * The qtdemux will use the 16bits length instead of startcode(00 00 00 01)
-     * If the first two bytes of data is not zero, we assume it is the NAL length.
-     */
-    while(((guint32)buf)<end){
-
-        jump = startcode = (buf[0]<<24)|(buf[1]<<16)|(buf[2]<<8)|(buf[3]);
-        GST_INFO("jump %x %x %x %x = %x\n", buf[0],  buf[1],  buf[2],  buf[3], jump);
-        if (startcode==0x00000001) {
-            GST_INFO("nal found\n");
-            break;
-        }
-        len = (buf[0]<<8) | (buf[1]);
-
-        GST_INFO("len = %04X\n", len);
-        if (len != 0) {
-            hdrBuf = gst_buffer_new_and_alloc(2);
-            bufout = GST_BUFFER_DATA(hdrBuf);
-            bufout[0] = bufout[1] = 0x00;
-            GST_BUFFER_SIZE(hdrBuf) = 2;
-            buf[0] = 0;
-            buf[1] = 0x01;
-            if (offset) {
-                preBuf = gst_buffer_create_sub(*buffer,0,offset);
-                nxtBuf = gst_buffer_create_sub(*buffer,offset,GST_BUFFER_SIZE(*buffer)-offset);
-                preBuf = gst_buffer_join(preBuf, hdrBuf);
-            }
-            else {
-                preBuf = hdrBuf;
-                nxtBuf = *buffer;
-            }
-            *buffer = gst_buffer_join(preBuf,nxtBuf);
-
-            offset += len+4;
-
-            buf = GST_BUFFER_DATA(*buffer);
-            end = GST_BUFFER_DATA(*buffer)+GST_BUFFER_SIZE(*buffer)-4;
+/*======================================================================================
+FUNCTION:           mfw_gst_AVC_Create_NALheader
 
-            buf+=offset;
+DESCRIPTION:        Replace the NAL length fields of AVC data with start codes
+                    in one pass. 4 bytes length fields are rewritten in place,
+                    shorter ones need a new buffer for the larger start codes.
 
-        }
-        else {
-            buf[2] = buf[1] = buf[0] = 0;
-            buf[3] = 0x01;
-            buf+=jump+4;
-        }
+ARGUMENTS PASSED:   h264dec_struct  - H264 decoder plugins context
+                    buffer - pointer to the input buffer which has the video data.
 
+RETURN VALUE:       None
+=======================================================================================*/
+static void mfw_gst_AVC_Create_NALheader(MFW_GST_H264DEC_INFO_T *
+					h264dec_struct, GstBuffer **buffer)
+{
+    guint length_size = h264dec_struct->nal_length_size;
+    GstBuffer *outbuf;
+    gint size;
+
+    if (length_size == NAL_HEADER_SIZE) {
+        mfw_nalconv_length_to_annexb(GST_BUFFER_DATA(*buffer),
+            GST_BUFFER_SIZE(*buffer), length_size,
+            GST_BUFFER_DATA(*buffer), GST_BUFFER_SIZE(*buffer));
+        return;
+    }
 
+    outbuf = gst_buffer_new_and_alloc(NALCONV_ANNEXB_MAX_SIZE(
+        GST_BUFFER_SIZE(*buffer), length_size));
+    size = mfw_nalconv_length_to_annexb(GST_BUFFER_DATA(*buffer),
+        GST_BUFFER_SIZE(*buffer), length_size,
+        GST_BUFFER_DATA(outbuf), GST_BUFFER_SIZE(outbuf));
+    if (size < 0) {
+        GST_ERROR("Failed to convert AVC data with %d bytes NAL length\n",
+            length_size);
+        gst_buffer_unref(outbuf);
+        return;
     }
 
+    GST_BUFFER_SIZE(outbuf) = size;
+    gst_buffer_copy_metadata(outbuf, *buffer,
+        GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS);
+    gst_buffer_unref(*buffer);
+    *buffer = outbuf;
 }
 
 
@@ -267,62 +253,38 @@ IMPORTANT NOTES:    None
 static GstFlowReturn mfw_gst_h264_AVC_Fix_NALheader(MFW_GST_H264DEC_INFO_T *
 					h264dec_struct, GstBuffer **buffer)
 {
-    guint32 jump;
-    unsigned char * buf;
-    guint32 end;
     GstBuffer *hdrBuf=NULL;
     if (h264dec_struct->codec_data_len)
     {
-        // must be qtdemux input which must be parsed more carefully
-        // if any codec data from qtdemux then add startcode and parse our paylose
-        // usually there are 3 sections.  First section has 8 bytes with last 2 bytes
-        // being length so put a startcode plus copy the length from codec data
-        // next section is 3 bytes with 2nd two bytes being length (usually 4 bytes)
-        // so put another start code and copy 4 bytes from codec data
-        // last step is make sure input buffer is fixed with start codes instead of
-        // length
+        // must be qtdemux input, the codec data is an avcC record carrying
+        // SPS/PPS with 16 bits lengths and the NAL length size of the stream
+        // so put start codes in front of the parameter sets, then make sure
+        // input buffer is fixed with start codes instead of length
         unsigned char *buf_hdr = GST_BUFFER_DATA(h264dec_struct->codec_data);
         guint32 startcode =  (buf_hdr[0]<<24)|(buf_hdr[1]<<16)|(buf_hdr[2]<<8)|(buf_hdr[3]);
-        unsigned char *bufout = NULL;
 
         if (startcode == 0x00000001) { /* FSL parser already encapsulate the codec data */
             GST_WARNING("FSL parser, no necessary to convert data\n");
             hdrBuf = gst_buffer_copy(h264dec_struct->codec_data);
         }
         else {
-            hdrBuf = gst_buffer_new_and_alloc(h264dec_struct->codec_data_len);
-            bufout = GST_BUFFER_DATA(hdrBuf);
-
-            {
-                gint length = (buf_hdr[6] << 8) | buf_hdr[7];
-                gint length2 = 0;
-                gint total_length = length+4;
-                g_print (" AVC SPS header length=%d\n", length);
-                bufout[2] = bufout[1] = bufout[0] = 0;
-                bufout[3] = 0x01;
-                length2 = h264dec_struct->codec_data_len - length - 8;
-                if(length2<=0)
-                    return GST_FLOW_OK;
-
-                memcpy(bufout+4,buf_hdr + 8,length);
-
-                if (length2 > 0)
-                {
-                    gint offset = length+4;  // start code plus length copied
-                    gint offset_src = length+8+3;
-                    length2 = (buf_hdr[length+8+1]<<8) | buf_hdr[length+8+2];
-                    g_print (" AVC PPS Header length=%d\n", length2);
-                    bufout[offset] = bufout[offset+1] = bufout[offset+2] = 0;
-                    bufout[offset+3] = 0x01;
-                    offset += 4;
-                    memcpy(bufout + offset, buf_hdr + offset_src, length2);
-                    total_length += length2+4;
-                }
-                GST_BUFFER_SIZE(hdrBuf) = total_length;
+            gint size;
+
+            hdrBuf = gst_buffer_new_and_alloc(
+                NALCONV_AVCC_ANNEXB_MAX_SIZE(h264dec_struct->codec_data_len));
+            size = mfw_nalconv_avcc_to_annexb(buf_hdr,
+                h264dec_struct->codec_data_len, GST_BUFFER_DATA(hdrBuf),
+                GST_BUFFER_SIZE(hdrBuf), &h264dec_struct->nal_length_size);
+            if (size <= 0) {
+                GST_ERROR("Invalid AVC codec data\n");
+                gst_buffer_unref(hdrBuf);
+                return GST_FLOW_OK;
             }
-
+            GST_BUFFER_SIZE(hdrBuf) = size;
+            GST_INFO("AVC NAL length size %d bytes\n",
+                h264dec_struct->nal_length_size);
         }
-        mfw_gst_AVC_Create_NALheader(buffer);
+        mfw_gst_AVC_Create_NALheader(h264dec_struct, buffer);
 
         *buffer = gst_buffer_join(hdrBuf,*buffer);
 
@@ -1227,7 +1189,7 @@ static GstFlowReturn mfw_gst_h264dec_chain(GstPad * pad,
 
     else {
 
-        mfw_gst_AVC_Create_NALheader(&buffer);
+        mfw_gst_AVC_Create_NALheader(h264dec_struct, &buffer);
 
     	h264dec_struct->dec_config.s32InBufferLength =
     	    GST_BUFFER_SIZE(buffer);
@@ -1986,6 +1948,7 @@ static void mfw_gst_h264dec_init(MFW_GST_H264DEC_INFO_T * h264dec_struct)
     h264dec_struct->framerate_n = 25;
     h264dec_struct->framerate_d = 1;
     h264dec_struct->frame_rate = 25;
+    h264dec_struct->nal_length_size = NAL_HEADER_SIZE;
 
     h264dec_struct->pTS_Mgr = createTSManager(0);
 
@@ -117,6 +117,7 @@ G_BEGIN_DECLS
 
     GstBuffer*      codec_data;        // Header data needed for VC-1 and some codecs
     guint           codec_data_len;    // Header Extension obtained through caps negotiation
+    guint           nal_length_size;   // NAL length field size of AVC data
 
 
     gboolean is_sfd;
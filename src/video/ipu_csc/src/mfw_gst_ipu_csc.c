@@ -323,6 +323,15 @@ mfw_gst_ipu_core_init(MfwGstIPUCSC* filter, GstCaps * incap, GstCaps * outcap)
        
     INPUT_CROP_HEIGHT(itask)=INPUT_HEIGHT(itask)-INPUT_CROP_Y(itask)-intvalue;
 
+    /* kept to restore the caps geometry after a frame with its own layout */
+    filter->input_format = format;
+    filter->input_width = INPUT_WIDTH(itask);
+    filter->input_height = INPUT_HEIGHT(itask);
+    filter->input_crop_x = INPUT_CROP_X(itask);
+    filter->input_crop_y = INPUT_CROP_Y(itask);
+    filter->input_crop_width = INPUT_CROP_WIDTH(itask);
+    filter->input_crop_height = INPUT_CROP_HEIGHT(itask);
+
     if (gst_video_format_parse_caps(outcap, &format, &intvalue, &intvalue0)==FALSE){
       goto fail;
     }
@@ -564,9 +573,11 @@ mfw_gst_ipu_csc_get_unit_size (GstBaseTransform * btrans, GstCaps * caps,
     guint * size)
 {
   GstVideoFormat format; 
-  gint width, height;
-  gst_video_format_parse_caps(caps, &format, &width, &height);
-  *size = gst_video_format_get_size(format, width, height);
+  gint width, height, framesize;
+  /* called for every buffer by basetransform, the caps rarely change */
+  if (!gst_video_format_parse_caps_cached(caps, &format, &width, &height, &framesize))
+    return FALSE;
+  *size = framesize;
   return TRUE;
 }
 
@@ -581,6 +592,139 @@ mfw_gst_ipu_csc_transform_ip (GstBaseTransform * btrans, GstBuffer * inbuf)
 #endif
 
 
+static void
+mfw_gst_ipu_csc_set_input (IPUTaskOne * itask, gint width, gint height,
+    gint crop_x, gint crop_y, gint crop_width, gint crop_height)
+{
+    INPUT_WIDTH(itask) = width;
+    INPUT_HEIGHT(itask) = height;
+    INPUT_CROP_X(itask) = crop_x;
+    INPUT_CROP_Y(itask) = crop_y;
+    INPUT_CROP_WIDTH(itask) = crop_width;
+    INPUT_CROP_HEIGHT(itask) = crop_height;
+}
+
+/* (re)allocate the dma input buffer to hold size bytes */
+static gboolean
+mfw_gst_ipu_csc_get_input_buffer (MfwGstIPUCSC * filter, gint size)
+{
+    if (size!=filter->hbuf_in_size){
+      if (filter->hbuf_in){
+         mfw_free_hw_buffer(filter->hbuf_in);
+         filter->hbuf_in_size = 0;
+      }
+      filter->hbuf_in = mfw_new_hw_buffer(size, &filter->hbuf_in_paddr, &filter->hbuf_in_vaddr, 0);
+      if (filter->hbuf_in==NULL){
+         return FALSE;
+      }
+      filter->hbuf_in_size = size;
+    }
+    return TRUE;
+}
+
+/*
+ * The plane layout the producer described, for the I420 and NV12 input
+ * the ipu takes in memory. NULL if there is none or it does not match the
+ * caps format, the frame is then addressed from caps.
+ */
+static GstBufferMeta *
+mfw_gst_ipu_csc_input_layout (MfwGstIPUCSC * filter, GstBuffer * buffer)
+{
+    GstBufferMeta * meta = buffer->_gst_reserved[G_N_ELEMENTS(buffer->_gst_reserved)-1];
+    guint n_planes;
+
+    if ((!GST_IS_BUFFER_META(meta)) || (!GST_BUFFER_META_HAS_LAYOUT(meta)))
+      return NULL;
+
+    if (filter->input_format==GST_VIDEO_FORMAT_I420){
+      n_planes = 3;
+    }else if (filter->input_format==GST_VIDEO_FORMAT_NV12){
+      n_planes = 2;
+    }else{
+      return NULL;
+    }
+
+    if ((meta->fourcc!=gst_video_format_to_fourcc(filter->input_format))
+        || (meta->n_planes!=n_planes)
+        || (meta->planes[0].physical_data==NULL)
+        || (meta->crop_width<8) || (meta->crop_height<8))
+      return NULL;
+
+    return meta;
+}
+
+/* the ipu takes a single address, the planes must follow the luma plane
+   as they do in a frame of stride x height pixels */
+static gboolean
+mfw_gst_ipu_csc_layout_is_contiguous (MfwGstIPUCSC * filter,
+    GstBufferMeta * meta)
+{
+    GstBufferMetaPlane * planes = meta->planes;
+    guint8 * base = planes[0].physical_data;
+    guint ysize = planes[0].stride * meta->height;
+
+    if ((planes[0].stride<meta->width)
+        || ((guint8 *)planes[1].physical_data!=base+ysize))
+      return FALSE;
+
+    if (filter->input_format==GST_VIDEO_FORMAT_NV12)
+      return (planes[1].stride==planes[0].stride);
+
+    return ((planes[1].stride==planes[0].stride/2)
+            && (planes[2].stride==planes[1].stride)
+            && ((guint8 *)planes[2].physical_data
+                ==base+ysize+planes[1].stride*(meta->height/2)));
+}
+
+/* copy the visible area plane by plane into the caps layout of its size */
+static gboolean
+mfw_gst_ipu_csc_copy_layout (MfwGstIPUCSC * filter, GstBufferMeta * meta,
+    gint width, gint height)
+{
+    GstBufferMetaPlane * planes = meta->planes;
+    GstVideoFormat format = filter->input_format;
+    guint8 * src, * dst;
+    gint i, line, bytes, lines, sstride, dstride;
+
+    for (i=0;i<meta->n_planes;i++){
+      if (planes[i].virtual_data==NULL)
+        return FALSE;
+    }
+    if (!mfw_gst_ipu_csc_get_input_buffer(filter,
+            gst_video_format_get_size(format, width, height)))
+      return FALSE;
+
+    for (i=0;i<meta->n_planes;i++){
+      sstride = planes[i].stride;
+      dstride = gst_video_format_get_row_stride(format, i, width);
+      dst = (guint8 *)filter->hbuf_in_vaddr
+            + gst_video_format_get_component_offset(format, i, width, height);
+      if (i==0){
+        src = (guint8 *)planes[0].virtual_data
+              + sstride*meta->crop_top + meta->crop_left;
+        bytes = width;
+        lines = height;
+      }else if (format==GST_VIDEO_FORMAT_NV12){
+        /* Cb and Cr interleaved, one pair per 2 pixels */
+        src = (guint8 *)planes[1].virtual_data
+              + sstride*(meta->crop_top/2) + (meta->crop_left&~1);
+        bytes = width;
+        lines = height/2;
+      }else{
+        src = (guint8 *)planes[i].virtual_data
+              + sstride*(meta->crop_top/2) + meta->crop_left/2;
+        bytes = width/2;
+        lines = height/2;
+      }
+      for (line=0;line<lines;line++){
+        memcpy(dst, src, bytes);
+        dst += dstride;
+        src += sstride;
+      }
+    }
+    return TRUE;
+}
+
 static gboolean 
 mfw_gst_ipu_core_start_convert (GstBaseTransform * btrans, GstBuffer * inbuf,
     GstBuffer * outbuf)
@@ -588,22 +732,44 @@ mfw_gst_ipu_core_start_convert (GstBaseTransform * btrans, GstBuffer * inbuf,
     MfwGstIPUCSC * filter = MFW_GST_IPU_CSC (btrans);
     gboolean ret = FALSE;
     IPUTaskOne * itask = &filter->iputask;
+    GstBufferMeta * layout = mfw_gst_ipu_csc_input_layout(filter, inbuf);
     gboolean copy_input = (!IS_DMABLE_BUFFER(inbuf));
     gboolean copy_output = (!IS_DMABLE_BUFFER(outbuf));
 
-    GST_LOG("start convert copy_input(%s), copy_output(%s)", (copy_input?"yes":"no"), (copy_output?"yes":"no"));
-
-    if (copy_input){
-      if (filter->input_framesize!=filter->hbuf_in_size){
-        if (filter->hbuf_in){
-           mfw_free_hw_buffer(filter->hbuf_in);
-           filter->hbuf_in_size = 0;
+    GST_LOG("start convert copy_input(%s), copy_output(%s) layout(%s)", (copy_input?"yes":"no"),
+        (copy_output?"yes":"no"), (layout?"yes":"no"));
+
+    mfw_gst_ipu_csc_set_input(itask, filter->input_width, filter->input_height,
+        filter->input_crop_x, filter->input_crop_y, filter->input_crop_width,
+        filter->input_crop_height);
+
+    if (layout){
+      gint x = GST_ROUND_UP_8(layout->crop_left);
+      gint y = GST_ROUND_UP_8(layout->crop_top);
+      gint right = layout->planes[0].stride - layout->crop_left - layout->crop_width;
+      gint bottom = layout->height - layout->crop_top - layout->crop_height;
+
+      if (mfw_gst_ipu_csc_layout_is_contiguous(filter, layout)){
+        /* padded frames go in as they are, cropped to the visible area */
+        mfw_gst_ipu_csc_set_input(itask, layout->planes[0].stride,
+            layout->height, x, y,
+            layout->planes[0].stride-x-GST_ROUND_UP_8(right),
+            layout->height-y-GST_ROUND_UP_8(bottom));
+        INPUT_PADDR(itask) = layout->planes[0].physical_data;
+      }else{
+        gint width = layout->crop_width&~7;
+        gint height = layout->crop_height&~7;
+        if (mfw_gst_ipu_csc_copy_layout(filter, layout, width, height)){
+          mfw_gst_ipu_csc_set_input(itask, width, height, 0, 0, width, height);
+          INPUT_PADDR(itask) = filter->hbuf_in_paddr;
+        }else{
+          /* no virtual address, hand over the frame as before */
+          INPUT_PADDR(itask) = DMABLE_BUFFER_PHY_ADDR(inbuf);
         }
-        filter->hbuf_in = mfw_new_hw_buffer(filter->input_framesize, &filter->hbuf_in_paddr, &filter->hbuf_in_vaddr, 0);
-        if (filter->hbuf_in==NULL){
-           goto fail;
-        }
-        filter->hbuf_in_size = filter->input_framesize;
+      }
+    }else if (copy_input){
+      if (!mfw_gst_ipu_csc_get_input_buffer(filter, filter->input_framesize)){
+        goto fail;
       }
       memcpy(filter->hbuf_in_vaddr, GST_BUFFER_DATA(inbuf), filter->input_framesize);
       INPUT_PADDR(itask) = filter->hbuf_in_paddr;
@@ -248,6 +248,10 @@ typedef struct _MfwGstIPUCSC
     gint input_height;
     guint input_format;
     gint input_cstype;
+    gint input_crop_x;  /* visible input area from caps */
+    gint input_crop_y;
+    gint input_crop_width;
+    gint input_crop_height;
     
     guint output_framesize;
     gint output_width;
@@ -141,8 +141,9 @@ static const GstQueryType *gst_vpudec_query_types (GstPad * pad);
 static gboolean gst_vpudec_src_query (GstPad * pad, GstQuery * query);
 static GType gst_vpudec_get_output_format_type (void);
 static void vpudec_init_qos_ctrl(VpuDecQosCtl * qos);
+static void gst_vpudec_clear_field_caps (GstVpuDec * vpudec);
 
-static gint g_fieldmap[] = {
+static gint g_fieldmap[VPUDEC_FIELD_TYPES] = {
   FIELD_NONE,
   FIELD_TOP,
   FIELD_BOTTOM,
@@ -510,6 +511,8 @@ vpudec_core_init (GstVpuDec * vpudec)
   vpudec->output_size = 0;
   vpudec->prerolling = TRUE;
   vpudec->field_info = VPU_FIELD_NONE;
+  vpudec->field_base = NULL;
+  memset (vpudec->field_caps, 0, sizeof (vpudec->field_caps));
   vpudec->ospec.width_align = DEFAULT_FRAME_BUFFER_ALIGNMENT_H;
   vpudec->ospec.height_align = DEFAULT_FRAME_BUFFER_ALIGNMENT_V;
   vpudec->ospec.buffer_align = 1;
@@ -575,6 +578,7 @@ vpudec_core_deinit (GstVpuDec * vpudec)
 
   vpudec_free_frames (vpudec);
   vpudec_free_memories (vpudec);
+  gst_vpudec_clear_field_caps (vpudec);
 
   GST_INFO ("Stat:\n\tin  : %lld\n\tout : %lld\n\tshow: %lld",
       vpudec->vpu_stat.in_cnt, vpudec->vpu_stat.out_cnt,
@@ -733,18 +737,60 @@ gst_vpudec_init (GstVpuDec * vpudec, GstVpuDecClass * klass)
 }
 
 
+/* owner release hook, runs once the last copy of the frame meta is freed */
 static void
-gst_vpudec_free_internal_frame (gpointer p)
+gst_vpudec_release_frame_block (gpointer p)
 {
-  GstBufferMeta *meta = (GstBufferMeta *) p;
-  VpuDecMem *frameblock = (VpuDecMem *) meta->priv;
+  VpuDecMem *frameblock = (VpuDecMem *) p;
   if (frameblock->parent) {
     gst_object_unref (frameblock->parent);
   }
   if (frameblock->freefunc) {
     frameblock->freefunc (frameblock);
   }
-  gst_buffer_meta_free (meta);
+}
+
+static void
+gst_vpudec_free_internal_frame (gpointer p)
+{
+  gst_buffer_meta_free ((GstBufferMeta *) p);
+}
+
+/* describe the padded frame so consumers need not derive it from caps */
+static void
+gst_vpudec_describe_frame (VpuOutPutSpec * ospec, GstBufferMeta * bufmeta,
+    gpointer vaddr)
+{
+  guint offsets[3], strides[3];
+  guint stride = ospec->crop_left + ospec->width + ospec->crop_right;
+  guint height = ospec->crop_top + ospec->height + ospec->crop_bottom;
+  guint n_planes = 3;
+
+  /* tiled frames have no linear plane layout */
+  if ((ospec->fourcc == GST_STR_FOURCC ("TNVF"))
+      || (ospec->fourcc == GST_STR_FOURCC ("TNVP")))
+    return;
+
+  offsets[0] = 0;
+  offsets[1] = ospec->plane_size[0];
+  offsets[2] = ospec->plane_size[0] + ospec->plane_size[1];
+  strides[0] = stride;
+  if (ospec->fourcc == GST_STR_FOURCC ("Y444")) {
+    strides[1] = strides[2] = stride;
+  } else if (ospec->fourcc == GST_STR_FOURCC ("Y800")) {
+    n_planes = 1;
+  } else if (ospec->fourcc == GST_STR_FOURCC ("NV12")) {
+    /* Y, then Cb and Cr interleaved at the full stride */
+    n_planes = 2;
+    strides[1] = stride;
+  } else {
+    strides[1] = strides[2] = stride / 2;
+  }
+
+  gst_buffer_meta_set_layout (bufmeta, ospec->fourcc, vaddr, stride, height,
+      n_planes, offsets, strides);
+  gst_buffer_meta_set_crop (bufmeta, ospec->crop_left, ospec->crop_top,
+      ospec->width, ospec->height);
 }
 
 static void
@@ -888,6 +934,10 @@ gst_vpudec_core_create_and_register_frames (GstVpuDec * vpudec, gint num)
           gint index = G_N_ELEMENTS (gstbuf->_gst_reserved) - 1;
           bufmeta->physical_data = frame_memory.paddr;
           bufmeta->priv = frameblock;
+          gst_buffer_meta_set_owner (bufmeta, frameblock,
+              gst_vpudec_release_frame_block);
+          gst_vpudec_describe_frame (&vpudec->ospec, bufmeta,
+              frame_memory.vaddr);
           gstbuf->_gst_reserved[index] = bufmeta;
 
 
@@ -1319,25 +1369,68 @@ gst_vpudec_get_frame (GstVpuDec * vpudec, VpuFrameBuffer * cframe)
 }
 
 static void
-gst_vpudec_set_field (GstVpuDec * vpudec, GstBuffer * buf)
+gst_vpudec_clear_field_caps (GstVpuDec * vpudec)
 {
-  if (!buf)
-    return;
+  gint i;
+
+  for (i = 0; i < VPUDEC_FIELD_TYPES; i++) {
+    if (vpudec->field_caps[i]) {
+      gst_caps_unref (vpudec->field_caps[i]);
+      vpudec->field_caps[i] = NULL;
+    }
+  }
+  if (vpudec->field_base) {
+    gst_caps_unref (vpudec->field_base);
+    vpudec->field_base = NULL;
+  }
+}
 
-  GstCaps *caps = GST_BUFFER_CAPS (buf);
-  GstCaps *newcaps;
+/*
+ * Caps with the field of each field type are built once from the caps of
+ * the frames, so interlaced streams switching field types per frame only
+ * swap caps pointers.
+ */
+static void
+gst_vpudec_set_field (GstVpuDec * vpudec, GstBuffer * buf)
+{
+  GstCaps *caps;
   GstStructure *stru;
   gint field = 0;
-  stru = gst_caps_get_structure (caps, 0);
-  gst_structure_get_int (stru, "field", &field);
-  if (field != g_fieldmap[vpudec->field_info]) {
-    newcaps = gst_caps_copy (caps);
-    gst_caps_set_simple (newcaps, "field", G_TYPE_INT,
-        g_fieldmap[vpudec->field_info], NULL);
-    gst_buffer_set_caps (buf, newcaps);
-    gst_caps_unref (newcaps);
+  gint i, type = vpudec->field_info;
+
+  if ((!buf) || (GST_BUFFER_CAPS (buf) == NULL) || (type < 0)
+      || (type >= VPUDEC_FIELD_TYPES))
+    return;
+
+  caps = GST_BUFFER_CAPS (buf);
+  if (caps == vpudec->field_caps[type])
+    return;
+
+  /* frames keep their variant until reused, only other caps are a new base */
+  if (caps != vpudec->field_base) {
+    for (i = 0; i < VPUDEC_FIELD_TYPES; i++) {
+      if (caps == vpudec->field_caps[i])
+        break;
+    }
+    if (i == VPUDEC_FIELD_TYPES) {
+      gst_vpudec_clear_field_caps (vpudec);
+      vpudec->field_base = gst_caps_ref (caps);
+    }
+  }
+
+  if (vpudec->field_caps[type] == NULL) {
+    stru = gst_caps_get_structure (vpudec->field_base, 0);
+    gst_structure_get_int (stru, "field", &field);
+    if (field == g_fieldmap[type]) {
+      vpudec->field_caps[type] = gst_caps_ref (vpudec->field_base);
+    } else {
+      vpudec->field_caps[type] = gst_caps_copy (vpudec->field_base);
+      gst_caps_set_simple (vpudec->field_caps[type], "field", G_TYPE_INT,
+          g_fieldmap[type], NULL);
+    }
   }
 
+  gst_buffer_set_caps (buf, vpudec->field_caps[type]);
 }
 
 static GstFlowReturn
@@ -162,6 +162,9 @@ typedef struct
   GstClockTime decode_time;
 } VpuDecProfileCount;
 
+/* one caps variant per VpuFieldType */
+#define VPUDEC_FIELD_TYPES 6
+
 typedef struct _GstVpuDec GstVpuDec;
 typedef struct _GstVpuDecClass GstVpuDecClass;
 
@@ -211,6 +214,8 @@ struct _GstVpuDec
   gboolean prerolling;
 
   VpuFieldType field_info;
+  GstCaps *field_base;          /* caps the field variants are built from */
+  GstCaps *field_caps[VPUDEC_FIELD_TYPES];
 
   gboolean use_new_tsm;
 
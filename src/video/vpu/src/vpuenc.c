@@ -79,9 +79,13 @@
 
 
 #define Align(ptr,align)	((align) ? ((((guint32)(ptr))+(align)-1)/(align)*(align)) : ((guint32)(ptr)))
+#define VPUENC_PHY_ALIGNED(ptr,align) (((ptr) != NULL) && ((guint32)(ptr) == Align ((ptr), (align))))
 
 #define VPUENC_TS_BUFFER_LENGTH_DEFAULT (1024)
 
+#define VPUENC_OUTPUT_BLOCK_ALIGN (16*1024)
+#define VPUENC_OUTPUT_HEADROOM_ALIGN (64)
+
 
 #define ATTACH_MEM2VPUDEC(vpuenc, desc)\
  do {\
@@ -347,6 +351,14 @@ vpuenc_free_framemem_pool(GstVpuEnc * vpuenc)
   vpuenc->framemem_pool.frame_size = 0;
 }
 
+static void
+vpuenc_free_outmem_pool(GstVpuEnc * vpuenc)
+{
+  vpuenc_free_memories(vpuenc->outmem_pool.mems);
+  vpuenc->outmem_pool.mems = NULL;
+  vpuenc->outmem_pool.block_size = 0;
+}
+
 
 static gboolean
 vpuenc_prealloc_memories (GstVpuEnc * vpuenc, VpuMemInfo * mem)
@@ -404,6 +416,25 @@ vpuenc_free_memories (VpuEncMem * mems)
 }
 
 
+/* unlink one block attached by ATTACH_MEM2VPUDEC and free it */
+static void
+vpuenc_release_memory (GstVpuEnc * vpuenc, VpuEncMem * desc)
+{
+  VpuEncMem **link = &vpuenc->mems;
+
+  while (*link) {
+    if (*link == desc) {
+      *link = desc->next;
+      if (desc->freefunc) {
+        desc->freefunc (desc);
+      }
+      return;
+    }
+    link = &(*link)->next;
+  }
+}
+
+
 
 static gboolean
 vpuenc_core_init (GstVpuEnc * vpuenc)
@@ -432,6 +463,7 @@ vpuenc_core_init (GstVpuEnc * vpuenc)
   memset (&vpuenc->vpu_stat, 0, sizeof (VpuEncStat));
 
   vpuenc->force_copy = FALSE;
+  vpuenc->ibuf = NULL;
 
   CORE_API (VPU_EncGetVersionInfo, goto fail, core_ret, &version);
   CORE_API (VPU_EncGetWrapperVersionInfo, goto fail, core_ret, &w_version);
@@ -482,14 +514,21 @@ vpuenc_core_deinit (GstVpuEnc * vpuenc)
 
   vpuenc_free_memories (vpuenc->mems);
   vpuenc->mems = NULL;
+  vpuenc->obuf = NULL;
+  vpuenc->ibuf = NULL;
 
   g_mutex_lock(vpuenc->framemem_pool_lock);
   vpuenc_free_framemem_pool(vpuenc);
   g_mutex_unlock(vpuenc->framemem_pool_lock);
 
-  GST_INFO ("stat:\n\tin  : %lld\n\tout : %lld\n\tshow: %lld",
+  g_mutex_lock(vpuenc->outmem_pool_lock);
+  vpuenc_free_outmem_pool(vpuenc);
+  vpuenc->outmem_pool.headroom = 0;
+  g_mutex_unlock(vpuenc->outmem_pool_lock);
+
+  GST_INFO ("stat:\n\tin  : %lld\n\tout : %lld\n\tshow: %lld\n\tcopy: %lld",
       vpuenc->vpu_stat.in_cnt, vpuenc->vpu_stat.out_cnt,
-      vpuenc->vpu_stat.show_cnt);
+      vpuenc->vpu_stat.show_cnt, vpuenc->vpu_stat.copy_cnt);
 
 }
 
@@ -599,6 +638,93 @@ gst_vpuenc_free_internal_frame(gpointer p)
 
 
 
+static void
+gst_vpuenc_free_output_block(gpointer p)
+{
+  VpuEncMem * mem = (VpuEncMem *) p;
+  GstVpuEnc * vpuenc = (GstVpuEnc *)(mem->parent);
+
+  g_mutex_lock(vpuenc->outmem_pool_lock);
+
+  if (mem->size==vpuenc->outmem_pool.block_size){
+    mem->next = vpuenc->outmem_pool.mems;
+    vpuenc->outmem_pool.mems = mem;
+  }else{
+
+    if (mem->freefunc) {
+      mem->freefunc (mem);
+    }
+
+  }
+  g_mutex_unlock(vpuenc->outmem_pool_lock);
+  gst_object_unref(vpuenc);
+}
+
+
+/* Output buffers come from a pool of blocks with headroom reserved in
+   front of the frame, so in-band headers can be prepended in place. */
+static GstBuffer *
+gst_vpuenc_alloc_output_buffer (GstVpuEnc * vpuenc, gint size)
+{
+  GstBuffer *gstbuf = NULL;
+  VpuEncMem * mem = NULL;
+  VpuEncOutMemPool *pool = &vpuenc->outmem_pool;
+
+  g_mutex_lock(vpuenc->outmem_pool_lock);
+
+  if (pool->headroom + size > pool->block_size){
+    /* grow to the new largest frame, blocks in use are freed on return */
+    vpuenc_free_outmem_pool(vpuenc);
+    pool->block_size = Align (pool->headroom + size, VPUENC_OUTPUT_BLOCK_ALIGN);
+    GST_INFO ("output block size %d headroom %d", pool->block_size,
+        pool->headroom);
+  }else if (pool->mems) {
+    mem = pool->mems;
+    pool->mems = mem->next;
+  }
+
+  if (mem==NULL)
+    mem = vpuenc_core_mem_alloc_normal_buffer (pool->block_size);
+
+  if (mem == NULL) {
+    goto bail;
+  }
+
+  gstbuf = gst_buffer_new ();
+  GST_BUFFER_SIZE (gstbuf) = size;
+  GST_BUFFER_DATA (gstbuf) = (guint8 *) mem->vaddr + pool->headroom;
+  mem->parent = gst_object_ref (vpuenc);
+
+  GST_BUFFER_MALLOCDATA (gstbuf) = (guint8 *) mem;
+  GST_BUFFER_FREE_FUNC (gstbuf) = gst_vpuenc_free_output_block;
+
+bail:
+  g_mutex_unlock(vpuenc->outmem_pool_lock);
+  return gstbuf;
+}
+
+
+/* Puts header in front of buffer, in place when buffer came from the output
+   pool with enough headroom. */
+static GstBuffer *
+gst_vpuenc_prepend_header (GstVpuEnc * vpuenc, GstBuffer * header,
+    GstBuffer * buffer)
+{
+  if (GST_BUFFER_FREE_FUNC (buffer) == gst_vpuenc_free_output_block) {
+    VpuEncMem * mem = (VpuEncMem *) GST_BUFFER_MALLOCDATA (buffer);
+    if ((GST_BUFFER_DATA (buffer) - (guint8 *) mem->vaddr)
+        >= GST_BUFFER_SIZE (header)) {
+      GST_BUFFER_DATA (buffer) -= GST_BUFFER_SIZE (header);
+      GST_BUFFER_SIZE (buffer) += GST_BUFFER_SIZE (header);
+      memcpy (GST_BUFFER_DATA (buffer), GST_BUFFER_DATA (header),
+          GST_BUFFER_SIZE (header));
+      return buffer;
+    }
+  }
+  return gst_buffer_join (gst_buffer_ref (header), buffer);
+}
+
+
 static GstFlowReturn
 gst_vpuenc_alloc_buffer (GstPad * pad, guint64 offset, guint size,
     GstCaps * caps, GstBuffer ** buf)
@@ -685,6 +811,7 @@ gst_vpuenc_init (GstVpuEnc * vpuenc, GstVpuEncClass * klass)
 
   vpuenc->lock = g_mutex_new ();
   vpuenc->framemem_pool_lock = g_mutex_new ();
+  vpuenc->outmem_pool_lock = g_mutex_new ();
   VPU_EncLoad ();
 }
 
@@ -817,6 +944,7 @@ gst_vpuenc_finalize (GObject * object)
 
   g_mutex_free (vpuenc->lock);
   g_mutex_free (vpuenc->framemem_pool_lock);
+  g_mutex_free (vpuenc->outmem_pool_lock);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -1041,10 +1169,9 @@ gst_vpuenc_push_buffer (GstVpuEnc * vpuenc, GstBuffer * buffer)
             || (vpuenc->options.seqheader_method == 3)) {
           sendwithbuffer = TRUE;
         }
-        /* FIXME: should allocate len+codec_data_len to avoid memory copy */
         if (sendwithbuffer) {
           buffer =
-              gst_buffer_join (gst_buffer_ref (vpuenc->codec_data), buffer);
+              gst_vpuenc_prepend_header (vpuenc, vpuenc->codec_data, buffer);
         } else {
           gst_caps_set_simple (caps, "codec_data", GST_TYPE_BUFFER,
               vpuenc->codec_data, NULL);
@@ -1061,7 +1188,7 @@ gst_vpuenc_push_buffer (GstVpuEnc * vpuenc, GstBuffer * buffer)
       goto bail;
     }
   } else if ((vpuenc->options.seqheader_method == 3) && (vpuenc->codec_data)) {
-    buffer = gst_buffer_join (gst_buffer_ref (vpuenc->codec_data), buffer);
+    buffer = gst_vpuenc_prepend_header (vpuenc, vpuenc->codec_data, buffer);
   }
   gst_buffer_set_caps (buffer, GST_PAD_CAPS (vpuenc->srcpad));
   TSM_TIMESTAMP ts = TSManagerSend (vpuenc->tsm);
@@ -1133,11 +1260,157 @@ bail:
   return ret;
 }
 
-static void
-gst_vpuenc_copy_frame (GstVpuEnc * vpuenc, GstBuffer * buffer, void *vaddr)
+static gboolean
+gst_vpuenc_can_direct_input (GstVpuEnc * vpuenc, GstBuffer * buffer)
 {
-  memcpy ((void *) (vaddr), GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer));
+  guint32 paddr;
 
+  if ((vpuenc->force_copy) || (!IS_DMABLE_BUFFER (buffer)))
+    return FALSE;
+
+  paddr = (guint32) DMABLE_BUFFER_PHY_ADDR (buffer);
+  if ((paddr == 0) || (paddr != Align (paddr, vpuenc->ispec.buffer_align)))
+    return FALSE;
+
+  return TRUE;
+}
+
+/* the producer's layout, when it is one vpu can take: padded frames such as
+   vpudec output then go in even when their size differs from caps */
+static GstBufferMeta *
+gst_vpuenc_layout_meta (GstVpuEnc * vpuenc, GstBuffer * buffer)
+{
+  GstBufferMeta *meta =
+      buffer->_gst_reserved[G_N_ELEMENTS (buffer->_gst_reserved) - 1];
+  VpuInputSpec *ispec = &vpuenc->ispec;
+  GstBufferMetaPlane *planes;
+
+  if ((!GST_IS_BUFFER_META (meta)) || (!GST_BUFFER_META_HAS_LAYOUT (meta)))
+    return NULL;
+
+  planes = meta->planes;
+  if ((meta->fourcc != GST_STR_FOURCC ("I420")) || (meta->n_planes != 3)
+      || (vpuenc->context.openparam.nChromaInterleave)
+      || (planes[1].stride != planes[0].stride / 2)
+      || (planes[2].stride != planes[1].stride)
+      || (planes[0].virtual_data == NULL)
+      || (planes[0].physical_data == NULL)
+      || (meta->crop_width < ispec->width)
+      || (meta->crop_height < ispec->height))
+    return NULL;
+
+  return meta;
+}
+
+static gboolean
+gst_vpuenc_assign_frame_from_meta (GstVpuEnc * vpuenc, GstBufferMeta * meta,
+    VpuFrameBuffer * frame)
+{
+  VpuInputSpec *ispec = &vpuenc->ispec;
+  GstBufferMetaPlane *planes = meta->planes;
+  gint offset;
+
+  if (vpuenc->force_copy)
+    return FALSE;
+
+  frame->nStrideY = planes[0].stride;
+  frame->nStrideC = planes[1].stride;
+
+  offset = frame->nStrideY * meta->crop_top + meta->crop_left;
+  frame->pbufY = (unsigned char *) planes[0].physical_data + offset;
+  frame->pbufVirtY = (unsigned char *) planes[0].virtual_data + offset;
+
+  offset = frame->nStrideC * (meta->crop_top / 2) + meta->crop_left / 2;
+  frame->pbufCb = (unsigned char *) planes[1].physical_data + offset;
+  frame->pbufVirtCb = (unsigned char *) planes[1].virtual_data + offset;
+  frame->pbufCr = (unsigned char *) planes[2].physical_data + offset;
+  frame->pbufVirtCr = (unsigned char *) planes[2].virtual_data + offset;
+
+  /* the crop offset may move a plane off the alignment vpu needs, such
+     frames are copied */
+  if ((!VPUENC_PHY_ALIGNED (frame->pbufY, ispec->buffer_align))
+      || (!VPUENC_PHY_ALIGNED (frame->pbufCb, ispec->buffer_align))
+      || (!VPUENC_PHY_ALIGNED (frame->pbufCr, ispec->buffer_align)))
+    return FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vpuenc_get_copy_buffer (GstVpuEnc * vpuenc, void **paddr, void **vaddr)
+{
+  gint size = vpuenc->ispec.pad_frame_size + vpuenc->ispec.buffer_align - 1;
+
+  /* one dma frame is kept for the whole stream, vpu is done with it once
+     VPU_EncEncodeFrame consumed the input */
+  if ((vpuenc->ibuf == NULL) || (vpuenc->ibuf->size < size)) {
+    GST_INFO ("Need memcpy input buffer, performance maybe drop");
+    /* a block too small for new caps is not kept until stop */
+    if (vpuenc->ibuf) {
+      vpuenc_release_memory (vpuenc, vpuenc->ibuf);
+      vpuenc->ibuf = NULL;
+    }
+    if ((vpuenc->ibuf = vpuenc_core_mem_alloc_dma_buffer (size)) == NULL) {
+      return FALSE;
+    }
+    ATTACH_MEM2VPUDEC (vpuenc, vpuenc->ibuf);
+  }
+
+  *paddr = (void *) Align (vpuenc->ibuf->paddr, vpuenc->ispec.buffer_align);
+  *vaddr = (void *) Align (vpuenc->ibuf->vaddr, vpuenc->ispec.buffer_align);
+  vpuenc->vpu_stat.copy_cnt++;
+  return TRUE;
+}
+
+static gboolean
+gst_vpuenc_copy_frame (GstVpuEnc * vpuenc, GstBuffer * buffer, void **paddr,
+    void **vaddr)
+{
+  if (!gst_vpuenc_get_copy_buffer (vpuenc, paddr, vaddr))
+    return FALSE;
+
+  memcpy (*vaddr, GST_BUFFER_DATA (buffer), GST_BUFFER_SIZE (buffer));
+  return TRUE;
+}
+
+/* copy the visible area line by line into the caps layout */
+static gboolean
+gst_vpuenc_copy_frame_from_meta (GstVpuEnc * vpuenc, GstBufferMeta * meta,
+    VpuFrameBuffer * frame)
+{
+  VpuInputSpec *ispec = &vpuenc->ispec;
+  GstBufferMetaPlane *planes = meta->planes;
+  guint8 *src, *dst[3];
+  void *paddr, *vaddr;
+  gint i, line, width, height, offset;
+
+  if (!gst_vpuenc_get_copy_buffer (vpuenc, &paddr, &vaddr))
+    return FALSE;
+
+  gst_vpuenc_assign_frame (ispec, frame, paddr, vaddr);
+  dst[0] = frame->pbufVirtY;
+  dst[1] = frame->pbufVirtCb;
+  dst[2] = frame->pbufVirtCr;
+
+  for (i = 0; i < 3; i++) {
+    if (i == 0) {
+      offset = planes[0].stride * meta->crop_top + meta->crop_left;
+      width = ispec->width;
+      height = ispec->height;
+    } else {
+      offset = planes[i].stride * (meta->crop_top / 2) + meta->crop_left / 2;
+      width = ispec->width / 2;
+      height = ispec->height / 2;
+    }
+    src = (guint8 *) planes[i].virtual_data + offset;
+    for (line = 0; line < height; line++) {
+      memcpy (dst[i], src, width);
+      dst[i] += (i == 0) ? frame->nStrideY : frame->nStrideC;
+      src += planes[i].stride;
+    }
+  }
+
+  return TRUE;
 }
 
 static GstFlowReturn
@@ -1146,7 +1419,6 @@ gst_vpuenc_chain (GstPad * pad, GstBuffer * buffer)
   GstVpuEnc *vpuenc;
   GstFlowReturn ret = GST_FLOW_UNEXPECTED;
   VpuEncRetCode core_ret;
-  VpuEncMem *frameblock = NULL;
 
   vpuenc = GST_VPUENC (GST_PAD_PARENT (pad));
 
@@ -1194,7 +1466,10 @@ gst_vpuenc_chain (GstPad * pad, GstBuffer * buffer)
   if (buffer) {
     void *paddr, *vaddr;
     VpuFrameBuffer frame = { 0 };
-    if (GST_BUFFER_SIZE (buffer) != vpuenc->ispec.pad_frame_size) {
+    GstBufferMeta *layout = gst_vpuenc_layout_meta (vpuenc, buffer);
+    gboolean described = (layout != NULL);
+    if ((!described)
+        && (GST_BUFFER_SIZE (buffer) != vpuenc->ispec.pad_frame_size)) {
       GST_ERROR ("Buffer size is not the same framesize of %d",
           vpuenc->ispec.frame_size);
       goto bail;
@@ -1205,25 +1480,26 @@ gst_vpuenc_chain (GstPad * pad, GstBuffer * buffer)
 
     TSManagerReceive (vpuenc->tsm, GST_BUFFER_TIMESTAMP (buffer));
 
-    if ((IS_DMABLE_BUFFER (buffer)) && (vpuenc->force_copy == FALSE)) {
-      paddr = DMABLE_BUFFER_PHY_ADDR (buffer);
-      vaddr = GST_BUFFER_DATA (buffer);
-    } else {
-      gint size = vpuenc->ispec.pad_frame_size + vpuenc->ispec.buffer_align - 1;
-      GST_INFO ("Need memcpy input buffer, performance maybe drop");
-      if ((frameblock =
-              vpuenc_core_mem_alloc_dma_buffer (vpuenc->ispec.pad_frame_size)) == NULL) {
+    /* encode straight from physically contiguous upstream memory such as
+       v4lsrc or vpudec frames, copy only what vpu can not address */
+    if (described) {
+      if ((!gst_vpuenc_assign_frame_from_meta (vpuenc, layout, &frame))
+          && (!gst_vpuenc_copy_frame_from_meta (vpuenc, layout, &frame))) {
         GST_ERROR ("Can not create dmaable buffer for input copy");
         goto bail;
       }
-      paddr = (void *) Align (frameblock->paddr, vpuenc->ispec.buffer_align);
-      vaddr = (void *) Align (frameblock->vaddr, vpuenc->ispec.buffer_align);
-      gst_vpuenc_copy_frame (vpuenc, buffer, vaddr);
+    } else if (gst_vpuenc_can_direct_input (vpuenc, buffer)) {
+      paddr = DMABLE_BUFFER_PHY_ADDR (buffer);
+      vaddr = GST_BUFFER_DATA (buffer);
+    } else if (!gst_vpuenc_copy_frame (vpuenc, buffer, &paddr, &vaddr)) {
+      GST_ERROR ("Can not create dmaable buffer for input copy");
+      goto bail;
     }
 
     memset (&vpuenc->context.params, 0, sizeof (VpuEncEncParam));
     gst_vpuenc_update_parameters (vpuenc);
-    gst_vpuenc_assign_frame (&vpuenc->ispec, &frame, paddr, vaddr);
+    if (!described)
+      gst_vpuenc_assign_frame (&vpuenc->ispec, &frame, paddr, vaddr);
     vpuenc->context.params.pInFrame = &frame;
 
     do {
@@ -1247,6 +1523,12 @@ gst_vpuenc_chain (GstPad * pad, GstBuffer * buffer)
               vpuenc->context.params.nOutOutputSize);
           GST_INFO ("got codec data %d bytes %" GST_PTR_FORMAT,
               vpuenc->context.params.nOutOutputSize, vpuenc->codec_data);
+
+          g_mutex_lock (vpuenc->outmem_pool_lock);
+          vpuenc->outmem_pool.headroom =
+              Align (vpuenc->context.params.nOutOutputSize,
+              VPUENC_OUTPUT_HEADROOM_ALIGN);
+          g_mutex_unlock (vpuenc->outmem_pool_lock);
         }
       } else if (vpuenc->context.params.eOutRetCode & VPU_ENC_OUTPUT_DIS) {
         GstBuffer *gstbuf;
@@ -1254,11 +1536,11 @@ gst_vpuenc_chain (GstPad * pad, GstBuffer * buffer)
             vpuenc->obuf->size);
         GST_LOG ("got compressed frame %d bytes",
             vpuenc->context.params.nOutOutputSize);
-        if ((ret =
-                gst_pad_alloc_buffer (vpuenc->srcpad, 0,
-                    vpuenc->context.params.nOutOutputSize, NULL,
-                    &gstbuf)) != GST_FLOW_OK) {
-          GST_INFO ("Create output buffer failed , ret = %d", ret);
+        if ((gstbuf =
+                gst_vpuenc_alloc_output_buffer (vpuenc,
+                    vpuenc->context.params.nOutOutputSize)) == NULL) {
+          GST_ERROR ("Create output buffer failed");
+          ret = GST_FLOW_ERROR;
           goto bail;
         }
         /* FIX ME : currently vpu wrapper still need copy since 6q does not dynamic output buffer */
@@ -1282,10 +1564,6 @@ bail:
     if (buffer) {
       gst_buffer_unref (buffer);
     }
-
-    if (frameblock) {
-      vpuenc_core_mem_free_dma_buffer (frameblock);
-    }
     return ret;
   }
 }
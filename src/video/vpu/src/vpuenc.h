@@ -134,6 +134,7 @@ typedef struct
   guint64 in_cnt;
   guint64 out_cnt;
   guint64 show_cnt;
+  guint64 copy_cnt;
 } VpuEncStat;
 
 
@@ -146,6 +147,12 @@ typedef struct {
   VpuEncMem * mems;
 } VpuEncFrameMemPool;
 
+typedef struct {
+  gint block_size;    /* headroom plus the largest frame seen */
+  gint headroom;      /* room for in-band headers in front of a frame */
+  VpuEncMem * mems;
+} VpuEncOutMemPool;
+
 struct _GstVpuEnc
 {
   GstElement element;
@@ -157,6 +164,7 @@ struct _GstVpuEnc
 
   VpuEncMem *mems;
   VpuEncFrameMemPool framemem_pool;
+  VpuEncOutMemPool outmem_pool;
 
   gint frame_num;
 
@@ -172,12 +180,14 @@ struct _GstVpuEnc
   gint mosaic_cnt;
   GMutex *lock;
   GMutex * framemem_pool_lock;
+  GMutex * outmem_pool_lock;
   VpuEncStat vpu_stat;
   gboolean init;
   gboolean downstream_caps_set;
 
   gboolean force_copy;
   VpuEncMem * obuf;
+  VpuEncMem * ibuf;
   guint64 frame_cnt;
 
   GstBuffer *codec_data;
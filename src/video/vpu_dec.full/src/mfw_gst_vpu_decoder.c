@@ -48,6 +48,7 @@
 
 #include "mfw_gst_vpu_decoder.h"
 #include "mfw_gst_vpu_thread.h"
+#include "mfw_gst_nalconv.h"
 
 #include "../../../misc/i_sink/src/mfw_isink_frame.h"
 
@@ -624,6 +625,137 @@ vpudec_free_gst_buf_meta (GstBuffer * buf)
   gst_buffer_meta_free (buf->_gst_reserved[index]);
 }
 
+/*=============================================================================
+FUNCTION:           mfw_gst_vpudec_wake_release_waiter
+
+DESCRIPTION:        Wakes up the chain waiting in mfw_gst_vpudec_wait_frame_return.
+                    Called when a frame buffer is returned and on flush or cleanup.
+
+ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
+
+RETURN VALUE:       None
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    Must not take vpu_mutex, downstream may return a frame
+                    buffer while the decoder holds it.
+=============================================================================*/
+static void
+mfw_gst_vpudec_wake_release_waiter (MfwGstVPU_Dec * vpu_dec)
+{
+  g_mutex_lock (vpu_dec->release_lock);
+  g_cond_broadcast (vpu_dec->release_cond);
+  g_mutex_unlock (vpu_dec->release_lock);
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_vpudec_wait_frame_return
+
+DESCRIPTION:        Blocks while input is pending and VPU has no frame buffer to
+                    decode into, until downstream returns one or the decoder
+                    is flushed. Frame buffers allocated by the sink are not
+                    returned through release_q, their reference count is
+                    checked again after FB_RELEASE_WAIT_US.
+
+ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
+
+RETURN VALUE:       TRUE if vpu_mutex is held again, FALSE if it could not be
+                    taken back
+PRE-CONDITIONS:     vpu_mutex is held
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+static gboolean
+mfw_gst_vpudec_wait_frame_return (MfwGstVPU_Dec * vpu_dec)
+{
+  gboolean notified = FALSE;
+  gint i;
+
+  for (i = 0; i < vpu_dec->numframebufs; i++) {
+    if (vpu_dec->fb_notify[i] && vpu_dec->fb_outstanding[i])
+      notified = TRUE;
+  }
+
+  // the release path must be able to run while we wait
+  vpu_mutex_unlock (vpu_dec->vpu_mutex);
+
+  g_mutex_lock (vpu_dec->release_lock);
+  if (notified) {
+    while (!vpu_dec->flushing && !vpu_dec->in_cleanup
+        && (g_async_queue_length (vpu_dec->release_q) <= 0))
+      g_cond_wait (vpu_dec->release_cond, vpu_dec->release_lock);
+  } else if (!vpu_dec->flushing && !vpu_dec->in_cleanup) {
+    GTimeVal timeout;
+    g_get_current_time (&timeout);
+    g_time_val_add (&timeout, FB_RELEASE_WAIT_US);
+    g_cond_timed_wait (vpu_dec->release_cond, vpu_dec->release_lock,
+        &timeout);
+  }
+  g_mutex_unlock (vpu_dec->release_lock);
+
+  return vpu_mutex_lock (vpu_dec->vpu_mutex, TRUE);
+}
+
+static void
+vpudec_release_gst_buf_meta (GstBuffer * buf)
+{
+  /* downstream dropped the last reference of a pushed frame, hand the
+     frame buffer index back to the decoder */
+  gint index = G_N_ELEMENTS (buf->_gst_reserved) - 1;
+  GstBufferMeta *bufmeta = buf->_gst_reserved[index];
+  MfwGstVPU_FbRelease *release = bufmeta->priv;
+  MfwGstVPU_Dec *vpu_dec = MFW_GST_VPU_DEC (release->parent);
+
+  g_async_queue_push (release->release_q, GUINT_TO_POINTER (release->tag));
+  g_async_queue_unref (release->release_q);
+  mfw_gst_vpudec_wake_release_waiter (vpu_dec);
+  gst_object_unref (release->parent);
+  g_slice_free (MfwGstVPU_FbRelease, release);
+  gst_buffer_meta_free (bufmeta);
+}
+
+/*=============================================================================
+FUNCTION:           mfw_gst_vpudec_wrap_outbuf
+
+DESCRIPTION:        Creates the buffer pushed downstream for a frame buffer the
+                    plugin allocated itself. It shares the frame memory and
+                    queues the frame buffer index on release_q when finalized.
+
+ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
+                    idx - index of the frame buffer
+
+RETURN VALUE:       GstBuffer - buffer to push
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=============================================================================*/
+static GstBuffer *
+mfw_gst_vpudec_wrap_outbuf (MfwGstVPU_Dec * vpu_dec, gint idx)
+{
+  GstBuffer *outbuffer = gst_buffer_new ();
+  GstBufferMeta *bufmeta = gst_buffer_meta_new ();
+  MfwGstVPU_FbRelease *release = g_slice_new (MfwGstVPU_FbRelease);
+  gint index = G_N_ELEMENTS (outbuffer->_gst_reserved) - 1;
+
+  release->release_q = g_async_queue_ref (vpu_dec->release_q);
+  release->tag = FB_RELEASE_TAG (vpu_dec->fb_generation, idx);
+  release->parent = gst_object_ref (vpu_dec);
+
+  GST_BUFFER_SIZE (outbuffer) = GST_BUFFER_SIZE (vpu_dec->outbuffers[idx]);
+  GST_BUFFER_DATA (outbuffer) = GST_BUFFER_DATA (vpu_dec->outbuffers[idx]);
+  GST_BUFFER_OFFSET_END (outbuffer) = idx;
+  gst_buffer_set_caps (outbuffer, GST_PAD_CAPS (vpu_dec->srcpad));
+
+  bufmeta->physical_data = vpu_dec->frame_mem[idx].phy_addr;
+  bufmeta->priv = release;
+  outbuffer->_gst_reserved[index] = bufmeta;
+
+  GST_BUFFER_MALLOCDATA (outbuffer) = outbuffer;
+  GST_BUFFER_FREE_FUNC (outbuffer) = vpudec_release_gst_buf_meta;
+
+  vpu_dec->fb_outstanding[idx] = TRUE;
+  return outbuffer;
+}
+
 
 /*=============================================================================
 FUNCTION:           mfw_gst_vpudec_FrameBufferInit
@@ -656,6 +788,9 @@ mfw_gst_vpudec_FrameBufferInit (MfwGstVPU_Dec * vpu_dec,
   gint sw_cnt = 0, hw_cnt = 0;
 
   vpu_dec->numframebufs = num_buffers;
+  vpu_dec->fb_generation++;
+  memset (vpu_dec->fb_notify, 0, sizeof (vpu_dec->fb_notify));
+  memset (vpu_dec->fb_outstanding, 0, sizeof (vpu_dec->fb_outstanding));
 
   if (mfw_gst_vpudec_is_mjpeg_422h (vpu_dec))
     cr_offset = (strideY * height) >> 1;
@@ -791,6 +926,7 @@ mfw_gst_vpudec_FrameBufferInit (MfwGstVPU_Dec * vpu_dec,
 
         vpu_dec->fb_state_plugin[i] = FB_STATE_ALLOCATED;
         vpu_dec->fb_type[i] = FB_TYPE_GST;
+        vpu_dec->fb_notify[i] = TRUE;
 
         frameBuf[i].bufY = vpu_dec->frame_mem[i].phy_addr;
         frameBuf[i].bufCb = frameBuf[i].bufY + img_size;
@@ -845,7 +981,11 @@ mfw_gst_vpudec_FrameBufferRelease (MfwGstVPU_Dec * vpu_dec)
       gst_buffer_unref (vpu_dec->outbuffers[i]);
       vpu_dec->outbuffers[i] = NULL;
     }
+    vpu_dec->fb_notify[i] = FALSE;
+    vpu_dec->fb_outstanding[i] = FALSE;
   }
+  /* returns still queued belong to the frame buffers just freed */
+  while (g_async_queue_try_pop (vpu_dec->release_q));
   return;
 }
 
@@ -977,10 +1117,82 @@ mfw_gst_vpudec_vpu_open (MfwGstVPU_Dec * vpu_dec)
   return GST_FLOW_OK;
 }
 
+/*======================================================================================
+FUNCTION:           mfw_gst_vpudec_bitbuf_space
+
+DESCRIPTION:        Gets the free space of the VPU bitstream ring buffer. In streaming
+                    mode our write pointer is synced to the one of VPU.
+
+ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
+                    space - returns the free space in bytes
+
+RETURN VALUE:       RetCode - VPU return code.
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=======================================================================================*/
+static RetCode
+mfw_gst_vpudec_bitbuf_space (MfwGstVPU_Dec * vpu_dec, Uint32 * space)
+{
+  RetCode vpu_ret = RETCODE_SUCCESS;
+  PhysicalAddress p1, p2;
+
+  *space = vpu_dec->buffer_fill_size;
+  vpu_ret = vpu_DecGetBitstreamBuffer (*(vpu_dec->handle), &p1, &p2, space);
+  if (vpu_ret != RETCODE_SUCCESS)
+    return vpu_ret;
+
+  if (!vpu_dec->file_play_mode && (p1 >= vpu_dec->base_write)
+      && (p1 < vpu_dec->end_write))
+    vpu_dec->start_addr = vpu_dec->base_addr + (p1 - vpu_dec->base_write);
+
+  vpu_dec->data_in_vpu = vpu_dec->buffer_fill_size - *space;
+  return vpu_ret;
+}
+
+/*======================================================================================
+FUNCTION:           mfw_gst_vpudec_bitbuf_write
+
+DESCRIPTION:        Writes data at the write pointer of the bitstream ring buffer,
+                    splitting the copy when it wraps, and hands it over to VPU.
+                    Caller must make sure there is enough space.
+
+ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
+                    data - data to write
+                    size - size of data in bytes
+
+RETURN VALUE:       RetCode - VPU return code.
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=======================================================================================*/
+static RetCode
+mfw_gst_vpudec_bitbuf_write (MfwGstVPU_Dec * vpu_dec, guint8 * data,
+    guint size)
+{
+  guint residue = vpu_dec->end_addr - vpu_dec->start_addr;
+
+  if (size < residue) {
+    memcpy (vpu_dec->start_addr, data, size);
+    vpu_dec->start_addr += size;
+  } else {
+    memcpy (vpu_dec->start_addr, data, residue);
+    memcpy (vpu_dec->base_addr, data + residue, size - residue);
+    vpu_dec->start_addr = vpu_dec->base_addr + size - residue;
+  }
+
+  vpu_dec->data_in_vpu += size;
+  vpu_dec->bitbuf_written += size;
+
+  return vpu_DecUpdateBitstreamBuffer (*(vpu_dec->handle), size);
+}
+
 /*======================================================================================
 FUNCTION:           mfw_gst_vpudec_copy_data
 
-DESCRIPTION:        Copies data to the VPU input
+DESCRIPTION:        Copies data to the VPU input. In streaming mode the part which does
+                    not fit in the bitstream buffer is kept and copied on the next call
+                    once VPU has consumed some data.
 
 ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
 
@@ -996,42 +1208,36 @@ mfw_gst_vpudec_copy_data (MfwGstVPU_Dec * vpu_dec)
   guint gst_buffer_size = GST_BUFFER_SIZE (vpu_dec->gst_buffer);
   guint size_to_copy = gst_buffer_size - vpu_dec->buff_consumed;
   guint8 *buffer_to_copy = GST_BUFFER_DATA (vpu_dec->gst_buffer);
-  PhysicalAddress p1, p2;
   Uint32 space = vpu_dec->buffer_fill_size;
   gchar *info;
 
   if (!vpu_dec->vpu_init || !vpu_dec->file_play_mode) {
-    vpu_ret = vpu_DecGetBitstreamBuffer (*(vpu_dec->handle), &p1, &p2, &space);
+    vpu_ret = mfw_gst_vpudec_bitbuf_space (vpu_dec, &space);
     if (vpu_ret != RETCODE_SUCCESS) {
       GST_ERROR
           (">>VPU_DEC: vpu_DecGetBitstreamBuffer failed. Error is %d ",
           vpu_ret);
       return GST_FLOW_ERROR;
     }
-    if ((space <= 0) && (vpu_dec->num_timeouts == 0)) {
+    if ((space <= BITBUF_RESERVE) && (vpu_dec->num_timeouts == 0)) {
       if (vpu_dec->vpu_init) {
-        GST_ERROR ("vpu_DecGetBitstreamBuffer returned zero space do a reset ");
-        /* in this case our bitstream buffer is full
-         *  - VPU is not able to decode into our buffers
-         */
-        mfw_gst_vpudec_reset (vpu_dec);
-        /*
-         * can't do copy yet since we need that first frame
-         * which is done in copy_sink
+        /* bitstream buffer is full, keep the input and let the decode
+         * loop drain it. It waits for a frame buffer when VPU has none.
          */
+        GST_FRAMEDBG (">>VPU_DEC: bitstream buffer full data_in_vpu %d\n",
+            vpu_dec->data_in_vpu);
+        vpu_dec->must_copy_data = TRUE;
         return GST_FLOW_OK;
       } else {
         GST_ERROR
             ("vpu_DecGetBitstreamBuffer returned zero space flush buffer ");
         vpu_ret = vpu_DecBitBufferFlush (*vpu_dec->handle);
         resyncTSManager (vpu_dec->pTS_Mgr, TSM_TIMESTAMP_NONE, MODE_AI);
-        vpu_ret =
-            vpu_DecGetBitstreamBuffer (*(vpu_dec->handle), &p1, &p2, &space);
+        vpu_ret = mfw_gst_vpudec_bitbuf_space (vpu_dec, &space);
         if (space <= 0)
           return GST_FLOW_ERROR;
       }
     }
-    vpu_dec->data_in_vpu = vpu_dec->buffer_fill_size - space;
   }
   // For File Play mode - copy over data from start of buffer and update VPU first time
   if (vpu_dec->file_play_mode == TRUE) {
@@ -1080,32 +1286,24 @@ mfw_gst_vpudec_copy_data (MfwGstVPU_Dec * vpu_dec)
         vpu_dec->min_data_in_vpu = (gst_buffer_size + 511) & ~511;
       }
     }
-    // check if we can only copy part of the buffer if so copy what what we can this time
-    if (space <= size_to_copy) {
-      size_to_copy = space - 4;
-    }
-    // check if we can do just one memcpy
-    if ((vpu_dec->start_addr + size_to_copy) <= vpu_dec->end_addr) {
-      memcpy (vpu_dec->start_addr, buffer_to_copy, size_to_copy);
-      vpu_dec->start_addr += size_to_copy;
-    } else                      // otherwise split it into two copies - one at end and one from beginning
-    {
-      guint residue = (vpu_dec->end_addr - vpu_dec->start_addr);
-      memcpy (vpu_dec->start_addr, buffer_to_copy, residue);
-      memcpy (vpu_dec->base_addr, buffer_to_copy + residue,
-          size_to_copy - residue);
-      vpu_dec->start_addr = vpu_dec->base_addr + size_to_copy - residue;
+    // copy only what fits this time, the rest waits in the sink buffer
+    if (space <= BITBUF_RESERVE) {
+      size_to_copy = 0;
+    } else if (space - BITBUF_RESERVE < size_to_copy) {
+      size_to_copy = space - BITBUF_RESERVE;
     }
 
-    // Now update the bitstream buffer with the amount we just copied
-    vpu_ret = vpu_DecUpdateBitstreamBuffer (*(vpu_dec->handle), size_to_copy);
-    if (vpu_ret != RETCODE_SUCCESS) {
-      GST_ERROR
-          ("vpu_DecUpdateBitstreamBuffer failed. Error code is %d ", vpu_ret);
-      return (GST_FLOW_ERROR);
+    if (size_to_copy) {
+      vpu_ret =
+          mfw_gst_vpudec_bitbuf_write (vpu_dec, buffer_to_copy, size_to_copy);
+      if (vpu_ret != RETCODE_SUCCESS) {
+        GST_ERROR
+            ("vpu_DecUpdateBitstreamBuffer failed. Error code is %d ",
+            vpu_ret);
+        return (GST_FLOW_ERROR);
+      }
     }
 
-    vpu_dec->data_in_vpu += size_to_copy;
     GST_FRAMEDBG
         (">>VPU_DEC: copy data data_in_vpu %d min_data_in_vpu %d space %d\n",
         vpu_dec->data_in_vpu, vpu_dec->min_data_in_vpu, space);
@@ -1173,139 +1371,6 @@ mfw_gst_vpudec_passthru (MfwGstVPU_Dec * vpu_dec)
   return GST_FLOW_OK;
 }
 
-void
-ModifyAVC_offset (guint32 * jump, guint32 NALLengthFieldSize)
-{
-  static guint32 mask_value[4] =
-      { 0xff000000, 0xffff0000, 0xffffff00, 0xffffffff };
-
-  *jump = ((*jump) & (mask_value[NALLengthFieldSize - 1]));
-  *jump >>= ((NAL_START_CODE_SIZE - NALLengthFieldSize) * 8);
-}
-
-/*======================================================================================
-FUNCTION:           nal_scan_replace
-
-DESCRIPTION:     * no nal header found, then we need to scan all the buffer
-                 * 1. find whether it have jump length greater than buffer length.
-                 *    if does not then replace the code with nal header until find it
-                 *    if found large length, then do nothing, and jump out
-                 ****************************************************************
-
-ARGUMENTS PASSED:
-                    buffer  - input buffer
-                    end - the end address of current buffer
-
-=======================================================================================*/
-
-guint32
-nal_scan_replace (unsigned char *buf, int end,
-    guint32 NALLengthFieldSize, guint32 Ori_buf_size)
-{
-  unsigned char *temp_buf1, *temp_buf2;
-  guint32 jump, data_size, unlegal_flag, counter, buf_size;
-  unlegal_flag = 0;
-  data_size = 0;
-  counter = 0;
-  buf_size = 0;
-  temp_buf1 = buf + NAL_START_DEFAULT_LENGTH;
-
-  while (((guint32) temp_buf1) < end) {
-    jump = (temp_buf1[0] << 24) | (temp_buf1[1] << 16) | (temp_buf1[2] << 8)
-        | (temp_buf1[3]);
-    if (jump == 0x00000001) {
-      break;
-    } else {
-      data_size = end - (guint32) temp_buf1;
-      ModifyAVC_offset (&jump, NALLengthFieldSize);
-      if (jump > data_size) {
-        unlegal_flag = 1;
-        break;
-      }
-    }
-    counter++;
-    temp_buf1 += (jump + NALLengthFieldSize);
-  }
-  /* nal header replace procedure, need copy to 100 byte ahead */
-  temp_buf1 = buf + NAL_START_DEFAULT_LENGTH;
-  temp_buf2 = buf;
-
-  if (!unlegal_flag) {
-    while (counter) {
-      jump =
-          (temp_buf1[0] << 24) | (temp_buf1[1] << 16) | (temp_buf1[2] <<
-          8) | (temp_buf1[3]);
-      ModifyAVC_offset (&jump, NALLengthFieldSize);
-
-      temp_buf2[2] = temp_buf2[1] = temp_buf2[0] = 0;
-      temp_buf2[3] = 0x01;
-      memmove (temp_buf2 + 4, temp_buf1 + NALLengthFieldSize, jump);
-      temp_buf1 += (jump + NALLengthFieldSize);
-      temp_buf2 += (jump + 4);
-      buf_size += (jump + 4);
-      counter--;
-    }
-  } else {
-    memmove (temp_buf2, temp_buf1, Ori_buf_size);
-    buf_size = Ori_buf_size;
-  }
-  return buf_size;
-}
-
-
-/*======================================================================================
-FUNCTION:           scan_data_found_nal_header
-
-DESCRIPTION:     * no nal header found, then we need to scan all the buffer
-                 * 1. find whether it have jump length greater than buffer length.
-                 *    if does not then replace the code with nal header until find it
-                 *    if found large length, then do nothing, and jump out
-                 ****************************************************************
-
-ARGUMENTS PASSED:
-                    buffer  - input buffer
-                    end - the end address of current buffer
-
-RETURN VALUE:       GstFlowReturn - Success of Failure.
-
-=======================================================================================*/
-
-void
-scan_data_found_nal_header (unsigned char *buf, int end)
-{
-  unsigned char *temp_buf;
-  guint32 jump, data_size, unlegal_flag, counter;
-  unlegal_flag = 0;
-  data_size = 0;
-  counter = 0;
-  temp_buf = buf;
-  while (((guint32) buf) < end) {
-    jump = (buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | (buf[3]);
-    if (jump == 0x00000001) {
-      break;
-    } else {
-      data_size = end - (guint32) buf;
-      if (jump > data_size) {
-        unlegal_flag = 1;
-        break;
-      }
-    }
-    counter++;
-    buf += (jump + 4);
-  }
-  /* nal header replace procedure */
-  if (!unlegal_flag) {
-    while (counter) {
-      jump = (temp_buf[0] << 24) | (temp_buf[1] << 16) | (temp_buf[2] << 8)
-          | (temp_buf[3]);
-      temp_buf[2] = temp_buf[1] = temp_buf[0] = 0;
-      temp_buf[3] = 0x01;
-      temp_buf += (jump + 4);
-      counter--;
-    }
-  }
-}
-
 /*======================================================================================
 FUNCTION:           mfw_gst_avc_handle_specificdata
 
@@ -1322,137 +1387,26 @@ gboolean
 mfw_gst_avc_handle_specificdata (GstBuffer * hdrbuffer, GstBuffer * codecdata,
     guint32 * NALLengthFieldSize)
 {
-  gboolean err = TRUE;
-  guint8 *inputData;
-  guint32 inputDataSize;
   /* H264 video, wrap decoder info in NAL units. The parameter NAL length field size
      is always 2 bytes long, different from that of data NAL units (1, 2 or 4 bytes) */
-  guint32 i, j, k;
-  guint32 info_size = 0;        /* size of SPS&PPS in NALs */
-  gchar *data = NULL;           /* temp buffer */
-  guint8 lengthSizeMinusOne;
-  guint8 numOfSequenceParameterSets;
-  guint8 numOfPictureParameterSets;
-  guint16 NALLength;
-
-  inputData = GST_BUFFER_DATA (codecdata);
-  inputDataSize = GST_BUFFER_SIZE (codecdata);
-  data = GST_BUFFER_DATA (hdrbuffer);
-
-
-  /*
-     start code to check for the begining of the H264 object header.
-     Might have to change for other streams if required
-     Amanda: ENGR57903
-     Format of 'avcC' does not strictly follow that of 'jvtC'in 14496-15(2003),
-     sec 4.1.5 "AVCConfigurationRecord".
-     The actual format seems to be:
-     aligned(8) class AVCDecoderConfigurationRecord {
-     unsigned int(8) configurationVersion = 1;
-     unsigned int(8) AVCProfileIndication;
-     unsigned int(8) AVCLevelIndication;
-     unsigned int(8) AVCCompatibleProfiles;
-     bit(6) reserved = '111111'b;
-     unsigned int(2) lengthSizeMinusOne;
-     bit(3) reserved = '111'b;
-     unsigned int(5) numOfSequenceParameterSets;
-     for (i=0; i< numOfSequenceParameterSets;  i++) {
-     unsigned int(16) sequenceParameterSetLength ;
-     bit(8*sequenceParameterSetLength) sequenceParameterSetNALUnit;
-     }
-     unsigned int(8) numOfPictureParameterSets;
-     for (i=0; i< numOfPictureParameterSets;  i++) {
-     unsigned int(16) pictureParameterSetLength;
-     bit(8*pictureParameterSetLength) pictureParameterSetNALUnit;
-     }
-     }
-     TODO: test more files to change the following code
-   */
-
-  lengthSizeMinusOne = inputData[4];
-  lengthSizeMinusOne &= 0x03;   /* nal length max is 4, min is 1 byte */
-
-  /* lengthSizeMinusOne = 0x11, 0b1111 1111 */
-  *NALLengthFieldSize = (guint32) lengthSizeMinusOne + 1;
-  GST_INFO ("AVC NAL length size %d bytes", *NALLengthFieldSize);
-
-  numOfSequenceParameterSets = inputData[5] & 0x1f;
-
-
-  k = 6;
-  for (i = 0; i < numOfSequenceParameterSets; i++) {
-    if (k >= inputDataSize) {
-      GST_ERROR ("Invalid Sequence parameter NAL length: %d", NALLength);
-      err = FALSE;
-      goto bail;
-    }
-    NALLength = inputData[k];
-    NALLength = (NALLength << 8) + inputData[k + 1];
-    //printf("Sequence parameter NAL length: %d\n",  NALLength);
-    k += (NALLength + 2);
-    info_size += (NALLength + NAL_START_CODE_SIZE);
+  guint length_size = NAL_START_CODE_SIZE;
+  gint info_size;
+
+  info_size = mfw_nalconv_avcc_to_annexb (GST_BUFFER_DATA (codecdata),
+      GST_BUFFER_SIZE (codecdata), GST_BUFFER_DATA (hdrbuffer),
+      GST_BUFFER_SIZE (hdrbuffer), &length_size);
+  if (info_size < 0) {
+    GST_ERROR ("Invalid AVC decoder configuration record");
+    return FALSE;
   }
-  numOfPictureParameterSets = inputData[k];
-  k++;
 
-
-  for (i = 0; i < numOfPictureParameterSets; i++) {
-    if (k >= inputDataSize) {
-      GST_ERROR ("Invalid picture parameter NAL length: %d", NALLength);
-      err = FALSE;
-      goto bail;
-    }
-    NALLength = inputData[k];
-    NALLength = (NALLength << 8) + inputData[k + 1];
-    //printf("Picture parameter NAL length: %d\n",  NALLength);
-    k += (NALLength + 2);
-    info_size += (NALLength + NAL_START_CODE_SIZE);
-  }
-
-  //printf("AVC decoder specific info size: %d\n", info_size);
-
-  /* wrap SPS + PPS into the temp buffer "data" */
-
-  k = 6;
-  j = 0;
-  for (i = 0; i < numOfSequenceParameterSets; i++) {
-    NALLength = inputData[k];
-    NALLength = (NALLength << 8) + inputData[k + 1];
-    //printf("Sequence parameter NAL length: %d\n",  NALLength);
-    *(data + j) = 0;
-    *(data + j + 1) = 0;
-    *(data + j + 2) = 0;
-    *(data + j + 3) = 1;
-    j += 4;
-
-    memmove (data + j, inputData + k + 2, NALLength);
-    k += (NALLength + 2);
-    j += NALLength;
-
-  }
-  k++;                          /* number of picture parameter sets */
-  for (i = 0; i < numOfPictureParameterSets; i++) {
-    NALLength = inputData[k];
-    NALLength = (NALLength << 8) + inputData[k + 1];
-    //printf("Picture parameter NAL length: %d\n",  NALLength);
-    *(data + j) = 0;
-    *(data + j + 1) = 0;
-    *(data + j + 2) = 0;
-    *(data + j + 3) = 1;
-    j += 4;
-
-    memmove (data + j, inputData + k + 2, NALLength);
-    k += (NALLength + 2);
-    j += NALLength;
-  }
+  *NALLengthFieldSize = length_size;
+  GST_INFO ("AVC NAL length size %d bytes", *NALLengthFieldSize);
 
   /* write back size to the original buffer */
   GST_BUFFER_SIZE (hdrbuffer) = info_size;
-  //g_print("AVC NAL header length size %d bytes\n",  info_size);
-
-bail:
-  return err;
 
+  return TRUE;
 }
 
 /*======================================================================================
@@ -1478,8 +1432,6 @@ mfw_gst_avc_fix_nalheader (MfwGstVPU_Dec * vpu_dec)
   gboolean ret;
   guint32 NALLengthFieldSize;
   unsigned char *buf = GST_BUFFER_DATA (buffer);
-  guint32 end =
-      (guint32) (GST_BUFFER_DATA (buffer) + GST_BUFFER_SIZE (buffer) - 4);
   GstBuffer *hdrBuf = NULL;
   ret = TRUE;
   NALLengthFieldSize = vpu_dec->NALLengthFieldSize;
@@ -1495,8 +1447,8 @@ mfw_gst_avc_fix_nalheader (MfwGstVPU_Dec * vpu_dec)
       } else {
 
         hdrBuf =
-            gst_buffer_new_and_alloc (vpu_dec->codec_data_len +
-            NAL_START_DEFAULT_LENGTH);
+            gst_buffer_new_and_alloc (NALCONV_AVCC_ANNEXB_MAX_SIZE
+            (vpu_dec->codec_data_len));
         if (hdrBuf == NULL)
           return GST_FLOW_OK;
         /* successful allocate hdrBuf, then use function to refill it. */
@@ -1552,38 +1504,45 @@ mfw_gst_avc_fix_nalheader (MfwGstVPU_Dec * vpu_dec)
     if (((buf[4] == 0x67) || (buf[4] == 0x68)))
       vpu_dec->hdr_received = TRUE;
 
-
-    /* no nal header found, then we need to scan all the buffer
-     * 1. find whether it have jump length greater than buffer length.
-     *    if does not then replace the code with nal header until find it
-     *    if found large length, then do nothing, and jump out
+    /* no nal header found, rewrite the length fields into start codes in
+     * one pass. 4 byte lengths are replaced in place, smaller ones need a
+     * larger buffer, which also takes the codec header so no join is needed.
+     * Conversion stops at a length running past the buffer.
      ****************************************************************/
-    {
-      if (NALLengthFieldSize != NAL_START_CODE_SIZE) {
-        /* offset of nal length is not same with start code, so we have to enlarge buffer
-         *  to accormidate the added data, 100 as a default adding value for it. */
-        GstBuffer *temp = NULL;
-        guint32 buf_size, tmp_buf_size;
-        temp = gst_buffer_new_and_alloc (NAL_START_DEFAULT_LENGTH);
-        if (temp == NULL)
-          return GST_FLOW_OK;
-        tmp_buf_size = GST_BUFFER_SIZE (vpu_dec->gst_buffer);
-        vpu_dec->gst_buffer = gst_buffer_join (temp, vpu_dec->gst_buffer);
-        buf = GST_BUFFER_DATA (vpu_dec->gst_buffer);
-        end =
-            (guint32) (GST_BUFFER_DATA (vpu_dec->gst_buffer) +
-            GST_BUFFER_SIZE (vpu_dec->gst_buffer));
-        /*  write new function handle special case, need to copy data  */
-        buf_size =
-            nal_scan_replace (buf, end, NALLengthFieldSize, tmp_buf_size);
-        if (buf_size != 0)
-          GST_BUFFER_SIZE (vpu_dec->gst_buffer) = buf_size;
+    if (NALLengthFieldSize == NAL_START_CODE_SIZE) {
+      mfw_nalconv_length_to_annexb (buf, GST_BUFFER_SIZE (buffer),
+          NALLengthFieldSize, buf, GST_BUFFER_SIZE (buffer));
+    } else {
+      GstBuffer *outbuf;
+      guint hdr_size = hdrBuf ? GST_BUFFER_SIZE (hdrBuf) : 0;
+      gint size;
+
+      outbuf = gst_buffer_new_and_alloc (hdr_size +
+          NALCONV_ANNEXB_MAX_SIZE (GST_BUFFER_SIZE (buffer),
+              NALLengthFieldSize));
+      if (outbuf == NULL)
+        return GST_FLOW_OK;
+      size = mfw_nalconv_length_to_annexb (buf, GST_BUFFER_SIZE (buffer),
+          NALLengthFieldSize, GST_BUFFER_DATA (outbuf) + hdr_size,
+          GST_BUFFER_SIZE (outbuf) - hdr_size);
+      if (size < 0) {
+        GST_ERROR ("Failed to convert AVC data with %d bytes NAL length",
+            NALLengthFieldSize);
+        gst_buffer_unref (outbuf);
       } else {
-        /* same with start code, normal process */
-        scan_data_found_nal_header (buf, end);
+        if (hdrBuf) {
+          memcpy (GST_BUFFER_DATA (outbuf), GST_BUFFER_DATA (hdrBuf),
+              hdr_size);
+          gst_buffer_unref (hdrBuf);
+          hdrBuf = NULL;
+        }
+        GST_BUFFER_SIZE (outbuf) = hdr_size + size;
+        gst_buffer_copy_metadata (outbuf, buffer,
+            GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS);
+        gst_buffer_unref (buffer);
+        vpu_dec->gst_buffer = outbuf;
       }
     }
-
   }
   if (hdrBuf)
     vpu_dec->gst_buffer = gst_buffer_join (hdrBuf, vpu_dec->gst_buffer);
@@ -2658,15 +2617,19 @@ mfw_gst_vpudec_prep_gstbuf (MfwGstVPU_Dec * vpu_dec)
         vpu_dec->fb_state_plugin[vpu_dec->outputInfo->
             indexFrameDisplay] = FB_STATE_PENDING;
       } else {
-        vpu_dec->pushbuff =
-            vpu_dec->outbuffers[vpu_dec->outputInfo->indexFrameDisplay];
-        if (vpu_dec->pushbuff) {
-          gst_buffer_set_caps (vpu_dec->pushbuff,
-              GST_PAD_CAPS (vpu_dec->srcpad));
-
-
-          gst_buffer_ref (vpu_dec->pushbuff);
+        gint idx = vpu_dec->outputInfo->indexFrameDisplay;
 
+        if (vpu_dec->fb_notify[idx] && vpu_dec->outbuffers[idx]) {
+          vpu_dec->pushbuff = mfw_gst_vpudec_wrap_outbuf (vpu_dec, idx);
+        } else {
+          vpu_dec->pushbuff = vpu_dec->outbuffers[idx];
+          if (vpu_dec->pushbuff) {
+            gst_buffer_set_caps (vpu_dec->pushbuff,
+                GST_PAD_CAPS (vpu_dec->srcpad));
+            gst_buffer_ref (vpu_dec->pushbuff);
+          }
+        }
+        if (vpu_dec->pushbuff) {
           vpu_dec->fb_state_plugin[vpu_dec->outputInfo->
               indexFrameDisplay] = FB_STATE_DISPLAY;
         }
@@ -3321,6 +3284,17 @@ mfw_gst_vpudec_chain (GstPad * pad, GstBuffer * buffer)
       if ((ret == RELEASE_BUFF_FAILED) ||
           (retval == RETCODE_FRAME_NOT_COMPLETE)) {
         retval = GST_FLOW_OK;
+        // input still pending - wait for downstream to return a frame
+        // buffer so VPU can drain the bitstream instead of dropping input
+        if ((ret == RELEASE_BUFF_FAILED) && vpu_dec->must_copy_data
+            && !vpu_dec->file_play_mode && !vpu_dec->flushing) {
+          if (mfw_gst_vpudec_wait_frame_return (vpu_dec) == FALSE) {
+            vpu_dec->trymutex = FALSE;
+            GST_MUTEX (">>VPU_DEC: after frame buffer wait - no mutex lock cnt=%d\n", mutex_cnt);
+            goto done;
+          }
+          goto check_continue;
+        }
         GST_WARNING ("No frame buffer is available");
         goto done;
       } else if ((retval != RETCODE_SUCCESS) || (retval != GST_FLOW_OK)) {
@@ -3422,8 +3396,18 @@ done:
   }
   // vc1 buffer join does an unref so can't do it in this case
   if (vpu_dec->gst_buffer != NULL) {
+    if (vpu_dec->must_copy_data && !vpu_dec->flushing) {
+      // the loop ended on an error with input still pending, only what
+      // never reached the ring is lost
+      vpu_dec->bitbuf_dropped +=
+          GST_BUFFER_SIZE (vpu_dec->gst_buffer) - vpu_dec->buff_consumed;
+      GST_WARNING (">>VPU_DEC: no bitstream space, dropped %d bytes",
+          GST_BUFFER_SIZE (vpu_dec->gst_buffer) - vpu_dec->buff_consumed);
+    }
     gst_buffer_unref (vpu_dec->gst_buffer);
     vpu_dec->gst_buffer = NULL;
+    vpu_dec->buff_consumed = 0;
+    vpu_dec->must_copy_data = FALSE;
   }
 
   return retval;
@@ -3591,6 +3575,7 @@ mfw_gst_vpudec_sink_event (GstPad * pad, GstEvent * event)
       vpu_mutex_lock (vpu_dec->vpu_mutex, FALSE);
       vpu_dec->flushing = TRUE;
       vpu_mutex_unlock (vpu_dec->vpu_mutex);
+      mfw_gst_vpudec_wake_release_waiter (vpu_dec);
       GST_MUTEX (">>VPU_DEC: flush start after mutex_lock cnt=%d\n", mutex_cnt);
 
       if (!vpu_dec->vpu_init) {
@@ -3745,6 +3730,7 @@ mfw_gst_vpudec_cleanup (MfwGstVPU_Dec * vpu_dec)
     return;
 
   vpu_dec->in_cleanup = TRUE;
+  mfw_gst_vpudec_wake_release_waiter (vpu_dec);
   vpu_dec->start_addr = NULL;
   vpu_dec->end_addr = NULL;
   vpu_dec->base_addr = NULL;
@@ -3933,6 +3919,11 @@ static GstStateChangeReturn mfw_gst_vpudec_change_state
       vpu_dec->just_flushed = FALSE;
       vpu_dec->flushing = FALSE;
       vpu_dec->data_in_vpu = 0;
+      if (vpu_dec->bitbuf_dropped)
+        GST_WARNING (">>VPU_DEC: bitstream written %lld dropped %lld bytes",
+            vpu_dec->bitbuf_written, vpu_dec->bitbuf_dropped);
+      vpu_dec->bitbuf_written = 0;
+      vpu_dec->bitbuf_dropped = 0;
       vpu_dec->start_addr = NULL;
       vpu_dec->end_addr = NULL;
       vpu_dec->base_addr = NULL;
@@ -4888,6 +4879,18 @@ mfw_gst_vpudec_finalize (GObject * object)
     destroyTSManager (vpu_dec->pTS_Mgr);
     (vpu_dec->pTS_Mgr) = NULL;
   }
+  if (vpu_dec->release_q) {
+    g_async_queue_unref (vpu_dec->release_q);
+    vpu_dec->release_q = NULL;
+  }
+  if (vpu_dec->release_cond) {
+    g_cond_free (vpu_dec->release_cond);
+    vpu_dec->release_cond = NULL;
+  }
+  if (vpu_dec->release_lock) {
+    g_mutex_free (vpu_dec->release_lock);
+    vpu_dec->release_lock = NULL;
+  }
   mfw_gst_vpudec_vpu_finalize ();
 
   PRINT_FINALIZE ("vpu_dec");
@@ -5118,6 +5121,10 @@ mfw_gst_vpudec_init (MfwGstVPU_Dec * vpu_dec, MfwGstVPU_DecClass * gclass)
   vpu_dec->dbk_offset_a = vpu_dec->dbk_offset_b = DEFAULT_DBK_OFFSET_VALUE;
 
   vpu_dec->pTS_Mgr = createTSManager (0);
+  vpu_dec->release_q = g_async_queue_new ();
+  vpu_dec->release_lock = g_mutex_new ();
+  vpu_dec->release_cond = g_cond_new ();
+  vpu_dec->fb_generation = 0;
 
   vpu_dec->fmt = 0;
 
@@ -128,7 +128,6 @@ enum
 
 #define VPU_PARALLELIZATION 1
 #define NAL_START_CODE_SIZE 4
-#define NAL_START_DEFAULT_LENGTH 100
 #define IS_DMABLE_BUFFER(buffer) ( (GST_IS_BUFFER_META(buffer->_gst_reserved[G_N_ELEMENTS(buffer->_gst_reserved)-1])) \
                                  || ( GST_IS_BUFFER(buffer) \
                                  &&  GST_BUFFER_FLAG_IS_SET((buffer),GST_BUFFER_FLAG_LAST)))
@@ -229,6 +228,9 @@ do {\
 #define BUFF_FILL_SIZE_LARGE (1024 * 1024)
 #define BUFF_FILL_SIZE_SMALL (512 * 1024)
 
+// bitstream ring buffer back-pressure
+#define BITBUF_RESERVE          4       // never fill the ring completely
+
 #define PS_SAVE_SIZE		0x028000
 #define SLICE_SAVE_SIZE		0x02D800
 #define MIN_WIDTH       16      //64  /* ENGR00109002 bug fix */
@@ -307,6 +309,20 @@ typedef enum
   FB_TYPE_HW,                   /* Buffer allocated from hardware */
 } FB_TYPE;
 
+/* frame buffers returned by downstream are queued as tags which carry the
+   frame buffer generation so returns from a previous allocation are ignored */
+#define FB_RELEASE_TAG(gen, idx)    ((((gen) & 0xffffff) << 8) | ((idx) + 1))
+#define FB_RELEASE_TAG_GEN(tag)     ((tag) >> 8)
+#define FB_RELEASE_TAG_IDX(tag)     ((gint) ((tag) & 0xff) - 1)
+#define FB_RELEASE_WAIT_US          20000       // wait for downstream to return a frame buffer
+
+typedef struct _MfwGstVPU_FbRelease
+{
+  GAsyncQueue *release_q;       // release queue of the decoder
+  guint tag;                    // FB_RELEASE_TAG of the frame buffer
+  GstElement *parent;           // decoder, its release_cond is signalled
+} MfwGstVPU_FbRelease;
+
 
 typedef struct _MfwGstVPU_Thread
 {
@@ -364,6 +380,8 @@ typedef struct _MfwGstVPU_Dec
   PhysicalAddress end_write;    // End physical address of the input ring buffer 
   guint buff_consumed;          // size of current sink buffer consumed - 0 if consumed 
   guint data_in_vpu;            // size of data in vpu input buffer not processed
+  guint64 bitbuf_written;       // total bytes written into the ring
+  guint64 bitbuf_dropped;       // bytes lost when decoding stopped on an error
 
 
   // Frame buffer members for output
@@ -379,6 +397,12 @@ typedef struct _MfwGstVPU_Dec
   vpu_mem_desc frame_mem[NUM_FRAME_BUF];        // structure for Frame buffer parameters 
   // if not used with V4LSink
   GstBuffer *outbuffers[NUM_FRAME_BUF]; // GST output buffers allocated through V4Lsink
+  gboolean fb_notify[NUM_FRAME_BUF];    // pushed as wrapper which returns the index through release_q
+  gboolean fb_outstanding[NUM_FRAME_BUF];       // wrapper still held downstream
+  GAsyncQueue *release_q;       // FB_RELEASE_TAG of frame buffers returned by downstream
+  GMutex *release_lock;         // protects release_cond
+  GCond *release_cond;          // signalled when a frame buffer is returned or on flush
+  guint fb_generation;          // bumped on every frame buffer allocation
   gboolean direct_render;       // allow VPU buffers to be used for display when using V4L
   gint buf_alignment_h;
   gint buf_alignment_v;
@@ -62,10 +62,57 @@
 static gint thread_mutex_cnt = 0;
 
 
+/*======================================================================================
+FUNCTION:           mfw_gst_vpudec_drain_release_q
+
+DESCRIPTION:        Marks the frame buffers downstream has returned through the
+                    release queue as no longer held downstream
+
+ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
+                    wait_us - time to wait for the first return, 0 to not wait
+
+RETURN VALUE:       gint - number of frame buffers returned
+PRE-CONDITIONS:     None
+POST-CONDITIONS:    None
+IMPORTANT NOTES:    None
+=======================================================================================*/
+static gint
+mfw_gst_vpudec_drain_release_q (MfwGstVPU_Dec * vpu_dec, gulong wait_us)
+{
+  gpointer tag;
+  gint idx;
+  gint numReturned = 0;
+
+  if (wait_us) {
+    GTimeVal timeout;
+    g_get_current_time (&timeout);
+    g_time_val_add (&timeout, wait_us);
+    tag = g_async_queue_timed_pop (vpu_dec->release_q, &timeout);
+  } else {
+    tag = g_async_queue_try_pop (vpu_dec->release_q);
+  }
+
+  while (tag) {
+    idx = FB_RELEASE_TAG_IDX (GPOINTER_TO_UINT (tag));
+    if ((FB_RELEASE_TAG_GEN (GPOINTER_TO_UINT (tag)) ==
+            (vpu_dec->fb_generation & 0xffffff))
+        && (idx >= 0) && (idx < vpu_dec->numframebufs)) {
+      GST_FRAMEDBG (">>VPU_DEC: returned by downstream %d\n", idx);
+      vpu_dec->fb_outstanding[idx] = FALSE;
+      numReturned++;
+    }
+    tag = g_async_queue_try_pop (vpu_dec->release_q);
+  }
+
+  return numReturned;
+}
+
+
 /*======================================================================================
 FUNCTION:           mfw_gst_vpudec_release_buff
 
-DESCRIPTION:        Release buffers that are already displayed
+DESCRIPTION:        Release buffers that are already displayed. Blocks for a
+                    while when none is free and downstream holds some.
 
 ARGUMENTS PASSED:   vpu_dec  - VPU decoder plugins context
 
@@ -81,6 +128,7 @@ mfw_gst_vpudec_release_buff (MfwGstVPU_Dec * vpu_dec)
   gint i = 0;
   int numFreeBufs = 0;
   int numBusyBufs = 0;
+  int numOutstanding = 0;
 
   if (vpu_dec->codec == STD_MJPG || (vpu_dec->handle == NULL)) {
     //GST_DEBUG (">>VPU_DEC: Release buf do nothing because of flush state or MJPEG");
@@ -94,12 +142,24 @@ mfw_gst_vpudec_release_buff (MfwGstVPU_Dec * vpu_dec)
   // are free but the looping allows the downstream v4lsink to display and release buffers
   // so VPU can now use them for decoding.  It is a throttle to force this plugin to wait
   // for more display buffers to be released and used for decoding.
+  // Frame buffers we allocated ourselves are pushed as wrappers which return
+  // their index on release_q when downstream drops them, so only buffers
+  // allocated by the sink need to be checked for their reference count.
+  mfw_gst_vpudec_drain_release_q (vpu_dec, 0);
+
+scan_buffers:
+  numFreeBufs = 0;
+  numBusyBufs = 0;
+  numOutstanding = 0;
   for (i = 0; i < vpu_dec->numframebufs; i++) {
+    if (vpu_dec->fb_outstanding[i])
+      numOutstanding++;
     if (vpu_dec->fb_state_plugin[i] == FB_STATE_ALLOCATED) {
       numFreeBufs++;
       //GST_FRAMEDBG (">>VPU_DEC: already free %d free buf %d busy bufs %d\n", i, numFreeBufs, numBusyBufs);
-    } else if (vpu_dec->outbuffers[i] &&
-        gst_buffer_is_metadata_writable (vpu_dec->outbuffers[i])) {
+    } else if (vpu_dec->fb_notify[i] ? !vpu_dec->fb_outstanding[i] :
+        (vpu_dec->outbuffers[i] &&
+            gst_buffer_is_metadata_writable (vpu_dec->outbuffers[i]))) {
       if ((vpu_dec->fb_state_plugin[i] == FB_STATE_PENDING) ||
           (vpu_dec->fb_state_plugin[i] == FB_STATE_FREE)) {
         GST_FRAMEDBG (">>VPU_DEC: clearing PENDING %d\n", i);   // use for debugging VPU buffer flow
@@ -141,8 +201,11 @@ mfw_gst_vpudec_release_buff (MfwGstVPU_Dec * vpu_dec)
     } else {
       // This is a special case usually only needed after flushing/seeking where the downstream is not unrefing the buffers
       // after a seek so we will do it now - otherwise VPU will be stuck waiting for buffers to decode into
+      // our own wrapped buffers are still held downstream and come back through
+      // the release queue, so they are left alone here
       if ((vpu_dec->fb_state_plugin[i] == FB_STATE_FREE)
-          && vpu_dec->direct_render && (vpu_dec->fb_type[i] == FB_TYPE_GST)) {
+          && vpu_dec->direct_render && (vpu_dec->fb_type[i] == FB_TYPE_GST)
+          && !vpu_dec->fb_notify[i]) {
         gst_buffer_unref (vpu_dec->outbuffers[i]);
         vpu_ret = vpu_DecClrDispFlag (*(vpu_dec->handle), i);
         if (vpu_ret != RETCODE_SUCCESS) {
@@ -162,6 +225,12 @@ mfw_gst_vpudec_release_buff (MfwGstVPU_Dec * vpu_dec)
     }
   }
 
+  // Nothing free but downstream still holds some of our frames - block until
+  // one comes back instead of polling from the decode loop
+  if ((numFreeBufs == 0) && numOutstanding && !vpu_dec->flushing
+      && mfw_gst_vpudec_drain_release_q (vpu_dec, FB_RELEASE_WAIT_US))
+    goto scan_buffers;
+
   //GST_FRAMEDBG (">>VPU_DEC: can decode now - %d buffers are free %d are busy\n", numFreeBufs, numBusyBufs);
   return GST_FLOW_OK;
 }
@@ -52,6 +52,7 @@
 
 #include "gstbufmeta.h"
 #include "mfw_gst_ts.h"
+#include "mfw_gst_nalconv.h"
 
 //#define GST_DEBUG g_print
 //#define GST_FRAMEDBG g_print
@@ -83,7 +84,6 @@ static MfwGstVPU_Enc *vpuenc_global_ptr = NULL;
 #define VPU_PIC_TYPE_IDR ( (vpu_enc->codec == STD_AVC) ? (!(vpu_enc->outputInfo->picType&0x1)) : (VPU_PIC_TYPE == 0))
 #define VPU_PIC_TYPE_I ( VPU_PIC_TYPE_IDR || (VPU_PIC_TYPE == 0))
 #define NALU_HEADER_SIZE    5
-#define AVC_NALU_START_CODE 0x00000001
 
 #ifdef SWAP
 #undef SWAP
@@ -1366,6 +1366,10 @@ mfw_gst_vpuenc_cleanup (MfwGstVPU_Enc * vpu_enc)
     vpu_enc->handle = 0;
     vpu_enc->vpu_init = FALSE;
   }
+  if (vpu_enc->in_frame) {
+    gst_buffer_unref (vpu_enc->in_frame);
+    vpu_enc->in_frame = NULL;
+  }
 
   if (vpu_enc->encOP != NULL) {
     g_free (vpu_enc->encOP);
@@ -1900,7 +1904,9 @@ mfw_gst_vpuenc_copy_sink_start_frame (MfwGstVPU_Enc * vpu_enc)
   }
   // Setup VPU with the input source buffer
   vpu_enc->encParam->sourceFrame = &(vpu_enc->vpuInFrame);
-  if (!vpu_enc->bytes_consumed && IS_DMABLE_BUFFER (vpu_enc->gst_buffer)) {
+  if (!vpu_enc->bytes_consumed && !vpu_enc->gst_copied
+      && IS_DMABLE_BUFFER (vpu_enc->gst_buffer)
+      && (GST_BUFFER_SIZE (vpu_enc->gst_buffer) >= vpu_enc->yuv_frame_size)) {
     GST_DEBUG (">>VPU_ENC:  direct from sink");
     vpu_enc->vpuInFrame.bufY = DMABLE_BUFFER_PHY_ADDR (vpu_enc->gst_buffer);
     if (MFW_GST_VPUENC_PLANAR_Y_V_U == vpu_enc->yuv_planar) {
@@ -1910,8 +1916,13 @@ mfw_gst_vpuenc_copy_sink_start_frame (MfwGstVPU_Enc * vpu_enc)
       vpu_enc->vpuInFrame.bufCb = vpu_enc->vpuInFrame.bufY + vpu_enc->picSizeY;
       vpu_enc->vpuInFrame.bufCr = vpu_enc->vpuInFrame.bufCb + vpu_enc->picSizeC;
     }
-    gst_buffer_unref (vpu_enc->gst_buffer);
+    // VPU reads the frame until the encode completes so keep it from being
+    // recycled upstream until then
+    if (vpu_enc->in_frame)
+      gst_buffer_unref (vpu_enc->in_frame);
+    vpu_enc->in_frame = vpu_enc->gst_buffer;
     vpu_enc->gst_buffer = NULL;
+    to_copy = vpu_enc->yuv_frame_size;
   } else {
     // we must memcpy input
     GST_DEBUG (">>VPU_ENC:  Memcpy %d from input", to_copy);
@@ -1919,7 +1930,7 @@ mfw_gst_vpuenc_copy_sink_start_frame (MfwGstVPU_Enc * vpu_enc)
         (PhysicalAddress) vpu_enc->vpuInFrameDesc.phy_addr;
     if (MFW_GST_VPUENC_PLANAR_Y_V_U == vpu_enc->yuv_planar) {
       vpu_enc->vpuInFrame.bufCr = vpu_enc->vpuInFrame.bufY + vpu_enc->picSizeY;
-      vpu_enc->vpuInFrame.bufCb = vpu_enc->vpuInFrame.bufCb + vpu_enc->picSizeC;
+      vpu_enc->vpuInFrame.bufCb = vpu_enc->vpuInFrame.bufCr + vpu_enc->picSizeC;
     } else {
       vpu_enc->vpuInFrame.bufCb = vpu_enc->vpuInFrame.bufY + vpu_enc->picSizeY;
       vpu_enc->vpuInFrame.bufCr = vpu_enc->vpuInFrame.bufCb + vpu_enc->picSizeC;
@@ -2007,72 +2018,18 @@ mfw_gst_vpuenc_copy_sink_start_frame (MfwGstVPU_Enc * vpu_enc)
 }
 
 
-static guint8 *
-mfw_gst_vpuenc_find_nalu_startcode (guint8 * buffer, guint8 * end)
-{
-  guint8 *buf_pos = buffer;
-  guint8 *buf_end = end;
-  guint32 start_code = -1;
-
-  while (buf_pos < buf_end) {
-    start_code = ((start_code << 8) + (*buf_pos));
-    buf_pos++;
-    if (AVC_NALU_START_CODE == start_code) {
-      break;
-    }
-    /* we suppose VPU encoded H.264 stream has NALU start code size of 4 */
-    if (AVC_NALU_START_CODE == (start_code & 0x00FFFFFF)) {
-      GST_ERROR ("Size of NALU start code == 3 is not support");
-      buf_pos = NULL;
-      break;
-    }
-  }
-
-  return buf_pos;
-}
-
-
 gboolean
 mfw_gst_vpuenc_nalu_stream (guint8 * dst_buf, guint32 dst_size,
     guint8 * src_buf, guint32 src_size)
 {
-  guint8 *src = src_buf;
-  guint32 size = src_size;
-  guint8 *end = src_buf + src_size;
-  guint8 *dst = dst_buf;
-  guint8 *nalu = NULL;
-  guint32 nalu_size = 0;
-  guint8 *nalu_size_ptr = (guint8 *) (&nalu_size);
-  guint32 start_code_size = 0;
-  gboolean ret = TRUE;
-
-  nalu = mfw_gst_vpuenc_find_nalu_startcode (src_buf, end);
-  if (src == NULL) {
+  /* VPU encoded H.264 stream uses start codes, replace them with 4 bytes
+     NALU length */
+  if (mfw_nalconv_annexb_to_length (src_buf, src_size, dst_buf, dst_size) < 0) {
+    GST_ERROR (">>VPU_ENC: Failed to convert NALU start codes to lengths");
     return FALSE;
   }
 
-  while (src < end) {
-    src = mfw_gst_vpuenc_find_nalu_startcode (src, end);
-    if (src == NULL) {
-      ret = FALSE;
-      break;
-    }
-    nalu_size = src - nalu;
-    if (src < end) {
-      nalu_size -= 4;
-    }
-
-    *(dst++) = nalu_size_ptr[3];
-    *(dst++) = nalu_size_ptr[2];
-    *(dst++) = nalu_size_ptr[1];
-    *(dst++) = nalu_size_ptr[0];
-    memcpy (dst, nalu, nalu_size);
-    dst += nalu_size;
-
-    nalu = src;
-  }
-
-  return ret;
+  return TRUE;
 }
 
 
@@ -2216,6 +2173,10 @@ mfw_gst_vpuenc_chain (GstPad * pad, GstBuffer * buffer)
 #endif
 
       vpu_enc->is_frame_started = FALSE;
+      if (vpu_enc->in_frame) {
+        gst_buffer_unref (vpu_enc->in_frame);
+        vpu_enc->in_frame = NULL;
+      }
 
       vpu_enc->num_total_frames++;
       vpu_enc->num_encoded_frames++;
@@ -3637,6 +3598,7 @@ mfw_gst_vpuenc_init (MfwGstVPU_Enc * vpu_enc, MfwGstVPU_EncClass * gclass)
   // State members
   vpu_enc->vpu_init = FALSE;
   vpu_enc->is_frame_started = FALSE;
+  vpu_enc->in_frame = NULL;
 
   // Header members
   vpu_enc->num_total_frames = 0;
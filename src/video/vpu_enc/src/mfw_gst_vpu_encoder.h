@@ -244,6 +244,7 @@ G_BEGIN_DECLS
   guint8 *end_addr;             // end address of hardware input buffer
   guint gst_copied;             // amt copied before previous encode
   GstBuffer *gst_buffer;        // buffer for wrap around to copy remainder after encode frame complete
+  GstBuffer *in_frame;          // physically contiguous input VPU encodes from, held until encode completes
 
 
   // State members